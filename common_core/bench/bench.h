@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// bench.h - Declarations shared by the parts of the common_core benchmark executable
+//
+// The benchmark executable is not part of libcommon_core.so; the bench folder is excluded from
+// the library's source entries.  bench/Makefile builds it, with the library it links against,
+// from the common_core project folder:
+//
+//   make -C bench [CONFIG=Debug|Release] [verify]
+//
+// and run 'bench/Debug/common_core_bench --help' for the options.  Build with
+// CPPFLAGS=-DCOMMON_CORE_TRACK_ALLOCATIONS to get allocations per operation.  Pass --counters to
+// read hardware performance counters; this needs perf_event_paranoid at 2 or lower and a PMU
+// that the kernel exposes (often not the case in containers and VMs).
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+#include "stdafx.h"
+#include "common_core.h"
+
+/**
+ * @brief Maximum number of thread counts that can be given with --threads.
+ */
+#define BENCH_MAX_THREAD_COUNTS     16
+
+/**
+ * @brief Maximum length of a benchmark's parameter description.
+ */
+#define BENCH_PARAMS_SIZE           96
+
+/**
+ * @brief Output formats for the results.
+ */
+typedef enum _BENCH_FORMAT {
+  BENCH_FORMAT_CSV,
+  BENCH_FORMAT_JSON
+} BENCH_FORMAT;
+
+/**
+ * @brief Settings taken from the command line.
+ */
+typedef struct _BENCH_OPTIONS {
+  const char* pszFilter;              /* run only names containing this */
+  size_t nMinSize;                    /* smallest input size, in bytes */
+  size_t nMaxSize;                    /* largest input size, in bytes */
+  int nThreadCounts[BENCH_MAX_THREAD_COUNTS];
+  int nThreadCountCount;
+  double dMinSeconds;                 /* minimum measured time per case */
+  BENCH_FORMAT nFormat;
+  FILE* fpOutput;                     /* where results are written */
+  BOOL bCounters;                     /* read hardware counters */
+  const char* pszTier;                /* kernel tier to label results with,
+                                         or NULL */
+} BENCH_OPTIONS, *LPBENCH_OPTIONS;
+
+/**
+ * @brief Describes one benchmark case: one function with one set of
+ * parameters.  Each thread that runs the case gets its own context.
+ */
+typedef struct _BENCH_CASE {
+  const char* pszName;                /* name of the function measured */
+  char szParams[BENCH_PARAMS_SIZE];   /* e.g., "size=4096,density=0.0156" */
+  size_t nSize;                       /* input size, in bytes */
+  double dDensity;                    /* needle/delimiter density, 0..1 */
+  size_t nBytesPerOp;                 /* bytes processed by one operation */
+  const void* pvData;                 /* for the use of pfnSetup */
+
+  /* Creates a thread's context; called outside the measured region */
+  void* (*pfnSetup)(const struct _BENCH_CASE* pCase);
+
+  /* Runs the operation ullIterations times */
+  void (*pfnRun)(void* pvContext, unsigned long long ullIterations);
+
+  /* Frees a thread's context.  May be NULL if the context is a single
+   * malloc'd block. */
+  void (*pfnTeardown)(void* pvContext);
+} BENCH_CASE, *LPBENCH_CASE;
+
+/**
+ * @brief Context of one microbenchmark thread.
+ */
+typedef struct _MICRO_CONTEXT {
+  size_t nSize;
+  char* pszInput;     /* nSize bytes plus the null */
+  char* pszCopy;      /* identical copy of pszInput */
+  char* pszScratch;   /* nSize + 1 bytes of scratch space */
+  char** ppszTokens;  /* pszInput split on ',' */
+  int nTokens;
+  int* pnValues;      /* nSize / sizeof(int) random integers */
+} MICRO_CONTEXT;
+
+/**
+ * @brief Measurements of one case at one thread count.
+ */
+typedef struct _BENCH_RESULT {
+  char szName[64];
+  char szParams[BENCH_PARAMS_SIZE];
+  int nThreads;
+  unsigned long long ullIterations;   /* per thread */
+  double dNanosecondsPerOp;           /* wall time / iterations per thread */
+  double dBytesPerSecond;             /* across all threads */
+  double dAllocationsPerOp;           /* negative if tracking is disabled */
+  double dP50Nanoseconds;             /* latency percentiles; zero unless */
+  double dP99Nanoseconds;             /* each operation was timed */
+  double dP999Nanoseconds;            /* individually */
+  double dInstructionsPerCycle;       /* hardware counter ratios; negative */
+  double dBranchMissesPerOp;          /* if the counters were not read */
+  double dL1MissesPerByte;
+  double dLlcMissesPerByte;
+} BENCH_RESULT, *LPBENCH_RESULT;
+
+/**
+ * @brief Hardware counters read around a measured run.
+ */
+typedef enum _PERF_COUNTER {
+  PERF_COUNTER_CYCLES,
+  PERF_COUNTER_INSTRUCTIONS,
+  PERF_COUNTER_BRANCH_MISSES,
+  PERF_COUNTER_L1D_MISSES,
+  PERF_COUNTER_LLC_MISSES,
+  PERF_COUNTER_COUNT
+} PERF_COUNTER;
+
+/**
+ * @brief Open counters; a file descriptor of -1 marks a counter that is
+ * unavailable.
+ */
+typedef struct _PERF_COUNTERS {
+  int nFds[PERF_COUNTER_COUNT];
+} PERF_COUNTERS, *LPPERF_COUNTERS;
+
+/**
+ * @brief Counts read by StopPerfCounters, indexed by PERF_COUNTER; -1 for a
+ * counter that is unavailable.
+ */
+typedef struct _PERF_READING {
+  long long llValues[PERF_COUNTER_COUNT];
+} PERF_READING, *LPPERF_READING;
+
+/**
+ * @brief Value that keeps the compiler from discarding the work done by
+ * the benchmark bodies.
+ */
+extern volatile unsigned long long g_ullBenchSink;
+
+/**
+ * @brief Fills in the counter ratios of a result from a reading.
+ * @param dOperations Operations done, across all threads, during the run.
+ * @param dBytes Bytes processed, across all threads, during the run.
+ */
+void ApplyPerfReading(LPBENCH_RESULT pResult, const PERF_READING* pReading,
+    double dOperations, double dBytes);
+
+/**
+ * @brief Marks every counter of a reading unavailable.
+ */
+void ClearPerfReading(LPPERF_READING pReading);
+
+/**
+ * @brief Closes the counters opened by OpenPerfCounters.
+ */
+void ClosePerfCounters(LPPERF_COUNTERS pCounters);
+
+/**
+ * @brief Compares the results of this run against a previously saved
+ * results file in CSV format.
+ * @returns The number of cases that got slower by more than
+ * dThresholdPercent.
+ */
+int CompareWithBaseline(const char* pszBaselinePath, double dThresholdPercent);
+
+/**
+ * @brief Gets the total number of allocations the library has made.
+ * @returns The count, or -1 if the library was built without allocation
+ * tracking.
+ */
+long long CountAllocations(void);
+
+/**
+ * @brief Fills a buffer with random lowercase text and a terminating null,
+ * replacing characters at random with the marker string at the density
+ * specified.
+ * @param pszBuffer Buffer to fill; must hold nSize + 1 bytes.
+ * @param nSize Number of characters to generate.
+ * @param pszMarker String to scatter through the text, e.g., a delimiter or
+ * needle.  May be NULL.
+ * @param dDensity Fraction of positions, 0..1, at which to place pszMarker.
+ * @param nSeed Seed of the random number generator, for reproducibility.
+ */
+void GenerateText(char* pszBuffer, size_t nSize, const char* pszMarker,
+    double dDensity, unsigned int nSeed);
+
+/**
+ * @brief Tells whether a benchmark name passes the --filter option.
+ */
+BOOL IsBenchSelected(const BENCH_OPTIONS* pOptions, const char* pszName);
+
+/**
+ * @brief Opens the hardware counters, disabled, on the calling thread.  They
+ * also count the threads the calling thread creates afterwards, up to when
+ * those threads exit.  Open fresh counters for each measured run; a reset
+ * does not clear the counts of threads that already exited.
+ * @returns The number of counters opened; zero if none are available.  Warns
+ * once on stderr about counters that could not be opened.
+ */
+int OpenPerfCounters(LPPERF_COUNTERS pCounters);
+
+/**
+ * @brief Records a result for saving and baseline comparison, and prints
+ * it in the format chosen.  Adds the kernel tier to the parameters if the
+ * options name one.
+ */
+void ReportBenchResult(const BENCH_OPTIONS* pOptions,
+    const BENCH_RESULT* pResult);
+
+/**
+ * @brief Runs one case at every thread count in the options, and records
+ * and prints the results.
+ */
+void RunBenchCase(const BENCH_OPTIONS* pOptions, const BENCH_CASE* pCase);
+
+/**
+ * @brief Bodies of the microbenchmarks of the inline versions of the
+ * predicates (see common_core_inline.h), built in a file of their own with
+ * COMMON_CORE_INLINE defined.  Each takes a MICRO_CONTEXT.
+ */
+void RunEqualsInline(void* pvContext, unsigned long long ullIterations);
+void RunEqualsNoCaseInline(void* pvContext, unsigned long long ullIterations);
+void RunFreeBufferInline(void* pvContext, unsigned long long ullIterations);
+void RunMinimumOfInline(void* pvContext, unsigned long long ullIterations);
+void RunStartsWithInline(void* pvContext, unsigned long long ullIterations);
+
+/**
+ * @brief Runs the microbenchmark of every public function of common_core.
+ */
+void RunMicroBenchmarks(const BENCH_OPTIONS* pOptions);
+
+/**
+ * @brief Runs the benchmarks of the integer-array reductions, after checking
+ * on each array that they agree with plain loops.
+ * @param pOptions Options of the run; the size options are ignored.
+ * @param nMaxCount Number of values of the largest array.
+ * @returns The number of reductions that disagreed, plus one if an array
+ * could not be generated; zero if all agreed.
+ */
+int RunReduceBenchmarks(const BENCH_OPTIONS* pOptions, size_t nMaxCount);
+
+/**
+ * @brief Runs the end-to-end workload replay benchmarks.
+ * @param pOptions Options of the run; the size options are ignored.
+ * @param pszCorpus Which corpus to replay: "logs", "csv", "config" or "all".
+ * @param pszInputPath File of lines to replay instead of a generated
+ * corpus, or NULL.  Requires a single corpus kind.
+ * @param nLines Number of lines to generate per corpus.
+ * @returns OK on success; ERROR if the corpus could not be loaded.
+ */
+int RunReplayBenchmarks(const BENCH_OPTIONS* pOptions,
+    const char* pszCorpus, const char* pszInputPath, int nLines);
+
+/**
+ * @brief Runs the benchmarks of the string-array sorts against qsort, after
+ * checking on each workload that they sort, and deduplicate, as qsort does.
+ * @param pOptions Options of the run; the size options are ignored.
+ * @param nLines Number of lines to sort.
+ * @returns The number of sorts that disagreed with qsort, plus one if a
+ * workload could not be generated; zero if all agreed.
+ */
+int RunSortBenchmarks(const BENCH_OPTIONS* pOptions, int nLines);
+
+/**
+ * @brief Resets and enables the counters.
+ */
+void StartPerfCounters(const PERF_COUNTERS* pCounters);
+
+/**
+ * @brief Disables the counters and reads them, scaling counts up for any
+ * time the kernel multiplexed a counter off the PMU.
+ */
+void StopPerfCounters(const PERF_COUNTERS* pCounters,
+    LPPERF_READING pReading);
+
+/**
+ * @brief Runs the benchmarks of the data structures (prefix sets, intern
+ * pools, ...) against the plain string code they replace, after checking on
+ * each workload that both give the same answers.
+ * @param pOptions Options of the run; the size options are ignored.
+ * @returns The number of answers that differed; zero if all agreed.
+ */
+int RunStructureBenchmarks(const BENCH_OPTIONS* pOptions);
+
+/**
+ * @brief Checks every kernel tier the machine supports against reference
+ * implementations of the functions that use the kernels, reporting each
+ * tier on stderr.
+ * @returns The number of failed checks.
+ */
+int VerifyKernelTiers(void);
+
+/**
+ * @brief Checks the quality of the string hash (avalanche of every key and
+ * seed bit, collisions among similar keys) and that its streamed, seeded and
+ * case-insensitive forms agree with the one-shot form, reporting on stderr.
+ * @returns The number of failed checks.
+ */
+int VerifyStringHash(void);
+
+/**
+ * @brief Writes every result recorded so far to a file in CSV format, so
+ * that it can serve as the baseline of a later run.
+ * @returns OK on success; ERROR if the file could not be written.
+ */
+int SaveBenchResults(const char* pszPath);
+
+#endif /* __BENCH_H__ */
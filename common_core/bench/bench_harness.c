@@ -0,0 +1,476 @@
+// bench_harness.c - Timing, threading, result recording and baseline comparison for the
+// benchmark executable
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Stack reserved for each benchmark thread beyond what the input size
+ * needs.  Several functions under test copy their input into variable-length
+ * arrays on the stack, so threads get room for a few copies of the input. */
+#define BENCH_BASE_STACK_SIZE   (16UL * 1024 * 1024)
+
+typedef struct _BENCH_THREAD {
+  const BENCH_CASE* pCase;
+  void* pvContext;
+  unsigned long long ullIterations;
+  pthread_barrier_t* pBarrier;
+} BENCH_THREAD;
+
+volatile unsigned long long g_ullBenchSink = 0;
+
+static LPBENCH_RESULT s_pResults = NULL;
+static int s_nResultCount = 0;
+static int s_nResultCapacity = 0;
+static BOOL s_bHeaderPrinted = FALSE;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadClock function - Reads the monotonic clock, in seconds.
+//
+
+static double ReadClock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BenchThreadProc function - Body of each benchmark thread.  Waits for all
+// of them to be ready, then runs the case.
+//
+
+static void* BenchThreadProc(void* pvArg) {
+  BENCH_THREAD* pThread = (BENCH_THREAD*) pvArg;
+
+  pthread_barrier_wait(pThread->pBarrier);
+  pThread->pCase->pfnRun(pThread->pvContext, pThread->ullIterations);
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TimeRun function - Runs a case ullIterations times on each of nThreads
+// threads at once, and returns the elapsed wall-clock time in seconds.  Reads
+// the hardware counters around the run into pReading if pCounters is not
+// NULL.  Exits the program if the threads cannot be started.
+//
+
+static double TimeRun(const BENCH_CASE* pCase, void** ppvContexts,
+    int nThreads, unsigned long long ullIterations,
+    const PERF_COUNTERS* pCounters, LPPERF_READING pReading) {
+  pthread_barrier_t barrier;
+  pthread_barrier_init(&barrier, NULL, nThreads + 1);
+
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, BENCH_BASE_STACK_SIZE + 4 * pCase->nSize);
+
+  pthread_t threads[nThreads];
+  BENCH_THREAD threadArgs[nThreads];
+  int nStarted = 0;
+
+  for (; nStarted < nThreads; nStarted++) {
+    threadArgs[nStarted].pCase = pCase;
+    threadArgs[nStarted].pvContext = ppvContexts[nStarted];
+    threadArgs[nStarted].ullIterations = ullIterations;
+    threadArgs[nStarted].pBarrier = &barrier;
+    if (pthread_create(&threads[nStarted], &attr, BenchThreadProc,
+        &threadArgs[nStarted]) != 0) {
+      break;
+    }
+  }
+
+  pthread_attr_destroy(&attr);
+
+  if (nStarted < nThreads) {
+    fprintf(stderr, "bench: could not start %d threads for %s\n", nThreads,
+        pCase->pszName);
+    exit(ERROR);  // The barrier can never open, so there is no way back
+  }
+
+  if (pCounters != NULL) {
+    StartPerfCounters(pCounters);
+  }
+
+  pthread_barrier_wait(&barrier);
+  double dStart = ReadClock();
+
+  for (int i = 0; i < nThreads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  double dElapsed = ReadClock() - dStart;
+  pthread_barrier_destroy(&barrier);
+
+  if (pCounters != NULL) {
+    StopPerfCounters(pCounters, pReading);
+  }
+
+  return dElapsed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CalibrateIterations function - Finds how many iterations a single thread
+// needs to run for the minimum measurement time.
+//
+
+static unsigned long long CalibrateIterations(const BENCH_OPTIONS* pOptions,
+    const BENCH_CASE* pCase, void* pvContext) {
+  unsigned long long ullIterations = 1;
+
+  for (;;) {
+    double dElapsed = TimeRun(pCase, &pvContext, 1, ullIterations, NULL,
+        NULL);
+    if (dElapsed >= pOptions->dMinSeconds / 10
+        || ullIterations >= (1ULL << 40)) {
+      double dWanted = ullIterations * pOptions->dMinSeconds
+          / (dElapsed > 0 ? dElapsed : 1e-9);
+      return dWanted < 1 ? 1 : (unsigned long long) dWanted;
+    }
+    ullIterations *= 4;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FormatPercentiles function - Formats the latency percentiles of a result
+// as CSV fields, left empty if the result has none.
+//
+
+static void FormatPercentiles(char* pszBuffer, size_t nSize,
+    const BENCH_RESULT* pResult) {
+  if (pResult->dP50Nanoseconds <= 0) {
+    snprintf(pszBuffer, nSize, ",,");
+    return;
+  }
+
+  snprintf(pszBuffer, nSize, "%.1f,%.1f,%.1f", pResult->dP50Nanoseconds,
+      pResult->dP99Nanoseconds, pResult->dP999Nanoseconds);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FormatCounterRatios function - Formats the hardware counter ratios of a
+// result as CSV fields, each left empty if its counters were not read.
+//
+
+static void FormatCounterRatios(char* pszBuffer, size_t nSize,
+    const BENCH_RESULT* pResult) {
+  const double RATIOS[] = { pResult->dInstructionsPerCycle,
+      pResult->dBranchMissesPerOp, pResult->dL1MissesPerByte,
+      pResult->dLlcMissesPerByte };
+  size_t nLength = 0;
+
+  pszBuffer[0] = '\0';
+  for (size_t i = 0; i < sizeof(RATIOS) / sizeof(RATIOS[0]); i++) {
+    if (RATIOS[i] >= 0) {
+      nLength += snprintf(pszBuffer + nLength, nSize - nLength, "%s%.4f",
+          i > 0 ? "," : "", RATIOS[i]);
+    } else {
+      nLength += snprintf(pszBuffer + nLength, nSize - nLength, "%s",
+          i > 0 ? "," : "");
+    }
+    if (nLength >= nSize) {
+      return;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RecordResult function - Appends a result to the list kept for saving and
+// for comparison with a baseline.
+//
+
+static void RecordResult(const BENCH_RESULT* pResult) {
+  if (s_nResultCount == s_nResultCapacity) {
+    int nNewCapacity = s_nResultCapacity == 0 ? 64 : s_nResultCapacity * 2;
+    LPBENCH_RESULT pNewResults = (LPBENCH_RESULT) realloc(s_pResults,
+        nNewCapacity * sizeof(BENCH_RESULT));
+    if (pNewResults == NULL) {
+      return;
+    }
+    s_pResults = pNewResults;
+    s_nResultCapacity = nNewCapacity;
+  }
+
+  s_pResults[s_nResultCount++] = *pResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PrintResult function - Writes a result in the format chosen.
+//
+
+static void PrintResult(const BENCH_OPTIONS* pOptions,
+    const BENCH_RESULT* pResult) {
+  if (pOptions->nFormat == BENCH_FORMAT_JSON) {
+    fprintf(pOptions->fpOutput, "{\"benchmark\":\"%s\",\"params\":\"%s\","
+        "\"threads\":%d,\"iterations\":%llu,\"ns_per_op\":%.3f,"
+        "\"bytes_per_sec\":%.0f,\"allocs_per_op\":%.3f,\"p50_ns\":%.1f,"
+        "\"p99_ns\":%.1f,\"p999_ns\":%.1f,\"ipc\":%.4f,"
+        "\"branch_misses_per_op\":%.4f,\"l1d_misses_per_byte\":%.4f,"
+        "\"llc_misses_per_byte\":%.4f}\n",
+        pResult->szName, pResult->szParams, pResult->nThreads,
+        pResult->ullIterations, pResult->dNanosecondsPerOp,
+        pResult->dBytesPerSecond, pResult->dAllocationsPerOp,
+        pResult->dP50Nanoseconds, pResult->dP99Nanoseconds,
+        pResult->dP999Nanoseconds, pResult->dInstructionsPerCycle,
+        pResult->dBranchMissesPerOp, pResult->dL1MissesPerByte,
+        pResult->dLlcMissesPerByte);
+    fflush(pOptions->fpOutput);
+    return;
+  }
+
+  if (!s_bHeaderPrinted) {
+    fprintf(pOptions->fpOutput, "benchmark,params,threads,iterations,"
+        "ns_per_op,bytes_per_sec,allocs_per_op,p50_ns,p99_ns,p999_ns,ipc,"
+        "branch_misses_per_op,l1d_misses_per_byte,llc_misses_per_byte\n");
+    s_bHeaderPrinted = TRUE;
+  }
+
+  char szPercentiles[64];
+  FormatPercentiles(szPercentiles, sizeof(szPercentiles), pResult);
+  char szCounterRatios[96];
+  FormatCounterRatios(szCounterRatios, sizeof(szCounterRatios), pResult);
+
+  fprintf(pOptions->fpOutput, "%s,%s,%d,%llu,%.3f,%.0f,%.3f,%s,%s\n",
+      pResult->szName, pResult->szParams, pResult->nThreads,
+      pResult->ullIterations, pResult->dNanosecondsPerOp,
+      pResult->dBytesPerSecond, pResult->dAllocationsPerOp, szPercentiles,
+      szCounterRatios);
+  fflush(pOptions->fpOutput);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindResult function - Looks up a result of this run by case and thread
+// count.
+//
+
+static LPBENCH_RESULT FindResult(const char* pszName, const char* pszParams,
+    int nThreads) {
+  for (int i = 0; i < s_nResultCount; i++) {
+    if (Equals(s_pResults[i].szName, pszName)
+        && Equals(s_pResults[i].szParams, pszParams)
+        && s_pResults[i].nThreads == nThreads) {
+      return &s_pResults[i];
+    }
+  }
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// CountAllocations function
+
+long long CountAllocations(void) {
+  if (!IsAllocationTrackingEnabled()) {
+    return -1;
+  }
+
+  long long llResult = 0;
+  for (int i = 0; i < CORE_ALLOC_SITE_COUNT; i++) {
+    CORE_ALLOC_STATS stats;
+    GetAllocationStats((CORE_ALLOC_SITE) i, &stats);
+    llResult += stats.ullAllocations;
+  }
+
+  return llResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompareWithBaseline function
+
+int CompareWithBaseline(const char* pszBaselinePath,
+    double dThresholdPercent) {
+  FILE* fp = fopen(pszBaselinePath, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "bench: cannot open baseline '%s'\n", pszBaselinePath);
+    return 0;
+  }
+
+  int nRegressions = 0;
+  char szLine[512];
+
+  fprintf(stderr, "\n%-28s %-40s %4s %14s %14s %9s\n", "benchmark", "params",
+      "thr", "baseline ns", "current ns", "change");
+
+  while (fgets(szLine, sizeof(szLine), fp) != NULL) {
+    char szName[64], szParams[BENCH_PARAMS_SIZE];
+    int nThreads;
+    unsigned long long ullIterations;
+    double dNanosecondsPerOp;
+
+    if (sscanf(szLine, "%63[^,],%95[^,],%d,%llu,%lf", szName, szParams,
+        &nThreads, &ullIterations, &dNanosecondsPerOp) != 5) {
+      continue;   // The header, or a line we cannot read
+    }
+
+    LPBENCH_RESULT pCurrent = FindResult(szName, szParams, nThreads);
+    if (pCurrent == NULL || dNanosecondsPerOp <= 0) {
+      continue;
+    }
+
+    double dChange = 100.0 * (pCurrent->dNanosecondsPerOp - dNanosecondsPerOp)
+        / dNanosecondsPerOp;
+    BOOL bRegressed = dChange > dThresholdPercent;
+    if (bRegressed) {
+      nRegressions++;
+    }
+
+    fprintf(stderr, "%-28s %-40s %4d %14.3f %14.3f %+8.1f%%%s\n", szName,
+        szParams, nThreads, dNanosecondsPerOp, pCurrent->dNanosecondsPerOp,
+        dChange, bRegressed ? "  REGRESSION" : "");
+  }
+
+  fclose(fp);
+  return nRegressions;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateText function
+
+void GenerateText(char* pszBuffer, size_t nSize, const char* pszMarker,
+    double dDensity, unsigned int nSeed) {
+  size_t nMarkerLength = pszMarker == NULL ? 0 : strlen(pszMarker);
+  unsigned int nThreshold = (unsigned int) (dDensity * RAND_MAX);
+
+  for (size_t i = 0; i < nSize; i++) {
+    int nRandom = rand_r(&nSeed);
+    if (nMarkerLength > 0 && (unsigned int) nRandom < nThreshold
+        && i + nMarkerLength <= nSize) {
+      memcpy(&pszBuffer[i], pszMarker, nMarkerLength);
+      i += nMarkerLength - 1;
+      continue;
+    }
+    pszBuffer[i] = 'a' + (nRandom >> 8) % 26;
+  }
+
+  pszBuffer[nSize] = '\0';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsBenchSelected function
+
+BOOL IsBenchSelected(const BENCH_OPTIONS* pOptions, const char* pszName) {
+  return pOptions->pszFilter == NULL
+      || strstr(pszName, pOptions->pszFilter) != NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReportBenchResult function
+
+void ReportBenchResult(const BENCH_OPTIONS* pOptions,
+    const BENCH_RESULT* pResult) {
+  BENCH_RESULT result = *pResult;
+
+  if (pOptions->pszTier != NULL) {
+    const size_t LENGTH = strlen(result.szParams);
+    snprintf(result.szParams + LENGTH, sizeof(result.szParams) - LENGTH,
+        "%stier=%s", LENGTH > 0 ? ";" : "", pOptions->pszTier);
+  }
+
+  RecordResult(&result);
+  PrintResult(pOptions, &result);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RunBenchCase function
+
+void RunBenchCase(const BENCH_OPTIONS* pOptions, const BENCH_CASE* pCase) {
+  if (!IsBenchSelected(pOptions, pCase->pszName)) {
+    return;
+  }
+
+  for (int t = 0; t < pOptions->nThreadCountCount; t++) {
+    const int THREADS = pOptions->nThreadCounts[t];
+
+    void* pvContexts[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+      pvContexts[i] = pCase->pfnSetup(pCase);
+      if (pvContexts[i] == NULL) {
+        fprintf(stderr, "bench: setup failed for %s %s\n", pCase->pszName,
+            pCase->szParams);
+        exit(ERROR);
+      }
+    }
+
+    unsigned long long ullIterations =
+        CalibrateIterations(pOptions, pCase, pvContexts[0]);
+
+    PERF_COUNTERS counters;
+    PERF_READING reading;
+    ClearPerfReading(&reading);
+    const BOOL COUNTERS = pOptions->bCounters
+        && OpenPerfCounters(&counters) > 0;
+
+    long long llAllocationsBefore = CountAllocations();
+    double dElapsed = TimeRun(pCase, pvContexts, THREADS, ullIterations,
+        COUNTERS ? &counters : NULL, &reading);
+    long long llAllocationsAfter = CountAllocations();
+
+    if (COUNTERS) {
+      ClosePerfCounters(&counters);
+    }
+
+    BENCH_RESULT result;
+    memset(&result, 0, sizeof(result));
+    snprintf(result.szName, sizeof(result.szName), "%s", pCase->pszName);
+    snprintf(result.szParams, sizeof(result.szParams), "%s",
+        pCase->szParams);
+    result.nThreads = THREADS;
+    result.ullIterations = ullIterations;
+    result.dNanosecondsPerOp = dElapsed * 1e9 / ullIterations;
+    result.dBytesPerSecond = dElapsed > 0
+        ? (double) pCase->nBytesPerOp * ullIterations * THREADS / dElapsed
+        : 0;
+    result.dAllocationsPerOp = llAllocationsBefore < 0
+        ? -1
+        : (double) (llAllocationsAfter - llAllocationsBefore)
+            / ((double) ullIterations * THREADS);
+    ApplyPerfReading(&result, &reading, (double) ullIterations * THREADS,
+        (double) pCase->nBytesPerOp * ullIterations * THREADS);
+
+    ReportBenchResult(pOptions, &result);
+
+    for (int i = 0; i < THREADS; i++) {
+      if (pCase->pfnTeardown != NULL) {
+        pCase->pfnTeardown(pvContexts[i]);
+      } else {
+        free(pvContexts[i]);
+      }
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SaveBenchResults function
+
+int SaveBenchResults(const char* pszPath) {
+  FILE* fp = fopen(pszPath, "w");
+  if (fp == NULL) {
+    return ERROR;
+  }
+
+  fprintf(fp, "benchmark,params,threads,iterations,ns_per_op,bytes_per_sec,"
+      "allocs_per_op,p50_ns,p99_ns,p999_ns,ipc,branch_misses_per_op,"
+      "l1d_misses_per_byte,llc_misses_per_byte\n");
+  for (int i = 0; i < s_nResultCount; i++) {
+    char szPercentiles[64];
+    FormatPercentiles(szPercentiles, sizeof(szPercentiles), &s_pResults[i]);
+    char szCounterRatios[96];
+    FormatCounterRatios(szCounterRatios, sizeof(szCounterRatios),
+        &s_pResults[i]);
+
+    fprintf(fp, "%s,%s,%d,%llu,%.3f,%.0f,%.3f,%s,%s\n", s_pResults[i].szName,
+        s_pResults[i].szParams, s_pResults[i].nThreads,
+        s_pResults[i].ullIterations, s_pResults[i].dNanosecondsPerOp,
+        s_pResults[i].dBytesPerSecond, s_pResults[i].dAllocationsPerOp,
+        szPercentiles, szCounterRatios);
+  }
+
+  return fclose(fp) == 0 ? OK : ERROR;
+}
@@ -0,0 +1,245 @@
+// bench_hash.c - Quality checks of the string hash: avalanche, collisions among similar keys,
+// and agreement between the one-shot, seeded, streamed and case-insensitive forms
+//
+// The avalanche check follows SMHasher's: flipping any one bit of the key (or of the seed)
+// should flip each bit of the hash with probability 1/2.  Each (input bit, output bit) cell is
+// tested against the number of trials with a six-sigma bound, so that the check does not fail by
+// chance yet catches real biases.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define AVALANCHE_MAX_LENGTH          128
+#define COLLISION_KEY_COUNT           (1 << 20)
+
+/* Key lengths around every boundary of the hash: 3/4, 8, 16, 48 and 96 */
+static const int s_nAvalancheLengths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16,
+    17, 31, 32, 33, 47, 48, 49, 63, 64, 95, 96, 97, 128 };
+
+#define COUNT_OF(array)   (sizeof(array) / sizeof((array)[0]))
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+static uint64_t NextRandom(uint64_t* pullState) {
+  /* splitmix64 */
+  uint64_t z = (*pullState += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+static int CompareHashes(const void* pvLeft, const void* pvRight) {
+  const uint64_t LEFT = *(const uint64_t*) pvLeft;
+  const uint64_t RIGHT = *(const uint64_t*) pvRight;
+  return (LEFT > RIGHT) - (LEFT < RIGHT);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckAvalanche function - Flips each bit of random keys of nLength bytes,
+// and of the seed, and counts how often each bit of the hash flips.
+// Returns the number of cells outside the bound, after printing the worst
+// bias seen.
+//
+
+static int CheckAvalanche(int nLength, int nTrials, uint64_t* pullRandom) {
+  const int INPUT_BITS = nLength * 8 + 64;
+  unsigned int* pnFlips = (unsigned int*) calloc((size_t) INPUT_BITS * 64,
+      sizeof(unsigned int));
+  if (pnFlips == NULL) {
+    return 1;
+  }
+
+  unsigned char key[AVALANCHE_MAX_LENGTH];
+  for (int t = 0; t < nTrials; t++) {
+    for (int i = 0; i < nLength; i++) {
+      key[i] = (unsigned char) NextRandom(pullRandom);
+    }
+    const uint64_t SEED = NextRandom(pullRandom);
+    const uint64_t HASH = HashBytesSeeded(key, nLength, SEED);
+
+    for (int nBit = 0; nBit < INPUT_BITS; nBit++) {
+      uint64_t ullFlipped;
+      if (nBit < nLength * 8) {
+        key[nBit / 8] ^= (unsigned char) (1 << (nBit % 8));
+        ullFlipped = HashBytesSeeded(key, nLength, SEED) ^ HASH;
+        key[nBit / 8] ^= (unsigned char) (1 << (nBit % 8));
+      } else {
+        ullFlipped = HashBytesSeeded(key, nLength,
+            SEED ^ (1ULL << (nBit - nLength * 8))) ^ HASH;
+      }
+
+      for (int j = 0; j < 64; j++) {
+        pnFlips[nBit * 64 + j] += (ullFlipped >> j) & 1;
+      }
+    }
+  }
+
+  /* Six standard deviations of a binomial(nTrials, 1/2) */
+  const double BOUND = 6.0 * sqrt((double) nTrials) / 2.0;
+  double dWorstBias = 0;
+  int nFailures = 0;
+  for (int i = 0; i < INPUT_BITS * 64; i++) {
+    const double DEVIATION = fabs(pnFlips[i] - nTrials / 2.0);
+    if (DEVIATION > BOUND) {
+      nFailures++;
+    }
+    if (DEVIATION / nTrials * 2 > dWorstBias) {
+      dWorstBias = DEVIATION / nTrials * 2;
+    }
+  }
+
+  fprintf(stderr, "verify: hash avalanche, %3d-byte keys: worst bias %.2f%% "
+      "(%d trials)%s\n", nLength, dWorstBias * 100, nTrials,
+      nFailures == 0 ? "" : "  FAILED");
+  free(pnFlips);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckCollisions function - Hashes a million keys that differ in a few
+// characters, as generated IDs and counters do, and counts the collisions
+// of the full hash and of its low and high 32 bits against what a random
+// function would give.  Returns the number of checks failed.
+//
+
+static int CheckCollisions(const char* pszFormat) {
+  uint64_t* pullHashes = (uint64_t*) malloc(COLLISION_KEY_COUNT
+      * sizeof(uint64_t));
+  uint64_t* pullHalves = (uint64_t*) malloc(COLLISION_KEY_COUNT
+      * sizeof(uint64_t));
+  if (pullHashes == NULL || pullHalves == NULL) {
+    free(pullHashes);
+    free(pullHalves);
+    return 1;
+  }
+
+  for (int i = 0; i < COLLISION_KEY_COUNT; i++) {
+    char szKey[64];
+    const int LENGTH = snprintf(szKey, sizeof(szKey), pszFormat, i);
+    pullHashes[i] = HashBytes(szKey, LENGTH);
+  }
+
+  /* n^2 / 2^33 collisions are expected among n random 32-bit values */
+  const double EXPECTED = (double) COLLISION_KEY_COUNT * COLLISION_KEY_COUNT
+      / 8589934592.0;
+  int nCollisions[3] = { 0, 0, 0 };
+  for (int nPart = 0; nPart < 3; nPart++) {
+    for (int i = 0; i < COLLISION_KEY_COUNT; i++) {
+      pullHalves[i] = nPart == 0 ? pullHashes[i]
+          : nPart == 1 ? (pullHashes[i] & 0xffffffffULL)
+          : (pullHashes[i] >> 32);
+    }
+    qsort(pullHalves, COLLISION_KEY_COUNT, sizeof(uint64_t), CompareHashes);
+    for (int i = 1; i < COLLISION_KEY_COUNT; i++) {
+      nCollisions[nPart] += pullHalves[i] == pullHalves[i - 1];
+    }
+  }
+
+  const int FAILURES = (nCollisions[0] > 0)
+      + (nCollisions[1] > 2 * EXPECTED + 10)
+      + (nCollisions[2] > 2 * EXPECTED + 10);
+  fprintf(stderr, "verify: hash collisions, keys \"%s\": %d in 64 bits, "
+      "%d and %d in the low and high 32 bits (%.0f expected)%s\n", pszFormat,
+      nCollisions[0], nCollisions[1], nCollisions[2], EXPECTED,
+      FAILURES == 0 ? "" : "  FAILED");
+
+  free(pullHashes);
+  free(pullHalves);
+  return FAILURES;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckForms function - Checks that streaming, in pieces of every size,
+// gives the one-shot hash; that the case-insensitive forms hash the folded
+// bytes; and that seeds change the hash.  Returns the number of failures.
+//
+
+static int CheckForms(uint64_t* pullRandom) {
+  unsigned char data[1024];
+  unsigned char folded[1024];
+  int nFailures = 0;
+
+  for (size_t i = 0; i < sizeof(data); i++) {
+    data[i] = (unsigned char) NextRandom(pullRandom);
+    folded[i] = data[i] >= 'A' && data[i] <= 'Z' ? data[i] + 32 : data[i];
+  }
+
+  for (size_t nLength = 0; nLength <= sizeof(data); nLength++) {
+    const uint64_t SEED = NextRandom(pullRandom);
+    const uint64_t EXPECTED = HashBytesSeeded(data, nLength, SEED);
+
+    /* Random piece sizes, biased towards the stripe and buffer edges */
+    STRING_HASH_STATE state;
+    STRING_HASH_STATE foldingState;
+    BeginStringHash(&state, SEED);
+    BeginStringHash(&foldingState, SEED);
+    for (size_t nDone = 0; nDone < nLength; ) {
+      size_t nPiece = NextRandom(pullRandom) % 4 == 0
+          ? 47 + NextRandom(pullRandom) % 3 : NextRandom(pullRandom) % 130;
+      if (nPiece > nLength - nDone) {
+        nPiece = nLength - nDone;
+      }
+      UpdateStringHash(&state, data + nDone, nPiece);
+      UpdateStringHashNoCase(&foldingState, data + nDone, nPiece);
+      nDone += nPiece;
+    }
+
+    const char* pszFailed = NULL;
+    if (EndStringHash(&state) != EXPECTED) {
+      pszFailed = "UpdateStringHash";
+    } else if (EndStringHash(&foldingState)
+        != HashBytesSeeded(folded, nLength, SEED)) {
+      pszFailed = "UpdateStringHashNoCase";
+    } else if (HashBytesNoCaseSeeded(data, nLength, SEED)
+        != HashBytesSeeded(folded, nLength, SEED)
+        || HashBytesNoCase(data, nLength) != HashBytes(folded, nLength)) {
+      pszFailed = "HashBytesNoCase";
+    } else if (HashBytesSeeded(data, nLength, SEED ^ 1) == EXPECTED
+        || HashBytesSeeded(data, nLength, STRING_HASH_DEFAULT_SEED)
+            != HashBytes(data, nLength)) {
+      pszFailed = "HashBytesSeeded";
+    }
+
+    if (pszFailed != NULL && nFailures++ < 5) {
+      fprintf(stderr, "verify: %s gives the wrong hash of %zu bytes\n",
+          pszFailed, nLength);
+    }
+  }
+
+  if (HashString("Content-Type") != HashBytes("Content-Type", 12)
+      || HashStringNoCase("Content-Type") != HashString("content-type")
+      || HashString(NULL) != HashBytes(NULL, 0)) {
+    fprintf(stderr, "verify: HashString or HashStringNoCase disagrees with "
+        "HashBytes\n");
+    nFailures++;
+  }
+
+  fprintf(stderr, "verify: hash forms %s\n", nFailures == 0 ? "ok" : "FAILED");
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// VerifyStringHash function
+
+int VerifyStringHash(void) {
+  uint64_t ullRandom = 20191017;
+  int nFailures = CheckForms(&ullRandom);
+
+  for (size_t i = 0; i < COUNT_OF(s_nAvalancheLengths); i++) {
+    const int LENGTH = s_nAvalancheLengths[i];
+    nFailures += CheckAvalanche(LENGTH, LENGTH <= 16 ? 20000 : 4000,
+        &ullRandom);
+  }
+
+  nFailures += CheckCollisions("%d");
+  nFailures += CheckCollisions("key-%08d");
+  nFailures += CheckCollisions("user:%d:session");
+
+  return nFailures;
+}
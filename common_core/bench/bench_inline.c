@@ -0,0 +1,57 @@
+// bench_inline.c - Microbenchmark bodies for the inline versions of the trivial predicates
+//
+// These are the same bodies as their counterparts in bench_micro.c, but this file is compiled
+// with COMMON_CORE_INLINE defined, so the calls below expand to common_core_inline.h.
+
+#define COMMON_CORE_INLINE
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark bodies
+
+void RunEqualsInline(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += Equals(pContext->pszInput, pContext->pszCopy);
+  }
+}
+
+void RunEqualsNoCaseInline(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += EqualsNoCase(pContext->pszInput, pContext->pszCopy);
+  }
+}
+
+void RunFreeBufferInline(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    void* pvBlock = malloc(pContext->nSize);
+    g_ullBenchSink += (uintptr_t) pvBlock & 1;
+    FreeBuffer(&pvBlock);
+  }
+}
+
+void RunMinimumOfInline(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  const size_t COUNT = pContext->nSize / sizeof(int);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    int nMinimum = INT_MAX;
+    for (size_t j = 0; j < COUNT; j++) {
+      nMinimum = MinimumOf(nMinimum, pContext->pnValues[j]);
+    }
+    g_ullBenchSink += nMinimum;
+  }
+}
+
+void RunStartsWithInline(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szPrefix[5];
+  memcpy(szPrefix, pContext->pszInput, 4);
+  szPrefix[4] = '\0';
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += StartsWith(pContext->pszInput, szPrefix);
+  }
+}
@@ -0,0 +1,264 @@
+// bench_main.c - Entry point of the common_core benchmark executable
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// PrintUsage function
+
+static void PrintUsage(const char* pszProgram) {
+  fprintf(stderr,
+      "Usage: %s [micro|reduce|replay|sort|structures|verify] [options]\n"
+      "\n"
+      "  micro                measure each public function (the default)\n"
+      "  reduce               measure the minimum, maximum, index of the\n"
+      "                       minimum, sum and clamp of int, int64_t and\n"
+      "                       size_t arrays against a loop of MinimumOf\n"
+      "  replay               run end-to-end pipelines over log, CSV and\n"
+      "                       key=value config corpora\n"
+      "  sort                 measure the string-array sorts, with and\n"
+      "                       without deduplication, against qsort on log\n"
+      "                       lines, paths and words\n"
+      "  structures           measure the data structures (prefix sets,\n"
+      "                       intern pools, string maps, set operations,\n"
+      "                       string indexes, Bloom filters, mapped\n"
+      "                       files) against the string code they replace\n"
+      "  verify               check every kernel tier this CPU supports\n"
+      "                       against reference code, and the quality of\n"
+      "                       the string hash\n"
+      "\n"
+      "  --filter TEXT        run only benchmarks whose name contains TEXT\n"
+      "  --min-size BYTES     smallest input size (default 8)\n"
+      "  --max-size BYTES     largest input size (default 67108864)\n"
+      "  --threads N[,N...]   thread counts to run each case at (default 1)\n"
+      "  --min-time SECONDS   minimum measured time per case (default 0.2)\n"
+      "  --format csv|json    output format (default csv)\n"
+      "  --output FILE        write results to FILE instead of stdout\n"
+      "  --save FILE          also save the results as a CSV baseline\n"
+      "  --baseline FILE      compare the results against a saved baseline\n"
+      "  --threshold PERCENT  slowdown counted as a regression (default 5)\n"
+      "  --tier NAME|all      run on kernel tier NAME (scalar, sse42, avx2,\n"
+      "                       avx512) or on every supported tier in turn\n"
+      "  --counters           read hardware counters (cycles, instructions,\n"
+      "                       branch and cache misses) and report IPC and\n"
+      "                       misses per operation and per byte\n"
+      "\n"
+      "Replay options:\n"
+      "  --corpus KIND        logs, csv, config or all (default all)\n"
+      "  --input FILE         replay the lines of FILE as corpus KIND\n"
+      "  --lines N            lines to generate per corpus (default 100000;\n"
+      "                       1000000 for sort)\n"
+      "\n"
+      "Reduce options:\n"
+      "  --max-count N        values in the largest array, from 1000 up in\n"
+      "                       steps of ten (default 100000000)\n"
+      "\n"
+      "Exits with status 1 if any case regressed against the baseline, or if\n"
+      "any tier, structure, sort or reduction failed verification.\n",
+      pszProgram);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ParseThreadCounts function - Parses a comma-separated list of thread
+// counts into the options.  Returns FALSE if the list is invalid.
+//
+
+static BOOL ParseThreadCounts(LPBENCH_OPTIONS pOptions, char* pszList) {
+  char** ppszCounts = NULL;
+  int nCounts = 0;
+
+  Split(pszList, (int) strlen(pszList), ",", &ppszCounts, &nCounts);
+  if (nCounts <= 0 || nCounts > BENCH_MAX_THREAD_COUNTS) {
+    FreeStringArray(&ppszCounts, nCounts);
+    return FALSE;
+  }
+
+  BOOL bResult = TRUE;
+  for (int i = 0; i < nCounts; i++) {
+    if (!IsNumeric(ppszCounts[i]) || atoi(ppszCounts[i]) <= 0) {
+      bResult = FALSE;
+      break;
+    }
+    pOptions->nThreadCounts[i] = atoi(ppszCounts[i]);
+  }
+  pOptions->nThreadCountCount = bResult ? nCounts : 0;
+
+  FreeStringArray(&ppszCounts, nCounts);
+  return bResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ParseTiers function - Turns the --tier option into the range of tiers to
+// run on.  Returns FALSE if the tier is unknown or this CPU lacks it.
+//
+
+static BOOL ParseTiers(const char* pszTier, int* pnFirstTier,
+    int* pnLastTier) {
+  if (EqualsNoCase(pszTier, "all")) {
+    *pnFirstTier = CORE_CPU_TIER_SCALAR;
+    *pnLastTier = GetSupportedCoreCpuTier();
+    return TRUE;
+  }
+
+  for (int i = 0; i < CORE_CPU_TIER_COUNT; i++) {
+    if (EqualsNoCase(pszTier, GetCoreCpuTierName((CORE_CPU_TIER) i))) {
+      if (i > (int) GetSupportedCoreCpuTier()) {
+        fprintf(stderr, "bench: this CPU does not support tier '%s'\n",
+            pszTier);
+        return FALSE;
+      }
+      *pnFirstTier = *pnLastTier = i;
+      return TRUE;
+    }
+  }
+
+  fprintf(stderr, "bench: unknown tier '%s'\n", pszTier);
+  return FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// main function
+
+int main(int argc, char* argv[]) {
+  BENCH_OPTIONS options;
+  memset(&options, 0, sizeof(options));
+  options.nMinSize = 8;
+  options.nMaxSize = 64UL * 1024 * 1024;
+  options.nThreadCounts[0] = 1;
+  options.nThreadCountCount = 1;
+  options.dMinSeconds = 0.2;
+  options.nFormat = BENCH_FORMAT_CSV;
+  options.fpOutput = stdout;
+
+  const char* pszMode = "micro";
+  const char* pszSavePath = NULL;
+  const char* pszBaselinePath = NULL;
+  double dThresholdPercent = 5.0;
+  const char* pszCorpus = "all";
+  const char* pszInputPath = NULL;
+  int nLines = 0;
+  size_t nMaxCount = 100000000;
+  const char* pszTier = NULL;
+
+  for (int i = 1; i < argc; i++) {
+    const BOOL HAS_VALUE = i + 1 < argc;
+
+    if (Equals(argv[i], "--help") || Equals(argv[i], "-h")) {
+      PrintUsage(argv[0]);
+      return OK;
+    } else if (Equals(argv[i], "--filter") && HAS_VALUE) {
+      options.pszFilter = argv[++i];
+    } else if (Equals(argv[i], "--min-size") && HAS_VALUE) {
+      options.nMinSize = strtoull(argv[++i], NULL, 10);
+    } else if (Equals(argv[i], "--max-size") && HAS_VALUE) {
+      options.nMaxSize = strtoull(argv[++i], NULL, 10);
+    } else if (Equals(argv[i], "--threads") && HAS_VALUE) {
+      if (!ParseThreadCounts(&options, argv[++i])) {
+        PrintUsage(argv[0]);
+        return ERROR;
+      }
+    } else if (Equals(argv[i], "--min-time") && HAS_VALUE) {
+      options.dMinSeconds = atof(argv[++i]);
+    } else if (Equals(argv[i], "--format") && HAS_VALUE) {
+      i++;
+      options.nFormat = EqualsNoCase(argv[i], "json")
+          ? BENCH_FORMAT_JSON : BENCH_FORMAT_CSV;
+    } else if (Equals(argv[i], "--output") && HAS_VALUE) {
+      options.fpOutput = fopen(argv[++i], "w");
+      if (options.fpOutput == NULL) {
+        fprintf(stderr, "bench: cannot write '%s'\n", argv[i]);
+        return ERROR;
+      }
+    } else if (Equals(argv[i], "--save") && HAS_VALUE) {
+      pszSavePath = argv[++i];
+    } else if (Equals(argv[i], "--baseline") && HAS_VALUE) {
+      pszBaselinePath = argv[++i];
+    } else if (Equals(argv[i], "--threshold") && HAS_VALUE) {
+      dThresholdPercent = atof(argv[++i]);
+    } else if (Equals(argv[i], "--tier") && HAS_VALUE) {
+      pszTier = argv[++i];
+    } else if (Equals(argv[i], "--counters")) {
+      options.bCounters = TRUE;
+    } else if (Equals(argv[i], "--corpus") && HAS_VALUE) {
+      pszCorpus = argv[++i];
+    } else if (Equals(argv[i], "--input") && HAS_VALUE) {
+      pszInputPath = argv[++i];
+    } else if (Equals(argv[i], "--lines") && HAS_VALUE) {
+      nLines = atoi(argv[++i]);
+    } else if (Equals(argv[i], "--max-count") && HAS_VALUE) {
+      nMaxCount = strtoull(argv[++i], NULL, 10);
+    } else if (argv[i][0] != '-') {
+      pszMode = argv[i];
+    } else {
+      PrintUsage(argv[0]);
+      return ERROR;
+    }
+  }
+
+  if (options.dMinSeconds <= 0) {
+    options.dMinSeconds = 0.2;
+  }
+
+  if (Equals(pszMode, "verify")) {
+    return VerifyKernelTiers() + VerifyStringHash() == 0 ? OK : 1;
+  }
+
+  if (!Equals(pszMode, "micro") && !Equals(pszMode, "reduce")
+      && !Equals(pszMode, "replay") && !Equals(pszMode, "sort")
+      && !Equals(pszMode, "structures")) {
+    PrintUsage(argv[0]);
+    return ERROR;
+  }
+
+  if (nLines <= 0) {
+    nLines = Equals(pszMode, "sort") ? 1000000 : 100000;
+  }
+
+  int nFirstTier = GetCoreCpuTier();
+  int nLastTier = nFirstTier;
+  if (pszTier != NULL && !ParseTiers(pszTier, &nFirstTier, &nLastTier)) {
+    return ERROR;
+  }
+
+  int nFailures = 0;
+  for (int nTier = nFirstTier; nTier <= nLastTier; nTier++) {
+    SetCoreCpuTier((CORE_CPU_TIER) nTier);
+    if (pszTier != NULL) {
+      options.pszTier = GetCoreCpuTierName((CORE_CPU_TIER) nTier);
+    }
+
+    if (Equals(pszMode, "micro")) {
+      RunMicroBenchmarks(&options);
+    } else if (Equals(pszMode, "reduce")) {
+      nFailures += RunReduceBenchmarks(&options, nMaxCount);
+    } else if (Equals(pszMode, "sort")) {
+      nFailures += RunSortBenchmarks(&options, nLines);
+    } else if (Equals(pszMode, "structures")) {
+      nFailures += RunStructureBenchmarks(&options);
+    } else if (RunReplayBenchmarks(&options, pszCorpus, pszInputPath,
+        nLines) != OK) {
+      return ERROR;
+    }
+  }
+
+  if (options.fpOutput != stdout) {
+    fclose(options.fpOutput);
+  }
+
+  if (pszSavePath != NULL && SaveBenchResults(pszSavePath) != OK) {
+    fprintf(stderr, "bench: cannot write '%s'\n", pszSavePath);
+  }
+
+  if (pszBaselinePath != NULL
+      && CompareWithBaseline(pszBaselinePath, dThresholdPercent) > 0) {
+    return 1;
+  }
+
+  if (nFailures > 0) {
+    return 1;
+  }
+
+  return OK;
+}
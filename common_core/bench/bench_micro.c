@@ -0,0 +1,634 @@
+// bench_micro.c - Microbenchmarks of the public functions declared in common_core.h
+//
+// Every function is measured across input sizes from 8 bytes to 64 MB (limited by --min-size
+// and --max-size) and, where it searches for something, across needle/delimiter densities.
+// Functions whose running time is quadratic in the input size today are capped at a smaller
+// size so that a full run finishes.  HandleError is not measured, since it terminates the
+// process under the legacy error model, and neither is GetSystemCommandOutput, which is
+// declared but has no implementation in this library.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Kinds of input text a benchmark can ask for */
+typedef enum _INPUT_KIND {
+  INPUT_TEXT,         /* random lowercase letters, with markers */
+  INPUT_DIGITS,       /* random decimal digits */
+  INPUT_UPPER,        /* random uppercase letters */
+  INPUT_PADDED        /* random lowercase letters with 16 spaces each side */
+} INPUT_KIND;
+
+/* Description of the benchmark of one function */
+typedef struct _MICRO_SPEC {
+  const char* pszName;
+  void (*pfnRun)(void* pvContext, unsigned long long ullIterations);
+  INPUT_KIND nInputKind;
+  const char* pszMarker;          /* scattered through INPUT_TEXT inputs */
+  const double* pdDensities;      /* NULL means a single density of zero */
+  int nDensities;
+  size_t nMaxSize;                /* 0 means no cap beyond --max-size */
+  BOOL bSizeIndependent;          /* run at one size only */
+} MICRO_SPEC;
+
+#define NEEDLE              "needle"
+#define MIN_MICRO_SIZE      8
+#define MAX_MICRO_SIZE      (64UL * 1024 * 1024)
+
+static const double s_dSearchDensities[] = { 0.0, 1.0 / 4096, 1.0 / 64 };
+static const double s_dSplitDensities[] = { 1.0 / 64, 1.0 / 8 };
+static const double s_dReplaceDensities[] = { 1.0 / 64, 1.0 / 8 };
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark bodies
+
+/* Allocates CHURN_BLOCKS blocks of random sizes up to the input size, then
+ * releases them in another order, with AllocateBuffer and FreeBuffer or
+ * with malloc and free, for the throughput of the pool, in a library built
+ * with COMMON_CORE_STRING_POOL defined, against malloc's */
+#define CHURN_BLOCKS        64
+
+static void ChurnBlocks(const MICRO_CONTEXT* pContext,
+    unsigned long long ullIterations, BOOL bPool) {
+  void* pvBlocks[CHURN_BLOCKS];
+  uint32_t nSeed = 0x9e3779b9U;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    for (int j = 0; j < CHURN_BLOCKS; j++) {
+      nSeed = nSeed * 1664525U + 1013904223U;
+      const size_t SIZE = 1 + (nSeed >> 8) % pContext->nSize;
+      pvBlocks[j] = bPool ? AllocateBuffer(SIZE) : malloc(SIZE);
+      *(char*) pvBlocks[j] = (char) j;
+    }
+
+    for (int j = 0; j < CHURN_BLOCKS; j++) {
+      void* pvBlock = pvBlocks[(j * 29) % CHURN_BLOCKS];
+      g_ullBenchSink += *(unsigned char*) pvBlock;
+      if (bPool) {
+        FreeBuffer(&pvBlock);
+      } else {
+        free(pvBlock);
+      }
+    }
+  }
+}
+
+static void RunAllocateBuffer(void* pvContext,
+    unsigned long long ullIterations) {
+  ChurnBlocks((MICRO_CONTEXT*) pvContext, ullIterations, TRUE);
+}
+
+static void RunAllocateBufferMalloc(void* pvContext,
+    unsigned long long ullIterations) {
+  ChurnBlocks((MICRO_CONTEXT*) pvContext, ullIterations, FALSE);
+}
+
+static void RunClearString(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ClearString(pContext->pszScratch, (int) pContext->nSize);
+  }
+  g_ullBenchSink += (unsigned char) pContext->pszScratch[0];
+}
+
+static void RunContains(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += Contains(pContext->pszInput, NEEDLE "!");
+  }
+}
+
+static void RunContainsNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += ContainsNoCase(pContext->pszInput, "NEEDLE!");
+  }
+}
+
+/* Copies the first or last four characters of the input, uppercased if
+ * bUpper is set, as the affix the StartsWith and EndsWith bodies look for */
+static void GetAffix(const MICRO_CONTEXT* pContext, BOOL bSuffix,
+    BOOL bUpper, char szAffix[5]) {
+  const char* pszSource = pContext->pszInput
+      + (bSuffix ? pContext->nSize - 4 : 0);
+  for (int i = 0; i < 4; i++) {
+    szAffix[i] = bUpper ? toupper((unsigned char) pszSource[i]) : pszSource[i];
+  }
+  szAffix[4] = '\0';
+}
+
+static void RunEndsWith(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szSuffix[5];
+  GetAffix(pContext, TRUE, FALSE, szSuffix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += EndsWith(pContext->pszInput, szSuffix);
+  }
+}
+
+static void RunEndsWithN(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szSuffix[5];
+  GetAffix(pContext, TRUE, FALSE, szSuffix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += EndsWithN(pContext->pszInput, pContext->nSize,
+        szSuffix, 4);
+  }
+}
+
+static void RunEndsWithNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szSuffix[5];
+  GetAffix(pContext, TRUE, TRUE, szSuffix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += EndsWithNoCase(pContext->pszInput, szSuffix);
+  }
+}
+
+static void RunEndsWithNoCaseN(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szSuffix[5];
+  GetAffix(pContext, TRUE, TRUE, szSuffix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += EndsWithNoCaseN(pContext->pszInput, pContext->nSize,
+        szSuffix, 4);
+  }
+}
+
+static void RunEquals(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += Equals(pContext->pszInput, pContext->pszCopy);
+  }
+}
+
+static void RunEqualsNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += EqualsNoCase(pContext->pszInput, pContext->pszCopy);
+  }
+}
+
+static void RunFormatDate(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    FormatDate(pContext->pszScratch, (int) pContext->nSize + 1,
+        "%Y-%m-%d %H:%M:%S");
+  }
+  g_ullBenchSink += (unsigned char) pContext->pszScratch[0];
+}
+
+static void RunFreeBuffer(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    void* pvBlock = malloc(pContext->nSize);
+    g_ullBenchSink += (uintptr_t) pvBlock & 1;
+    FreeBuffer(&pvBlock);
+  }
+}
+
+static void RunFreeStringArray(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  const int COUNT = (int) (pContext->nSize / 16) + 1;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char** ppszArray = (char**) malloc(COUNT * sizeof(char*));
+    for (int j = 0; j < COUNT; j++) {
+      ppszArray[j] = (char*) malloc(16);
+    }
+    FreeStringArray(&ppszArray, COUNT);
+  }
+}
+
+static void RunGetSubstringOccurrenceCount(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += GetSubstringOccurrenceCount(pContext->pszInput, NEEDLE);
+  }
+}
+
+static void RunHashBytes(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += HashBytes(pContext->pszInput, pContext->nSize);
+  }
+}
+
+static void RunHashBytesNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += HashBytesNoCase(pContext->pszInput, pContext->nSize);
+  }
+}
+
+static void RunHashString(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += HashString(pContext->pszInput);
+  }
+}
+
+static void RunIsAlphaNumeric(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += IsAlphaNumeric(pContext->pszInput);
+  }
+}
+
+static void RunIsNullOrWhiteSpace(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += IsNullOrWhiteSpace(pContext->pszInput);
+  }
+}
+
+static void RunIsNumeric(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += IsNumeric(pContext->pszInput);
+  }
+}
+
+static void RunIsOneOf(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  const int POSSIBILITIES = (int) pContext->nSize + 1;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += IsOneOf('!', pContext->pszInput, POSSIBILITIES);
+  }
+}
+
+static void RunIsUppercase(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += IsUppercase(pContext->pszInput);
+  }
+}
+
+static void RunJoinStrings(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char* pszJoined = NULL;
+    int nJoinedLength = 0;
+    JoinStrings(pContext->ppszTokens, pContext->nTokens, &pszJoined,
+        &nJoinedLength);
+    g_ullBenchSink += nJoinedLength;
+    FreeBuffer((void**) &pszJoined);
+  }
+}
+
+static void RunMinimumOf(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  const size_t COUNT = pContext->nSize / sizeof(int);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    int nMinimum = INT_MAX;
+    for (size_t j = 0; j < COUNT; j++) {
+      nMinimum = MinimumOf(nMinimum, pContext->pnValues[j]);
+    }
+    g_ullBenchSink += nMinimum;
+  }
+}
+
+static void RunPrependTo(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char* pszResult = NULL;
+    PrependTo(&pszResult, "prefix-prefix-16", pContext->pszInput);
+    g_ullBenchSink += (uintptr_t) pszResult & 1;
+    FreeBuffer((void**) &pszResult);
+  }
+}
+
+static void RunSecureClear(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    SecureClear(pContext->pszScratch, pContext->nSize);
+  }
+  g_ullBenchSink += (unsigned char) pContext->pszScratch[0];
+}
+
+static void RunSplit(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char** ppszTokens = NULL;
+    int nTokens = 0;
+    Split(pContext->pszInput, (int) pContext->nSize, ",", &ppszTokens,
+        &nTokens);
+    g_ullBenchSink += nTokens;
+    FreeStringArray(&ppszTokens, nTokens);
+  }
+}
+
+/* The region is reset after each line, as a parser of many lines would */
+static void RunSplitInRegion(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  LPREGION pRegion = NULL;
+  if (CreateRegion(NULL, &pRegion) != OK) {
+    return;
+  }
+
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char** ppszTokens = NULL;
+    int nTokens = 0;
+    SplitInRegion(pRegion, pContext->pszInput, (int) pContext->nSize, ",",
+        &ppszTokens, &nTokens);
+    g_ullBenchSink += nTokens;
+    ResetRegion(pRegion);
+  }
+
+  FreeRegion(&pRegion);
+}
+
+static void RunStartsWith(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szPrefix[5];
+  GetAffix(pContext, FALSE, FALSE, szPrefix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += StartsWith(pContext->pszInput, szPrefix);
+  }
+}
+
+static void RunStartsWithN(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szPrefix[5];
+  GetAffix(pContext, FALSE, FALSE, szPrefix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += StartsWithN(pContext->pszInput, pContext->nSize,
+        szPrefix, 4);
+  }
+}
+
+static void RunStartsWithNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szPrefix[5];
+  GetAffix(pContext, FALSE, TRUE, szPrefix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += StartsWithNoCase(pContext->pszInput, szPrefix);
+  }
+}
+
+static void RunStartsWithNoCaseN(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  char szPrefix[5];
+  GetAffix(pContext, FALSE, TRUE, szPrefix);
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    g_ullBenchSink += StartsWithNoCaseN(pContext->pszInput, pContext->nSize,
+        szPrefix, 4);
+  }
+}
+
+static void RunStringReplace(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char* pszResult = NULL;
+    StringReplace(pContext->pszInput, NEEDLE, "pin", &pszResult);
+    g_ullBenchSink += (uintptr_t) pszResult & 1;
+    FreeBuffer((void**) &pszResult);
+  }
+}
+
+static void RunTrim(void* pvContext, unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    Trim(pContext->pszScratch, pContext->nSize + 1, pContext->pszInput);
+  }
+  g_ullBenchSink += (unsigned char) pContext->pszScratch[0];
+}
+
+static void RunUpdateStringHash(void* pvContext,
+    unsigned long long ullIterations) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    /* Pieces that are not whole stripes, so the buffering is exercised */
+    STRING_HASH_STATE state;
+    BeginStringHash(&state, STRING_HASH_DEFAULT_SEED);
+    for (size_t nDone = 0; nDone < pContext->nSize; nDone += 1000) {
+      const size_t PIECE = pContext->nSize - nDone < 1000
+          ? pContext->nSize - nDone : 1000;
+      UpdateStringHash(&state, pContext->pszInput + nDone, PIECE);
+    }
+    g_ullBenchSink += EndStringHash(&state);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Table of benchmarks
+
+static const MICRO_SPEC s_specs[] = {
+  { "AllocateBuffer", RunAllocateBuffer, INPUT_TEXT, NULL, NULL, 0, 4096,
+      FALSE },
+  { "AllocateBufferMalloc", RunAllocateBufferMalloc, INPUT_TEXT, NULL, NULL,
+      0, 4096, FALSE },
+  { "ClearString", RunClearString, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "Contains", RunContains, INPUT_TEXT, NEEDLE, s_dSearchDensities, 3, 0,
+      FALSE },
+  { "ContainsNoCase", RunContainsNoCase, INPUT_TEXT, NEEDLE,
+      s_dSearchDensities, 3, 0, FALSE },
+  { "EndsWith", RunEndsWith, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "EndsWithN", RunEndsWithN, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "EndsWithNoCase", RunEndsWithNoCase, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "EndsWithNoCaseN", RunEndsWithNoCaseN, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "Equals", RunEquals, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "EqualsInline", RunEqualsInline, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "EqualsNoCase", RunEqualsNoCase, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "EqualsNoCaseInline", RunEqualsNoCaseInline, INPUT_TEXT, NULL, NULL, 0,
+      0, FALSE },
+  { "FormatDate", RunFormatDate, INPUT_TEXT, NULL, NULL, 0, 0, TRUE },
+  { "FreeBuffer", RunFreeBuffer, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "FreeBufferInline", RunFreeBufferInline, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "FreeStringArray", RunFreeStringArray, INPUT_TEXT, NULL, NULL, 0,
+      2UL * 1024 * 1024, FALSE },
+  { "GetSubstringOccurrenceCount", RunGetSubstringOccurrenceCount,
+      INPUT_TEXT, NEEDLE, s_dReplaceDensities, 2, 256UL * 1024, FALSE },
+  { "HashBytes", RunHashBytes, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "HashBytesNoCase", RunHashBytesNoCase, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "HashString", RunHashString, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "IsAlphaNumeric", RunIsAlphaNumeric, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "IsNullOrWhiteSpace", RunIsNullOrWhiteSpace, INPUT_PADDED, NULL, NULL, 0,
+      0, FALSE },
+  { "IsNumeric", RunIsNumeric, INPUT_DIGITS, NULL, NULL, 0, 0, FALSE },
+  { "IsOneOf", RunIsOneOf, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "IsUppercase", RunIsUppercase, INPUT_UPPER, NULL, NULL, 0, 0, FALSE },
+  { "JoinStrings", RunJoinStrings, INPUT_TEXT, ",", s_dSplitDensities, 2,
+      256UL * 1024, FALSE },
+  { "MinimumOf", RunMinimumOf, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "MinimumOfInline", RunMinimumOfInline, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "PrependTo", RunPrependTo, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "SecureClear", RunSecureClear, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "Split", RunSplit, INPUT_TEXT, ",", s_dSplitDensities, 2, 0, FALSE },
+  { "SplitInRegion", RunSplitInRegion, INPUT_TEXT, ",", s_dSplitDensities, 2,
+      0, FALSE },
+  { "StartsWith", RunStartsWith, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "StartsWithInline", RunStartsWithInline, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "StartsWithN", RunStartsWithN, INPUT_TEXT, NULL, NULL, 0, 0, FALSE },
+  { "StartsWithNoCase", RunStartsWithNoCase, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "StartsWithNoCaseN", RunStartsWithNoCaseN, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE },
+  { "StringReplace", RunStringReplace, INPUT_TEXT, NEEDLE,
+      s_dReplaceDensities, 2, 2UL * 1024 * 1024, FALSE },
+  { "Trim", RunTrim, INPUT_PADDED, NULL, NULL, 0, 0, FALSE },
+  { "UpdateStringHash", RunUpdateStringHash, INPUT_TEXT, NULL, NULL, 0, 0,
+      FALSE }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// TeardownMicroContext function
+
+static void TeardownMicroContext(void* pvContext) {
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) pvContext;
+  if (pContext == NULL) {
+    return;
+  }
+
+  FreeStringArray(&pContext->ppszTokens, pContext->nTokens);
+  free(pContext->pszInput);
+  free(pContext->pszCopy);
+  free(pContext->pszScratch);
+  free(pContext->pnValues);
+  free(pContext);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupMicroContext function - Generates the input of a case for one thread.
+//
+
+static void* SetupMicroContext(const BENCH_CASE* pCase) {
+  const MICRO_SPEC* pSpec = (const MICRO_SPEC*) pCase->pvData;
+  const size_t SIZE = pCase->nSize;
+
+  MICRO_CONTEXT* pContext = (MICRO_CONTEXT*) calloc(1, sizeof(MICRO_CONTEXT));
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->nSize = SIZE;
+  pContext->pszInput = (char*) malloc(SIZE + 1);
+  pContext->pszCopy = (char*) malloc(SIZE + 1);
+  pContext->pszScratch = (char*) calloc(SIZE + 1, 1);
+  pContext->pnValues = (int*) malloc(SIZE + sizeof(int));
+  if (pContext->pszInput == NULL || pContext->pszCopy == NULL
+      || pContext->pszScratch == NULL || pContext->pnValues == NULL) {
+    TeardownMicroContext(pContext);
+    return NULL;
+  }
+
+  GenerateText(pContext->pszInput, SIZE, pSpec->pszMarker, pCase->dDensity,
+      (unsigned int) SIZE);
+
+  for (size_t i = 0; i < SIZE; i++) {
+    switch (pSpec->nInputKind) {
+      case INPUT_DIGITS:
+        pContext->pszInput[i] = '0' + pContext->pszInput[i] % 10;
+        break;
+
+      case INPUT_UPPER:
+        pContext->pszInput[i] = toupper(pContext->pszInput[i]);
+        break;
+
+      case INPUT_PADDED:
+        if (i < 16 || i + 16 >= SIZE) {
+          pContext->pszInput[i] = ' ';
+        }
+        break;
+
+      default:
+        break;
+    }
+  }
+
+  memcpy(pContext->pszCopy, pContext->pszInput, SIZE + 1);
+
+  for (size_t i = 0; i < SIZE / sizeof(int); i++) {
+    pContext->pnValues[i] = rand();
+  }
+
+  if (pSpec->pfnRun == RunJoinStrings) {
+    Split(pContext->pszInput, (int) SIZE, ",", &pContext->ppszTokens,
+        &pContext->nTokens);
+  }
+
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// RunMicroBenchmarks function
+
+void RunMicroBenchmarks(const BENCH_OPTIONS* pOptions) {
+  for (size_t s = 0; s < sizeof(s_specs) / sizeof(s_specs[0]); s++) {
+    const MICRO_SPEC* pSpec = &s_specs[s];
+    if (!IsBenchSelected(pOptions, pSpec->pszName)) {
+      continue;
+    }
+
+    const int DENSITIES = pSpec->pdDensities == NULL ? 1 : pSpec->nDensities;
+    for (int d = 0; d < DENSITIES; d++) {
+      double dDensity = pSpec->pdDensities == NULL
+          ? 0.0 : pSpec->pdDensities[d];
+
+      /* 8 B, 64 B, ..., 16 MB, then 64 MB to finish on the upper bound */
+      for (size_t nSize = MIN_MICRO_SIZE; nSize <= MAX_MICRO_SIZE;
+          nSize = nSize < MAX_MICRO_SIZE && nSize * 8 > MAX_MICRO_SIZE
+              ? MAX_MICRO_SIZE : nSize * 8) {
+        if (nSize < pOptions->nMinSize || nSize > pOptions->nMaxSize) {
+          continue;
+        }
+
+        if (pSpec->nMaxSize != 0 && nSize > pSpec->nMaxSize) {
+          break;
+        }
+
+        BENCH_CASE benchCase;
+        memset(&benchCase, 0, sizeof(benchCase));
+        benchCase.pszName = pSpec->pszName;
+        benchCase.nSize = pSpec->bSizeIndependent ? 64 : nSize;
+        benchCase.dDensity = dDensity;
+        benchCase.nBytesPerOp = benchCase.nSize;
+        benchCase.pvData = pSpec;
+        benchCase.pfnSetup = SetupMicroContext;
+        benchCase.pfnRun = pSpec->pfnRun;
+        benchCase.pfnTeardown = TeardownMicroContext;
+
+        if (pSpec->bSizeIndependent) {
+          snprintf(benchCase.szParams, sizeof(benchCase.szParams), "-");
+        } else if (pSpec->pdDensities == NULL) {
+          snprintf(benchCase.szParams, sizeof(benchCase.szParams), "size=%zu",
+              nSize);
+        } else {
+          snprintf(benchCase.szParams, sizeof(benchCase.szParams),
+              "size=%zu;density=%.6f", nSize, dDensity);
+        }
+
+        RunBenchCase(pOptions, &benchCase);
+
+        if (pSpec->bSizeIndependent) {
+          break;
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,332 @@
+// bench_reduce.c - Benchmarks of the integer-array reductions of int_array.h, against a loop of
+// MinimumOf calls
+//
+// Each array type (int, int64_t and size_t) is measured at 1000 to 100 million values, in steps
+// of ten (limited by --max-count), with random values across the whole range of the type.  Before
+// an array is timed, the minimum, maximum, index of the minimum and sum are checked against plain
+// loops.  The clamps work on a copy per thread, which they clamp again on every run; the values
+// they leave in range cost the same to clamp as the others.  Run with --tier all to compare the
+// vector kernels against the scalar ones.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define MIN_REDUCE_COUNT        1000UL
+
+/* Values of one type, shared by the threads that only read them */
+typedef struct _REDUCE_WORKLOAD {
+  const char* pszType;
+  size_t nElementSize;
+  size_t nCount;
+  void* pvValues;
+} REDUCE_WORKLOAD;
+
+typedef struct _REDUCE_CONTEXT {
+  const REDUCE_WORKLOAD* pWorkload;
+  void* pvValues;     /* the workload's values, or a copy for the clamps */
+} REDUCE_CONTEXT;
+
+/* A function measured on each type */
+typedef struct _REDUCE_SPEC {
+  const char* pszName;
+  void (*pfnRun)(void* pvContext, unsigned long long ullIterations);
+  BOOL bWrites;       /* needs a copy of the values per thread */
+} REDUCE_SPEC;
+
+#define COUNT_OF(array)   (sizeof(array) / sizeof((array)[0]))
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// NextRandom function - xorshift64*, which fills 100 million values far
+// faster than rand(3).
+//
+
+static uint64_t NextRandom(uint64_t* pullState) {
+  *pullState ^= *pullState >> 12;
+  *pullState ^= *pullState << 25;
+  *pullState ^= *pullState >> 27;
+  return *pullState * 2685821657736338717ULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateReduceWorkload function - Fills an array of nCount random values
+// of the type specified.  Returns FALSE if memory ran out.
+//
+
+static BOOL GenerateReduceWorkload(REDUCE_WORKLOAD* pWorkload,
+    const char* pszType, size_t nElementSize, size_t nCount) {
+  pWorkload->pszType = pszType;
+  pWorkload->nElementSize = nElementSize;
+  pWorkload->nCount = nCount;
+  pWorkload->pvValues = malloc(nCount * nElementSize);
+  if (pWorkload->pvValues == NULL) {
+    return FALSE;
+  }
+
+  uint64_t ullState = 0x9E3779B97F4A7C15ULL ^ nCount;
+  for (size_t i = 0; i < nCount; i++) {
+    const uint64_t RANDOM = NextRandom(&ullState);
+    if (nElementSize == sizeof(int)) {
+      ((int*) pWorkload->pvValues)[i] = (int) RANDOM;
+    } else {
+      ((uint64_t*) pWorkload->pvValues)[i] = RANDOM;
+    }
+  }
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Check*s functions - Compare the reductions of one type against plain
+// loops.  Return the number of reductions that disagree, after describing
+// them on stderr.
+//
+
+#define CHECK_REDUCTIONS(Suffix, Type, SumType)                               \
+static int Check##Suffix##s(const void* pvValues, size_t nCount) {            \
+  const Type* pValues = (const Type*) pvValues;                               \
+  Type minimum = pValues[0];                                                  \
+  Type maximum = pValues[0];                                                  \
+  size_t nMinimumAt = 0;                                                      \
+  SumType sum = 0;                                                            \
+  for (size_t i = 0; i < nCount; i++) {                                       \
+    if (pValues[i] < minimum) {                                               \
+      minimum = pValues[i];                                                   \
+      nMinimumAt = i;                                                         \
+    }                                                                         \
+    if (pValues[i] > maximum) {                                               \
+      maximum = pValues[i];                                                   \
+    }                                                                         \
+    sum += (SumType) pValues[i];                                              \
+  }                                                                           \
+                                                                              \
+  const BOOL FAILED[] = {                                                     \
+    MinimumOf##Suffix##s(pValues, nCount) != minimum,                         \
+    MaximumOf##Suffix##s(pValues, nCount) != maximum,                         \
+    IndexOfMinimumOf##Suffix##s(pValues, nCount) != nMinimumAt,               \
+    (SumType) SumOf##Suffix##s(pValues, nCount) != sum                        \
+  };                                                                          \
+  static const char* pszNames[] = { "MinimumOf" #Suffix "s",                  \
+      "MaximumOf" #Suffix "s", "IndexOfMinimumOf" #Suffix "s",                \
+      "SumOf" #Suffix "s" };                                                  \
+                                                                              \
+  int nFailures = 0;                                                          \
+  for (size_t i = 0; i < COUNT_OF(FAILED); i++) {                             \
+    if (FAILED[i]) {                                                          \
+      fprintf(stderr, "reduce: %s differs from a plain loop on %zu "          \
+          "values\n", pszNames[i], nCount);                                   \
+      nFailures++;                                                            \
+    }                                                                         \
+  }                                                                           \
+  return nFailures;                                                           \
+}
+
+CHECK_REDUCTIONS(Int, int, int64_t)
+CHECK_REDUCTIONS(Int64, int64_t, uint64_t)
+CHECK_REDUCTIONS(Size, size_t, size_t)
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupReduceContext function - Points a thread at the workload's values.
+//
+
+static void* SetupReduceContext(const BENCH_CASE* pCase) {
+  const REDUCE_WORKLOAD* pWorkload = (const REDUCE_WORKLOAD*) pCase->pvData;
+
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) calloc(1,
+      sizeof(REDUCE_CONTEXT));
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->pWorkload = pWorkload;
+  pContext->pvValues = pWorkload->pvValues;
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupClampContext function - Gives a thread a copy of the values to
+// clamp, in the same block as its context.
+//
+
+static void* SetupClampContext(const BENCH_CASE* pCase) {
+  const REDUCE_WORKLOAD* pWorkload = (const REDUCE_WORKLOAD*) pCase->pvData;
+  const size_t SIZE = pWorkload->nCount * pWorkload->nElementSize;
+
+  /* The copy starts 64 bytes past the context, aligned as malloc aligns */
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) malloc(64 + SIZE);
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->pWorkload = pWorkload;
+  pContext->pvValues = (char*) pContext + 64;
+  memcpy(pContext->pvValues, pWorkload->pvValues, SIZE);
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark bodies
+
+/* The clamps keep the middle half of each type's range */
+#define REDUCE_RUNS(Suffix, Type, Low, High)                                  \
+static void RunMinimumOf##Suffix##s(void* pvContext,                          \
+    unsigned long long ullIterations) {                                       \
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) pvContext;                     \
+  for (unsigned long long i = 0; i < ullIterations; i++) {                    \
+    g_ullBenchSink += (unsigned long long) MinimumOf##Suffix##s(              \
+        (const Type*) pContext->pvValues, pContext->pWorkload->nCount);       \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static void RunMaximumOf##Suffix##s(void* pvContext,                          \
+    unsigned long long ullIterations) {                                       \
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) pvContext;                     \
+  for (unsigned long long i = 0; i < ullIterations; i++) {                    \
+    g_ullBenchSink += (unsigned long long) MaximumOf##Suffix##s(              \
+        (const Type*) pContext->pvValues, pContext->pWorkload->nCount);       \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static void RunIndexOfMinimumOf##Suffix##s(void* pvContext,                   \
+    unsigned long long ullIterations) {                                       \
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) pvContext;                     \
+  for (unsigned long long i = 0; i < ullIterations; i++) {                    \
+    g_ullBenchSink += IndexOfMinimumOf##Suffix##s(                            \
+        (const Type*) pContext->pvValues, pContext->pWorkload->nCount);       \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static void RunSumOf##Suffix##s(void* pvContext,                              \
+    unsigned long long ullIterations) {                                       \
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) pvContext;                     \
+  for (unsigned long long i = 0; i < ullIterations; i++) {                    \
+    g_ullBenchSink += (unsigned long long) SumOf##Suffix##s(                  \
+        (const Type*) pContext->pvValues, pContext->pWorkload->nCount);       \
+  }                                                                           \
+}                                                                             \
+                                                                              \
+static void RunClamp##Suffix##s(void* pvContext,                              \
+    unsigned long long ullIterations) {                                       \
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) pvContext;                     \
+  for (unsigned long long i = 0; i < ullIterations; i++) {                    \
+    Clamp##Suffix##s((Type*) pContext->pvValues, pContext->pWorkload->nCount, \
+        Low, High);                                                           \
+  }                                                                           \
+  g_ullBenchSink += (unsigned long long) ((Type*) pContext->pvValues)[0];     \
+}
+
+REDUCE_RUNS(Int, int, INT_MIN / 2, INT_MAX / 2)
+REDUCE_RUNS(Int64, int64_t, INT64_MIN / 2, INT64_MAX / 2)
+REDUCE_RUNS(Size, size_t, SIZE_MAX / 4, SIZE_MAX / 4 * 3)
+
+/* The minimum as callers found it before MinimumOfInts: one call per value */
+static void RunMinimumOfLoop(void* pvContext,
+    unsigned long long ullIterations) {
+  REDUCE_CONTEXT* pContext = (REDUCE_CONTEXT*) pvContext;
+  const int* pnValues = (const int*) pContext->pvValues;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    int nMinimum = INT_MAX;
+    for (size_t j = 0; j < pContext->pWorkload->nCount; j++) {
+      nMinimum = MinimumOf(nMinimum, pnValues[j]);
+    }
+    g_ullBenchSink += nMinimum;
+  }
+}
+
+static const REDUCE_SPEC s_intSpecs[] = {
+  { "ClampInts", RunClampInts, TRUE },
+  { "IndexOfMinimumOfInts", RunIndexOfMinimumOfInts, FALSE },
+  { "MaximumOfInts", RunMaximumOfInts, FALSE },
+  { "MinimumOfInts", RunMinimumOfInts, FALSE },
+  { "MinimumOfLoop", RunMinimumOfLoop, FALSE },
+  { "SumOfInts", RunSumOfInts, FALSE }
+};
+
+static const REDUCE_SPEC s_int64Specs[] = {
+  { "ClampInt64s", RunClampInt64s, TRUE },
+  { "IndexOfMinimumOfInt64s", RunIndexOfMinimumOfInt64s, FALSE },
+  { "MaximumOfInt64s", RunMaximumOfInt64s, FALSE },
+  { "MinimumOfInt64s", RunMinimumOfInt64s, FALSE },
+  { "SumOfInt64s", RunSumOfInt64s, FALSE }
+};
+
+static const REDUCE_SPEC s_sizeSpecs[] = {
+  { "ClampSizes", RunClampSizes, TRUE },
+  { "IndexOfMinimumOfSizes", RunIndexOfMinimumOfSizes, FALSE },
+  { "MaximumOfSizes", RunMaximumOfSizes, FALSE },
+  { "MinimumOfSizes", RunMinimumOfSizes, FALSE },
+  { "SumOfSizes", RunSumOfSizes, FALSE }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// RunReduceBenchmarks function
+
+int RunReduceBenchmarks(const BENCH_OPTIONS* pOptions, size_t nMaxCount) {
+  const struct {
+    const char* pszType;
+    size_t nElementSize;
+    int (*pfnCheck)(const void* pvValues, size_t nCount);
+    const REDUCE_SPEC* pSpecs;
+    size_t nSpecs;
+  } TYPES[] = {
+    { "int", sizeof(int), CheckInts, s_intSpecs, COUNT_OF(s_intSpecs) },
+    { "int64_t", sizeof(int64_t), CheckInt64s, s_int64Specs,
+        COUNT_OF(s_int64Specs) },
+    { "size_t", sizeof(size_t), CheckSizes, s_sizeSpecs,
+        COUNT_OF(s_sizeSpecs) }
+  };
+  int nFailures = 0;
+
+  for (size_t t = 0; t < COUNT_OF(TYPES); t++) {
+    BOOL bSelected = FALSE;
+    for (size_t s = 0; s < TYPES[t].nSpecs; s++) {
+      bSelected |= IsBenchSelected(pOptions, TYPES[t].pSpecs[s].pszName);
+    }
+    if (!bSelected) {
+      continue;
+    }
+
+    for (size_t nCount = MIN_REDUCE_COUNT; nCount <= nMaxCount;
+        nCount *= 10) {
+      REDUCE_WORKLOAD workload;
+      if (!GenerateReduceWorkload(&workload, TYPES[t].pszType,
+          TYPES[t].nElementSize, nCount)) {
+        fprintf(stderr, "reduce: cannot generate %zu %s values\n", nCount,
+            TYPES[t].pszType);
+        return nFailures + 1;
+      }
+
+      nFailures += TYPES[t].pfnCheck(workload.pvValues, nCount);
+
+      for (size_t s = 0; s < TYPES[t].nSpecs; s++) {
+        const REDUCE_SPEC* pSpec = &TYPES[t].pSpecs[s];
+        if (!IsBenchSelected(pOptions, pSpec->pszName)) {
+          continue;
+        }
+
+        BENCH_CASE benchCase;
+        memset(&benchCase, 0, sizeof(benchCase));
+        benchCase.pszName = pSpec->pszName;
+        benchCase.nSize = nCount * TYPES[t].nElementSize;
+        benchCase.nBytesPerOp = benchCase.nSize;
+        benchCase.pvData = &workload;
+        benchCase.pfnSetup = pSpec->bWrites
+            ? SetupClampContext : SetupReduceContext;
+        benchCase.pfnRun = pSpec->pfnRun;
+        snprintf(benchCase.szParams, sizeof(benchCase.szParams),
+            "count=%zu;type=%s", nCount, workload.pszType);
+        RunBenchCase(pOptions, &benchCase);
+      }
+
+      free(workload.pvValues);
+    }
+  }
+
+  return nFailures;
+}
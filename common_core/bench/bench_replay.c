@@ -0,0 +1,464 @@
+// bench_replay.c - End-to-end workload replay: chains of common_core calls over log, CSV and
+// key=value config corpora, the way our services actually use the library
+//
+// Each line of a corpus goes through a pipeline of Split, Trim, IsNumeric, StringReplace,
+// JoinStrings (and, for configs, StartsWith and PrependTo).  Every line is timed individually,
+// so the results carry tail latencies as well as throughput.  Each thread replays the whole
+// corpus.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Pipeline that processes one line and returns a checksum of the work */
+typedef unsigned long long (*LPPIPELINE)(char* pszLine);
+
+typedef struct _CORPUS {
+  const char* pszName;
+  LPPIPELINE pfnPipeline;
+  char** ppszLines;
+  int nLines;
+  size_t nTotalBytes;
+} CORPUS;
+
+typedef struct _REPLAY_THREAD {
+  const CORPUS* pCorpus;
+  double* pdLatencies;              /* one per line, in nanoseconds */
+  pthread_barrier_t* pBarrier;
+} REPLAY_THREAD;
+
+static const char* s_pszLevels[] = { "INFO", "DEBUG", "WARN", "ERROR" };
+static const char* s_pszPaths[] = { "/api/v1/items", "/api/v1/orders",
+    "/health", "/api/v2/users/search", "/static/app.js" };
+static const char* s_pszWords[] = { "alpha", "bravo", "charlie", "delta",
+    "echo", "foxtrot", "golf", "hotel" };
+
+///////////////////////////////////////////////////////////////////////////////
+// Pipelines
+
+///////////////////////////////////////////////////////////////////////////////
+// ReplaceTokens function - Runs StringReplace over each token of an array,
+// swapping each result into the array, and sums the numeric tokens.
+//
+
+static unsigned long long ReplaceTokens(char** ppszTokens, int nTokens,
+    const char* pszFindWhat, const char* pszReplaceWith) {
+  unsigned long long ullChecksum = 0;
+
+  for (int i = 0; i < nTokens; i++) {
+    const size_t TOKEN_SIZE = strlen(ppszTokens[i]) + 1;
+    char szTrimmed[TOKEN_SIZE];
+    Trim(szTrimmed, TOKEN_SIZE, ppszTokens[i]);
+
+    if (IsNumeric(szTrimmed)) {
+      ullChecksum += strtoull(szTrimmed, NULL, 10);
+    }
+
+    char* pszReplaced = NULL;
+    StringReplace(szTrimmed, pszFindWhat, pszReplaceWith, &pszReplaced);
+    if (pszReplaced != NULL) {
+      FreeBuffer((void**) &ppszTokens[i]);
+      ppszTokens[i] = pszReplaced;
+    }
+  }
+
+  return ullChecksum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JoinAndRelease function - Joins the tokens, releases everything, and
+// returns the length of the joined string.
+//
+
+static unsigned long long JoinAndRelease(char*** pppszTokens, int nTokens) {
+  char* pszJoined = NULL;
+  int nJoinedLength = 0;
+
+  JoinStrings(*pppszTokens, nTokens, &pszJoined, &nJoinedLength);
+
+  FreeBuffer((void**) &pszJoined);
+  FreeStringArray(pppszTokens, nTokens);
+
+  return (unsigned long long) nJoinedLength;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ProcessLogLine function - e.g.,
+// 2026-10-17 11:38:00 INFO [worker-3] request id=1234 took=56 path=/health
+
+static unsigned long long ProcessLogLine(char* pszLine) {
+  char** ppszTokens = NULL;
+  int nTokens = 0;
+
+  Split(pszLine, (int) strlen(pszLine), " ", &ppszTokens, &nTokens);
+  if (nTokens == 0) {
+    return 0;
+  }
+
+  unsigned long long ullChecksum = ReplaceTokens(ppszTokens, nTokens, "=",
+      ": ");
+
+  return ullChecksum + JoinAndRelease(&ppszTokens, nTokens);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ProcessCsvLine function - e.g., 1234,"golf", 17 ,99.50,echo
+
+static unsigned long long ProcessCsvLine(char* pszLine) {
+  char** ppszTokens = NULL;
+  int nTokens = 0;
+
+  Split(pszLine, (int) strlen(pszLine), ",", &ppszTokens, &nTokens);
+  if (nTokens == 0) {
+    return 0;
+  }
+
+  unsigned long long ullChecksum = ReplaceTokens(ppszTokens, nTokens, "\"",
+      "");
+
+  return ullChecksum + JoinAndRelease(&ppszTokens, nTokens);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ProcessConfigLine function - e.g.,   cache_dir = ${HOME}/cache   or a
+// '#' comment
+
+static unsigned long long ProcessConfigLine(char* pszLine) {
+  const size_t LINE_SIZE = strlen(pszLine) + 1;
+  char szTrimmed[LINE_SIZE];
+  Trim(szTrimmed, LINE_SIZE, pszLine);
+
+  if (IsNullOrWhiteSpace(szTrimmed) || StartsWith(szTrimmed, "#")) {
+    return 1;
+  }
+
+  char** ppszTokens = NULL;
+  int nTokens = 0;
+
+  Split(szTrimmed, (int) LINE_SIZE - 1, "=", &ppszTokens, &nTokens);
+  if (nTokens < 2) {
+    FreeStringArray(&ppszTokens, nTokens);
+    return 2;
+  }
+
+  unsigned long long ullChecksum = ReplaceTokens(ppszTokens, nTokens,
+      "${HOME}", "/home/svc");
+
+  char* pszQualifiedKey = NULL;
+  PrependTo(&pszQualifiedKey, "app.", ppszTokens[0]);
+  if (pszQualifiedKey != NULL) {
+    FreeBuffer((void**) &ppszTokens[0]);
+    ppszTokens[0] = pszQualifiedKey;
+  }
+
+  return ullChecksum + JoinAndRelease(&ppszTokens, nTokens);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// AddLine function - Appends a copy of a line to a corpus.
+//
+
+static int AddLine(CORPUS* pCorpus, int* pnCapacity, const char* pszLine) {
+  if (pCorpus->nLines == *pnCapacity) {
+    int nNewCapacity = *pnCapacity == 0 ? 1024 : *pnCapacity * 2;
+    char** ppszNewLines = (char**) realloc(pCorpus->ppszLines,
+        nNewCapacity * sizeof(char*));
+    if (ppszNewLines == NULL) {
+      return ERROR;
+    }
+    pCorpus->ppszLines = ppszNewLines;
+    *pnCapacity = nNewCapacity;
+  }
+
+  char* pszCopy = strdup(pszLine);
+  if (pszCopy == NULL) {
+    return ERROR;
+  }
+
+  pCorpus->ppszLines[pCorpus->nLines++] = pszCopy;
+  pCorpus->nTotalBytes += strlen(pszLine) + 1;
+
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateCorpus function - Fills a corpus with nLines representative lines.
+//
+
+static int GenerateCorpus(CORPUS* pCorpus, int nLines) {
+  unsigned int nSeed = 20191017;
+  int nCapacity = 0;
+  char szLine[512];
+
+  for (int i = 0; i < nLines; i++) {
+    const int R = rand_r(&nSeed);
+
+    if (pCorpus->pfnPipeline == ProcessLogLine) {
+      snprintf(szLine, sizeof(szLine),
+          "2026-10-17 11:%02d:%02d %s [worker-%d] request id=%d took=%d "
+          "path=%s user=%s", (R >> 4) % 60, (R >> 10) % 60,
+          s_pszLevels[R % 4], R % 16, R % 100000, (R >> 3) % 500,
+          s_pszPaths[R % 5], s_pszWords[(R >> 5) % 8]);
+    } else if (pCorpus->pfnPipeline == ProcessCsvLine) {
+      snprintf(szLine, sizeof(szLine), "%d,\"%s\", %d ,%d.%02d,%s,%s", i,
+          s_pszWords[R % 8], (R >> 4) % 1000, (R >> 8) % 500, R % 100,
+          s_pszWords[(R >> 3) % 8], s_pszPaths[(R >> 6) % 5]);
+    } else if (R % 10 == 0) {
+      snprintf(szLine, sizeof(szLine), "# %s settings", s_pszWords[R % 8]);
+    } else if (R % 10 == 1) {
+      snprintf(szLine, sizeof(szLine), "   ");
+    } else {
+      snprintf(szLine, sizeof(szLine), "  %s_%d = %s  ",
+          s_pszWords[(R >> 4) % 8], i, R % 3 == 0
+              ? "${HOME}/cache" : (R % 3 == 1 ? "8080" : "enabled"));
+    }
+
+    if (AddLine(pCorpus, &nCapacity, szLine) != OK) {
+      return ERROR;
+    }
+  }
+
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadCorpus function - Fills a corpus with the lines of a file.
+//
+
+static int LoadCorpus(CORPUS* pCorpus, const char* pszPath) {
+  FILE* fp = fopen(pszPath, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "bench: cannot open '%s'\n", pszPath);
+    return ERROR;
+  }
+
+  int nCapacity = 0;
+  char* pszLine = NULL;
+  size_t nLineCapacity = 0;
+  ssize_t nRead;
+  int nResult = OK;
+
+  while ((nRead = getline(&pszLine, &nLineCapacity, fp)) >= 0) {
+    while (nRead > 0 && (pszLine[nRead - 1] == '\n'
+        || pszLine[nRead - 1] == '\r')) {
+      pszLine[--nRead] = '\0';
+    }
+
+    if (AddLine(pCorpus, &nCapacity, pszLine) != OK) {
+      nResult = ERROR;
+      break;
+    }
+  }
+
+  free(pszLine);
+  fclose(fp);
+
+  return nResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeCorpus function
+
+static void FreeCorpus(CORPUS* pCorpus) {
+  FreeStringArray(&pCorpus->ppszLines, pCorpus->nLines);
+  pCorpus->nLines = 0;
+  pCorpus->nTotalBytes = 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompareDoubles function - qsort comparer for latencies.
+//
+
+static int CompareDoubles(const void* pvLeft, const void* pvRight) {
+  double dLeft = *(const double*) pvLeft;
+  double dRight = *(const double*) pvRight;
+  return (dLeft > dRight) - (dLeft < dRight);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadNanoseconds function - Reads the monotonic clock, in nanoseconds.
+//
+
+static inline double ReadNanoseconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReplayThreadProc function - Replays the whole corpus once, timing each
+// line.
+//
+
+static void* ReplayThreadProc(void* pvArg) {
+  REPLAY_THREAD* pThread = (REPLAY_THREAD*) pvArg;
+  const CORPUS* pCorpus = pThread->pCorpus;
+  unsigned long long ullChecksum = 0;
+
+  pthread_barrier_wait(pThread->pBarrier);
+
+  for (int i = 0; i < pCorpus->nLines; i++) {
+    double dStart = ReadNanoseconds();
+    ullChecksum += pCorpus->pfnPipeline(pCorpus->ppszLines[i]);
+    pThread->pdLatencies[i] = ReadNanoseconds() - dStart;
+  }
+
+  g_ullBenchSink += ullChecksum;
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReplayCorpus function - Replays a corpus at every thread count in the
+// options and reports the results.
+//
+
+static int ReplayCorpus(const BENCH_OPTIONS* pOptions, const CORPUS* pCorpus) {
+  if (pCorpus->nLines == 0) {
+    return OK;
+  }
+
+  /* One untimed pass to warm up caches and the allocator */
+  for (int i = 0; i < pCorpus->nLines; i++) {
+    g_ullBenchSink += pCorpus->pfnPipeline(pCorpus->ppszLines[i]);
+  }
+
+  for (int t = 0; t < pOptions->nThreadCountCount; t++) {
+    const int THREADS = pOptions->nThreadCounts[t];
+    const size_t SAMPLES = (size_t) THREADS * pCorpus->nLines;
+
+    double* pdLatencies = (double*) malloc(SAMPLES * sizeof(double));
+    if (pdLatencies == NULL) {
+      return ERROR;
+    }
+
+    PERF_COUNTERS counters;
+    PERF_READING reading;
+    ClearPerfReading(&reading);
+    const BOOL COUNTERS = pOptions->bCounters
+        && OpenPerfCounters(&counters) > 0;
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, THREADS + 1);
+
+    pthread_t threads[THREADS];
+    REPLAY_THREAD threadArgs[THREADS];
+    for (int i = 0; i < THREADS; i++) {
+      threadArgs[i].pCorpus = pCorpus;
+      threadArgs[i].pdLatencies = &pdLatencies[(size_t) i * pCorpus->nLines];
+      threadArgs[i].pBarrier = &barrier;
+      if (pthread_create(&threads[i], NULL, ReplayThreadProc,
+          &threadArgs[i]) != 0) {
+        fprintf(stderr, "bench: could not start %d threads\n", THREADS);
+        exit(ERROR);  // The barrier can never open
+      }
+    }
+
+    long long llAllocationsBefore = CountAllocations();
+    if (COUNTERS) {
+      StartPerfCounters(&counters);
+    }
+    pthread_barrier_wait(&barrier);
+    double dStart = ReadNanoseconds();
+    for (int i = 0; i < THREADS; i++) {
+      pthread_join(threads[i], NULL);
+    }
+    double dElapsed = ReadNanoseconds() - dStart;
+    pthread_barrier_destroy(&barrier);
+    long long llAllocationsAfter = CountAllocations();
+    if (COUNTERS) {
+      StopPerfCounters(&counters, &reading);
+      ClosePerfCounters(&counters);
+    }
+
+    qsort(pdLatencies, SAMPLES, sizeof(double), CompareDoubles);
+
+    BENCH_RESULT result;
+    memset(&result, 0, sizeof(result));
+    snprintf(result.szName, sizeof(result.szName), "replay:%s",
+        pCorpus->pszName);
+    snprintf(result.szParams, sizeof(result.szParams), "lines=%d;bytes=%zu",
+        pCorpus->nLines, pCorpus->nTotalBytes);
+    result.nThreads = THREADS;
+    result.ullIterations = pCorpus->nLines;
+    result.dNanosecondsPerOp = dElapsed / pCorpus->nLines;
+    result.dBytesPerSecond = pCorpus->nTotalBytes * (double) THREADS
+        / (dElapsed / 1e9);
+    result.dAllocationsPerOp = llAllocationsBefore < 0
+        ? -1
+        : (double) (llAllocationsAfter - llAllocationsBefore) / SAMPLES;
+    result.dP50Nanoseconds = pdLatencies[SAMPLES / 2];
+    result.dP99Nanoseconds = pdLatencies[(size_t) (SAMPLES * 0.99)];
+    result.dP999Nanoseconds = pdLatencies[(size_t) (SAMPLES * 0.999)];
+    ApplyPerfReading(&result, &reading, (double) SAMPLES,
+        (double) pCorpus->nTotalBytes * THREADS);
+
+    ReportBenchResult(pOptions, &result);
+
+    free(pdLatencies);
+  }
+
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// RunReplayBenchmarks function
+
+int RunReplayBenchmarks(const BENCH_OPTIONS* pOptions,
+    const char* pszCorpus, const char* pszInputPath, int nLines) {
+  CORPUS corpora[] = {
+    { "logs", ProcessLogLine, NULL, 0, 0 },
+    { "csv", ProcessCsvLine, NULL, 0, 0 },
+    { "config", ProcessConfigLine, NULL, 0, 0 }
+  };
+  const int CORPUS_COUNT = sizeof(corpora) / sizeof(corpora[0]);
+
+  const BOOL ALL = Equals(pszCorpus, "all");
+  if (ALL && pszInputPath != NULL) {
+    fprintf(stderr, "bench: --input needs --corpus logs, csv or config\n");
+    return ERROR;
+  }
+
+  if (nLines <= 0) {
+    nLines = 100000;
+  }
+
+  BOOL bFound = FALSE;
+  for (int i = 0; i < CORPUS_COUNT; i++) {
+    if (!ALL && !Equals(pszCorpus, corpora[i].pszName)) {
+      continue;
+    }
+    bFound = TRUE;
+
+    char szName[32];
+    snprintf(szName, sizeof(szName), "replay:%s", corpora[i].pszName);
+    if (!IsBenchSelected(pOptions, szName)) {
+      continue;
+    }
+
+    int nResult = pszInputPath != NULL
+        ? LoadCorpus(&corpora[i], pszInputPath)
+        : GenerateCorpus(&corpora[i], nLines);
+    if (nResult == OK) {
+      nResult = ReplayCorpus(pOptions, &corpora[i]);
+    }
+
+    FreeCorpus(&corpora[i]);
+    if (nResult != OK) {
+      return ERROR;
+    }
+  }
+
+  if (!bFound) {
+    fprintf(stderr, "bench: unknown corpus '%s'\n", pszCorpus);
+    return ERROR;
+  }
+
+  return OK;
+}
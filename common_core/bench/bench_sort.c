@@ -0,0 +1,471 @@
+// bench_sort.c - Benchmarks of the string-array sorts against qsort(3) with strcmp(3) and
+// strcasecmp(3)
+//
+// Each run sorts a fresh copy of a generated array of lines, so the copy is part of every
+// measurement; the runs of SortUniqueStrings, which frees the duplicates, copy the lines
+// themselves too, as do those of the qsort-then-unique code it is measured against, and free
+// the lines kept.  The lines are of three kinds: log lines, which share long timestamp prefixes;
+// file paths, which share directories; and short words in mixed case.  Before an array is timed,
+// every sort's output is checked against qsort's, and the stable sort's for keeping equal lines
+// in order; SortUniqueStrings is checked on several thread counts, for keeping the first of each
+// set of equal lines.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define SORT_LINE_SIZE          128
+
+/* Lines of one kind, generated into one buffer in order, so that comparing
+ * two lines' pointers tells which came first */
+typedef struct _SORT_WORKLOAD {
+  const char* pszKind;
+  char* pchText;
+  char** ppszLines;
+  int nLines;
+  size_t nTotalBytes;
+} SORT_WORKLOAD;
+
+typedef struct _SORT_CONTEXT {
+  const SORT_WORKLOAD* pWorkload;
+  char** ppszScratch;
+} SORT_CONTEXT;
+
+static const char* s_pszSortKinds[] = { "logs", "paths", "words" };
+
+static const char* s_pszSyllables[] = { "ka", "lo", "mi", "ne", "ru", "sa",
+    "te", "vo", "ya", "zu", "Ba", "Da", "Fo", "Gi", "Ho", "Ju" };
+
+#define COUNT_OF(array)   (sizeof(array) / sizeof((array)[0]))
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+static int CompareLines(const void* pvLeft, const void* pvRight) {
+  return strcmp(*(char* const*) pvLeft, *(char* const*) pvRight);
+}
+
+static int CompareLinesNoCase(const void* pvLeft, const void* pvRight) {
+  return strcasecmp(*(char* const*) pvLeft, *(char* const*) pvRight);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FormatLine function - Writes line i of a workload of the kind specified.
+//
+
+static void FormatLine(const char* pszKind, int i, unsigned int* pnSeed,
+    char* pszLine) {
+  if (Equals(pszKind, "logs")) {
+    /* About a thousand lines a second, so the timestamps share prefixes */
+    const int SECONDS = i / 1000;
+    snprintf(pszLine, SORT_LINE_SIZE, "2024-05-%02d %02d:%02d:%02d.%03d %s "
+        "[worker-%d] request %s id=%08x", 1 + SECONDS / 86400 % 28,
+        SECONDS / 3600 % 24, SECONDS / 60 % 60, SECONDS % 60,
+        rand_r(pnSeed) % 1000, rand_r(pnSeed) % 8 == 0 ? "WARN" : "INFO",
+        rand_r(pnSeed) % 16, rand_r(pnSeed) % 2 ? "served" : "queued",
+        (unsigned int) rand_r(pnSeed));
+  } else if (Equals(pszKind, "paths")) {
+    snprintf(pszLine, SORT_LINE_SIZE, "/var/lib/service/data/shard-%03d/"
+        "segment-%06d/%s.idx", rand_r(pnSeed) % 64, rand_r(pnSeed) % 20000,
+        rand_r(pnSeed) % 2 ? "offsets" : "terms");
+  } else {
+    size_t nLength = 0;
+    const int SYLLABLES = 1 + rand_r(pnSeed) % 4;
+    for (int s = 0; s < SYLLABLES; s++) {
+      nLength += snprintf(pszLine + nLength, SORT_LINE_SIZE - nLength, "%s",
+          s_pszSyllables[rand_r(pnSeed) % COUNT_OF(s_pszSyllables)]);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeSortWorkload function
+
+static void FreeSortWorkload(SORT_WORKLOAD* pWorkload) {
+  free(pWorkload->pchText);
+  free(pWorkload->ppszLines);
+  memset(pWorkload, 0, sizeof(SORT_WORKLOAD));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateSortWorkload function - Makes nLines lines of the kind specified.
+// Returns FALSE if memory ran out.
+//
+
+static BOOL GenerateSortWorkload(SORT_WORKLOAD* pWorkload,
+    const char* pszKind, int nLines) {
+  unsigned int nSeed = (unsigned int) nLines;
+
+  memset(pWorkload, 0, sizeof(SORT_WORKLOAD));
+  pWorkload->pszKind = pszKind;
+  pWorkload->pchText = (char*) malloc((size_t) nLines * SORT_LINE_SIZE);
+  pWorkload->ppszLines = (char**) malloc((size_t) nLines * sizeof(char*));
+  if (pWorkload->pchText == NULL || pWorkload->ppszLines == NULL) {
+    FreeSortWorkload(pWorkload);
+    return FALSE;
+  }
+
+  /* Shuffle the line numbers, so that the input is out of order but its text
+   * is laid out in input order */
+  int* pnOrder = (int*) malloc((size_t) nLines * sizeof(int));
+  if (pnOrder == NULL) {
+    FreeSortWorkload(pWorkload);
+    return FALSE;
+  }
+  for (int i = 0; i < nLines; i++) {
+    pnOrder[i] = i;
+  }
+  for (int i = nLines - 1; i > 0; i--) {
+    const int J = rand_r(&nSeed) % (i + 1);
+    const int LINE = pnOrder[i];
+    pnOrder[i] = pnOrder[J];
+    pnOrder[J] = LINE;
+  }
+
+  char* pchNext = pWorkload->pchText;
+  for (int i = 0; i < nLines; i++) {
+    FormatLine(pszKind, pnOrder[i], &nSeed, pchNext);
+    pWorkload->ppszLines[i] = pchNext;
+    pchNext += strlen(pchNext) + 1;
+  }
+  free(pnOrder);
+
+  pWorkload->nLines = nLines;
+  pWorkload->nTotalBytes = pchNext - pWorkload->pchText;
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckSortWorkload function - Sorts the lines with each sort, and with
+// qsort, and compares the results.  Returns the number of disagreements.
+//
+
+static int CheckSortWorkload(const SORT_WORKLOAD* pWorkload) {
+  const size_t SIZE = (size_t) pWorkload->nLines * sizeof(char*);
+  char** ppszExpected = (char**) malloc(SIZE);
+  char** ppszActual = (char**) malloc(SIZE);
+  int nFailures = 0;
+
+  if (ppszExpected == NULL || ppszActual == NULL) {
+    free(ppszExpected);
+    free(ppszActual);
+    return 1;
+  }
+
+  for (int nFold = 0; nFold < 2; nFold++) {
+    int (*pfnCompare)(const void*, const void*) = nFold
+        ? CompareLinesNoCase : CompareLines;
+    memcpy(ppszExpected, pWorkload->ppszLines, SIZE);
+    qsort(ppszExpected, pWorkload->nLines, sizeof(char*), pfnCompare);
+
+    for (int nStable = 0; nStable < 2; nStable++) {
+      memcpy(ppszActual, pWorkload->ppszLines, SIZE);
+      const int RESULT = nStable
+          ? SortStringsStable(ppszActual, pWorkload->nLines, nFold)
+          : SortStrings(ppszActual, pWorkload->nLines, nFold);
+
+      int nWrong = RESULT == OK ? -1 : 0;
+      for (int i = 0; RESULT == OK && nWrong < 0 && i < pWorkload->nLines;
+          i++) {
+        const int ORDER = i == 0 ? -1 : pfnCompare(&ppszActual[i - 1],
+            &ppszActual[i]);
+        if (pfnCompare(&ppszActual[i], &ppszExpected[i]) != 0
+            || (nStable && ORDER == 0 && ppszActual[i - 1] > ppszActual[i])) {
+          nWrong = i;
+        }
+      }
+
+      if (nWrong >= 0) {
+        fprintf(stderr, "sort: %s%s is wrong on %s lines at line %d\n",
+            nStable ? "SortStringsStable" : "SortStrings",
+            nFold ? " (NoCase)" : "", pWorkload->pszKind, nWrong);
+        nFailures++;
+      }
+    }
+  }
+
+  free(ppszExpected);
+  free(ppszActual);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DuplicateLines function - Copies the lines to the heap.  Returns FALSE if
+// memory ran out, having freed the copies made.
+//
+
+static BOOL DuplicateLines(const SORT_WORKLOAD* pWorkload, char** ppszCopies) {
+  for (int i = 0; i < pWorkload->nLines; i++) {
+    ppszCopies[i] = strdup(pWorkload->ppszLines[i]);
+    if (ppszCopies[i] == NULL) {
+      while (i-- > 0) {
+        free(ppszCopies[i]);
+      }
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// QsortUnique function - Sorts heap-allocated lines with qsort and frees
+// the duplicates, the way deduplication is done without SortUniqueStrings.
+// Returns the number of lines kept.
+//
+
+static int QsortUnique(char** ppszLines, int nLines, BOOL bFoldCase) {
+  int (*pfnCompare)(const void*, const void*) = bFoldCase
+      ? CompareLinesNoCase : CompareLines;
+  int nKept = 0;
+
+  qsort(ppszLines, nLines, sizeof(char*), pfnCompare);
+  for (int i = 0; i < nLines; i++) {
+    if (nKept > 0 && pfnCompare(&ppszLines[nKept - 1], &ppszLines[i]) == 0) {
+      FreeBuffer((void**) &ppszLines[i]);
+    } else {
+      ppszLines[nKept++] = ppszLines[i];
+    }
+  }
+  return nKept;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckUniqueWorkload function - Deduplicates the lines with
+// SortUniqueStrings on several thread counts, and by sorting the line
+// numbers stably with qsort, and compares the results.  Returns the number
+// of disagreements.
+//
+
+static int CompareLineNumbers(const void* pvLeft, const void* pvRight,
+    void* pvLines) {
+  char* const* ppszLines = (char* const*) pvLines;
+  const int LEFT = *(const int*) pvLeft;
+  const int RIGHT = *(const int*) pvRight;
+  const int ORDER = CompareLines(&ppszLines[LEFT], &ppszLines[RIGHT]);
+  return ORDER != 0 ? ORDER : LEFT - RIGHT;
+}
+
+static int CheckUniqueWorkload(const SORT_WORKLOAD* pWorkload) {
+  static const int THREADS[] = { 1, 3, 8 };
+  const int LINES = pWorkload->nLines;
+  int* pnExpected = (int*) malloc((size_t) LINES * sizeof(int));
+  char** ppszCopies = (char**) malloc((size_t) LINES * sizeof(char*));
+  char** ppszOriginals = (char**) malloc((size_t) LINES * sizeof(char*));
+  int nFailures = 0;
+
+  if (pnExpected == NULL || ppszCopies == NULL || ppszOriginals == NULL) {
+    free(pnExpected);
+    free(ppszCopies);
+    free(ppszOriginals);
+    return 1;
+  }
+
+  /* The line numbers of the first of each set of equal lines, in order */
+  int nExpected = 0;
+  for (int i = 0; i < LINES; i++) {
+    pnExpected[i] = i;
+  }
+  qsort_r(pnExpected, LINES, sizeof(int), CompareLineNumbers,
+      pWorkload->ppszLines);
+  for (int i = 0; i < LINES; i++) {
+    if (nExpected == 0 || !Equals(pWorkload->ppszLines[pnExpected[i]],
+        pWorkload->ppszLines[pnExpected[nExpected - 1]])) {
+      pnExpected[nExpected++] = pnExpected[i];
+    }
+  }
+
+  for (size_t t = 0; t < COUNT_OF(THREADS); t++) {
+    if (!DuplicateLines(pWorkload, ppszCopies)) {
+      nFailures++;
+      break;
+    }
+
+    /* Copies of equal lines are told apart by their addresses */
+    memcpy(ppszOriginals, ppszCopies, (size_t) LINES * sizeof(char*));
+
+    int nKept = -1;
+    int nWrong = SortUniqueStrings(ppszCopies, LINES, FALSE, THREADS[t],
+        &nKept) == OK && nKept == nExpected ? -1 : 0;
+    for (int i = 0; nWrong < 0 && i < LINES; i++) {
+      if ((i < nExpected && ppszCopies[i] != ppszOriginals[pnExpected[i]])
+          || (i >= nExpected && ppszCopies[i] != NULL)) {
+        nWrong = i;
+      }
+    }
+
+    if (nWrong >= 0) {
+      fprintf(stderr, "sort: SortUniqueStrings on %d threads is wrong on %s "
+          "lines at line %d\n", THREADS[t], pWorkload->pszKind, nWrong);
+      nFailures++;
+    }
+
+    for (int i = 0; i < LINES; i++) {
+      free(ppszCopies[i]);
+    }
+  }
+
+  free(pnExpected);
+  free(ppszCopies);
+  free(ppszOriginals);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupSortContext function - Gives a thread an array to sort copies of the
+// lines in.
+//
+
+static void* SetupSortContext(const BENCH_CASE* pCase) {
+  const SORT_WORKLOAD* pWorkload = (const SORT_WORKLOAD*) pCase->pvData;
+
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) calloc(1, sizeof(SORT_CONTEXT)
+      + (size_t) pWorkload->nLines * sizeof(char*));
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->pWorkload = pWorkload;
+  pContext->ppszScratch = (char**) (pContext + 1);
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark bodies
+
+/* Each body copies the lines to the thread's scratch array and sorts them */
+#define COPY_LINES(pContext) \
+  memcpy((pContext)->ppszScratch, (pContext)->pWorkload->ppszLines, \
+      (size_t) (pContext)->pWorkload->nLines * sizeof(char*))
+
+static void RunQsortStrcasecmp(void* pvContext,
+    unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    COPY_LINES(pContext);
+    qsort(pContext->ppszScratch, pContext->pWorkload->nLines, sizeof(char*),
+        CompareLinesNoCase);
+  }
+  g_ullBenchSink += (uintptr_t) pContext->ppszScratch[0];
+}
+
+static void RunQsortStrcmp(void* pvContext, unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    COPY_LINES(pContext);
+    qsort(pContext->ppszScratch, pContext->pWorkload->nLines, sizeof(char*),
+        CompareLines);
+  }
+  g_ullBenchSink += (uintptr_t) pContext->ppszScratch[0];
+}
+
+static void RunSortStrings(void* pvContext, unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    COPY_LINES(pContext);
+    SortStrings(pContext->ppszScratch, pContext->pWorkload->nLines, FALSE);
+  }
+  g_ullBenchSink += (uintptr_t) pContext->ppszScratch[0];
+}
+
+static void RunSortStringsNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    COPY_LINES(pContext);
+    SortStrings(pContext->ppszScratch, pContext->pWorkload->nLines, TRUE);
+  }
+  g_ullBenchSink += (uintptr_t) pContext->ppszScratch[0];
+}
+
+static void RunQsortUnique(void* pvContext, unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    if (!DuplicateLines(pContext->pWorkload, pContext->ppszScratch)) {
+      return;
+    }
+    const int KEPT = QsortUnique(pContext->ppszScratch,
+        pContext->pWorkload->nLines, FALSE);
+    g_ullBenchSink += KEPT;
+    for (int j = 0; j < KEPT; j++) {
+      free(pContext->ppszScratch[j]);
+    }
+  }
+}
+
+static void RunSortUniqueStrings(void* pvContext,
+    unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    if (!DuplicateLines(pContext->pWorkload, pContext->ppszScratch)) {
+      return;
+    }
+    int nKept = 0;
+    SortUniqueStrings(pContext->ppszScratch, pContext->pWorkload->nLines,
+        FALSE, 0, &nKept);
+    g_ullBenchSink += nKept;
+    for (int j = 0; j < nKept; j++) {
+      free(pContext->ppszScratch[j]);
+    }
+  }
+}
+
+static void RunSortStringsStable(void* pvContext,
+    unsigned long long ullIterations) {
+  SORT_CONTEXT* pContext = (SORT_CONTEXT*) pvContext;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    COPY_LINES(pContext);
+    SortStringsStable(pContext->ppszScratch, pContext->pWorkload->nLines,
+        FALSE);
+  }
+  g_ullBenchSink += (uintptr_t) pContext->ppszScratch[0];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// RunSortBenchmarks function
+
+int RunSortBenchmarks(const BENCH_OPTIONS* pOptions, int nLines) {
+  static const char* pszNames[] = { "QsortStrcasecmp", "QsortStrcmp",
+      "QsortUnique", "SortStrings", "SortStringsNoCase",
+      "SortStringsStable", "SortUniqueStrings" };
+  void (*pfnRuns[])(void*, unsigned long long) = { RunQsortStrcasecmp,
+      RunQsortStrcmp, RunQsortUnique, RunSortStrings, RunSortStringsNoCase,
+      RunSortStringsStable, RunSortUniqueStrings };
+  int nFailures = 0;
+
+  for (size_t k = 0; k < COUNT_OF(s_pszSortKinds); k++) {
+    SORT_WORKLOAD workload;
+    if (!GenerateSortWorkload(&workload, s_pszSortKinds[k], nLines)) {
+      fprintf(stderr, "sort: cannot generate %d %s lines\n", nLines,
+          s_pszSortKinds[k]);
+      return nFailures + 1;
+    }
+
+    nFailures += CheckSortWorkload(&workload);
+    nFailures += CheckUniqueWorkload(&workload);
+
+    for (size_t r = 0; r < COUNT_OF(pszNames); r++) {
+      BENCH_CASE benchCase;
+      memset(&benchCase, 0, sizeof(benchCase));
+      benchCase.pszName = pszNames[r];
+      benchCase.nSize = workload.nTotalBytes;
+      benchCase.nBytesPerOp = benchCase.nSize;
+      benchCase.pvData = &workload;
+      benchCase.pfnSetup = SetupSortContext;
+      benchCase.pfnRun = pfnRuns[r];
+      snprintf(benchCase.szParams, sizeof(benchCase.szParams),
+          "lines=%d;kind=%s", workload.nLines, workload.pszKind);
+
+      if (IsBenchSelected(pOptions, benchCase.pszName)) {
+        RunBenchCase(pOptions, &benchCase);
+      }
+    }
+
+    FreeSortWorkload(&workload);
+  }
+
+  return nFailures;
+}
@@ -0,0 +1,1930 @@
+// bench_structures.c - Benchmarks of the data structures of common_core against the loops of
+// plain string calls they replace
+//
+// Each structure is measured over a generated workload of a given size (e.g., the number of
+// prefixes in a prefix set, or of distinct strings in an intern pool), next to the
+// straightforward code a caller would otherwise write.  Before a workload is timed, the two are
+// checked to give the same answers.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define SUBJECT_COUNT           4096
+#define SUBJECT_SIZE            96
+
+/* Route prefixes and request paths to match against them; shared by every
+ * thread, read-only once generated */
+typedef struct _ROUTE_WORKLOAD {
+  char** ppszPrefixes;
+  size_t* pnPrefixLengths;
+  int nPrefixes;
+  char** ppszSubjects;
+  int nSubjects;
+  size_t nTotalSubjectBytes;
+} ROUTE_WORKLOAD;
+
+typedef struct _ROUTE_CONTEXT {
+  const ROUTE_WORKLOAD* pWorkload;
+  LPPREFIX_SET pPrefixSet;
+} ROUTE_CONTEXT;
+
+static const char* s_pszRouteSegments[] = { "api", "v1", "v2", "users",
+    "orders", "items", "search", "admin", "static", "assets", "health",
+    "metrics", "accounts", "billing", "reports", "export" };
+
+static const int s_nPrefixCounts[] = { 16, 64, 256, 1024 };
+
+/* Header names, and their spellings as they arrive, interned in a
+ * case-sensitive and a case-folding pool; shared by every thread */
+typedef struct _VOCABULARY_WORKLOAD {
+  char** ppszWords;                 /* as spelled in the vocabulary */
+  int nWords;
+  char** ppszSubjects;              /* words, each spelled as it arrived */
+  const char** ppszInterned;        /* subjects, interned case-sensitively */
+  const char** ppszFolded;          /* subjects, interned case-insensitively */
+  int nSubjects;
+  size_t nTotalSubjectBytes;
+  LPINTERN_POOL pPool;
+  LPINTERN_POOL pFoldingPool;
+} VOCABULARY_WORKLOAD;
+
+static const char* s_pszHeaderNames[] = { "Accept", "Accept-Encoding",
+    "Accept-Language", "Authorization", "Cache-Control", "Connection",
+    "Content-Encoding", "Content-Length", "Content-Type", "Cookie", "Date",
+    "ETag", "Expires", "Host", "If-Modified-Since", "If-None-Match",
+    "Last-Modified", "Location", "Origin", "Pragma", "Referer", "Server",
+    "Set-Cookie", "Transfer-Encoding", "User-Agent", "Vary", "Via",
+    "X-Forwarded-For", "X-Forwarded-Proto", "X-Request-Id", "X-Trace-Id",
+    "X-Span-Id" };
+
+static const int s_nVocabularySizes[] = { 32, 256, 4096 };
+
+/* A thread's maps and scratch array for counting a vocabulary's subjects */
+typedef struct _COUNT_CONTEXT {
+  const VOCABULARY_WORKLOAD* pWorkload;
+  LPSTRING_MAP pMap;
+  LPSTRING_MAP pFoldingMap;
+  const char** ppszSorted;
+} COUNT_CONTEXT;
+
+/* A thread's scratch arrays for intersecting the two halves of a
+ * vocabulary's subjects by sorting */
+typedef struct _SET_CONTEXT {
+  const VOCABULARY_WORKLOAD* pWorkload;
+  const char** ppszLeft;
+  const char** ppszRight;
+} SET_CONTEXT;
+
+/* A list of paths, split out of one text as a deny list loaded from a file
+ * would be, indexed, and sorted for bsearch; and subjects to look up in it,
+ * of which some are in the list, some are not, and some are prefixes of
+ * paths in it.  Shared by every thread, read-only once generated */
+typedef struct _INDEX_WORKLOAD {
+  char** ppszStrings;               /* as Split returned them */
+  int nStrings;
+  char** ppszSorted;                /* the strings, sorted, distinct */
+  int nSorted;
+  char** ppszSubjects;
+  int nSubjects;
+  size_t nTotalSubjectBytes;
+  size_t nTotalStringBytes;
+  LPSTRING_INDEX pIndex;
+  char szImagePath[64];             /* the index, saved to a file */
+  size_t nIndexBytes;               /* the index's size, if allocations are
+                                       tracked; else 0 */
+} INDEX_WORKLOAD;
+
+static const int s_nIndexSizes[] = { 4096, 262144 };
+
+/* Bodies of the index suite that look one subject up; they come first */
+#define INDEX_LOOKUP_BODIES     4
+
+/* A large keyword list, in a case-folding Bloom filter and string map, and
+ * tokens to test against it, of which one in KEYWORD_HIT_RATE is a keyword
+ * spelled in another case.  Shared by every thread, read-only once
+ * generated */
+typedef struct _KEYWORD_WORKLOAD {
+  char** ppszKeywords;
+  int nKeywords;
+  char** ppszSubjects;
+  BOOL* pbKeywords;                 /* whether each subject is a keyword */
+  int nSubjects;
+  size_t nTotalSubjectBytes;
+  LPBLOOM_FILTER pFilter;
+  LPSTRING_MAP pMap;
+  double dFalsePositiveRate;        /* found by CheckKeywordWorkload */
+} KEYWORD_WORKLOAD;
+
+#define KEYWORD_HIT_RATE        16
+
+/* Subjects the batch body tests per call; divides SUBJECT_COUNT */
+#define KEYWORD_BATCH_SIZE      256
+
+static const int s_nKeywordCounts[] = { 65536, 1048576 };
+
+/* A configuration file of key=value lines, with no empty lines, so that
+ * Split finds the same lines as MapFile; shared by every thread, read-only
+ * once written */
+typedef struct _LINES_WORKLOAD {
+  char szPath[64];
+  size_t nFileSize;
+  int nLines;
+} LINES_WORKLOAD;
+
+static const int s_nLineCounts[] = { 1024, 262144 };
+
+/* Room for the workload of any suite */
+typedef union _STRUCTURE_WORKLOAD {
+  ROUTE_WORKLOAD route;
+  VOCABULARY_WORKLOAD vocabulary;
+  INDEX_WORKLOAD index;
+  KEYWORD_WORKLOAD keyword;
+  LINES_WORKLOAD lines;
+} STRUCTURE_WORKLOAD;
+
+typedef struct _STRUCTURE_BODY {
+  const char* pszName;
+  void (*pfnRun)(void* pvContext, unsigned long long ullIterations);
+} STRUCTURE_BODY;
+
+/* The bodies that time a structure against the code it replaces, and the
+ * workload they share: its sizes, and how to make it at one of them, check
+ * the structure on it, describe a body's case, and free it */
+typedef struct _STRUCTURE_SUITE {
+  const STRUCTURE_BODY* pBodies;
+  size_t nBodies;
+  const int* pnSizes;               /* e.g., prefix counts */
+  size_t nSizes;
+  const char* pszGenerateError;     /* printf format of the size */
+  BOOL (*pfnGenerate)(void* pvWorkload, int nSize);
+  int (*pfnCheck)(void* pvWorkload);  /* returns the disagreements */
+  void (*pfnFree)(void* pvWorkload);
+  void* (*pfnSetup)(const BENCH_CASE* pCase);
+  void (*pfnTeardown)(void* pvContext);
+  /* Stores the input size and params of the case of body nBody */
+  void (*pfnDescribe)(const void* pvWorkload, size_t nBody,
+      BENCH_CASE* pCase);
+} STRUCTURE_SUITE;
+
+#define COUNT_OF(array)   (sizeof(array) / sizeof((array)[0]))
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// FindLongestPrefixByLoop function - Does what a router without a prefix
+// set does: calls StartsWith on every prefix and keeps the longest match.
+//
+
+static int FindLongestPrefixByLoop(const ROUTE_WORKLOAD* pWorkload,
+    const char* pszSubject) {
+  int nBest = PREFIX_SET_NO_MATCH;
+  for (int i = 0; i < pWorkload->nPrefixes; i++) {
+    if (StartsWith(pszSubject, pWorkload->ppszPrefixes[i])
+        && (nBest == PREFIX_SET_NO_MATCH || pWorkload->pnPrefixLengths[i]
+            > pWorkload->pnPrefixLengths[nBest])) {
+      nBest = i;
+    }
+  }
+  return nBest;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeRouteWorkload function
+
+static void FreeRouteWorkload(void* pvWorkload) {
+  ROUTE_WORKLOAD* pWorkload = (ROUTE_WORKLOAD*) pvWorkload;
+  for (int i = 0; i < pWorkload->nPrefixes; i++) {
+    free(pWorkload->ppszPrefixes[i]);
+  }
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    free(pWorkload->ppszSubjects[i]);
+  }
+  free(pWorkload->ppszPrefixes);
+  free(pWorkload->pnPrefixLengths);
+  free(pWorkload->ppszSubjects);
+  memset(pWorkload, 0, sizeof(ROUTE_WORKLOAD));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateRouteWorkload function - Makes nPrefixes route prefixes of one to
+// four path segments, and request paths of which most extend a prefix, some
+// stop partway through one, and the rest match nothing.  Returns FALSE if
+// memory ran out.
+//
+
+static BOOL GenerateRouteWorkload(void* pvWorkload, int nPrefixes) {
+  ROUTE_WORKLOAD* pWorkload = (ROUTE_WORKLOAD*) pvWorkload;
+  unsigned int nSeed = (unsigned int) nPrefixes;
+  const int SEGMENTS = (int) COUNT_OF(s_pszRouteSegments);
+
+  memset(pWorkload, 0, sizeof(ROUTE_WORKLOAD));
+  pWorkload->ppszPrefixes = (char**) calloc(nPrefixes, sizeof(char*));
+  pWorkload->pnPrefixLengths = (size_t*) calloc(nPrefixes, sizeof(size_t));
+  pWorkload->ppszSubjects = (char**) calloc(SUBJECT_COUNT, sizeof(char*));
+  if (pWorkload->ppszPrefixes == NULL || pWorkload->pnPrefixLengths == NULL
+      || pWorkload->ppszSubjects == NULL) {
+    FreeRouteWorkload(pWorkload);
+    return FALSE;
+  }
+
+  for (int i = 0; i < nPrefixes; i++) {
+    char szPrefix[SUBJECT_SIZE] = "";
+    const int DEPTH = 1 + rand_r(&nSeed) % 4;
+    for (int d = 0; d < DEPTH; d++) {
+      snprintf(szPrefix + strlen(szPrefix), sizeof(szPrefix) - strlen(szPrefix),
+          "/%s", s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS]);
+    }
+
+    /* Keep most of them distinct, as real route tables are */
+    if (i >= SEGMENTS) {
+      snprintf(szPrefix + strlen(szPrefix), sizeof(szPrefix) - strlen(szPrefix),
+          "/%d", i);
+    }
+
+    pWorkload->ppszPrefixes[i] = strdup(szPrefix);
+    if (pWorkload->ppszPrefixes[i] == NULL) {
+      FreeRouteWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->pnPrefixLengths[i] = strlen(szPrefix);
+    pWorkload->nPrefixes++;
+  }
+
+  for (int i = 0; i < SUBJECT_COUNT; i++) {
+    char szSubject[SUBJECT_SIZE];
+    const char* pszPrefix = pWorkload->ppszPrefixes[rand_r(&nSeed) % nPrefixes];
+
+    switch (rand_r(&nSeed) % 4) {
+      case 0:
+        snprintf(szSubject, sizeof(szSubject), "/%s/unknown/%d",
+            s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS], rand_r(&nSeed));
+        break;
+
+      case 1:
+        snprintf(szSubject, sizeof(szSubject), "%.*s", 1 + (int) (rand_r(
+            &nSeed) % strlen(pszPrefix)), pszPrefix);
+        break;
+
+      default:
+        snprintf(szSubject, sizeof(szSubject), "%s/%d?page=%d", pszPrefix,
+            rand_r(&nSeed) % 100000, rand_r(&nSeed) % 10);
+        break;
+    }
+
+    pWorkload->ppszSubjects[i] = strdup(szSubject);
+    if (pWorkload->ppszSubjects[i] == NULL) {
+      FreeRouteWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->nTotalSubjectBytes += strlen(szSubject);
+    pWorkload->nSubjects++;
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TeardownRouteContext function
+
+static void TeardownRouteContext(void* pvContext) {
+  ROUTE_CONTEXT* pContext = (ROUTE_CONTEXT*) pvContext;
+  if (pContext == NULL) {
+    return;
+  }
+
+  FreePrefixSet(&pContext->pPrefixSet);
+  free(pContext);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupRouteContext function - Compiles the workload's prefixes for one
+// thread.
+//
+
+static void* SetupRouteContext(const BENCH_CASE* pCase) {
+  const ROUTE_WORKLOAD* pWorkload = (const ROUTE_WORKLOAD*) pCase->pvData;
+
+  ROUTE_CONTEXT* pContext = (ROUTE_CONTEXT*) calloc(1, sizeof(ROUTE_CONTEXT));
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->pWorkload = pWorkload;
+  if (CreatePrefixSet((const char* const*) pWorkload->ppszPrefixes,
+      pWorkload->nPrefixes, &pContext->pPrefixSet) != OK) {
+    TeardownRouteContext(pContext);
+    return NULL;
+  }
+
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckRouteWorkload function - Compiles the prefixes, and compares
+// MatchPrefixSet with the StartsWith loop on every subject.  Returns the
+// number of disagreements.
+//
+
+static int CheckRouteWorkload(void* pvWorkload) {
+  const ROUTE_WORKLOAD* pWorkload = (const ROUTE_WORKLOAD*) pvWorkload;
+  LPPREFIX_SET pPrefixSet = NULL;
+  if (CreatePrefixSet((const char* const*) pWorkload->ppszPrefixes,
+      pWorkload->nPrefixes, &pPrefixSet) != OK) {
+    fprintf(stderr, "structures: cannot build %d route prefixes\n",
+        pWorkload->nPrefixes);
+    return 1;
+  }
+
+  int nFailures = 0;
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[i];
+    const int EXPECTED = FindLongestPrefixByLoop(pWorkload, pszSubject);
+    const int ACTUAL = MatchPrefixSet(pPrefixSet, pszSubject);
+    const int ACTUAL_N = MatchPrefixSetN(pPrefixSet, pszSubject,
+        strlen(pszSubject));
+
+    /* Duplicate prefixes may differ in ID, but not in length */
+    if ((EXPECTED == PREFIX_SET_NO_MATCH) != (ACTUAL == PREFIX_SET_NO_MATCH)
+        || ACTUAL != ACTUAL_N
+        || (EXPECTED != PREFIX_SET_NO_MATCH
+            && !Equals(pWorkload->ppszPrefixes[EXPECTED],
+                pWorkload->ppszPrefixes[ACTUAL]))) {
+      if (nFailures++ < 5) {
+        fprintf(stderr, "structures: MatchPrefixSet gives %d (%d), the "
+            "StartsWith loop %d, on \"%s\"\n", ACTUAL, ACTUAL_N, EXPECTED,
+            pszSubject);
+      }
+    }
+  }
+
+  FreePrefixSet(&pPrefixSet);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescribeRouteCase function - Each body matches one subject.
+//
+
+static void DescribeRouteCase(const void* pvWorkload, size_t nBody,
+    BENCH_CASE* pCase) {
+  const ROUTE_WORKLOAD* pWorkload = (const ROUTE_WORKLOAD*) pvWorkload;
+  (void) nBody;
+  pCase->nSize = pWorkload->nTotalSubjectBytes / pWorkload->nSubjects;
+  snprintf(pCase->szParams, sizeof(pCase->szParams), "prefixes=%d",
+      pWorkload->nPrefixes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeVocabularyWorkload function
+
+static void FreeVocabularyWorkload(void* pvWorkload) {
+  VOCABULARY_WORKLOAD* pWorkload = (VOCABULARY_WORKLOAD*) pvWorkload;
+  for (int i = 0; i < pWorkload->nWords; i++) {
+    free(pWorkload->ppszWords[i]);
+  }
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    free(pWorkload->ppszSubjects[i]);
+  }
+  free(pWorkload->ppszWords);
+  free(pWorkload->ppszSubjects);
+  free(pWorkload->ppszInterned);
+  free(pWorkload->ppszFolded);
+  FreeInternPool(&pWorkload->pPool);
+  FreeInternPool(&pWorkload->pFoldingPool);
+  memset(pWorkload, 0, sizeof(VOCABULARY_WORKLOAD));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateVocabularyWorkload function - Makes a vocabulary of nWords header
+// names, the real ones first, then subjects drawn from it, half of them
+// spelled in another case, and interns the subjects in both pools.  Returns
+// FALSE if memory ran out.
+//
+
+static BOOL GenerateVocabularyWorkload(void* pvWorkload, int nWords) {
+  VOCABULARY_WORKLOAD* pWorkload = (VOCABULARY_WORKLOAD*) pvWorkload;
+  unsigned int nSeed = (unsigned int) nWords;
+
+  memset(pWorkload, 0, sizeof(VOCABULARY_WORKLOAD));
+  pWorkload->ppszWords = (char**) calloc(nWords, sizeof(char*));
+  pWorkload->ppszSubjects = (char**) calloc(SUBJECT_COUNT, sizeof(char*));
+  pWorkload->ppszInterned = (const char**) calloc(SUBJECT_COUNT,
+      sizeof(char*));
+  pWorkload->ppszFolded = (const char**) calloc(SUBJECT_COUNT,
+      sizeof(char*));
+  if (pWorkload->ppszWords == NULL || pWorkload->ppszSubjects == NULL
+      || pWorkload->ppszInterned == NULL || pWorkload->ppszFolded == NULL
+      || CreateInternPool(FALSE, &pWorkload->pPool) != OK
+      || CreateInternPool(TRUE, &pWorkload->pFoldingPool) != OK) {
+    FreeVocabularyWorkload(pWorkload);
+    return FALSE;
+  }
+
+  for (int i = 0; i < nWords; i++) {
+    char szWord[SUBJECT_SIZE];
+    if (i < (int) COUNT_OF(s_pszHeaderNames)) {
+      snprintf(szWord, sizeof(szWord), "%s", s_pszHeaderNames[i]);
+    } else {
+      snprintf(szWord, sizeof(szWord), "X-%s-%d",
+          s_pszHeaderNames[i % COUNT_OF(s_pszHeaderNames)], i);
+    }
+
+    pWorkload->ppszWords[i] = strdup(szWord);
+    if (pWorkload->ppszWords[i] == NULL) {
+      FreeVocabularyWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->nWords++;
+  }
+
+  for (int i = 0; i < SUBJECT_COUNT; i++) {
+    char* pszSubject = strdup(pWorkload->ppszWords[rand_r(&nSeed) % nWords]);
+    if (pszSubject == NULL) {
+      FreeVocabularyWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->ppszSubjects[i] = pszSubject;
+    pWorkload->nSubjects++;
+
+    if (rand_r(&nSeed) % 2 == 0) {
+      for (char* pch = pszSubject; *pch != '\0'; pch++) {
+        *pch = rand_r(&nSeed) % 2 == 0 ? toupper(*pch) : tolower(*pch);
+      }
+    }
+
+    pWorkload->ppszInterned[i] = InternString(pWorkload->pPool, pszSubject);
+    pWorkload->ppszFolded[i] = InternString(pWorkload->pFoldingPool,
+        pszSubject);
+    if (pWorkload->ppszInterned[i] == NULL
+        || pWorkload->ppszFolded[i] == NULL) {
+      FreeVocabularyWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->nTotalSubjectBytes += strlen(pszSubject);
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckVocabularyWorkload function - Compares pointer equality of interned
+// strings with Equals and EqualsNoCase on pairs of subjects.  Returns the
+// number of disagreements.
+//
+
+static int CheckVocabularyWorkload(void* pvWorkload) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      (const VOCABULARY_WORKLOAD*) pvWorkload;
+  int nFailures = 0;
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    for (int j = i; j < pWorkload->nSubjects; j += 1 + j % 61) {
+      const char* pszLeft = pWorkload->ppszSubjects[i];
+      const char* pszRight = pWorkload->ppszSubjects[j];
+      if (Equals(pszLeft, pszRight)
+          != (pWorkload->ppszInterned[i] == pWorkload->ppszInterned[j])
+          || EqualsNoCase(pszLeft, pszRight)
+          != (pWorkload->ppszFolded[i] == pWorkload->ppszFolded[j])
+          || InternString(pWorkload->pPool, pszLeft)
+          != pWorkload->ppszInterned[i]) {
+        if (nFailures++ < 5) {
+          fprintf(stderr, "structures: interning disagrees with Equals or "
+              "EqualsNoCase on \"%s\" and \"%s\"\n", pszLeft, pszRight);
+        }
+      }
+    }
+  }
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescribeInternCase function - Each body interns or compares one subject.
+//
+
+static void DescribeInternCase(const void* pvWorkload, size_t nBody,
+    BENCH_CASE* pCase) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      (const VOCABULARY_WORKLOAD*) pvWorkload;
+  (void) nBody;
+  pCase->nSize = pWorkload->nTotalSubjectBytes / pWorkload->nSubjects;
+  snprintf(pCase->szParams, sizeof(pCase->szParams), "vocabulary=%d",
+      pWorkload->nWords);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescribeVocabularyCase function - Each body counts, or combines, every
+// subject.
+//
+
+static void DescribeVocabularyCase(const void* pvWorkload, size_t nBody,
+    BENCH_CASE* pCase) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      (const VOCABULARY_WORKLOAD*) pvWorkload;
+  (void) nBody;
+  pCase->nSize = pWorkload->nTotalSubjectBytes;
+  snprintf(pCase->szParams, sizeof(pCase->szParams), "vocabulary=%d",
+      pWorkload->nWords);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompareStrings function - qsort(3) comparisons of string pointers, by
+// strcmp(3) and by strcasecmp(3).
+//
+
+static int CompareStrings(const void* pvLeft, const void* pvRight) {
+  return strcmp(*(const char* const*) pvLeft, *(const char* const*) pvRight);
+}
+
+static int CompareStringsNoCase(const void* pvLeft, const void* pvRight) {
+  return strcasecmp(*(const char* const*) pvLeft,
+      *(const char* const*) pvRight);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CountBySorting function - Does what a caller without a map does to count
+// tokens: sorts them and measures the runs of equal ones.  Returns the
+// number of distinct tokens; if pMap is not NULL, also checks each run's
+// length against the map's count of its token, adding disagreements to
+// *pnFailures.
+//
+
+static int CountBySorting(const char** ppszSorted, char* const* ppszTokens,
+    int nTokens, BOOL bFoldCase, const STRING_MAP* pMap, int* pnFailures) {
+  int (*pfnCompare)(const void*, const void*) = bFoldCase
+      ? CompareStringsNoCase : CompareStrings;
+  memcpy(ppszSorted, ppszTokens, nTokens * sizeof(char*));
+  qsort(ppszSorted, nTokens, sizeof(char*), pfnCompare);
+
+  int nDistinct = 0;
+  for (int i = 0, j; i < nTokens; i = j) {
+    for (j = i + 1; j < nTokens && pfnCompare(&ppszSorted[i],
+        &ppszSorted[j]) == 0; j++) {
+    }
+    nDistinct++;
+
+    if (pMap != NULL) {
+      const long* plCount = (const long*) FindStringMapValue(pMap,
+          StringViewOf(ppszSorted[j - 1]));
+      if ((plCount == NULL || *plCount != j - i) && (*pnFailures)++ < 5) {
+        fprintf(stderr, "structures: the map counts \"%s\" %ld times, "
+            "sorting %d times\n", ppszSorted[i],
+            plCount == NULL ? 0 : *plCount, j - i);
+      }
+    }
+  }
+  return nDistinct;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CountByMap function - Counts tokens in a map, emptied first.  Returns the
+// number of distinct tokens, or -1 if memory ran out.
+//
+
+static int CountByMap(LPSTRING_MAP pMap, char* const* ppszTokens,
+    int nTokens) {
+  ClearStringMap(pMap);
+  for (int i = 0; i < nTokens; i++) {
+    long* plCount = (long*) InsertStringMapKey(pMap,
+        StringViewOf(ppszTokens[i]), NULL);
+    if (plCount == NULL) {
+      return -1;
+    }
+    ++*plCount;
+  }
+  return (int) GetStringMapCount(pMap);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TeardownCountContext function
+
+static void TeardownCountContext(void* pvContext) {
+  COUNT_CONTEXT* pContext = (COUNT_CONTEXT*) pvContext;
+  if (pContext == NULL) {
+    return;
+  }
+
+  FreeStringMap(&pContext->pMap);
+  FreeStringMap(&pContext->pFoldingMap);
+  free(pContext->ppszSorted);
+  free(pContext);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupCountContext function - Gives a thread its own maps and sorting
+// space for counting the workload's subjects.
+//
+
+static void* SetupCountContext(const BENCH_CASE* pCase) {
+  COUNT_CONTEXT* pContext = (COUNT_CONTEXT*) calloc(1, sizeof(COUNT_CONTEXT));
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->pWorkload = (const VOCABULARY_WORKLOAD*) pCase->pvData;
+  pContext->ppszSorted = (const char**) malloc(
+      pContext->pWorkload->nSubjects * sizeof(char*));
+  if (pContext->ppszSorted == NULL
+      || CreateStringMap(FALSE, sizeof(long), &pContext->pMap) != OK
+      || CreateStringMap(TRUE, sizeof(long), &pContext->pFoldingMap) != OK) {
+    TeardownCountContext(pContext);
+    return NULL;
+  }
+
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckCountWorkload function - Counts the subjects with a map and by
+// sorting, with and without regard to case, and compares the counts.
+// Returns the number of disagreements.
+//
+
+static int CheckCountWorkload(void* pvWorkload) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      (const VOCABULARY_WORKLOAD*) pvWorkload;
+  BENCH_CASE benchCase;
+  memset(&benchCase, 0, sizeof(benchCase));
+  benchCase.pvData = pWorkload;
+
+  COUNT_CONTEXT* pContext = (COUNT_CONTEXT*) SetupCountContext(&benchCase);
+  if (pContext == NULL) {
+    return 1;
+  }
+
+  int nFailures = 0;
+  for (int nFold = 0; nFold < 2; nFold++) {
+    LPSTRING_MAP pMap = nFold ? pContext->pFoldingMap : pContext->pMap;
+    const int DISTINCT = CountByMap(pMap, pWorkload->ppszSubjects,
+        pWorkload->nSubjects);
+    const int EXPECTED = CountBySorting(pContext->ppszSorted,
+        pWorkload->ppszSubjects, pWorkload->nSubjects, nFold, pMap,
+        &nFailures);
+    if (DISTINCT != EXPECTED && nFailures++ < 5) {
+      fprintf(stderr, "structures: the map%s finds %d distinct subjects, "
+          "sorting %d\n", nFold ? " (NoCase)" : "", DISTINCT, EXPECTED);
+    }
+  }
+
+  TeardownCountContext(pContext);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IntersectBySorting function - Does what a caller without the set
+// operations does to intersect two token lists: sorts both and walks them
+// side by side.  Returns the number of distinct tokens they share.
+//
+
+static int IntersectBySorting(const char** ppszLeft, char* const* ppszTokens,
+    int nLeft, const char** ppszRight, char* const* ppszRightTokens,
+    int nRight, BOOL bFoldCase) {
+  int (*pfnCompare)(const void*, const void*) = bFoldCase
+      ? CompareStringsNoCase : CompareStrings;
+  memcpy(ppszLeft, ppszTokens, nLeft * sizeof(char*));
+  memcpy(ppszRight, ppszRightTokens, nRight * sizeof(char*));
+  qsort(ppszLeft, nLeft, sizeof(char*), pfnCompare);
+  qsort(ppszRight, nRight, sizeof(char*), pfnCompare);
+
+  int nShared = 0;
+  for (int i = 0, j = 0; i < nLeft && j < nRight; ) {
+    const int ORDER = pfnCompare(&ppszLeft[i], &ppszRight[j]);
+    if (ORDER < 0) {
+      i++;
+    } else if (ORDER > 0) {
+      j++;
+    } else {
+      nShared++;
+      for (i++; i < nLeft && pfnCompare(&ppszLeft[i - 1], &ppszLeft[i]) == 0;
+          i++) {
+      }
+      for (j++; j < nRight
+          && pfnCompare(&ppszRight[j - 1], &ppszRight[j]) == 0; j++) {
+      }
+    }
+  }
+  return nShared;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CountSetOperation function - Runs a set operation on the two halves of a
+// vocabulary's subjects, and frees its result.  Returns the number of
+// strings in the result, or -1 if the operation failed.
+//
+
+static int CountSetOperation(const VOCABULARY_WORKLOAD* pWorkload,
+    int (*pfnOperation)(char* const*, int, char* const*, int, BOOL, char***,
+        int*), BOOL bFoldCase) {
+  const int HALF = pWorkload->nSubjects / 2;
+  char** ppszResult = NULL;
+  int nResult = 0;
+
+  if (pfnOperation(pWorkload->ppszSubjects, HALF,
+      pWorkload->ppszSubjects + HALF, pWorkload->nSubjects - HALF, bFoldCase,
+      &ppszResult, &nResult) != OK) {
+    return -1;
+  }
+
+  FreeBuffer((void**) &ppszResult);
+  return nResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UniqueSubjects function - UniqueStrings on the subjects, with the
+// signature of the set operations, for CountSetOperation.
+//
+
+static int UniqueSubjects(char* const* ppszLeft, int nLeft,
+    char* const* ppszRight, int nRight, BOOL bFoldCase, char*** pppszResult,
+    int* pnResultCount) {
+  (void) ppszRight;
+  return UniqueStrings(ppszLeft, nLeft + nRight, bFoldCase, pppszResult,
+      pnResultCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupSetContext function - Gives a thread its own sorting space for
+// intersecting the workload's subjects.
+//
+
+static void* SetupSetContext(const BENCH_CASE* pCase) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      (const VOCABULARY_WORKLOAD*) pCase->pvData;
+
+  SET_CONTEXT* pContext = (SET_CONTEXT*) calloc(1, sizeof(SET_CONTEXT)
+      + pWorkload->nSubjects * sizeof(char*));
+  if (pContext == NULL) {
+    return NULL;
+  }
+
+  pContext->pWorkload = pWorkload;
+  pContext->ppszLeft = (const char**) (pContext + 1);
+  pContext->ppszRight = pContext->ppszLeft + pWorkload->nSubjects / 2;
+  return pContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckSetWorkload function - Runs each set operation on the halves of the
+// subjects, with and without regard to case, and compares the sizes of the
+// results with those sorting and counting give.  Returns the number of
+// disagreements.
+//
+
+static int CheckSetWorkload(void* pvWorkload) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      (const VOCABULARY_WORKLOAD*) pvWorkload;
+  BENCH_CASE benchCase;
+  memset(&benchCase, 0, sizeof(benchCase));
+  benchCase.pvData = pWorkload;
+
+  SET_CONTEXT* pContext = (SET_CONTEXT*) SetupSetContext(&benchCase);
+  const char** ppszSorted = (const char**) malloc(pWorkload->nSubjects
+      * sizeof(char*));
+  if (pContext == NULL || ppszSorted == NULL) {
+    free(pContext);
+    free(ppszSorted);
+    return 1;
+  }
+
+  const int HALF = pWorkload->nSubjects / 2;
+  int nFailures = 0;
+  for (int nFold = 0; nFold < 2; nFold++) {
+    const int SHARED = IntersectBySorting(pContext->ppszLeft,
+        pWorkload->ppszSubjects, HALF, pContext->ppszRight,
+        pWorkload->ppszSubjects + HALF, pWorkload->nSubjects - HALF, nFold);
+    const int LEFT = CountBySorting(ppszSorted, pWorkload->ppszSubjects,
+        HALF, nFold, NULL, NULL);
+    const int ALL = CountBySorting(ppszSorted, pWorkload->ppszSubjects,
+        pWorkload->nSubjects, nFold, NULL, NULL);
+
+    const struct {
+      const char* pszName;
+      int (*pfnOperation)(char* const*, int, char* const*, int, BOOL,
+          char***, int*);
+      int nExpected;
+    } CHECKS[] = {
+      { "IntersectStrings", IntersectStrings, SHARED },
+      { "SubtractStrings", SubtractStrings, LEFT - SHARED },
+      { "UnionStrings", UnionStrings, ALL },
+      { "UniqueStrings", UniqueSubjects, ALL }
+    };
+
+    for (size_t c = 0; c < COUNT_OF(CHECKS); c++) {
+      const int ACTUAL = CountSetOperation(pWorkload, CHECKS[c].pfnOperation,
+          nFold);
+      if (ACTUAL != CHECKS[c].nExpected && nFailures++ < 5) {
+        fprintf(stderr, "structures: %s%s gives %d strings, sorting %d\n",
+            CHECKS[c].pszName, nFold ? " (NoCase)" : "", ACTUAL,
+            CHECKS[c].nExpected);
+      }
+    }
+  }
+
+  free(pContext);
+  free(ppszSorted);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindSortedPrefix function - Does what a caller without an index does to
+// find the strings of a sorted array that start with a prefix: two binary
+// searches, for the first string not before the prefix and the first one
+// after the strings starting with it.  Returns the position of the first,
+// and stores the number of strings in the range.
+//
+
+static int FindSortedPrefix(char* const* ppszSorted, int nSorted,
+    const char* pszPrefix, int* pnCount) {
+  const size_t LENGTH = strlen(pszPrefix);
+  int nFirst = 0;
+  for (int nEnd = nSorted; nFirst < nEnd; ) {
+    const int MIDDLE = nFirst + (nEnd - nFirst) / 2;
+    if (strcmp(ppszSorted[MIDDLE], pszPrefix) < 0) {
+      nFirst = MIDDLE + 1;
+    } else {
+      nEnd = MIDDLE;
+    }
+  }
+
+  int nLast = nFirst;
+  for (int nEnd = nSorted; nLast < nEnd; ) {
+    const int MIDDLE = nLast + (nEnd - nLast) / 2;
+    if (strncmp(ppszSorted[MIDDLE], pszPrefix, LENGTH) <= 0) {
+      nLast = MIDDLE + 1;
+    } else {
+      nEnd = MIDDLE;
+    }
+  }
+
+  *pnCount = nLast - nFirst;
+  return nFirst;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindSortedString function - bsearch(3) on the sorted strings.  Returns the
+// position of the key, or STRING_INDEX_NOT_FOUND.
+//
+
+static int FindSortedString(char* const* ppszSorted, int nSorted,
+    const char* pszKey) {
+  char* const* ppszFound = (char* const*) bsearch(&pszKey, ppszSorted,
+      nSorted, sizeof(char*), CompareStrings);
+  return ppszFound == NULL ? STRING_INDEX_NOT_FOUND
+      : (int) (ppszFound - ppszSorted);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeIndexWorkload function
+
+static void FreeIndexWorkload(void* pvWorkload) {
+  INDEX_WORKLOAD* pWorkload = (INDEX_WORKLOAD*) pvWorkload;
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    free(pWorkload->ppszSubjects[i]);
+  }
+  FreeStringArray(&pWorkload->ppszStrings, pWorkload->nStrings);
+  free(pWorkload->ppszSorted);
+  free(pWorkload->ppszSubjects);
+  FreeStringIndex(&pWorkload->pIndex);
+  if (pWorkload->szImagePath[0] != '\0') {
+    unlink(pWorkload->szImagePath);
+  }
+  memset(pWorkload, 0, sizeof(INDEX_WORKLOAD));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateIndexWorkload function - Makes a text of nStrings paths, one per
+// line, some of them repeated, splits it, indexes the lines and sorts a copy
+// of them, and saves the index to a file; then makes subjects, of which
+// half are paths of the list, a quarter are paths with their last character
+// changed, and a quarter are paths cut short.  Returns FALSE if memory ran
+// out or the file could not be written.
+//
+
+static BOOL GenerateIndexWorkload(void* pvWorkload, int nStrings) {
+  INDEX_WORKLOAD* pWorkload = (INDEX_WORKLOAD*) pvWorkload;
+  unsigned int nSeed = (unsigned int) nStrings;
+  const int SEGMENTS = (int) COUNT_OF(s_pszRouteSegments);
+
+  memset(pWorkload, 0, sizeof(INDEX_WORKLOAD));
+  char* pszText = (char*) malloc((size_t) nStrings * SUBJECT_SIZE + 1);
+  if (pszText == NULL) {
+    return FALSE;
+  }
+
+  size_t nTextLength = 0;
+  for (int i = 0; i < nStrings; i++) {
+    nTextLength += snprintf(pszText + nTextLength, SUBJECT_SIZE,
+        "/srv/%s/%s/%s/%06d.%s\n", s_pszRouteSegments[rand_r(&nSeed)
+        % SEGMENTS], s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS],
+        s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS], rand_r(&nSeed)
+        % (nStrings / 2), rand_r(&nSeed) % 2 ? "json" : "html");
+  }
+
+  if (Split(pszText, (int) nTextLength, "\n", &pWorkload->ppszStrings,
+      &pWorkload->nStrings) != OK || pWorkload->nStrings != nStrings) {
+    free(pszText);
+    FreeIndexWorkload(pWorkload);
+    return FALSE;
+  }
+  free(pszText);
+
+  pWorkload->ppszSorted = (char**) malloc(nStrings * sizeof(char*));
+  pWorkload->ppszSubjects = (char**) calloc(SUBJECT_COUNT, sizeof(char*));
+  if (pWorkload->ppszSorted == NULL || pWorkload->ppszSubjects == NULL
+      || CreateStringIndex(pWorkload->ppszStrings, nStrings,
+          &pWorkload->pIndex) != OK) {
+    FreeIndexWorkload(pWorkload);
+    return FALSE;
+  }
+
+  snprintf(pWorkload->szImagePath, sizeof(pWorkload->szImagePath),
+      "%s/common_core_bench.%ld.%d.idx", P_tmpdir, (long) getpid(),
+      nStrings);
+  if (SaveStringIndexFile(pWorkload->pIndex, pWorkload->szImagePath) != OK) {
+    pWorkload->szImagePath[0] = '\0';
+    FreeIndexWorkload(pWorkload);
+    return FALSE;
+  }
+
+  memcpy(pWorkload->ppszSorted, pWorkload->ppszStrings,
+      nStrings * sizeof(char*));
+  qsort(pWorkload->ppszSorted, nStrings, sizeof(char*), CompareStrings);
+  for (int i = 0; i < nStrings; i++) {
+    pWorkload->nTotalStringBytes += strlen(pWorkload->ppszStrings[i]);
+    if (pWorkload->nSorted == 0 || !Equals(pWorkload->ppszSorted[
+        pWorkload->nSorted - 1], pWorkload->ppszSorted[i])) {
+      pWorkload->ppszSorted[pWorkload->nSorted++] = pWorkload->ppszSorted[i];
+    }
+  }
+
+  for (int i = 0; i < SUBJECT_COUNT; i++) {
+    char* pszSubject = strdup(pWorkload->ppszStrings[rand_r(&nSeed)
+        % nStrings]);
+    if (pszSubject == NULL) {
+      FreeIndexWorkload(pWorkload);
+      return FALSE;
+    }
+
+    const size_t LENGTH = strlen(pszSubject);
+    switch (i % 4) {
+      case 2:
+        pszSubject[LENGTH - 1] = 'a' + rand_r(&nSeed) % 26;
+        break;
+
+      case 3:
+        pszSubject[1 + rand_r(&nSeed) % (LENGTH - 1)] = '\0';
+        break;
+    }
+
+    pWorkload->ppszSubjects[i] = pszSubject;
+    pWorkload->nTotalSubjectBytes += strlen(pszSubject);
+    pWorkload->nSubjects++;
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckStringIndex function - Compares an index's strings with the sorted
+// array's, then its lookups and prefix ranges with those binary searches
+// give on every subject.  Returns the number of disagreements.
+//
+
+static int CheckStringIndex(const INDEX_WORKLOAD* pWorkload,
+    const STRING_INDEX* pIndex) {
+  int nFailures = 0;
+
+  if (GetStringIndexCount(pIndex) != pWorkload->nSorted) {
+    fprintf(stderr, "structures: the index has %d strings, the sorted "
+        "array %d\n", GetStringIndexCount(pIndex), pWorkload->nSorted);
+    return 1;
+  }
+
+  for (int i = 0; i < pWorkload->nSorted; i++) {
+    char szString[SUBJECT_SIZE];
+    const int LENGTH = GetIndexedString(pIndex, i, szString,
+        sizeof(szString));
+    if ((LENGTH != (int) strlen(pWorkload->ppszSorted[i])
+        || !Equals(szString, pWorkload->ppszSorted[i])) && nFailures++ < 5) {
+      fprintf(stderr, "structures: the index's string %d is \"%s\", not "
+          "\"%s\"\n", i, szString, pWorkload->ppszSorted[i]);
+    }
+  }
+
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[i];
+    const STRING_VIEW SUBJECT = MakeStringView(pszSubject, strlen(pszSubject));
+    int nExpectedCount = 0;
+    int nActualCount = 0;
+    const int EXPECTED = FindSortedString(pWorkload->ppszSorted,
+        pWorkload->nSorted, pszSubject);
+    const int ACTUAL = FindIndexedString(pIndex, SUBJECT);
+    const int EXPECTED_FIRST = FindSortedPrefix(pWorkload->ppszSorted,
+        pWorkload->nSorted, pszSubject, &nExpectedCount);
+    const int ACTUAL_FIRST = FindIndexedPrefix(pIndex, SUBJECT,
+        &nActualCount);
+
+    if ((EXPECTED != ACTUAL || EXPECTED_FIRST != ACTUAL_FIRST
+        || nExpectedCount != nActualCount
+        || GetIndexedStringRank(pIndex, SUBJECT) != EXPECTED_FIRST)
+        && nFailures++ < 5) {
+      fprintf(stderr, "structures: the index finds \"%s\" at %d, and %d "
+          "strings from %d starting with it; bsearch at %d, and %d from "
+          "%d\n", pszSubject, ACTUAL, nActualCount, ACTUAL_FIRST, EXPECTED,
+          nExpectedCount, EXPECTED_FIRST);
+    }
+  }
+
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckIndexWorkload function - Checks the built index, then maps its
+// file, verifying it, and checks the mapped one.  Stores the built index's
+// size.  Returns the number of disagreements.
+//
+
+static int CheckIndexWorkload(void* pvWorkload) {
+  INDEX_WORKLOAD* pWorkload = (INDEX_WORKLOAD*) pvWorkload;
+  CORE_ALLOC_STATS allocStats;
+  LPSTRING_INDEX pMapped = NULL;
+
+  /* The index is the only one alive, so its size is known if allocations
+   * are tracked */
+  GetAllocationStats(CORE_ALLOC_STRING_INDEX, &allocStats);
+  pWorkload->nIndexBytes = (size_t) allocStats.ullLiveBytes;
+
+  int nFailures = CheckStringIndex(pWorkload, pWorkload->pIndex);
+  if (MapStringIndexFile(pWorkload->szImagePath, MAPPED_IMAGE_VERIFY,
+      &pMapped) != OK) {
+    fprintf(stderr, "structures: cannot map %s: %s\n",
+        pWorkload->szImagePath, GetLastCoreErrorMessage());
+    return nFailures + 1;
+  }
+
+  nFailures += CheckStringIndex(pWorkload, pMapped);
+  FreeStringIndex(&pMapped);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescribeIndexCase function - The first INDEX_LOOKUP_BODIES bodies look one
+// subject up; the rest get the whole index ready.
+//
+
+static void DescribeIndexCase(const void* pvWorkload, size_t nBody,
+    BENCH_CASE* pCase) {
+  const INDEX_WORKLOAD* pWorkload = (const INDEX_WORKLOAD*) pvWorkload;
+  pCase->nSize = nBody < INDEX_LOOKUP_BODIES
+      ? pWorkload->nTotalSubjectBytes / pWorkload->nSubjects
+      : pWorkload->nTotalStringBytes;
+  snprintf(pCase->szParams, sizeof(pCase->szParams), "strings=%d",
+      pWorkload->nSorted);
+  if (pWorkload->nIndexBytes > 0) {
+    snprintf(pCase->szParams + strlen(pCase->szParams),
+        sizeof(pCase->szParams) - strlen(pCase->szParams),
+        ";compression=%.2f", (double) pWorkload->nTotalStringBytes
+        / pWorkload->nIndexBytes);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeKeywordWorkload function
+
+static void FreeKeywordWorkload(void* pvWorkload) {
+  KEYWORD_WORKLOAD* pWorkload = (KEYWORD_WORKLOAD*) pvWorkload;
+  for (int i = 0; i < pWorkload->nKeywords; i++) {
+    free(pWorkload->ppszKeywords[i]);
+  }
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    free(pWorkload->ppszSubjects[i]);
+  }
+  free(pWorkload->ppszKeywords);
+  free(pWorkload->ppszSubjects);
+  free(pWorkload->pbKeywords);
+  FreeBloomFilter(&pWorkload->pFilter);
+  FreeStringMap(&pWorkload->pMap);
+  memset(pWorkload, 0, sizeof(KEYWORD_WORKLOAD));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateKeywordWorkload function - Makes nKeywords distinct keywords,
+// adds them to a case-folding filter of the default density and to a
+// case-folding map, and makes subjects, some of them keywords in upper
+// case, the rest words that are not keywords.  Returns FALSE if memory ran
+// out.
+//
+
+static BOOL GenerateKeywordWorkload(void* pvWorkload, int nKeywords) {
+  KEYWORD_WORKLOAD* pWorkload = (KEYWORD_WORKLOAD*) pvWorkload;
+  unsigned int nSeed = (unsigned int) nKeywords;
+  const int SEGMENTS = (int) COUNT_OF(s_pszRouteSegments);
+
+  memset(pWorkload, 0, sizeof(KEYWORD_WORKLOAD));
+  pWorkload->ppszKeywords = (char**) calloc(nKeywords, sizeof(char*));
+  pWorkload->ppszSubjects = (char**) calloc(SUBJECT_COUNT, sizeof(char*));
+  pWorkload->pbKeywords = (BOOL*) calloc(SUBJECT_COUNT, sizeof(BOOL));
+  if (pWorkload->ppszKeywords == NULL || pWorkload->ppszSubjects == NULL
+      || pWorkload->pbKeywords == NULL
+      || CreateBloomFilter(nKeywords, 0, TRUE, &pWorkload->pFilter) != OK
+      || CreateStringMap(TRUE, 0, &pWorkload->pMap) != OK) {
+    FreeKeywordWorkload(pWorkload);
+    return FALSE;
+  }
+
+  for (int i = 0; i < nKeywords; i++) {
+    char szKeyword[SUBJECT_SIZE];
+    snprintf(szKeyword, sizeof(szKeyword), "%s-%s-%d",
+        s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS],
+        s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS], i);
+
+    pWorkload->ppszKeywords[i] = strdup(szKeyword);
+    if (pWorkload->ppszKeywords[i] == NULL
+        || InsertStringMapKey(pWorkload->pMap, MakeStringView(szKeyword,
+            strlen(szKeyword)), NULL) == NULL) {
+      FreeKeywordWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->nKeywords++;
+  }
+
+  if (AddBloomFilterKeys(pWorkload->pFilter, pWorkload->ppszKeywords,
+      nKeywords) != OK) {
+    FreeKeywordWorkload(pWorkload);
+    return FALSE;
+  }
+
+  for (int i = 0; i < SUBJECT_COUNT; i++) {
+    char szSubject[SUBJECT_SIZE];
+    pWorkload->pbKeywords[i] = rand_r(&nSeed) % KEYWORD_HIT_RATE == 0;
+    if (pWorkload->pbKeywords[i]) {
+      snprintf(szSubject, sizeof(szSubject), "%s",
+          pWorkload->ppszKeywords[rand_r(&nSeed) % nKeywords]);
+      for (char* pch = szSubject; *pch != '\0'; pch++) {
+        *pch = (char) toupper((unsigned char) *pch);
+      }
+    } else {
+      snprintf(szSubject, sizeof(szSubject), "%s-%s-%d",
+          s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS],
+          s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS],
+          nKeywords + rand_r(&nSeed));
+    }
+
+    pWorkload->ppszSubjects[i] = strdup(szSubject);
+    if (pWorkload->ppszSubjects[i] == NULL) {
+      FreeKeywordWorkload(pWorkload);
+      return FALSE;
+    }
+    pWorkload->nTotalSubjectBytes += strlen(szSubject);
+    pWorkload->nSubjects++;
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckKeywordWorkload function - Tests every subject against the filter,
+// one at a time and in a batch, and against a copy of the filter saved and
+// loaded back, and compares the answers with the map's.  Stores the share
+// of the other subjects the filter let through in the workload.  Returns
+// the number of disagreements: keywords the filter missed, and answers that
+// differ between the single, batch and loaded tests.
+//
+
+static int CheckKeywordWorkload(void* pvWorkload) {
+  KEYWORD_WORKLOAD* pWorkload = (KEYWORD_WORKLOAD*) pvWorkload;
+  LPBLOOM_FILTER pLoaded = NULL;
+  void* pvSaved = NULL;
+  size_t nSaved = 0;
+  BOOL* pbBatch = (BOOL*) malloc(pWorkload->nSubjects * sizeof(BOOL));
+  BOOL* pbLoaded = (BOOL*) malloc(pWorkload->nSubjects * sizeof(BOOL));
+  if (pbBatch == NULL || pbLoaded == NULL
+      || SaveBloomFilter(pWorkload->pFilter, &pvSaved, &nSaved) != OK
+      || LoadBloomFilter(pvSaved, nSaved, &pLoaded) != OK
+      || TestBloomFilterKeys(pWorkload->pFilter, pWorkload->ppszSubjects,
+          pWorkload->nSubjects, pbBatch) < 0
+      || TestBloomFilterKeys(pLoaded, pWorkload->ppszSubjects,
+          pWorkload->nSubjects, pbLoaded) < 0) {
+    fprintf(stderr, "structures: cannot test %d keywords\n",
+        pWorkload->nKeywords);
+    free(pbBatch);
+    free(pbLoaded);
+    FreeBuffer(&pvSaved);
+    FreeBloomFilter(&pLoaded);
+    return 1;
+  }
+
+  int nFailures = 0;
+  int nOthers = 0;
+  int nFalsePositives = 0;
+  for (int i = 0; i < pWorkload->nSubjects; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[i];
+    const STRING_VIEW SUBJECT = MakeStringView(pszSubject,
+        strlen(pszSubject));
+    const BOOL IN_MAP = FindStringMapValue(pWorkload->pMap, SUBJECT) != NULL;
+    const BOOL MAYBE = TestBloomFilterKey(pWorkload->pFilter, SUBJECT);
+
+    if ((IN_MAP != pWorkload->pbKeywords[i] || (IN_MAP && !MAYBE)
+        || MAYBE != pbBatch[i] || MAYBE != pbLoaded[i]) && nFailures++ < 5) {
+      fprintf(stderr, "structures: on \"%s\", the map says %d, the filter "
+          "%d, in a batch %d, loaded %d\n", pszSubject, IN_MAP, MAYBE,
+          pbBatch[i], pbLoaded[i]);
+    }
+
+    if (!IN_MAP) {
+      nOthers++;
+      nFalsePositives += MAYBE;
+    }
+  }
+
+  pWorkload->dFalsePositiveRate = nOthers == 0 ? 0.0
+      : (double) nFalsePositives / nOthers;
+
+  free(pbBatch);
+  free(pbLoaded);
+  FreeBuffer(&pvSaved);
+  FreeBloomFilter(&pLoaded);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescribeKeywordCase function - Each body tests one subject.
+//
+
+static void DescribeKeywordCase(const void* pvWorkload, size_t nBody,
+    BENCH_CASE* pCase) {
+  const KEYWORD_WORKLOAD* pWorkload = (const KEYWORD_WORKLOAD*) pvWorkload;
+  (void) nBody;
+  pCase->nSize = pWorkload->nTotalSubjectBytes / pWorkload->nSubjects;
+  snprintf(pCase->szParams, sizeof(pCase->szParams), "keywords=%d;fpr=%.4f",
+      pWorkload->nKeywords, pWorkload->dFalsePositiveRate);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeLinesWorkload function
+
+static void FreeLinesWorkload(void* pvWorkload) {
+  LINES_WORKLOAD* pWorkload = (LINES_WORKLOAD*) pvWorkload;
+  if (pWorkload->szPath[0] != '\0') {
+    unlink(pWorkload->szPath);
+  }
+  memset(pWorkload, 0, sizeof(LINES_WORKLOAD));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateLinesWorkload function - Writes a file of nLines settings, one per
+// line, named after route segments.  Returns FALSE if the file could not be
+// written.
+//
+
+static BOOL GenerateLinesWorkload(void* pvWorkload, int nLines) {
+  LINES_WORKLOAD* pWorkload = (LINES_WORKLOAD*) pvWorkload;
+  unsigned int nSeed = (unsigned int) nLines;
+  const int SEGMENTS = (int) COUNT_OF(s_pszRouteSegments);
+
+  memset(pWorkload, 0, sizeof(LINES_WORKLOAD));
+  snprintf(pWorkload->szPath, sizeof(pWorkload->szPath),
+      "%s/common_core_bench.%ld.%d.conf", P_tmpdir, (long) getpid(), nLines);
+  FILE* fp = fopen(pWorkload->szPath, "w");
+  if (fp == NULL) {
+    pWorkload->szPath[0] = '\0';
+    return FALSE;
+  }
+
+  for (int i = 0; i < nLines; i++) {
+    const int WRITTEN = fprintf(fp, "%s.%s.%s = %d\n",
+        s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS],
+        s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS],
+        s_pszRouteSegments[rand_r(&nSeed) % SEGMENTS], rand_r(&nSeed));
+    pWorkload->nFileSize += WRITTEN > 0 ? (size_t) WRITTEN : 0;
+  }
+
+  pWorkload->nLines = nLines;
+  if (fclose(fp) != 0) {
+    FreeLinesWorkload(pWorkload);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadFileSplitLines function - Loads a file the way MapFile replaces:
+// reads it whole into a buffer and splits that into a copy of each line.
+// Returns the status of Split, or ERROR if the file could not be read.
+//
+
+static int ReadFileSplitLines(const char* pszPath, char*** pppszLines,
+    int* pnLines) {
+  *pppszLines = NULL;
+  *pnLines = 0;
+
+  FILE* fp = fopen(pszPath, "rb");
+  if (fp == NULL) {
+    return ERROR;
+  }
+
+  struct stat fileStat;
+  char* pszText = fstat(fileno(fp), &fileStat) == 0
+      ? (char*) malloc((size_t) fileStat.st_size + 1) : NULL;
+  const size_t READ = pszText == NULL ? 0
+      : fread(pszText, 1, (size_t) fileStat.st_size, fp);
+  fclose(fp);
+  if (pszText == NULL || READ != (size_t) fileStat.st_size) {
+    free(pszText);
+    return ERROR;
+  }
+
+  pszText[READ] = '\0';
+  const int RESULT = Split(pszText, (int) READ, "\n", pppszLines, pnLines);
+  free(pszText);
+  return RESULT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckLinesWorkload function - Compares the lines of the mapped file,
+// mapped with each flag, with those Split finds.  Returns the number of
+// disagreements.
+//
+
+static int CheckLinesWorkload(void* pvWorkload) {
+  const LINES_WORKLOAD* pWorkload = (const LINES_WORKLOAD*) pvWorkload;
+  static const int nFlags[] = { 0, MAPPED_FILE_SEQUENTIAL,
+      MAPPED_FILE_POPULATE };
+  char** ppszLines = NULL;
+  int nLines = 0;
+  if (ReadFileSplitLines(pWorkload->szPath, &ppszLines, &nLines) != OK) {
+    fprintf(stderr, "structures: cannot read %s\n", pWorkload->szPath);
+    return 1;
+  }
+
+  int nFailures = nLines != pWorkload->nLines;
+  for (size_t f = 0; f < COUNT_OF(nFlags); f++) {
+    LPMAPPED_FILE pFile = NULL;
+    if (MapFile(pWorkload->szPath, nFlags[f], &pFile) != OK) {
+      fprintf(stderr, "structures: cannot map %s: %s\n", pWorkload->szPath,
+          GetLastCoreErrorMessage());
+      nFailures++;
+      continue;
+    }
+
+    nFailures += GetMappedFileLineCount(pFile) != (size_t) nLines
+        || GetMappedFileContents(pFile).nLength != pWorkload->nFileSize;
+    for (int i = 0; i < nLines; i++) {
+      const STRING_VIEW LINE = GetMappedFileLine(pFile, i);
+      nFailures += LINE.nLength != strlen(ppszLines[i])
+          || memcmp(LINE.pchData, ppszLines[i], LINE.nLength) != 0;
+    }
+    FreeMappedFile(&pFile);
+  }
+
+  if (nFailures > 0) {
+    fprintf(stderr, "structures: MapFile and Split disagree on %d lines of "
+        "%s\n", nFailures, pWorkload->szPath);
+  }
+
+  FreeStringArray(&ppszLines, nLines);
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DescribeLinesCase function - Each body loads the whole file.
+//
+
+static void DescribeLinesCase(const void* pvWorkload, size_t nBody,
+    BENCH_CASE* pCase) {
+  const LINES_WORKLOAD* pWorkload = (const LINES_WORKLOAD*) pvWorkload;
+  (void) nBody;
+  pCase->nSize = pWorkload->nFileSize;
+  snprintf(pCase->szParams, sizeof(pCase->szParams), "lines=%d",
+      pWorkload->nLines);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Benchmark bodies
+
+/* The bodies add their results up locally and publish the sum once, so that
+ * threads running side by side do not contend for the sink's cache line.
+ * Subjects are taken in turn; SUBJECT_COUNT is a power of 2. */
+#define SUBJECT_OF(i)       ((size_t) (i) & (SUBJECT_COUNT - 1))
+
+/* Vocabulary bodies compare each subject with one further along, as a
+ * dispatcher comparing incoming names against known ones would */
+#define PARTNER_OF(i)       SUBJECT_OF((i) * 31 + 7)
+
+static void RunMatchPrefixSet(void* pvContext,
+    unsigned long long ullIterations) {
+  ROUTE_CONTEXT* pContext = (ROUTE_CONTEXT*) pvContext;
+  char** ppszSubjects = pContext->pWorkload->ppszSubjects;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += MatchPrefixSet(pContext->pPrefixSet, ppszSubjects[SUBJECT_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunStartsWithLoop(void* pvContext,
+    unsigned long long ullIterations) {
+  ROUTE_CONTEXT* pContext = (ROUTE_CONTEXT*) pvContext;
+  const ROUTE_WORKLOAD* pWorkload = pContext->pWorkload;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += FindLongestPrefixByLoop(pWorkload,
+        pWorkload->ppszSubjects[SUBJECT_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunInternedEquals(void* pvContext,
+    unsigned long long ullIterations) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      *(const VOCABULARY_WORKLOAD**) pvContext;
+  const char** ppszInterned = pWorkload->ppszInterned;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += ppszInterned[SUBJECT_OF(i)] == ppszInterned[PARTNER_OF(i)];
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunInternString(void* pvContext,
+    unsigned long long ullIterations) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      *(const VOCABULARY_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += (uintptr_t) InternString(pWorkload->pPool,
+        pWorkload->ppszSubjects[SUBJECT_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunInternStringFoldCase(void* pvContext,
+    unsigned long long ullIterations) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      *(const VOCABULARY_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += (uintptr_t) InternString(pWorkload->pFoldingPool,
+        pWorkload->ppszSubjects[SUBJECT_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunVocabularyEquals(void* pvContext,
+    unsigned long long ullIterations) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      *(const VOCABULARY_WORKLOAD**) pvContext;
+  char** ppszSubjects = pWorkload->ppszSubjects;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += Equals(ppszSubjects[SUBJECT_OF(i)], ppszSubjects[PARTNER_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunVocabularyEqualsNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  const VOCABULARY_WORKLOAD* pWorkload =
+      *(const VOCABULARY_WORKLOAD**) pvContext;
+  char** ppszSubjects = pWorkload->ppszSubjects;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += EqualsNoCase(ppszSubjects[SUBJECT_OF(i)],
+        ppszSubjects[PARTNER_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunCountTokensSorted(void* pvContext,
+    unsigned long long ullIterations) {
+  COUNT_CONTEXT* pContext = (COUNT_CONTEXT*) pvContext;
+  const VOCABULARY_WORKLOAD* pWorkload = pContext->pWorkload;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountBySorting(pContext->ppszSorted, pWorkload->ppszSubjects,
+        pWorkload->nSubjects, FALSE, NULL, NULL);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunCountTokensStringMap(void* pvContext,
+    unsigned long long ullIterations) {
+  COUNT_CONTEXT* pContext = (COUNT_CONTEXT*) pvContext;
+  const VOCABULARY_WORKLOAD* pWorkload = pContext->pWorkload;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountByMap(pContext->pMap, pWorkload->ppszSubjects,
+        pWorkload->nSubjects);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunCountTokensStringMapNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  COUNT_CONTEXT* pContext = (COUNT_CONTEXT*) pvContext;
+  const VOCABULARY_WORKLOAD* pWorkload = pContext->pWorkload;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountByMap(pContext->pFoldingMap, pWorkload->ppszSubjects,
+        pWorkload->nSubjects);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunIntersectBySorting(void* pvContext,
+    unsigned long long ullIterations) {
+  SET_CONTEXT* pContext = (SET_CONTEXT*) pvContext;
+  const VOCABULARY_WORKLOAD* pWorkload = pContext->pWorkload;
+  const int HALF = pWorkload->nSubjects / 2;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += IntersectBySorting(pContext->ppszLeft, pWorkload->ppszSubjects,
+        HALF, pContext->ppszRight, pWorkload->ppszSubjects + HALF,
+        pWorkload->nSubjects - HALF, FALSE);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunIntersectStrings(void* pvContext,
+    unsigned long long ullIterations) {
+  const SET_CONTEXT* pContext = (const SET_CONTEXT*) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountSetOperation(pContext->pWorkload, IntersectStrings, FALSE);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunIntersectStringsNoCase(void* pvContext,
+    unsigned long long ullIterations) {
+  const SET_CONTEXT* pContext = (const SET_CONTEXT*) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountSetOperation(pContext->pWorkload, IntersectStrings, TRUE);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunUnionStrings(void* pvContext,
+    unsigned long long ullIterations) {
+  const SET_CONTEXT* pContext = (const SET_CONTEXT*) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountSetOperation(pContext->pWorkload, UnionStrings, FALSE);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunUniqueStrings(void* pvContext,
+    unsigned long long ullIterations) {
+  const SET_CONTEXT* pContext = (const SET_CONTEXT*) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += CountSetOperation(pContext->pWorkload, UniqueSubjects, FALSE);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunBsearchPrefix(void* pvContext,
+    unsigned long long ullIterations) {
+  const INDEX_WORKLOAD* pWorkload = *(const INDEX_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    int nCount = 0;
+    ullSum += FindSortedPrefix(pWorkload->ppszSorted, pWorkload->nSorted,
+        pWorkload->ppszSubjects[SUBJECT_OF(i)], &nCount) + nCount;
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunBsearchStrings(void* pvContext,
+    unsigned long long ullIterations) {
+  const INDEX_WORKLOAD* pWorkload = *(const INDEX_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    ullSum += FindSortedString(pWorkload->ppszSorted, pWorkload->nSorted,
+        pWorkload->ppszSubjects[SUBJECT_OF(i)]);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunFindIndexedPrefix(void* pvContext,
+    unsigned long long ullIterations) {
+  const INDEX_WORKLOAD* pWorkload = *(const INDEX_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[SUBJECT_OF(i)];
+    int nCount = 0;
+    ullSum += FindIndexedPrefix(pWorkload->pIndex, MakeStringView(pszSubject,
+        strlen(pszSubject)), &nCount) + nCount;
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunFindIndexedString(void* pvContext,
+    unsigned long long ullIterations) {
+  const INDEX_WORKLOAD* pWorkload = *(const INDEX_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[SUBJECT_OF(i)];
+    ullSum += FindIndexedString(pWorkload->pIndex, MakeStringView(pszSubject,
+        strlen(pszSubject)));
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunCreateStringIndex(void* pvContext,
+    unsigned long long ullIterations) {
+  const INDEX_WORKLOAD* pWorkload = *(const INDEX_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[SUBJECT_OF(i)];
+    LPSTRING_INDEX pIndex = NULL;
+    CreateStringIndex(pWorkload->ppszStrings, pWorkload->nStrings, &pIndex);
+    ullSum += FindIndexedString(pIndex, MakeStringView(pszSubject,
+        strlen(pszSubject)));
+    FreeStringIndex(&pIndex);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+/* Maps the index's file, looks a subject up and unmaps it, as a service
+ * that maps its lists as it starts would */
+static void MapIndexFile(const INDEX_WORKLOAD* pWorkload, int nFlags,
+    unsigned long long ullIterations) {
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[SUBJECT_OF(i)];
+    LPSTRING_INDEX pIndex = NULL;
+    MapStringIndexFile(pWorkload->szImagePath, nFlags, &pIndex);
+    ullSum += FindIndexedString(pIndex, MakeStringView(pszSubject,
+        strlen(pszSubject)));
+    FreeStringIndex(&pIndex);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunMapStringIndexFile(void* pvContext,
+    unsigned long long ullIterations) {
+  MapIndexFile(*(const INDEX_WORKLOAD**) pvContext, 0, ullIterations);
+}
+
+static void RunMapStringIndexFileVerified(void* pvContext,
+    unsigned long long ullIterations) {
+  MapIndexFile(*(const INDEX_WORKLOAD**) pvContext, MAPPED_IMAGE_VERIFY,
+      ullIterations);
+}
+
+static void RunStringMapKeywords(void* pvContext,
+    unsigned long long ullIterations) {
+  const KEYWORD_WORKLOAD* pWorkload = *(const KEYWORD_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[SUBJECT_OF(i)];
+    ullSum += FindStringMapValue(pWorkload->pMap, MakeStringView(pszSubject,
+        strlen(pszSubject))) != NULL;
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunTestBloomFilterKey(void* pvContext,
+    unsigned long long ullIterations) {
+  const KEYWORD_WORKLOAD* pWorkload = *(const KEYWORD_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    const char* pszSubject = pWorkload->ppszSubjects[SUBJECT_OF(i)];
+    ullSum += TestBloomFilterKey(pWorkload->pFilter, MakeStringView(
+        pszSubject, strlen(pszSubject)));
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunTestBloomFilterKeys(void* pvContext,
+    unsigned long long ullIterations) {
+  const KEYWORD_WORKLOAD* pWorkload = *(const KEYWORD_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; ) {
+    const unsigned long long BATCH = ullIterations - i < KEYWORD_BATCH_SIZE
+        ? ullIterations - i : KEYWORD_BATCH_SIZE;
+    ullSum += TestBloomFilterKeys(pWorkload->pFilter,
+        pWorkload->ppszSubjects + SUBJECT_OF(i), (int) BATCH, NULL);
+    i += BATCH;
+  }
+  g_ullBenchSink += ullSum;
+}
+
+/* Loads the file and reads the first byte of every line, as a service
+ * reading its configuration would */
+static void RunReadFileSplitLines(void* pvContext,
+    unsigned long long ullIterations) {
+  const LINES_WORKLOAD* pWorkload = *(const LINES_WORKLOAD**) pvContext;
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    char** ppszLines = NULL;
+    int nLines = 0;
+    ReadFileSplitLines(pWorkload->szPath, &ppszLines, &nLines);
+    for (int k = 0; k < nLines; k++) {
+      ullSum += (unsigned char) ppszLines[k][0];
+    }
+    FreeStringArray(&ppszLines, nLines);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void MapFileLines(const LINES_WORKLOAD* pWorkload, int nFlags,
+    unsigned long long ullIterations) {
+  unsigned long long ullSum = 0;
+  for (unsigned long long i = 0; i < ullIterations; i++) {
+    LPMAPPED_FILE pFile = NULL;
+    MapFile(pWorkload->szPath, nFlags, &pFile);
+    const size_t LINES = GetMappedFileLineCount(pFile);
+    for (size_t k = 0; k < LINES; k++) {
+      ullSum += (unsigned char) GetMappedFileLine(pFile, k).pchData[0];
+    }
+    FreeMappedFile(&pFile);
+  }
+  g_ullBenchSink += ullSum;
+}
+
+static void RunMapFile(void* pvContext, unsigned long long ullIterations) {
+  MapFileLines(*(const LINES_WORKLOAD**) pvContext, 0, ullIterations);
+}
+
+static void RunMapFilePopulate(void* pvContext,
+    unsigned long long ullIterations) {
+  MapFileLines(*(const LINES_WORKLOAD**) pvContext, MAPPED_FILE_POPULATE,
+      ullIterations);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetupSharedContext function - Gives a thread a pointer to the workload,
+// which the threads share.
+//
+
+static void* SetupSharedContext(const BENCH_CASE* pCase) {
+  const void** ppvContext = (const void**) malloc(sizeof(void*));
+  if (ppvContext != NULL) {
+    *ppvContext = pCase->pvData;
+  }
+  return ppvContext;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Suites
+
+static const STRUCTURE_BODY s_prefixSetBodies[] = {
+  { "MatchPrefixSet", RunMatchPrefixSet },
+  { "StartsWithLoop", RunStartsWithLoop }
+};
+
+static const STRUCTURE_BODY s_internPoolBodies[] = {
+  { "InternedEquals", RunInternedEquals },
+  { "InternString", RunInternString },
+  { "InternStringFoldCase", RunInternStringFoldCase },
+  { "VocabularyEquals", RunVocabularyEquals },
+  { "VocabularyEqualsNoCase", RunVocabularyEqualsNoCase }
+};
+
+static const STRUCTURE_BODY s_stringMapBodies[] = {
+  { "CountTokensSorted", RunCountTokensSorted },
+  { "CountTokensStringMap", RunCountTokensStringMap },
+  { "CountTokensStringMapNoCase", RunCountTokensStringMapNoCase }
+};
+
+static const STRUCTURE_BODY s_stringSetBodies[] = {
+  { "IntersectBySorting", RunIntersectBySorting },
+  { "IntersectStrings", RunIntersectStrings },
+  { "IntersectStringsNoCase", RunIntersectStringsNoCase },
+  { "UnionStrings", RunUnionStrings },
+  { "UniqueStrings", RunUniqueStrings }
+};
+
+/* The lookups first; see INDEX_LOOKUP_BODIES */
+static const STRUCTURE_BODY s_stringIndexBodies[] = {
+  { "BsearchPrefix", RunBsearchPrefix },
+  { "BsearchStrings", RunBsearchStrings },
+  { "FindIndexedPrefix", RunFindIndexedPrefix },
+  { "FindIndexedString", RunFindIndexedString },
+  { "CreateStringIndex", RunCreateStringIndex },
+  { "MapStringIndexFile", RunMapStringIndexFile },
+  { "MapStringIndexFileVerified", RunMapStringIndexFileVerified }
+};
+
+static const STRUCTURE_BODY s_bloomFilterBodies[] = {
+  { "StringMapKeywords", RunStringMapKeywords },
+  { "TestBloomFilterKey", RunTestBloomFilterKey },
+  { "TestBloomFilterKeys", RunTestBloomFilterKeys }
+};
+
+static const STRUCTURE_BODY s_mappedFileBodies[] = {
+  { "ReadFileSplitLines", RunReadFileSplitLines },
+  { "MapFile", RunMapFile },
+  { "MapFilePopulate", RunMapFilePopulate }
+};
+
+/* MatchPrefixSet against the StartsWith loop on route tables; interning,
+ * and comparing interned strings by pointer, against Equals and
+ * EqualsNoCase; counting a vocabulary's subjects with a map against sorting
+ * them; the set operations on the two halves of the subjects against
+ * intersecting them by sorting; lookups in a string index against binary
+ * searches, then getting an index ready by building it and by mapping its
+ * file; testing tokens against a Bloom filter of a keyword list against
+ * looking them up in a map; and loading a configuration file by mapping it
+ * against reading and splitting it */
+static const STRUCTURE_SUITE s_suites[] = {
+  { s_prefixSetBodies, COUNT_OF(s_prefixSetBodies), s_nPrefixCounts,
+      COUNT_OF(s_nPrefixCounts), "structures: cannot build %d route "
+      "prefixes\n", GenerateRouteWorkload, CheckRouteWorkload,
+      FreeRouteWorkload, SetupRouteContext, TeardownRouteContext,
+      DescribeRouteCase },
+  { s_internPoolBodies, COUNT_OF(s_internPoolBodies), s_nVocabularySizes,
+      COUNT_OF(s_nVocabularySizes), "structures: cannot build a vocabulary "
+      "of %d words\n", GenerateVocabularyWorkload, CheckVocabularyWorkload,
+      FreeVocabularyWorkload, SetupSharedContext, NULL, DescribeInternCase },
+  { s_stringMapBodies, COUNT_OF(s_stringMapBodies), s_nVocabularySizes,
+      COUNT_OF(s_nVocabularySizes), "structures: cannot build a vocabulary "
+      "of %d words\n", GenerateVocabularyWorkload, CheckCountWorkload,
+      FreeVocabularyWorkload, SetupCountContext, TeardownCountContext,
+      DescribeVocabularyCase },
+  { s_stringSetBodies, COUNT_OF(s_stringSetBodies), s_nVocabularySizes,
+      COUNT_OF(s_nVocabularySizes), "structures: cannot build a vocabulary "
+      "of %d words\n", GenerateVocabularyWorkload, CheckSetWorkload,
+      FreeVocabularyWorkload, SetupSetContext, NULL, DescribeVocabularyCase },
+  { s_stringIndexBodies, COUNT_OF(s_stringIndexBodies), s_nIndexSizes,
+      COUNT_OF(s_nIndexSizes), "structures: cannot index %d strings\n",
+      GenerateIndexWorkload, CheckIndexWorkload, FreeIndexWorkload,
+      SetupSharedContext, NULL, DescribeIndexCase },
+  { s_bloomFilterBodies, COUNT_OF(s_bloomFilterBodies), s_nKeywordCounts,
+      COUNT_OF(s_nKeywordCounts), "structures: cannot build %d keywords\n",
+      GenerateKeywordWorkload, CheckKeywordWorkload, FreeKeywordWorkload,
+      SetupSharedContext, NULL, DescribeKeywordCase },
+  { s_mappedFileBodies, COUNT_OF(s_mappedFileBodies), s_nLineCounts,
+      COUNT_OF(s_nLineCounts), "structures: cannot write %d lines\n",
+      GenerateLinesWorkload, CheckLinesWorkload, FreeLinesWorkload,
+      SetupSharedContext, NULL, DescribeLinesCase }
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// RunStructureSuite function - Makes the suite's workload at each of its
+// sizes, checks the structure on it, and times each of the suite's bodies
+// on it; unless none of them is selected.  Returns the number of
+// disagreements.
+//
+
+static int RunStructureSuite(const BENCH_OPTIONS* pOptions,
+    const STRUCTURE_SUITE* pSuite) {
+  int nFailures = 0;
+
+  BOOL bSelected = FALSE;
+  for (size_t b = 0; b < pSuite->nBodies; b++) {
+    bSelected = bSelected || IsBenchSelected(pOptions,
+        pSuite->pBodies[b].pszName);
+  }
+  if (!bSelected) {
+    return 0;
+  }
+
+  for (size_t s = 0; s < pSuite->nSizes; s++) {
+    STRUCTURE_WORKLOAD workload;
+    if (!pSuite->pfnGenerate(&workload, pSuite->pnSizes[s])) {
+      fprintf(stderr, pSuite->pszGenerateError, pSuite->pnSizes[s]);
+      return nFailures + 1;
+    }
+
+    nFailures += pSuite->pfnCheck(&workload);
+
+    for (size_t b = 0; b < pSuite->nBodies; b++) {
+      BENCH_CASE benchCase;
+      memset(&benchCase, 0, sizeof(benchCase));
+      benchCase.pszName = pSuite->pBodies[b].pszName;
+      pSuite->pfnDescribe(&workload, b, &benchCase);
+      benchCase.nBytesPerOp = benchCase.nSize;
+      benchCase.pvData = &workload;
+      benchCase.pfnSetup = pSuite->pfnSetup;
+      benchCase.pfnRun = pSuite->pBodies[b].pfnRun;
+      benchCase.pfnTeardown = pSuite->pfnTeardown;
+
+      RunBenchCase(pOptions, &benchCase);
+    }
+
+    pSuite->pfnFree(&workload);
+  }
+
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// RunStructureBenchmarks function
+
+int RunStructureBenchmarks(const BENCH_OPTIONS* pOptions) {
+  int nFailures = 0;
+  for (size_t s = 0; s < COUNT_OF(s_suites); s++) {
+    nFailures += RunStructureSuite(pOptions, &s_suites[s]);
+  }
+  return nFailures;
+}
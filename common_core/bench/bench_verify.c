@@ -0,0 +1,509 @@
+// bench_verify.c - Checks that every kernel tier this machine supports gives the same answers
+// as straightforward reference code, through the public functions that use the kernels
+//
+// The inputs are random, but built to hit the edges of the vector code: runs of one character
+// class with a single odd byte at every position, lengths around the 16-, 32- and 64-byte vector
+// widths, and bytes of 0x80 and up.  Integer arrays get the same treatment: lengths around the
+// vector widths, values across the whole range of their type, and narrow ranges in which the
+// minimum repeats.  Now and then a file of random lines, large enough to take several blocks of
+// the newline scan, is mapped and its lines compared with the reference's.
+
+#include "bench.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define VERIFY_MAX_LENGTH       300
+#define VERIFY_ROUNDS           20000
+
+/* Integer arrays are this many times longer than the strings, now and then,
+ * so that IndexOfMinimumOf* searches more than one block */
+#define VERIFY_LONG_ARRAY_SCALE 100
+
+/* Mapped files are this many times longer than the strings */
+#define VERIFY_FILE_SCALE       1000
+
+/* Character pools the inputs are drawn from */
+static const char* s_pszPools[] = {
+  "0123456789",
+  "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789",
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+  " \t\n\v\f\r",
+  "ab, ;c:d|\te",
+  "\x80\xa0\xc3\xa9\xff@[`{/:"
+};
+
+/* Delimiter sets for Split, including one too large for vector code */
+static const char* s_pszDelimiterSets[] = {
+  ",", ", ", ",;:|\t", " \t\n;,:|!?#%&*+-/", " \t\n;,:|!?#%&*+-/=@^"
+};
+
+#define COUNT_OF(array)   (sizeof(array) / sizeof((array)[0]))
+
+///////////////////////////////////////////////////////////////////////////////
+// Reference implementations
+
+static BOOL IsAll(const char* pszTest, int (*pfnIsClass)(int)) {
+  for (; *pszTest != '\0'; pszTest++) {
+    if (!pfnIsClass((unsigned char) *pszTest)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static BOOL ReferenceIsNullOrWhiteSpace(const char* pszTest) {
+  return IsAll(pszTest, isspace);
+}
+
+static BOOL ReferenceIsUppercase(const char* pszTest) {
+  if (ReferenceIsNullOrWhiteSpace(pszTest)) {
+    return FALSE;
+  }
+
+  for (; *pszTest != '\0'; pszTest++) {
+    if (!isspace((unsigned char) *pszTest)
+        && !isupper((unsigned char) *pszTest)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static void ReferenceTrim(char* pszOutput, size_t nSize, const char* pszInput) {
+  const char* pchBegin = pszInput;
+  while (*pchBegin != '\0' && isspace((unsigned char) *pchBegin)) {
+    pchBegin++;
+  }
+
+  const char* pchEnd = pchBegin + strlen(pchBegin);
+  while (pchEnd > pchBegin && isspace((unsigned char) pchEnd[-1])) {
+    pchEnd--;
+  }
+
+  size_t nKept = (size_t) (pchEnd - pchBegin);
+  if (nKept > nSize - 1) {
+    nKept = nSize - 1;
+  }
+
+  memset(pszOutput, 0, nSize);
+  memcpy(pszOutput, pchBegin, nKept);
+}
+
+/* Replaces the occurrences of pszFindWhat in pszInput, from the left,
+ * resuming after each; pszOutput must be large enough.  Returns how many it
+ * replaced. */
+static int ReferenceReplace(char* pszOutput, const char* pszInput,
+    const char* pszFindWhat, const char* pszReplaceWith) {
+  const size_t FIND_LENGTH = strlen(pszFindWhat);
+  int nReplaced = 0;
+  while (*pszInput != '\0') {
+    if (strncmp(pszInput, pszFindWhat, FIND_LENGTH) == 0) {
+      pszOutput = stpcpy(pszOutput, pszReplaceWith);
+      pszInput += FIND_LENGTH;
+      nReplaced++;
+    } else {
+      *pszOutput++ = *pszInput++;
+    }
+  }
+  *pszOutput = '\0';
+  return nReplaced;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// GenerateInput function - Makes a random test string of nLength characters.
+//
+
+static void GenerateInput(char* pszBuffer, int nLength, unsigned int* pnSeed) {
+  const char* pszPool = s_pszPools[rand_r(pnSeed) % COUNT_OF(s_pszPools)];
+  const char* pszOddPool = s_pszPools[rand_r(pnSeed) % COUNT_OF(s_pszPools)];
+  const int POOL_LENGTH = (int) strlen(pszPool);
+
+  for (int i = 0; i < nLength; i++) {
+    pszBuffer[i] = pszPool[rand_r(pnSeed) % POOL_LENGTH];
+  }
+  pszBuffer[nLength] = '\0';
+
+  /* Usually, plant a byte from another pool somewhere */
+  if (nLength > 0 && rand_r(pnSeed) % 4 != 0) {
+    pszBuffer[rand_r(pnSeed) % nLength] =
+        pszOddPool[rand_r(pnSeed) % strlen(pszOddPool)];
+  }
+
+  /* Sometimes, pad with whitespace on either side */
+  if (nLength > 2 && rand_r(pnSeed) % 3 == 0) {
+    pszBuffer[0] = ' ';
+    pszBuffer[nLength - 1] = '\t';
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckSplit function - Compares Split against strtok(3) on a copy of the
+// trimmed input, and SplitInRegion against Split.  Returns TRUE if they all
+// agree.
+//
+
+static BOOL CheckSplit(char* pszInput, const char* pszDelimiters, int nSize) {
+  char** ppszTokens = NULL;
+  int nTokens = 0;
+  Split(pszInput, nSize, pszDelimiters, &ppszTokens, &nTokens);
+
+  char szTrimmed[nSize + 1];
+  ReferenceTrim(szTrimmed, nSize + 1, pszInput);
+
+  BOOL bMatch = TRUE;
+  int nExpected = 0;
+  char* pszSavePointer = NULL;
+  for (char* pszToken = ReferenceIsNullOrWhiteSpace(pszInput)
+      ? NULL : strtok_r(szTrimmed, pszDelimiters, &pszSavePointer);
+      pszToken != NULL;
+      pszToken = strtok_r(NULL, pszDelimiters, &pszSavePointer)) {
+    if (nExpected >= nTokens || strcmp(ppszTokens[nExpected], pszToken) != 0) {
+      bMatch = FALSE;
+    }
+    nExpected++;
+  }
+
+  /* SplitInRegion must give the same tokens */
+  LPREGION pRegion = NULL;
+  char** ppszRegionTokens = NULL;
+  int nRegionTokens = 0;
+  if (CreateRegion(NULL, &pRegion) != OK
+      || SplitInRegion(pRegion, pszInput, nSize, pszDelimiters,
+          &ppszRegionTokens, &nRegionTokens) != OK
+      || nRegionTokens != nTokens) {
+    bMatch = FALSE;
+  }
+  for (int i = 0; bMatch && i < nTokens; i++) {
+    if (strcmp(ppszRegionTokens[i], ppszTokens[i]) != 0) {
+      bMatch = FALSE;
+    }
+  }
+
+  FreeRegion(&pRegion);
+  FreeStringArray(&ppszTokens, nTokens);
+  return bMatch && nExpected == nTokens;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckReplace function - Replaces a piece of the input, which often occurs
+// several times in a row, with StringReplace and StringReplaceInRegion, and
+// compares the results, and the count that sizes them, with the
+// reference's.  Returns TRUE if they all agree.
+//
+
+static BOOL CheckReplace(const char* pszInput, unsigned int* pnSeed) {
+  static const char* pszReplacements[] = { "", "x", "xyz", "<tag>" };
+  const size_t LENGTH = strlen(pszInput);
+  if (LENGTH == 0) {
+    return TRUE;
+  }
+
+  /* One to three characters from somewhere in the input */
+  char szFindWhat[4] = { 0 };
+  const size_t START = (size_t) rand_r(pnSeed) % LENGTH;
+  strncpy(szFindWhat, pszInput + START, 1 + rand_r(pnSeed) % 3);
+  const char* pszReplaceWith = pszReplacements[rand_r(pnSeed)
+      % COUNT_OF(pszReplacements)];
+
+  char szExpected[LENGTH * strlen(pszReplaceWith) + LENGTH + 1];
+  const int REPLACED = ReferenceReplace(szExpected, pszInput, szFindWhat,
+      pszReplaceWith);
+
+  char* pszResult = NULL;
+  StringReplace(pszInput, szFindWhat, pszReplaceWith, &pszResult);
+  BOOL bMatch = GetSubstringOccurrenceCount(pszInput, szFindWhat) == REPLACED
+      && pszResult != NULL && strcmp(pszResult, szExpected) == 0;
+  free(pszResult);
+
+  LPREGION pRegion = NULL;
+  char* pszRegionResult = NULL;
+  bMatch = bMatch && CreateRegion(NULL, &pRegion) == OK
+      && StringReplaceInRegion(pRegion, pszInput, szFindWhat, pszReplaceWith,
+          &pszRegionResult) == OK
+      && strcmp(pszRegionResult, szExpected) == 0;
+  FreeRegion(&pRegion);
+  return bMatch;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Check*s functions - Compare the functions of int_array.h for one type
+// against plain loops, clamping the values last.  Return the name of the
+// first function that disagrees, or NULL if they all agree.
+//
+
+#define CHECK_INTEGER_ARRAY(Suffix, Type, SumType, Largest, Smallest)         \
+static const char* Check##Suffix##s(Type* pValues, size_t nCount, Type low,   \
+    Type high) {                                                              \
+  Type minimum = Largest;                                                     \
+  Type maximum = Smallest;                                                    \
+  size_t nMinimumAt = 0;                                                      \
+  SumType sum = 0;                                                            \
+  for (size_t i = 0; i < nCount; i++) {                                       \
+    if (pValues[i] < minimum) {                                               \
+      minimum = pValues[i];                                                   \
+      nMinimumAt = i;                                                         \
+    }                                                                         \
+    if (pValues[i] > maximum) {                                               \
+      maximum = pValues[i];                                                   \
+    }                                                                         \
+    sum += (SumType) pValues[i];                                              \
+  }                                                                           \
+                                                                              \
+  if (MinimumOf##Suffix##s(pValues, nCount) != minimum) {                     \
+    return "MinimumOf" #Suffix "s";                                           \
+  }                                                                           \
+  if (MaximumOf##Suffix##s(pValues, nCount) != maximum) {                     \
+    return "MaximumOf" #Suffix "s";                                           \
+  }                                                                           \
+  if (IndexOfMinimumOf##Suffix##s(pValues, nCount) != nMinimumAt) {           \
+    return "IndexOfMinimumOf" #Suffix "s";                                    \
+  }                                                                           \
+  if ((SumType) SumOf##Suffix##s(pValues, nCount) != sum) {                   \
+    return "SumOf" #Suffix "s";                                               \
+  }                                                                           \
+                                                                              \
+  Type expected[nCount + 1];                                                  \
+  for (size_t i = 0; i < nCount; i++) {                                       \
+    expected[i] = pValues[i] < low ? low                                      \
+        : pValues[i] > high ? high : pValues[i];                              \
+  }                                                                           \
+  if (Clamp##Suffix##s(pValues, nCount, low, high) != OK                      \
+      || memcmp(pValues, expected, nCount * sizeof(Type)) != 0) {             \
+    return "Clamp" #Suffix "s";                                               \
+  }                                                                           \
+  return NULL;                                                                \
+}
+
+CHECK_INTEGER_ARRAY(Int, int, int64_t, INT_MAX, INT_MIN)
+CHECK_INTEGER_ARRAY(Int64, int64_t, uint64_t, INT64_MAX, INT64_MIN)
+CHECK_INTEGER_ARRAY(Size, size_t, size_t, SIZE_MAX, 0)
+
+///////////////////////////////////////////////////////////////////////////////
+// RandomInteger function - Draws 64 random bits, or, if bNarrow is TRUE, a
+// value from -3 to 3.
+//
+
+static uint64_t RandomInteger(BOOL bNarrow, unsigned int* pnSeed) {
+  const uint64_t RANDOM = ((uint64_t) rand_r(pnSeed) << 33)
+      ^ ((uint64_t) rand_r(pnSeed) << 11) ^ (uint64_t) rand_r(pnSeed);
+  return bNarrow ? RANDOM % 7 - 3 : RANDOM;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckIntegers function - Runs the Check*s functions on nCount random
+// values of each type, drawn from a narrow range half the time so that the
+// minimum repeats.  Returns the name of the first function that disagrees
+// with its reference, or NULL.
+//
+
+static const char* CheckIntegers(size_t nCount, unsigned int* pnSeed) {
+  int* pnValues = (int*) malloc((nCount + 1) * sizeof(int));
+  int64_t* pllValues = (int64_t*) malloc((nCount + 1) * sizeof(int64_t));
+  size_t* pnSizes = (size_t*) malloc((nCount + 1) * sizeof(size_t));
+  if (pnValues == NULL || pllValues == NULL || pnSizes == NULL) {
+    free(pnValues);
+    free(pllValues);
+    free(pnSizes);
+    return "malloc";
+  }
+
+  const BOOL NARROW = rand_r(pnSeed) % 2 == 0;
+  for (size_t i = 0; i < nCount; i++) {
+    const uint64_t RANDOM = RandomInteger(NARROW, pnSeed);
+    pnValues[i] = (int) RANDOM;
+    pllValues[i] = (int64_t) RANDOM;
+    pnSizes[i] = (size_t) RANDOM;
+  }
+
+  const uint64_t ullBounds[2] = { RandomInteger(NARROW, pnSeed),
+      RandomInteger(NARROW, pnSeed) };
+
+  /* Bounds are ordered in each type's own terms */
+  const int N_LOW = MinimumOf((int) ullBounds[0], (int) ullBounds[1]);
+  const int N_HIGH = (int) ullBounds[0] == N_LOW
+      ? (int) ullBounds[1] : (int) ullBounds[0];
+  const int64_t LL_LOW = (int64_t) ullBounds[0] < (int64_t) ullBounds[1]
+      ? (int64_t) ullBounds[0] : (int64_t) ullBounds[1];
+  const int64_t LL_HIGH = (int64_t) ullBounds[0] < (int64_t) ullBounds[1]
+      ? (int64_t) ullBounds[1] : (int64_t) ullBounds[0];
+  const size_t SIZE_LOW = (size_t) (ullBounds[0] < ullBounds[1]
+      ? ullBounds[0] : ullBounds[1]);
+  const size_t SIZE_HIGH = (size_t) (ullBounds[0] < ullBounds[1]
+      ? ullBounds[1] : ullBounds[0]);
+
+  const char* pszFailed = CheckInts(pnValues, nCount, N_LOW, N_HIGH);
+  if (pszFailed == NULL) {
+    pszFailed = CheckInt64s(pllValues, nCount, LL_LOW, LL_HIGH);
+  }
+  if (pszFailed == NULL) {
+    pszFailed = CheckSizes(pnSizes, nCount, SIZE_LOW, SIZE_HIGH);
+  }
+
+  free(pnValues);
+  free(pllValues);
+  free(pnSizes);
+  return pszFailed;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CheckMappedFile function - Writes nLength random letters, with newlines
+// and carriage returns at a random density among them, to a temporary file,
+// maps it, and compares its lines with those found by walking the bytes.
+// Returns TRUE if they all agree.
+//
+
+static BOOL CheckMappedFile(size_t nLength, unsigned int* pnSeed) {
+  char szPath[64];
+  snprintf(szPath, sizeof(szPath), "%s/common_core_verify.%ld.txt",
+      P_tmpdir, (long) getpid());
+
+  char* pchText = (char*) malloc(nLength + 1);
+  FILE* fp = fopen(szPath, "wb");
+  if (pchText == NULL || fp == NULL) {
+    free(pchText);
+    if (fp != NULL) {
+      fclose(fp);
+    }
+    return FALSE;
+  }
+
+  const int SPACING = 1 + rand_r(pnSeed) % 64;
+  for (size_t i = 0; i < nLength; i++) {
+    const int DRAW = rand_r(pnSeed) % SPACING;
+    pchText[i] = DRAW == 0 ? '\n' : DRAW == 1 ? '\r'
+        : (char) ('a' + rand_r(pnSeed) % 26);
+  }
+
+  LPMAPPED_FILE pFile = NULL;
+  BOOL bMatch = fwrite(pchText, 1, nLength, fp) == nLength;
+  bMatch = fclose(fp) == 0 && bMatch;
+  bMatch = bMatch && MapFile(szPath, rand_r(pnSeed) % 4, &pFile) == OK;
+
+  size_t nLine = 0;
+  for (size_t nBegin = 0; bMatch && nBegin < nLength; nLine++) {
+    const char* pchNewline = (const char*) memchr(pchText + nBegin, '\n',
+        nLength - nBegin);
+    const size_t NEXT = pchNewline == NULL ? nLength
+        : (size_t) (pchNewline - pchText) + 1;
+    const size_t END = pchNewline == NULL ? nLength : NEXT - 1
+        - (NEXT - 1 > nBegin && pchText[NEXT - 2] == '\r');
+
+    const STRING_VIEW LINE = GetMappedFileLine(pFile, nLine);
+    bMatch = LINE.pchData != NULL && LINE.nLength == END - nBegin
+        && memcmp(LINE.pchData, pchText + nBegin, LINE.nLength) == 0;
+    nBegin = NEXT;
+  }
+
+  bMatch = bMatch && GetMappedFileLineCount(pFile) == nLine
+      && GetMappedFileLine(pFile, nLine).pchData == NULL
+      && GetMappedFileContents(pFile).nLength == nLength;
+
+  FreeMappedFile(&pFile);
+  unlink(szPath);
+  free(pchText);
+  return bMatch;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// VerifyTier function - Runs the checks on the tier in use.  Returns the
+// number of failures, after describing the first few of them.
+//
+
+static int VerifyTier(void) {
+  unsigned int nSeed = 20191017;
+  int nFailures = 0;
+  char szInput[VERIFY_MAX_LENGTH + 1];
+  char szTrimmed[VERIFY_MAX_LENGTH + 3];
+  char szExpected[VERIFY_MAX_LENGTH + 3];
+
+  for (int nRound = 0; nRound < VERIFY_ROUNDS; nRound++) {
+    /* Favour lengths near the vector widths */
+    const int LENGTH = rand_r(&nSeed) % 2 == 0
+        ? rand_r(&nSeed) % (VERIFY_MAX_LENGTH + 1)
+        : 16 * (1 + rand_r(&nSeed) % 8) + rand_r(&nSeed) % 5 - 2;
+    GenerateInput(szInput, LENGTH, &nSeed);
+
+    const char* pszFailed = NULL;
+    if (IsNullOrWhiteSpace(szInput) != ReferenceIsNullOrWhiteSpace(szInput)) {
+      pszFailed = "IsNullOrWhiteSpace";
+    } else if (IsNumeric(szInput) != (!ReferenceIsNullOrWhiteSpace(szInput)
+        && IsAll(szInput, isdigit))) {
+      pszFailed = "IsNumeric";
+    } else if (IsAlphaNumeric(szInput) != (!ReferenceIsNullOrWhiteSpace(
+        szInput) && IsAll(szInput, isalnum))) {
+      pszFailed = "IsAlphaNumeric";
+    } else if (IsUppercase(szInput) != ReferenceIsUppercase(szInput)) {
+      pszFailed = "IsUppercase";
+    }
+
+    const size_t TRIM_SIZE = 1 + rand_r(&nSeed) % (LENGTH + 2);
+    Trim(szTrimmed, TRIM_SIZE, szInput);
+    ReferenceTrim(szExpected, TRIM_SIZE, szInput);
+    if (pszFailed == NULL && memcmp(szTrimmed, szExpected, TRIM_SIZE) != 0) {
+      pszFailed = "Trim";
+    }
+
+    const char* pszDelimiters = s_pszDelimiterSets[rand_r(&nSeed)
+        % COUNT_OF(s_pszDelimiterSets)];
+    const int SPLIT_SIZE = 1 + rand_r(&nSeed) % (LENGTH + 1);
+    if (pszFailed == NULL && !CheckSplit(szInput, pszDelimiters, SPLIT_SIZE)) {
+      pszFailed = "Split";
+    }
+
+    if (pszFailed == NULL && !CheckReplace(szInput, &nSeed)) {
+      pszFailed = "StringReplace";
+    }
+
+    if (pszFailed != NULL && nFailures++ < 5) {
+      fprintf(stderr, "verify: %s: %s differs from the reference on "
+          "\"%s\"\n", GetCoreCpuTierName(GetCoreCpuTier()), pszFailed,
+          szInput);
+    }
+
+    const size_t ARRAY_LENGTH = nRound % 64 == 0
+        ? (size_t) LENGTH * VERIFY_LONG_ARRAY_SCALE : (size_t) LENGTH;
+    const char* pszIntegersFailed = CheckIntegers(ARRAY_LENGTH, &nSeed);
+    if (pszIntegersFailed != NULL && nFailures++ < 5) {
+      fprintf(stderr, "verify: %s: %s differs from the reference on %zu "
+          "values\n", GetCoreCpuTierName(GetCoreCpuTier()),
+          pszIntegersFailed, ARRAY_LENGTH);
+    }
+
+    const size_t FILE_LENGTH = (size_t) LENGTH * VERIFY_FILE_SCALE;
+    if (nRound % 64 == 0 && !CheckMappedFile(FILE_LENGTH, &nSeed)
+        && nFailures++ < 5) {
+      fprintf(stderr, "verify: %s: MapFile differs from the reference on a "
+          "file of %zu bytes\n", GetCoreCpuTierName(GetCoreCpuTier()),
+          FILE_LENGTH);
+    }
+  }
+
+  return nFailures;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// VerifyKernelTiers function
+
+int VerifyKernelTiers(void) {
+  const CORE_CPU_TIER ORIGINAL_TIER = GetCoreCpuTier();
+  int nFailures = 0;
+
+  for (int nTier = 0; nTier <= (int) GetSupportedCoreCpuTier(); nTier++) {
+    SetCoreCpuTier((CORE_CPU_TIER) nTier);
+
+    const int TIER_FAILURES = VerifyTier();
+    fprintf(stderr, "verify: %-6s %s\n", GetCoreCpuTierName(nTier),
+        TIER_FAILURES == 0 ? "ok" : "FAILED");
+    nFailures += TIER_FAILURES;
+  }
+
+  SetCoreCpuTier(ORIGINAL_TIER);
+  return nFailures;
+}
@@ -0,0 +1,202 @@
+// perf_counters.c - Hardware performance counters for the benchmark executable, read through
+// perf_event_open(2)
+//
+// The counters are opened in the thread that starts the benchmark threads, with inherit set, so
+// they also count every thread created while they are open; the kernel folds a thread's counts
+// into the parent counter when the thread exits.  A reset does not clear those folded counts,
+// so the harness opens fresh counters for every measured run.  Counters that the CPU does not
+// have, or that the kernel's perf_event_paranoid setting withholds, are left closed and reported
+// as unavailable; the benchmark then carries on with the clock alone.
+
+#include "bench.h"
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+typedef struct _PERF_COUNTER_SPEC {
+  const char* pszName;
+  unsigned int nType;
+  unsigned long long ullConfig;
+} PERF_COUNTER_SPEC;
+
+#define PERF_CACHE_MISS_CONFIG(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+        | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+/* In PERF_COUNTER order */
+static const PERF_COUNTER_SPEC s_counterSpecs[PERF_COUNTER_COUNT] = {
+  { "cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+  { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+  { "branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+  { "L1-dcache-load-misses", PERF_TYPE_HW_CACHE,
+      PERF_CACHE_MISS_CONFIG(PERF_COUNT_HW_CACHE_L1D) },
+  { "LLC-load-misses", PERF_TYPE_HW_CACHE,
+      PERF_CACHE_MISS_CONFIG(PERF_COUNT_HW_CACHE_LL) }
+};
+
+/* Layout of a read(2) with PERF_FORMAT_TOTAL_TIME_ENABLED and _RUNNING */
+typedef struct _PERF_READ_FORMAT {
+  unsigned long long ullValue;
+  unsigned long long ullTimeEnabled;
+  unsigned long long ullTimeRunning;
+} PERF_READ_FORMAT;
+
+static BOOL s_bWarned = FALSE;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// OpenCounter function - Opens one disabled, inherited counter on the calling
+// thread.  Returns the file descriptor, or -1.
+//
+
+static int OpenCounter(const PERF_COUNTER_SPEC* pSpec) {
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = pSpec->nType;
+  attr.config = pSpec->ullConfig;
+  attr.disabled = 1;
+  attr.inherit = 1;
+  attr.exclude_kernel = 1;  // Allowed at perf_event_paranoid 2
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+  return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadCounter function - Reads a counter, scaled up for the time it was
+// multiplexed off the PMU.  Returns -1 if it could not be read or never ran.
+//
+
+static long long ReadCounter(int nFd) {
+  PERF_READ_FORMAT reading;
+
+  if (read(nFd, &reading, sizeof(reading)) != (ssize_t) sizeof(reading)
+      || reading.ullTimeRunning == 0) {
+    return -1;
+  }
+
+  if (reading.ullTimeRunning == reading.ullTimeEnabled) {
+    return (long long) reading.ullValue;
+  }
+
+  return (long long) ((double) reading.ullValue * reading.ullTimeEnabled
+      / reading.ullTimeRunning);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// ApplyPerfReading function
+
+void ApplyPerfReading(LPBENCH_RESULT pResult, const PERF_READING* pReading,
+    double dOperations, double dBytes) {
+  const long long* VALUES = pReading->llValues;
+
+  pResult->dInstructionsPerCycle = VALUES[PERF_COUNTER_CYCLES] > 0
+      && VALUES[PERF_COUNTER_INSTRUCTIONS] >= 0
+      ? (double) VALUES[PERF_COUNTER_INSTRUCTIONS]
+          / VALUES[PERF_COUNTER_CYCLES]
+      : -1;
+  pResult->dBranchMissesPerOp = VALUES[PERF_COUNTER_BRANCH_MISSES] >= 0
+      && dOperations > 0
+      ? VALUES[PERF_COUNTER_BRANCH_MISSES] / dOperations
+      : -1;
+  pResult->dL1MissesPerByte = VALUES[PERF_COUNTER_L1D_MISSES] >= 0
+      && dBytes > 0
+      ? VALUES[PERF_COUNTER_L1D_MISSES] / dBytes
+      : -1;
+  pResult->dLlcMissesPerByte = VALUES[PERF_COUNTER_LLC_MISSES] >= 0
+      && dBytes > 0
+      ? VALUES[PERF_COUNTER_LLC_MISSES] / dBytes
+      : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ClearPerfReading function
+
+void ClearPerfReading(LPPERF_READING pReading) {
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    pReading->llValues[i] = -1;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ClosePerfCounters function
+
+void ClosePerfCounters(LPPERF_COUNTERS pCounters) {
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (pCounters->nFds[i] >= 0) {
+      close(pCounters->nFds[i]);
+      pCounters->nFds[i] = -1;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// OpenPerfCounters function
+
+int OpenPerfCounters(LPPERF_COUNTERS pCounters) {
+  int nOpened = 0;
+  int nError = 0;
+  char szMissing[128] = "";
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    pCounters->nFds[i] = OpenCounter(&s_counterSpecs[i]);
+    if (pCounters->nFds[i] >= 0) {
+      nOpened++;
+    } else {
+      nError = errno;
+      size_t nLength = strlen(szMissing);
+      snprintf(szMissing + nLength, sizeof(szMissing) - nLength, "%s%s",
+          nLength > 0 ? ", " : "", s_counterSpecs[i].pszName);
+    }
+  }
+
+  if (nOpened < PERF_COUNTER_COUNT && !s_bWarned) {
+    fprintf(stderr, "bench: hardware counters unavailable (%s): %s\n",
+        szMissing, strerror(nError));
+    s_bWarned = TRUE;
+  }
+
+  return nOpened;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StartPerfCounters function
+
+void StartPerfCounters(const PERF_COUNTERS* pCounters) {
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (pCounters->nFds[i] >= 0) {
+      ioctl(pCounters->nFds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(pCounters->nFds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StopPerfCounters function
+
+void StopPerfCounters(const PERF_COUNTERS* pCounters,
+    LPPERF_READING pReading) {
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    if (pCounters->nFds[i] >= 0) {
+      ioctl(pCounters->nFds[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+
+  for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+    pReading->llValues[i] = pCounters->nFds[i] >= 0
+        ? ReadCounter(pCounters->nFds[i])
+        : -1;
+  }
+}
@@ -0,0 +1,104 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// alloc_stats.h - Optional accounting of the heap memory allocated by the functions of
+// common_core, with a leak report and an allocations-per-operation benchmark mode
+//
+// Define COMMON_CORE_TRACK_ALLOCATIONS when building the library to have every block it
+// allocates on behalf of a caller recorded against the API that allocated it, until the block
+// is released with FreeBuffer, FreeStringArray or the Free function of the object (e.g.,
+// FreeInternPool).  Without it, the library calls malloc and free directly (or its pool,
+// see AllocateBuffer) and the functions below report zeroes.
+
+#ifndef __ALLOC_STATS_H__
+#define __ALLOC_STATS_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Identifies the API a block of memory was allocated by.
+ */
+typedef enum _CORE_ALLOC_SITE {
+  CORE_ALLOC_BLOOM_FILTER,
+  CORE_ALLOC_BUFFER,
+  CORE_ALLOC_INTERN_POOL,
+  CORE_ALLOC_JOIN_STRINGS,
+  CORE_ALLOC_MAPPED_FILE,
+  CORE_ALLOC_PREFIX_SET,
+  CORE_ALLOC_PREPEND_TO,
+  CORE_ALLOC_REGION,
+  CORE_ALLOC_SPLIT,
+  CORE_ALLOC_STRING_INDEX,
+  CORE_ALLOC_STRING_MAP,
+  CORE_ALLOC_STRING_SET,
+  CORE_ALLOC_STRING_REPLACE,
+  CORE_ALLOC_SITE_COUNT   /* number of allocation sites; not an ID */
+} CORE_ALLOC_SITE;
+
+/**
+ * @brief Allocation statistics of one API.
+ */
+typedef struct _CORE_ALLOC_STATS {
+  unsigned long long ullAllocations;    /* blocks allocated or reallocated */
+  unsigned long long ullFrees;          /* blocks released */
+  unsigned long long ullBytes;          /* total bytes requested */
+  unsigned long long ullLiveBlocks;     /* blocks not yet released */
+  unsigned long long ullLiveBytes;      /* bytes not yet released */
+  unsigned long long ullPeakLiveBytes;  /* high-water mark of ullLiveBytes */
+} CORE_ALLOC_STATS, *LPCORE_ALLOC_STATS;
+
+/**
+ * @brief Starts an allocation benchmark by remembering the current
+ * statistics of every API.
+ * @remarks Run the operations to be measured, then call
+ * EndAllocationBenchmark with the number of operations performed.
+ */
+void BeginAllocationBenchmark(void);
+
+/**
+ * @brief Ends an allocation benchmark and writes, for every API that
+ * allocated anything since BeginAllocationBenchmark, the allocations and
+ * bytes per operation.
+ * @param fp Stream to write to, e.g., stdout.  Required.
+ * @param pszLabel Name of the benchmark, printed on each line.  May be NULL.
+ * @param ullOperations Number of operations performed.  Must be positive.
+ */
+void EndAllocationBenchmark(FILE* fp, const char* pszLabel,
+    unsigned long long ullOperations);
+
+/**
+ * @brief Gets the name of the API having the allocation-site ID specified.
+ * @returns The name, or NULL if nSite is not a valid CORE_ALLOC_SITE.
+ */
+const char* GetAllocationSiteName(CORE_ALLOC_SITE nSite);
+
+/**
+ * @brief Gets the allocation statistics of the API specified.
+ * @param nSite API whose statistics are wanted.
+ * @param pStats Address of the structure that receives the statistics.
+ * Required.
+ */
+void GetAllocationStats(CORE_ALLOC_SITE nSite, LPCORE_ALLOC_STATS pStats);
+
+/**
+ * @brief Tells whether the library was built with
+ * COMMON_CORE_TRACK_ALLOCATIONS defined.
+ */
+BOOL IsAllocationTrackingEnabled(void);
+
+/**
+ * @brief Writes a report of every block allocated by the library that has
+ * not yet been released with FreeBuffer, FreeStringArray or the Free
+ * function of the object it belongs to.
+ * @param fp Stream to write to, e.g., stderr.  Required.
+ * @returns The number of unreleased blocks.
+ * @remarks Blocks released with free() instead of FreeBuffer are reported
+ * as leaks, since the library cannot see them go.
+ */
+unsigned long long ReportLeaks(FILE* fp);
+
+/**
+ * @brief Sets the counters of every API back to zero.  Blocks that are
+ * still live stay tracked, so the leak report is unaffected.
+ */
+void ResetAllocationStats(void);
+
+#endif /* __ALLOC_STATS_H__ */
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// bloom_filter.h - Blocked Bloom filters of strings, for ruling keys out of large keyword sets
+// before looking them up, or scanning for them, the slow way
+//
+// A Bloom filter answers "is this key in the set" with "no" or "maybe": it never misses a key it
+// was given, and says "maybe" about a key it was not given with a small probability, the false
+// positive rate, which depends on the bits it spends per key.  A classic filter sets bits all
+// over its array, so each lookup costs as many cache misses as it tests bits.  This one is
+// blocked: a key hashes to one block of 64 bytes, a cache line, and sets one bit in each of its
+// eight 64-bit words, so a lookup costs a single miss and tests its bits without branching.
+// The batch functions hash a run of keys first and prefetch their blocks, so that the misses of
+// the run overlap.
+//
+// Keys are hashed with HashBytes or, in a filter created with bFoldCase set, folded as
+// EqualsNoCase folds them first.  A filter can be saved to a byte buffer and loaded back, on
+// this machine or another, to ship a prebuilt keyword filter, or saved to a file and mapped back
+// in place, as mapped_image.h describes, which costs nothing however large the filter.
+//
+// A filter may be tested by any number of threads at once, but only while no thread adds to it.
+// A mapped filter is read-only.
+
+#ifndef __BLOOM_FILTER_H__
+#define __BLOOM_FILTER_H__
+
+#include "stdafx.h"
+#include "string_view.h"
+#include "mapped_image.h"
+
+/**
+ * @brief Bits per key for filters created without a preference.  False
+ * positive rates by bits per key are about 3% at 8, 1% at 10, 0.4% at 12,
+ * 0.1% at 16, and 0.01% at 24.
+ */
+#ifndef BLOOM_FILTER_DEFAULT_BITS_PER_KEY
+#define BLOOM_FILTER_DEFAULT_BITS_PER_KEY 10
+#endif //BLOOM_FILTER_DEFAULT_BITS_PER_KEY
+
+/**
+ * @brief A blocked Bloom filter of strings.  Opaque; create it with
+ * CreateBloomFilter, LoadBloomFilter or MapBloomFilterFile, and release it
+ * with FreeBloomFilter.
+ */
+typedef struct _BLOOM_FILTER BLOOM_FILTER, *LPBLOOM_FILTER;
+
+/**
+ * @brief Adds a key to a filter.
+ * @param pFilter Filter to add to.  Required.
+ * @param key Key to add.
+ * @returns OK on success; ERROR, with the last-error record set, if pFilter
+ * is NULL or was mapped from a file.
+ */
+int AddBloomFilterKey(LPBLOOM_FILTER pFilter, STRING_VIEW key);
+
+/**
+ * @brief Adds an array of keys to a filter, such as the tokens Split
+ * returns.
+ * @param pFilter Filter to add to.  Required.
+ * @param ppszKeys Array of the keys.  May be NULL if nCount is zero; none of
+ * its elements may be NULL.
+ * @param nCount Number of elements in ppszKeys.  Must not be negative.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or pFilter was mapped from a file, in which case no
+ * key is added.
+ */
+int AddBloomFilterKeys(LPBLOOM_FILTER pFilter, char* const* ppszKeys,
+    int nCount);
+
+/**
+ * @brief Creates an empty filter sized for a number of keys.
+ * @param nExpectedCount Number of keys the filter is to hold.  Must not be
+ * negative.  Adding more keys than this raises the false positive rate.
+ * @param nBitsPerKey Bits of filter per expected key, from 1 to 64; zero for
+ * BLOOM_FILTER_DEFAULT_BITS_PER_KEY.
+ * @param bFoldCase TRUE to treat keys as EqualsNoCase compares them; FALSE
+ * to treat them as Equals does.
+ * @param ppFilter Address of the pointer that receives the new filter.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated.
+ * @remarks A case-folding filter folds case with tolower(3) as it behaves
+ * in the locale in effect when the filter is created, and keeps doing so
+ * once saved and loaded elsewhere.
+ */
+int CreateBloomFilter(int nExpectedCount, int nBitsPerKey, BOOL bFoldCase,
+    LPBLOOM_FILTER* ppFilter);
+
+/**
+ * @brief Releases a filter, unmapping its file if it was mapped, and sets
+ * the pointer to NULL.
+ * @param ppFilter Address of the pointer to the filter.  Nothing happens if
+ * it, or the pointer it points to, is NULL.
+ */
+void FreeBloomFilter(LPBLOOM_FILTER* ppFilter);
+
+/**
+ * @brief Gets the number of keys added to a filter, counting keys added
+ * more than once as many times.
+ * @returns The number of keys, or zero if pFilter is NULL.
+ */
+int GetBloomFilterCount(const BLOOM_FILTER* pFilter);
+
+/**
+ * @brief Rebuilds a filter from the bytes SaveBloomFilter gave.
+ * @param pvData Address of the bytes.  Required.
+ * @param nSize Number of bytes at pvData.
+ * @param ppFilter Address of the pointer that receives the new filter.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL, the bytes are not a saved filter (or are truncated), or
+ * memory could not be allocated.
+ * @remarks The filter is a copy; the bytes need not outlive it.
+ */
+int LoadBloomFilter(const void* pvData, size_t nSize,
+    LPBLOOM_FILTER* ppFilter);
+
+/**
+ * @brief Maps a filter from a file that SaveBloomFilterFile wrote.
+ * @param pszPath Path of the file.  Required.
+ * @param nFlags Zero, or MAPPED_IMAGE_* flags.
+ * @param ppFilter Address of the pointer that receives the filter.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL, the file cannot be opened or mapped, does not hold a
+ * filter, or fails the checksum with MAPPED_IMAGE_VERIFY, or memory could
+ * not be allocated.
+ * @remarks The filter tests keys against the file's pages in place until it
+ * is released, and cannot be added to.  The file may be replaced meanwhile,
+ * as SaveBloomFilterFile does, but must not be rewritten.
+ */
+int MapBloomFilterFile(const char* pszPath, int nFlags,
+    LPBLOOM_FILTER* ppFilter);
+
+/**
+ * @brief Saves a filter to a byte buffer, to be stored or sent and then
+ * given to LoadBloomFilter.
+ * @param pFilter Filter to save.  Required.
+ * @param ppvData Address of the pointer that receives the buffer.  Release
+ * it with FreeBuffer.  Required.
+ * @param pnSize Address of a size_t that receives the size of the buffer.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL or memory could not be allocated.
+ * @remarks The bytes are the same whatever the byte order of the machine.
+ */
+int SaveBloomFilter(const BLOOM_FILTER* pFilter, void** ppvData,
+    size_t* pnSize);
+
+/**
+ * @brief Saves a filter to a file, for MapBloomFilterFile.
+ * @param pFilter Filter to save.  Required; may itself be mapped.
+ * @param pszPath Path of the file, which is replaced if it exists.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL or the file cannot be written.
+ * @remarks Unlike the bytes of SaveBloomFilter, the file is in the byte
+ * order of this machine.
+ */
+int SaveBloomFilterFile(const BLOOM_FILTER* pFilter, const char* pszPath);
+
+/**
+ * @brief Tells whether a filter may hold a key.
+ * @param pFilter Filter to test.  Required.
+ * @param key Key to test.
+ * @returns FALSE if the key was never added to the filter, or if pFilter is
+ * NULL (which also sets the last-error record); TRUE if it may have been.
+ */
+BOOL TestBloomFilterKey(const BLOOM_FILTER* pFilter, STRING_VIEW key);
+
+/**
+ * @brief Tests an array of keys against a filter.
+ * @param pFilter Filter to test.  Required.
+ * @param ppszKeys Array of the keys.  May be NULL if nCount is zero; none of
+ * its elements may be NULL.
+ * @param nCount Number of elements in ppszKeys.  Must not be negative.
+ * @param pbResults Array of nCount BOOLs that receives, for each key, what
+ * TestBloomFilterKey would say about it.  May be NULL, to count only.
+ * @returns The number of keys the filter may hold; -1, with the last-error
+ * record set, if an argument is invalid.
+ */
+int TestBloomFilterKeys(const BLOOM_FILTER* pFilter, char* const* ppszKeys,
+    int nCount, BOOL* pbResults);
+
+/**
+ * @brief Checks the checksum of the file a mapped filter lies in.
+ * @param pFilter Filter to check.  Required.
+ * @returns OK if the file is intact or the filter is not mapped; ERROR, with
+ * the last-error record set, if pFilter is NULL or the file has been
+ * damaged.
+ * @remarks Reads every page of the file, so it may be called from a
+ * background thread once the filter is in use.
+ */
+int VerifyBloomFilter(const BLOOM_FILTER* pFilter);
+
+#endif /* __BLOOM_FILTER_H__ */
@@ -6,6 +6,39 @@
 #define __COMMON_CORE_H__
 
 #include "stdafx.h"
+#include "core_error.h"
+#include "diagnostics.h"
+#include "cpu_dispatch.h"
+#include "core_stats.h"
+#include "alloc_stats.h"
+#include "region.h"
+#include "int_array.h"
+#include "string_view.h"
+#include "string_hash.h"
+#include "mapped_image.h"
+#include "mapped_file.h"
+#include "prefix_set.h"
+#include "intern_pool.h"
+#include "string_map.h"
+#include "string_sort.h"
+#include "string_set.h"
+#include "string_index.h"
+#include "bloom_filter.h"
+
+/**
+ * @brief Selects the error model the library is built with.
+ * @remarks By default (the legacy model), invalid arguments and allocation
+ * failures terminate the process with exit() or are thrown through
+ * exceptions_core.  Define COMMON_CORE_NONTERMINATING_ERRORS when building
+ * the library to have such failures recorded in the calling thread's
+ * last-error record (see core_error.h) and reported to the caller through
+ * the return value instead.  Both models record the error before acting on it.
+ */
+#ifdef COMMON_CORE_NONTERMINATING_ERRORS
+#define COMMON_CORE_LEGACY_ERRORS     0
+#else
+#define COMMON_CORE_LEGACY_ERRORS     1
+#endif //COMMON_CORE_NONTERMINATING_ERRORS
 
 #ifndef ERROR_FAILED_ALLOC_ARRAY
 #define ERROR_FAILED_ALLOC_ARRAY \
@@ -31,6 +64,19 @@
 #define ERROR -1
 #endif
 
+/**
+ * @brief Allocates a buffer that the library's functions may release or
+ * replace, from the same pool as the strings they return.
+ * @param nSize Size of the buffer, in bytes.  Must be positive.
+ * @returns The buffer, which is uninitialized; NULL, with the last-error
+ * record set, if nSize is zero or memory could not be allocated.
+ * @remarks Release the buffer with FreeBuffer.  The buffer comes from
+ * malloc, unless the library was built with COMMON_CORE_STRING_POOL
+ * defined, in which case buffers of up to 512 bytes come from per-thread
+ * free lists instead; see src/core_pool.h.
+ */
+void* AllocateBuffer(size_t nSize);
+
 /**
  * @brief Checks whether the specified substring is contained within the
  * specified string.
@@ -55,9 +101,48 @@ BOOL ContainsNoCase(const char* pszString, const char* pszSubstring);
  * @brief Clears a char array to be filled with null terminator characters.
  * @param pszBuffer Pointer to the array to be filled with zero.
  * @param nSize Length of the buffer, in bytes.
- * @remarks This is basically just a wrapper for memset.
+ * @returns OK if the buffer was cleared or is NULL; ERROR if nSize is not a
+ * positive number (non-terminating error model only).
+ * @remarks Clears all nSize bytes, whatever they hold, and as SecureClear
+ * does, so the compiler cannot leave the clearing out.
+ */
+int ClearString(char* pszBuffer, int nSize);
+
+/**
+ * @brief Checks to see whether one string ends with another.
+ * @param pszString String to be examined.
+ * @param pszSuffix The suffix to be checked.
+ * @returns TRUE if pszString ends with pszSuffix; FALSE otherwise, or if
+ * either string is NULL.
+ * @remarks Finding the end of pszString takes a scan of all of it.  If the
+ * caller knows its length already, EndsWithN avoids that.
+ */
+BOOL EndsWith(const char* pszString, const char* pszSuffix);
+
+/**
+ * @brief Checks to see whether a character sequence of known length ends
+ * with another.
+ * @param pchString Characters to be examined; need not be null-terminated.
+ * @param nLength Number of characters at pchString.
+ * @param pchSuffix Characters of the suffix; need not be null-terminated.
+ * @param nSuffixLength Number of characters at pchSuffix.
+ * @returns TRUE if the last nSuffixLength characters at pchString are those
+ * at pchSuffix; FALSE otherwise, or if either pointer is NULL.
+ * @remarks Runs in time proportional to nSuffixLength at most.
  */
-void ClearString(char* pszBuffer, int nSize);
+BOOL EndsWithN(const char* pchString, size_t nLength, const char* pchSuffix,
+    size_t nSuffixLength);
+
+/**
+ * @brief Does the same thing as EndsWith but ignores case.
+ */
+BOOL EndsWithNoCase(const char* pszString, const char* pszSuffix);
+
+/**
+ * @brief Does the same thing as EndsWithN but ignores case.
+ */
+BOOL EndsWithNoCaseN(const char* pchString, size_t nLength,
+    const char* pchSuffix, size_t nSuffixLength);
 
 /**
  * @brief Compares two strings to each other to see if they match (case-
@@ -78,27 +163,36 @@ BOOL Equals(const char* pszDest, const char* pszSrc);
  * otherwise.
  */
 BOOL EqualsNoCase(const char* pszDest, const char* pszSrc);
+
 /**
  * @brief Formats the current date and time according to the format string.
  * @param pszBuffer Address of the storage where the result is to be placed.
  * @param nSize Length of the buffer, in bytes.
  * @param pszFormat Format string to be passed to strftime.
+ * @returns OK on success; ERROR if the buffer, size or format is invalid or
+ * the local time could not be determined (non-terminating error model only;
+ * the legacy model exits the program instead).
  */
-void FormatDate(char* pszBuffer, int nSize, const char* pszFormat);
+int FormatDate(char* pszBuffer, int nSize, const char* pszFormat);
 
 /**
  * @brief Frees the memory at the address specified.
  * @param ppBuffer Address of a pointer which points to memory
- * allocated with the '*alloc' functions (malloc, calloc, realloc).
+ * allocated with AllocateBuffer, returned by one of the library's functions,
+ * or allocated with the '*alloc' functions (malloc, calloc, realloc).
  * @remarks Remember to cast the address of the pointer being passed
- * to this function to void**
+ * to this function to void**.  If the library was built with
+ * COMMON_CORE_STRING_POOL defined, the strings it returns may come from its
+ * pool rather than from malloc, and must be released with this function or
+ * FreeStringArray, never with free().
  */
 void FreeBuffer(void **ppBuffer);
 
 /**
  * @brief Frees the string array located at the address specified.
  * @param pppszStringArray Address of a char** array of strings, each
- * element of which has been previously allocated with malloc.
+ * element of which has been previously allocated with malloc or
+ * AllocateBuffer, or returned by one of the library's functions.
  * @param nElementCount Count of elements that are present in the string
  * array.  Must be a number greater than zero.
  * @remarks Iterates through the provided string array and frees each element.
@@ -112,7 +206,8 @@ void FreeStringArray(char*** pppszStringArray, int nElementCount);
  * @brief Determines the number of times a substring appears in a string.
  * @param pszSrc String to examine.
  * @param pszFindWhat Substring to check for.
- * @return Number of occurrences of pszFindWhat in pszSrc.
+ * @return Number of occurrences of pszFindWhat in pszSrc that do not overlap,
+ * found from the left, as StringReplace replaces them.
  */
 int GetSubstringOccurrenceCount(const char* pszSrc, const char* pszFindWhat);
 
@@ -133,8 +228,14 @@ void GetSystemCommandOutput(const char* pszCommand,
  *  @brief Reports the error message specified as well as the error from
  *  the system. Exits the program with the ERROR exit code.
  *  @param pszErrorMessage Additional error text to be echoed to the console.
+ *  @remarks The report is written to stderr, in full, before this function
+ *  returns, after any diagnostic messages the calling thread queued (see
+ *  diagnostics.h).
+ *  @returns OK if pszErrorMessage is blank; otherwise ERROR, after recording
+ *  the message and errno in the last-error record.  Under the legacy error
+ *  model, this function does not return if a message is given.
  **/
-void HandleError(const char* pszErrorMessage);
+int HandleError(const char* pszErrorMessage);
 
 /**
  * @brief Tells whether a string buffer contains only letters and numbers.
@@ -162,6 +263,10 @@ BOOL IsNullOrWhiteSpace(const char* pszTest);
  * the terminating null character, if any.
  * @return TRUE if the character chTest is one of the values in
  * pszPossibilities, FALSE otherwise.
+ * @remarks If nPossibilities does not equal strlen(pszPossibilities) + 1,
+ * an ArgumentOutOfRangeException is thrown under the legacy error model;
+ * under the non-terminating model, CORE_ERROR_OUT_OF_RANGE is recorded and
+ * FALSE is returned.
  */
 BOOL IsOneOf(char chTest, const char* pszPossibilities, int nPossibilities);
 
@@ -177,7 +282,8 @@ BOOL IsNumeric(const char* pszTest);
  * @brief Returns a value indicating whether the string specified represents a
  * all-uppercase value.
  * @param pszTest Pointer to the string to check.
- * @returns TRUE if the string represents a numeric value; FALSE otherwise.
+ * @returns TRUE if every character of the string other than whitespace is an
+ * uppercase letter; FALSE otherwise, or if the string is NULL or whitespace.
  */
 BOOL IsUppercase(const char* pszTest);
 
@@ -185,13 +291,35 @@ void JoinStrings(char* ppszSourceStringArray[],
   int nSourceStringArrayLength, char** ppszOutput,
   int *pnOutputLength);
 
+/**
+ * @brief Concatenates an array of strings into a new string allocated in a
+ * region.
+ * @param pRegion Region to allocate the result in.  Required.
+ * @param ppszSourceStringArray Strings to concatenate, none of which may be
+ * NULL.  May be NULL if nSourceStringArrayLength is zero.
+ * @param nSourceStringArrayLength Number of strings.  Must not be negative.
+ * @param ppszOutput Address of the pointer that receives the result.
+ * Required.
+ * @param pnOutputLength Address of an int that receives the size of the
+ * result, its null terminator included, as JoinStrings gives it.  May be
+ * NULL.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated.
+ * @remarks Unlike JoinStrings, ignores what *ppszOutput pointed to, and
+ * measures the strings before allocating the result once.
+ */
+int JoinStringsInRegion(LPREGION pRegion, char* ppszSourceStringArray[],
+    int nSourceStringArrayLength, char** ppszOutput, int* pnOutputLength);
+
 /**
  * @brief Tells which of the two integer values passed is the smaller of the two.
  * @param a The first integer value to be checked.
  * @param b The second integer value to be checked.
  * @returns If a < b, then a is returned. If a = b, a is returned.  If b < a, then b is returned.
  * @remarks This function compares two values and returns the value which is the smaller
- * of the two.  If they are equal, then both are returned.
+ * of the two.  If they are equal, then both are returned.  The result is selected with a mask
+ * rather than a branch, so unpredictable inputs cost no mispredictions.  For the least value
+ * of an array, call MinimumOfInts (see int_array.h) instead of MinimumOf in a loop.
  */
 int MinimumOf(int a, int b);
 
@@ -207,6 +335,36 @@ int MinimumOf(int a, int b);
  */
 void PrependTo(char** ppszDest, const char* pszPrefix, const char* pszSrc);
 
+/**
+ * @brief Prepends a string to another string, allocating the result in a
+ * region.
+ * @param pRegion Region to allocate the result in.  Required.
+ * @param ppszDest Memory location that receives the address of the result.
+ * Required.
+ * @param pszPrefix Prefix to be prepended to the source string.  Required;
+ * may be empty.
+ * @param pszSrc The string you want the prefix prepended to.  Required; may
+ * be empty.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL or memory could not be allocated.
+ */
+int PrependToInRegion(LPREGION pRegion, char** ppszDest,
+    const char* pszPrefix, const char* pszSrc);
+
+/**
+ * @brief Overwrites a buffer with zeroes, as explicit_bzero(3) does, so that
+ * secrets it held (passwords, keys) do not linger in memory.
+ * @param pvBuffer Buffer to clear.  May be NULL if nSize is zero.
+ * @param nSize Number of bytes to clear, all of which are cleared whatever
+ * they hold.
+ * @returns OK on success; ERROR, with the last-error record set, if
+ * pvBuffer is NULL and nSize is not zero.
+ * @remarks Unlike a memset of a buffer about to be freed or to go out of
+ * scope, the clearing cannot be optimized away.  Copies of the secret the
+ * compiler made in registers or elsewhere on the stack are not cleared.
+ */
+int SecureClear(void* pvBuffer, size_t nSize);
+
 /**
  * @brief Splits a specified string into tokens based on given delimiters.
  * @param pszStringToSplit String to be tokenized.
@@ -217,24 +375,69 @@ void PrependTo(char** ppszDest, const char* pszPrefix, const char* pszSrc);
  * @param pppszStrings Memory location to be filled with the address of an
  * array of character strings containing the tokens.
  * @param pnResultCount Count of tokens that were found.
- * @remarks This function is basically a nice wrapper for strtok(3). Be sure
+ * @returns OK on success, or if there was nothing to split; ERROR if a
+ * required parameter is missing or memory could not be allocated.  In the
+ * latter case, the last-error record says which.
+ * @remarks This function tokenizes the way strtok(3) does, but leaves
+ * pszStringToSplit untouched and makes no copy of it.  Be sure
  * to call free() on each element of the array of strings returned, as well
  * as the array itself, when you're done using the data.  The pszStringToSplit
  * and pszDelimiters are not allowed to be NULL or whitespace characters only;
  * if this is the case for either one of them or both, the Split function
- * does nothing.
+ * does nothing.  Under the legacy error model, a failed allocation exits the
+ * program.
  */
-void Split(char* pszStringToSplit, int nStringToSplitSize,
+int Split(char* pszStringToSplit, int nStringToSplitSize,
     const char* pszDelimiters, char*** pppszStrings, int* pnResultCount);
 
+/**
+ * @brief Splits a string into tokens as Split does, allocating the tokens
+ * and the array of them in a region.
+ * @param pRegion Region to allocate the results in.  Required.
+ * @returns As for Split, which describes the other parameters.
+ * @remarks The results are released with the region, never with
+ * FreeStringArray.  If the call fails, whatever it allocated in the region
+ * is released.
+ */
+int SplitInRegion(LPREGION pRegion, char* pszStringToSplit,
+    int nStringToSplitSize, const char* pszDelimiters, char*** pppszStrings,
+    int* pnResultCount);
+
 /**
  * @brief Checks to see whether one string begins with another.
  * @param str String to be examined.
  * @param startsWith The prefix to be checked.
- * @returns TRUE if the string in str begins with the string in startsWith.
+ * @returns TRUE if the string in str begins with the string in startsWith;
+ * FALSE otherwise, or if either string is NULL.
+ * @remarks Stops at the first character that differs, so the cost depends on
+ * the length of the prefix only, never on that of str.
  */
 BOOL StartsWith(const char *str, const char *startsWith);
 
+/**
+ * @brief Checks to see whether a character sequence of known length begins
+ * with another.
+ * @param pchString Characters to be examined; need not be null-terminated.
+ * @param nLength Number of characters at pchString.
+ * @param pchPrefix Characters of the prefix; need not be null-terminated.
+ * @param nPrefixLength Number of characters at pchPrefix.
+ * @returns TRUE if the first nPrefixLength characters at pchString are those
+ * at pchPrefix; FALSE otherwise, or if either pointer is NULL.
+ */
+BOOL StartsWithN(const char* pchString, size_t nLength,
+    const char* pchPrefix, size_t nPrefixLength);
+
+/**
+ * @brief Does the same thing as StartsWith but ignores case.
+ */
+BOOL StartsWithNoCase(const char* pszString, const char* pszPrefix);
+
+/**
+ * @brief Does the same thing as StartsWithN but ignores case.
+ */
+BOOL StartsWithNoCaseN(const char* pchString, size_t nLength,
+    const char* pchPrefix, size_t nPrefixLength);
+
 /**
  * @name StringReplace
  * @brief Replaces all occurrences of a substring with another string in a
@@ -253,6 +456,21 @@ void StringReplace(const char* pszSrc,
     const char* pszFindWhat, const char* pszReplaceWith,
     char** ppszResult);
 
+/**
+ * @brief Replaces all occurrences of a substring as StringReplace does,
+ * allocating the result in a region.
+ * @param pRegion Region to allocate the result in.  Required.
+ * @param pszSrc String in which to do the replacement.  Required.
+ * @param pszFindWhat Substring to replace.  Required; must not be empty.
+ * @param pszReplaceWith String to replace it with.  Required; may be empty.
+ * @param ppszResult Address of the pointer that receives the result.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated.
+ */
+int StringReplaceInRegion(LPREGION pRegion, const char* pszSrc,
+    const char* pszFindWhat, const char* pszReplaceWith, char** ppszResult);
+
 
 /**
  * @brief Returns a new string in which all leading and trailing occurrences
@@ -261,7 +479,21 @@ void StringReplace(const char* pszSrc,
  * @param len Size of the output buffer.  This must be at least as big as the
  * strlen of the str buffer.
  * @param str Pointer to a memory location containing the string to be trimmed.
+ * @remarks Whitespace is what isspace(3) says it is.  Whitespace between the
+ * first and last non-whitespace characters is kept.  If the result does not
+ * fit, it is truncated to len - 1 characters; either way, it is null-
+ * terminated and the rest of the buffer is zero-filled.
  */
 void Trim(char *out, size_t len, const char *str);
 
+/**
+ * @brief Define COMMON_CORE_INLINE before including this file to have calls
+ * to Equals, EqualsNoCase, FreeBuffer, MinimumOf and StartsWith compiled
+ * inline into the caller (see common_core_inline.h).  The library exports
+ * the functions either way.
+ */
+#ifdef COMMON_CORE_INLINE
+#include "common_core_inline.h"
+#endif //COMMON_CORE_INLINE
+
 #endif /* __COMMON_CORE_H__ */
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// common_core_inline.h - Inline definitions of the trivial predicates of common_core, so that calls
+// to them compile into the caller instead of going through the PLT
+//
+// Do not include this file directly.  Define COMMON_CORE_INLINE before including common_core.h
+// (or on the compiler's command line) and common_core.h pulls it in.  Calls written as
+// Equals(a, b), EqualsNoCase(a, b), MinimumOf(a, b), StartsWith(s, p) and FreeBuffer(pp) then
+// expand to the inline versions below.  The library keeps exporting the real functions, so
+// taking their address, e.g., 'pfnCompare = Equals;', still yields the exported symbol, and code
+// built without COMMON_CORE_INLINE is unaffected.
+//
+// Calls that are inlined are not seen by the per-function counters of core_stats.h.
+
+#ifndef __COMMON_CORE_INLINE_H__
+#define __COMMON_CORE_INLINE_H__
+
+#include "stdafx.h"
+
+static inline BOOL EqualsInline(const char* pszDest, const char* pszSrc) {
+  return strcmp(pszDest, pszSrc) == 0;
+}
+
+static inline BOOL EqualsNoCaseInline(const char* pszDest,
+    const char* pszSrc) {
+  return strcasecmp(pszDest, pszSrc) == 0;
+}
+
+/* Releasing the block is left to the library, so that it reaches the
+ * library's allocator (and allocation tracking, if built in); only the
+ * common no-op case is inlined.  The parentheses keep FreeBuffer from being
+ * expanded as the macro below. */
+static inline void FreeBufferInline(void** ppBuffer) {
+  if (ppBuffer != NULL && *ppBuffer != NULL) {
+    (FreeBuffer)(ppBuffer);
+  }
+}
+
+static inline int MinimumOfInline(int a, int b) {
+  const int A_MASK = -(a <= b);
+  return (a & A_MASK) | (b & ~A_MASK);
+}
+
+static inline BOOL StartsWithInline(const char* str, const char* startsWith) {
+  if (str == NULL || startsWith == NULL) {
+    return FALSE;
+  }
+
+  while (*startsWith != '\0' && *str == *startsWith) {
+    str++;
+    startsWith++;
+  }
+  return *startsWith == '\0';
+}
+
+#define Equals(pszDest, pszSrc)           EqualsInline(pszDest, pszSrc)
+#define EqualsNoCase(pszDest, pszSrc)     EqualsNoCaseInline(pszDest, pszSrc)
+#define FreeBuffer(ppBuffer)              FreeBufferInline(ppBuffer)
+#define MinimumOf(a, b)                   MinimumOfInline(a, b)
+#define StartsWith(str, startsWith)       StartsWithInline(str, startsWith)
+
+#endif /* __COMMON_CORE_INLINE_H__ */
@@ -0,0 +1,93 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_error.h - Thread-local last-error record used by the non-terminating error model of
+// common_core
+
+#ifndef __CORE_ERROR_H__
+#define __CORE_ERROR_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Error codes stored in the last-error record.
+ */
+#ifndef CORE_ERROR_NONE
+#define CORE_ERROR_NONE               0
+#endif //CORE_ERROR_NONE
+
+#ifndef CORE_ERROR_INVALID_ARGUMENT
+#define CORE_ERROR_INVALID_ARGUMENT   1
+#endif //CORE_ERROR_INVALID_ARGUMENT
+
+#ifndef CORE_ERROR_OUT_OF_RANGE
+#define CORE_ERROR_OUT_OF_RANGE       2
+#endif //CORE_ERROR_OUT_OF_RANGE
+
+#ifndef CORE_ERROR_OUT_OF_MEMORY
+#define CORE_ERROR_OUT_OF_MEMORY      3
+#endif //CORE_ERROR_OUT_OF_MEMORY
+
+#ifndef CORE_ERROR_SYSTEM
+#define CORE_ERROR_SYSTEM             4
+#endif //CORE_ERROR_SYSTEM
+
+/**
+ * @brief Size, in bytes, of the message buffer held by the last-error record.
+ */
+#ifndef CORE_ERROR_MESSAGE_SIZE
+#define CORE_ERROR_MESSAGE_SIZE       256
+#endif //CORE_ERROR_MESSAGE_SIZE
+
+/**
+ * @brief Snapshot of the calling thread's last-error record.
+ */
+typedef struct _CORE_ERROR_INFO {
+  int nCode;                                /* one of the CORE_ERROR_* codes */
+  int nErrno;                               /* value of errno when recorded */
+  char szMessage[CORE_ERROR_MESSAGE_SIZE];  /* human-readable description */
+} CORE_ERROR_INFO, *LPCORE_ERROR_INFO;
+
+/**
+ * @brief Resets the calling thread's last-error record to CORE_ERROR_NONE.
+ * @remarks Functions that succeed do not clear the record; call this before
+ * an operation if you need to tell whether that operation set it.
+ */
+void ClearLastCoreError(void);
+
+/**
+ * @brief Gets the error code most recently recorded on the calling thread.
+ * @returns One of the CORE_ERROR_* values; CORE_ERROR_NONE if no error has
+ * been recorded since the thread started or since ClearLastCoreError was
+ * called.
+ */
+int GetLastCoreError(void);
+
+/**
+ * @brief Gets a copy of the calling thread's entire last-error record.
+ * @param pInfo Address of the structure that receives the record.  Required.
+ */
+void GetLastCoreErrorInfo(LPCORE_ERROR_INFO pInfo);
+
+/**
+ * @brief Gets the message most recently recorded on the calling thread.
+ * @returns Pointer to thread-local storage holding the message.  The empty
+ * string is returned if no error has been recorded.  Do not free it.
+ */
+const char* GetLastCoreErrorMessage(void);
+
+/**
+ * @brief Gets the value errno had when the last error was recorded on the
+ * calling thread.
+ */
+int GetLastCoreErrorNumber(void);
+
+/**
+ * @brief Records an error in the calling thread's last-error record.
+ * @param nCode One of the CORE_ERROR_* codes.
+ * @param pszMessage Description of the error.  May be NULL.  Messages longer
+ * than CORE_ERROR_MESSAGE_SIZE - 1 bytes are truncated.
+ * @remarks The current value of errno is captured along with the message and
+ * is left unchanged.
+ */
+void SetLastCoreError(int nCode, const char* pszMessage);
+
+#endif /* __CORE_ERROR_H__ */
@@ -0,0 +1,210 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_stats.h - Optional per-function call counters and latency histograms for the public
+// functions of common_core
+//
+// Define COMMON_CORE_INSTRUMENT when building the library to have every public function count
+// its calls, input bytes and latency into per-thread counters.  Without it, the probes compile
+// to nothing and the functions below report zeroes.  Note that calls the library makes to its
+// own functions (e.g., StringReplace calling GetSubstringOccurrenceCount) are counted too.
+
+#ifndef __CORE_STATS_H__
+#define __CORE_STATS_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Number of buckets in each latency histogram.  Bucket i counts calls
+ * that took from 2^i up to (but not including) 2^(i+1) nanoseconds; bucket 0
+ * also counts calls that took less than one nanosecond, and the last bucket
+ * counts everything slower.
+ */
+#ifndef CORE_STATS_HISTOGRAM_BUCKETS
+#define CORE_STATS_HISTOGRAM_BUCKETS  32
+#endif //CORE_STATS_HISTOGRAM_BUCKETS
+
+/**
+ * @brief Identifies each instrumented function.
+ */
+typedef enum _CORE_FUNCTION_ID {
+  CORE_FN_ADD_BLOOM_FILTER_KEY,
+  CORE_FN_ADD_BLOOM_FILTER_KEYS,
+  CORE_FN_ALLOCATE_BUFFER,
+  CORE_FN_ALLOCATE_FROM_REGION,
+  CORE_FN_CONTAINS,
+  CORE_FN_CONTAINS_NO_CASE,
+  CORE_FN_CLAMP_INT64S,
+  CORE_FN_CLAMP_INTS,
+  CORE_FN_CLAMP_SIZES,
+  CORE_FN_CLEAR_STRING,
+  CORE_FN_CLEAR_STRING_MAP,
+  CORE_FN_COPY_TO_REGION,
+  CORE_FN_CREATE_BLOOM_FILTER,
+  CORE_FN_CREATE_INTERN_POOL,
+  CORE_FN_CREATE_PREFIX_SET,
+  CORE_FN_CREATE_REGION,
+  CORE_FN_CREATE_STRING_INDEX,
+  CORE_FN_CREATE_STRING_MAP,
+  CORE_FN_ENDS_WITH,
+  CORE_FN_ENDS_WITH_N,
+  CORE_FN_ENDS_WITH_NO_CASE,
+  CORE_FN_ENDS_WITH_NO_CASE_N,
+  CORE_FN_EQUALS,
+  CORE_FN_EQUALS_NO_CASE,
+  CORE_FN_FIND_INDEXED_PREFIX,
+  CORE_FN_FIND_INDEXED_STRING,
+  CORE_FN_FIND_INTERNED_STRING,
+  CORE_FN_FIND_INTERNED_STRING_N,
+  CORE_FN_FIND_STRING_MAP_VALUE,
+  CORE_FN_FORMAT_DATE,
+  CORE_FN_FREE_BLOOM_FILTER,
+  CORE_FN_FREE_BUFFER,
+  CORE_FN_FREE_INTERN_POOL,
+  CORE_FN_FREE_MAPPED_FILE,
+  CORE_FN_FREE_PREFIX_SET,
+  CORE_FN_FREE_REGION,
+  CORE_FN_FREE_STRING_ARRAY,
+  CORE_FN_FREE_STRING_INDEX,
+  CORE_FN_FREE_STRING_MAP,
+  CORE_FN_GET_INDEXED_STRING,
+  CORE_FN_GET_INDEXED_STRING_RANK,
+  CORE_FN_GET_SUBSTRING_OCCURRENCE_COUNT,
+  CORE_FN_HANDLE_ERROR,
+  CORE_FN_HASH_BYTES,
+  CORE_FN_HASH_BYTES_NO_CASE,
+  CORE_FN_HASH_BYTES_NO_CASE_SEEDED,
+  CORE_FN_HASH_BYTES_SEEDED,
+  CORE_FN_HASH_STRING,
+  CORE_FN_HASH_STRING_NO_CASE,
+  CORE_FN_INDEX_OF_MINIMUM_OF_INT64S,
+  CORE_FN_INDEX_OF_MINIMUM_OF_INTS,
+  CORE_FN_INDEX_OF_MINIMUM_OF_SIZES,
+  CORE_FN_INSERT_STRING_MAP_KEY,
+  CORE_FN_INTERN_STRING,
+  CORE_FN_INTERN_STRING_N,
+  CORE_FN_INTERSECT_STRINGS,
+  CORE_FN_IS_ALPHA_NUMERIC,
+  CORE_FN_IS_NULL_OR_WHITE_SPACE,
+  CORE_FN_IS_NUMERIC,
+  CORE_FN_IS_ONE_OF,
+  CORE_FN_IS_UPPERCASE,
+  CORE_FN_JOIN_STRINGS,
+  CORE_FN_JOIN_STRINGS_IN_REGION,
+  CORE_FN_LOAD_BLOOM_FILTER,
+  CORE_FN_MAP_BLOOM_FILTER_FILE,
+  CORE_FN_MAP_FILE,
+  CORE_FN_MAP_PREFIX_SET_FILE,
+  CORE_FN_MAP_STRING_INDEX_FILE,
+  CORE_FN_MARK_REGION,
+  CORE_FN_MATCH_PREFIX_SET,
+  CORE_FN_MATCH_PREFIX_SET_N,
+  CORE_FN_MAXIMUM_OF_INT64S,
+  CORE_FN_MAXIMUM_OF_INTS,
+  CORE_FN_MAXIMUM_OF_SIZES,
+  CORE_FN_MINIMUM_OF,
+  CORE_FN_MINIMUM_OF_INT64S,
+  CORE_FN_MINIMUM_OF_INTS,
+  CORE_FN_MINIMUM_OF_SIZES,
+  CORE_FN_PREPEND_TO,
+  CORE_FN_PREPEND_TO_IN_REGION,
+  CORE_FN_REMOVE_STRING_MAP_KEY,
+  CORE_FN_RESET_REGION,
+  CORE_FN_ROLL_BACK_REGION,
+  CORE_FN_SAVE_BLOOM_FILTER,
+  CORE_FN_SAVE_BLOOM_FILTER_FILE,
+  CORE_FN_SAVE_PREFIX_SET_FILE,
+  CORE_FN_SAVE_STRING_INDEX_FILE,
+  CORE_FN_SECURE_CLEAR,
+  CORE_FN_SORT_STRINGS,
+  CORE_FN_SORT_STRINGS_STABLE,
+  CORE_FN_SORT_UNIQUE_STRINGS,
+  CORE_FN_SPLIT,
+  CORE_FN_SPLIT_IN_REGION,
+  CORE_FN_STARTS_WITH,
+  CORE_FN_STARTS_WITH_N,
+  CORE_FN_STARTS_WITH_NO_CASE,
+  CORE_FN_STARTS_WITH_NO_CASE_N,
+  CORE_FN_STRING_REPLACE,
+  CORE_FN_STRING_REPLACE_IN_REGION,
+  CORE_FN_SUBTRACT_STRINGS,
+  CORE_FN_SUM_OF_INT64S,
+  CORE_FN_SUM_OF_INTS,
+  CORE_FN_SUM_OF_SIZES,
+  CORE_FN_TEST_BLOOM_FILTER_KEY,
+  CORE_FN_TEST_BLOOM_FILTER_KEYS,
+  CORE_FN_TRIM,
+  CORE_FN_UNION_STRINGS,
+  CORE_FN_UNIQUE_STRINGS,
+  CORE_FN_UPDATE_STRING_HASH,
+  CORE_FN_UPDATE_STRING_HASH_NO_CASE,
+  CORE_FN_VERIFY_BLOOM_FILTER,
+  CORE_FN_VERIFY_PREFIX_SET,
+  CORE_FN_VERIFY_STRING_INDEX,
+  CORE_FN_COUNT       /* number of instrumented functions; not an ID */
+} CORE_FUNCTION_ID;
+
+/**
+ * @brief Statistics gathered for one function.
+ */
+typedef struct _CORE_FUNCTION_STATS {
+  unsigned long long ullCalls;          /* number of calls */
+  unsigned long long ullBytes;          /* input bytes processed */
+  unsigned long long ullNanoseconds;    /* total time spent, in ns */
+  unsigned long long ullHistogram[CORE_STATS_HISTOGRAM_BUCKETS];
+} CORE_FUNCTION_STATS, *LPCORE_FUNCTION_STATS;
+
+/**
+ * @brief Statistics for every instrumented function, indexed by
+ * CORE_FUNCTION_ID.
+ */
+typedef struct _CORE_STATS_SNAPSHOT {
+  CORE_FUNCTION_STATS functions[CORE_FN_COUNT];
+} CORE_STATS_SNAPSHOT, *LPCORE_STATS_SNAPSHOT;
+
+/**
+ * @brief Writes a human-readable table of the statistics in a snapshot.
+ * @param fp Stream to write to, e.g., stderr.  Required.
+ * @param pSnapshot Snapshot to dump.  Required.
+ * @remarks Functions that were never called are left out.  The percentile
+ * columns are the upper bounds of the histogram buckets they fall in.
+ */
+void DumpCoreStats(FILE* fp, const CORE_STATS_SNAPSHOT* pSnapshot);
+
+/**
+ * @brief Gets the name of the function having the ID specified.
+ * @returns The name, or NULL if nFunction is not a valid CORE_FUNCTION_ID.
+ */
+const char* GetCoreFunctionName(CORE_FUNCTION_ID nFunction);
+
+/**
+ * @brief Fills a snapshot with the statistics of every thread, merged.
+ * @param pSnapshot Address of the structure that receives the statistics.
+ * Required.
+ * @remarks Counters are read while other threads may be updating them, so
+ * the snapshot is only approximately consistent.  If the library was built
+ * without instrumentation, the snapshot is all zeroes.
+ */
+void GetCoreStatsSnapshot(LPCORE_STATS_SNAPSHOT pSnapshot);
+
+/**
+ * @brief Tells whether the library was built with COMMON_CORE_INSTRUMENT
+ * defined, i.e., whether statistics are being gathered at all.
+ */
+BOOL IsCoreStatsEnabled(void);
+
+/**
+ * @brief Adds the statistics of one snapshot into another, e.g., to
+ * combine snapshots taken in different processes.
+ * @param pDest Snapshot that receives the sums.  Required.
+ * @param pSrc Snapshot to be added.  Required.
+ */
+void MergeCoreStatsSnapshot(LPCORE_STATS_SNAPSHOT pDest,
+    const CORE_STATS_SNAPSHOT* pSrc);
+
+/**
+ * @brief Sets every counter of every thread back to zero.
+ * @remarks Calls in progress on other threads while this runs may or may not
+ * be counted.
+ */
+void ResetCoreStats(void);
+
+#endif /* __CORE_STATS_H__ */
@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// cpu_dispatch.h - Selection of the instruction-set tier used by the library's vectorized string
+// kernels
+//
+// The classification, trimming and splitting functions of common_core run on kernels that exist
+// in scalar, SSE4.2, AVX2 and AVX-512BW variants.  When the library is loaded, it picks the best
+// tier the CPU (and the operating system) supports, so that one libcommon_core.so serves every
+// host.  Set the COMMON_CORE_CPU_TIER environment variable to scalar, sse42, avx2 or avx512 to
+// force a lower tier, e.g., to compare tiers or to rule a tier out while chasing a problem.
+// Every tier produces the same results.
+
+#ifndef __CPU_DISPATCH_H__
+#define __CPU_DISPATCH_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Name of the environment variable that forces a tier at load time.
+ */
+#ifndef COMMON_CORE_CPU_TIER_ENV
+#define COMMON_CORE_CPU_TIER_ENV      "COMMON_CORE_CPU_TIER"
+#endif //COMMON_CORE_CPU_TIER_ENV
+
+/**
+ * @brief Instruction-set tiers, from the least to the most capable.
+ */
+typedef enum _CORE_CPU_TIER {
+  CORE_CPU_TIER_SCALAR,     /* portable C */
+  CORE_CPU_TIER_SSE42,      /* 16-byte vectors, SSE4.2 string instructions */
+  CORE_CPU_TIER_AVX2,       /* 32-byte vectors */
+  CORE_CPU_TIER_AVX512,     /* 64-byte vectors and masks, AVX-512BW */
+  CORE_CPU_TIER_COUNT       /* number of tiers; not a tier */
+} CORE_CPU_TIER;
+
+/**
+ * @brief Gets the tier the library's kernels are currently running on.
+ */
+CORE_CPU_TIER GetCoreCpuTier(void);
+
+/**
+ * @brief Gets the name of a tier, as accepted by COMMON_CORE_CPU_TIER.
+ * @returns The name, or NULL if nTier is not a tier.
+ */
+const char* GetCoreCpuTierName(CORE_CPU_TIER nTier);
+
+/**
+ * @brief Gets the most capable tier this machine supports.
+ */
+CORE_CPU_TIER GetSupportedCoreCpuTier(void);
+
+/**
+ * @brief Switches the library's kernels to another tier.
+ * @param nTier Tier to switch to.  Must not exceed GetSupportedCoreCpuTier().
+ * @returns OK if the tier is now in use; ERROR, with the last-error record
+ * set, if nTier is not a tier or the machine does not support it.
+ * @remarks Meant for benchmarks and for checking the tiers against each
+ * other.  Calls already under way on other threads finish on the tier they
+ * started with.
+ */
+int SetCoreCpuTier(CORE_CPU_TIER nTier);
+
+#endif /* __CPU_DISPATCH_H__ */
@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// diagnostics.h - Asynchronous, lock-free logging of error and diagnostic messages to stderr
+
+#ifndef __DIAGNOSTICS_H__
+#define __DIAGNOSTICS_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Number of messages each thread's diagnostic ring can hold before
+ * further messages are dropped.
+ */
+#ifndef DIAGNOSTIC_RING_SLOTS
+#define DIAGNOSTIC_RING_SLOTS         256
+#endif //DIAGNOSTIC_RING_SLOTS
+
+/**
+ * @brief Size, in bytes, of a ring slot, including the terminating null.
+ * Longer messages are not queued but written directly, in full, as
+ * WriteDiagnostic writes them.
+ */
+#ifndef DIAGNOSTIC_MESSAGE_SIZE
+#define DIAGNOSTIC_MESSAGE_SIZE       256
+#endif //DIAGNOSTIC_MESSAGE_SIZE
+
+/**
+ * @brief Makes sure every diagnostic message queued so far has been written
+ * to stderr before returning.
+ * @remarks Called automatically at exit() time.  Call it yourself before
+ * terminating the process by other means, e.g., _exit or abort.
+ */
+void FlushDiagnostics(void);
+
+/**
+ * @brief Gets the total number of diagnostic messages that were discarded
+ * because the ring of the thread that logged them was full.
+ */
+long GetDroppedDiagnosticCount(void);
+
+/**
+ * @brief Queues a message to be written to stderr by the background
+ * diagnostics thread.
+ * @param pszMessage Text to be written, verbatim; no newline is appended.
+ * @remarks Does not wait for the write.  Each thread logs into its own
+ * bounded, lock-free ring buffer, and the background thread drains all the
+ * rings with batched writev calls; it sleeps while they are all empty, and
+ * the first message queued wakes it.  If the calling thread's ring is full,
+ * the message is dropped and counted; the drain thread reports the count on
+ * stderr.  A message of DIAGNOSTIC_MESSAGE_SIZE bytes or more is written
+ * directly instead.  After fork(), the child writes only its own messages,
+ * through a drain thread of its own.
+ */
+void LogDiagnostic(const char* pszMessage);
+
+/**
+ * @brief Formats a message with vsnprintf and queues it in the same manner
+ * as LogDiagnostic.
+ * @param pszFormat printf-style format string.
+ */
+void LogDiagnosticFormat(const char* pszFormat, ...)
+    __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Writes a message to stderr before returning, after every message
+ * the calling thread queued before it.  Neither truncated nor dropped.
+ * @param pszMessage Text to be written, verbatim; no newline is appended.
+ * @remarks For messages that must not be lost, e.g., those about an error
+ * that is about to end the process.  Holds up the drain thread while it
+ * writes.
+ */
+void WriteDiagnostic(const char* pszMessage);
+
+/**
+ * @brief Formats a message with vsnprintf and writes it in the same manner
+ * as WriteDiagnostic, however long it is.
+ * @param pszFormat printf-style format string.
+ */
+void WriteDiagnosticFormat(const char* pszFormat, ...)
+    __attribute__((format(printf, 1, 2)));
+
+#endif /* __DIAGNOSTICS_H__ */
@@ -0,0 +1,168 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// int_array.h - Minimum, maximum, index of the minimum, sum and clamping of arrays of int, int64_t
+// and size_t
+//
+// Each function takes the array and its length, and runs on the vector kernels selected for this
+// CPU (see cpu_dispatch.h).  Their inner loops do not branch on the values, so their speed does not
+// depend on the order of the data, where a loop of MinimumOf calls written to stop early would.  An
+// empty array gives the identity of the operation: the type's largest value for a minimum, its
+// smallest for a maximum, and zero for a sum.
+
+#ifndef __INT_ARRAY_H__
+#define __INT_ARRAY_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Replaces each value of an array of int64_t values that lies outside
+ * [llLow, llHigh] with the nearer bound.
+ * @param pllValues Values to clamp, in place.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @param llLow Least value to keep.
+ * @param llHigh Greatest value to keep; must not be less than llLow.
+ * @returns OK on success; ERROR, with the last-error record set, if
+ * pllValues is NULL and nCount is not zero, or llLow > llHigh.
+ */
+int ClampInt64s(int64_t* pllValues, size_t nCount, int64_t llLow,
+    int64_t llHigh);
+
+/**
+ * @brief Replaces each value of an array of ints that lies outside
+ * [nLow, nHigh] with the nearer bound.
+ * @param pnValues Values to clamp, in place.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @param nLow Least value to keep.
+ * @param nHigh Greatest value to keep; must not be less than nLow.
+ * @returns OK on success; ERROR, with the last-error record set, if pnValues
+ * is NULL and nCount is not zero, or nLow > nHigh.
+ */
+int ClampInts(int* pnValues, size_t nCount, int nLow, int nHigh);
+
+/**
+ * @brief Replaces each value of an array of size_t values that lies outside
+ * [nLow, nHigh] with the nearer bound.
+ * @param pnValues Values to clamp, in place.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @param nLow Least value to keep.
+ * @param nHigh Greatest value to keep; must not be less than nLow.
+ * @returns OK on success; ERROR, with the last-error record set, if pnValues
+ * is NULL and nCount is not zero, or nLow > nHigh.
+ */
+int ClampSizes(size_t* pnValues, size_t nCount, size_t nLow, size_t nHigh);
+
+/**
+ * @brief Finds the first occurrence of the least value of an array of
+ * int64_t values.
+ * @param pllValues Values to search.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The index of the first value equal to the least one; zero if
+ * nCount is zero, or, with the last-error record set, if pllValues is NULL.
+ * @remarks Finds the least value a block at a time, then narrows down the
+ * first block that holds it by halves, so only that block is read twice.
+ */
+size_t IndexOfMinimumOfInt64s(const int64_t* pllValues, size_t nCount);
+
+/**
+ * @brief Finds the first occurrence of the least value of an array of ints.
+ * @param pnValues Values to search.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The index of the first value equal to the least one; zero if
+ * nCount is zero, or, with the last-error record set, if pnValues is NULL.
+ * @remarks See IndexOfMinimumOfInt64s.
+ */
+size_t IndexOfMinimumOfInts(const int* pnValues, size_t nCount);
+
+/**
+ * @brief Finds the first occurrence of the least value of an array of size_t
+ * values.
+ * @param pnValues Values to search.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The index of the first value equal to the least one; zero if
+ * nCount is zero, or, with the last-error record set, if pnValues is NULL.
+ * @remarks See IndexOfMinimumOfInt64s.
+ */
+size_t IndexOfMinimumOfSizes(const size_t* pnValues, size_t nCount);
+
+/**
+ * @brief Gets the greatest value of an array of int64_t values.
+ * @param pllValues Values to examine.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The greatest value; INT64_MIN if nCount is zero, or, with the
+ * last-error record set, if pllValues is NULL.
+ */
+int64_t MaximumOfInt64s(const int64_t* pllValues, size_t nCount);
+
+/**
+ * @brief Gets the greatest value of an array of ints.
+ * @param pnValues Values to examine.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The greatest value; INT_MIN if nCount is zero, or, with the
+ * last-error record set, if pnValues is NULL.
+ */
+int MaximumOfInts(const int* pnValues, size_t nCount);
+
+/**
+ * @brief Gets the greatest value of an array of size_t values.
+ * @param pnValues Values to examine.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The greatest value; zero if nCount is zero, or, with the
+ * last-error record set, if pnValues is NULL.
+ */
+size_t MaximumOfSizes(const size_t* pnValues, size_t nCount);
+
+/**
+ * @brief Gets the least value of an array of int64_t values.
+ * @param pllValues Values to examine.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The least value; INT64_MAX if nCount is zero, or, with the
+ * last-error record set, if pllValues is NULL.
+ */
+int64_t MinimumOfInt64s(const int64_t* pllValues, size_t nCount);
+
+/**
+ * @brief Gets the least value of an array of ints.
+ * @param pnValues Values to examine.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The least value; INT_MAX if nCount is zero, or, with the
+ * last-error record set, if pnValues is NULL.
+ */
+int MinimumOfInts(const int* pnValues, size_t nCount);
+
+/**
+ * @brief Gets the least value of an array of size_t values.
+ * @param pnValues Values to examine.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The least value; SIZE_MAX if nCount is zero, or, with the
+ * last-error record set, if pnValues is NULL.
+ */
+size_t MinimumOfSizes(const size_t* pnValues, size_t nCount);
+
+/**
+ * @brief Adds up an array of int64_t values.
+ * @param pllValues Values to add.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The sum, wrapped modulo 2^64 into the range of int64_t if it
+ * overflows; zero if nCount is zero, or, with the last-error record set, if
+ * pllValues is NULL.
+ */
+int64_t SumOfInt64s(const int64_t* pllValues, size_t nCount);
+
+/**
+ * @brief Adds up an array of ints.
+ * @param pnValues Values to add.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The sum, which is exact for fewer than 2^32 values; zero if
+ * nCount is zero, or, with the last-error record set, if pnValues is NULL.
+ */
+int64_t SumOfInts(const int* pnValues, size_t nCount);
+
+/**
+ * @brief Adds up an array of size_t values.
+ * @param pnValues Values to add.  May be NULL if nCount is zero.
+ * @param nCount Number of values.
+ * @returns The sum, modulo SIZE_MAX + 1 if it overflows; zero if nCount is
+ * zero, or, with the last-error record set, if pnValues is NULL.
+ */
+size_t SumOfSizes(const size_t* pnValues, size_t nCount);
+
+#endif /* __INT_ARRAY_H__ */
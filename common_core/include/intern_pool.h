@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// intern_pool.h - Pools of interned strings, so that strings from a small vocabulary (header
+// names, tag keys, ...) can be compared by pointer or ID instead of with Equals
+//
+// Interning a string returns the pool's one copy of it, its canonical pointer.  Two strings
+// interned in the same pool are equal if and only if their canonical pointers are equal, and
+// each canonical string also has a small integer ID, dense from zero, for use as an array index.
+// A pool created with bFoldCase set treats strings that differ only in case as the same string,
+// so pointer equality there stands in for EqualsNoCase.
+//
+// Pools are thread-safe.  Looking up a string that is already in the pool takes no lock; only
+// adding a string does.  Canonical pointers stay valid, and IDs stay the same, until the pool is
+// freed.
+
+#ifndef __INTERN_POOL_H__
+#define __INTERN_POOL_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief A pool of interned strings.  Opaque; create it with
+ * CreateInternPool and release it with FreeInternPool.
+ */
+typedef struct _INTERN_POOL INTERN_POOL, *LPINTERN_POOL;
+
+/**
+ * @brief Creates an empty pool of interned strings.
+ * @param bFoldCase TRUE to intern strings without regard to case, as
+ * EqualsNoCase compares them; FALSE to intern them as Equals compares them.
+ * @param ppPool Address of the pointer that receives the new pool.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if ppPool
+ * is NULL or memory could not be allocated.
+ * @remarks A case-folding pool folds case with tolower(3) as it behaves in
+ * the locale in effect when the pool is created.
+ */
+int CreateInternPool(BOOL bFoldCase, LPINTERN_POOL* ppPool);
+
+/**
+ * @brief Releases a pool, and every canonical string in it, and sets the
+ * pointer to NULL.
+ * @param ppPool Address of the pointer to the pool.  Nothing happens if it,
+ * or the pointer it points to, is NULL.
+ * @remarks No other thread may be using the pool.
+ */
+void FreeInternPool(LPINTERN_POOL* ppPool);
+
+/**
+ * @brief Looks up a string in the pool, without adding it.
+ * @param pPool Pool to look in.  Required.
+ * @param pszString String to look up.  May be NULL, which is never found.
+ * @returns The canonical pointer of the string, or NULL if the string has
+ * not been interned or pPool is NULL (which also sets the last-error
+ * record).
+ * @remarks Takes no lock.
+ */
+const char* FindInternedString(const INTERN_POOL* pPool,
+    const char* pszString);
+
+/**
+ * @brief Looks up the first nLength characters of a string in the pool,
+ * without adding them.
+ * @param pPool Pool to look in.  Required.
+ * @param pchString Characters to look up; need not be null-terminated, and
+ * may contain nulls.  May be NULL if nLength is zero.
+ * @param nLength Number of characters in pchString.
+ * @returns As for FindInternedString.
+ */
+const char* FindInternedStringN(const INTERN_POOL* pPool,
+    const char* pchString, size_t nLength);
+
+/**
+ * @brief Gets the canonical string having the ID specified.
+ * @returns The canonical pointer, or NULL if pPool is NULL or has no string
+ * with that ID.
+ */
+const char* GetInternedString(const INTERN_POOL* pPool, int nId);
+
+/**
+ * @brief Gets the ID of a canonical string.
+ * @param pszInterned A canonical pointer returned by this pool's functions.
+ * Passing any other pointer gives undefined results.
+ * @returns The ID, from zero up to GetInternPoolCount() - 1.
+ */
+int GetInternedStringId(const char* pszInterned);
+
+/**
+ * @brief Gets the length of a canonical string, which is how many
+ * characters were interned (embedded nulls included).
+ * @param pszInterned A canonical pointer returned by this pool's functions.
+ * Passing any other pointer gives undefined results.
+ */
+size_t GetInternedStringLength(const char* pszInterned);
+
+/**
+ * @brief Gets the number of distinct strings in the pool.
+ * @returns The number of strings, or zero if pPool is NULL.
+ */
+int GetInternPoolCount(const INTERN_POOL* pPool);
+
+/**
+ * @brief Interns a string: returns the pool's canonical copy of it, adding
+ * a copy if the pool has none yet.
+ * @param pPool Pool to intern the string in.  Required.
+ * @param pszString String to intern.  Required.
+ * @returns The canonical pointer, which is null-terminated; NULL, with the
+ * last-error record set, if an argument is invalid or memory could not be
+ * allocated.
+ * @remarks In a case-folding pool, the canonical copy is spelled the way
+ * the string was spelled the first time it was interned.
+ */
+const char* InternString(LPINTERN_POOL pPool, const char* pszString);
+
+/**
+ * @brief Interns the first nLength characters of a string.
+ * @param pPool Pool to intern the string in.  Required.
+ * @param pchString Characters to intern; need not be null-terminated, and
+ * may contain nulls.  May be NULL if nLength is zero.
+ * @param nLength Number of characters in pchString.
+ * @returns As for InternString.  The canonical copy is null-terminated.
+ */
+const char* InternStringN(LPINTERN_POOL pPool, const char* pchString,
+    size_t nLength);
+
+#endif /* __INTERN_POOL_H__ */
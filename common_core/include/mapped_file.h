@@ -0,0 +1,98 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// mapped_file.h - Text files mapped into memory and indexed by line, for loading configuration
+// and data files without reading them into a buffer and splitting that into copies of its lines
+//
+// MapFile maps a file read-only with mmap(2), then finds every newline in it in one pass of the
+// vector kernels selected for this CPU (see cpu_dispatch.h), recording where each one lies.  The
+// lines are then had by number, in constant time, as views of the mapped pages (see
+// string_view.h) that can be handed straight to FindIndexedString, AddBloomFilterKey and the
+// other functions that take views.  Nothing is copied: the index costs four bytes per line, and
+// the pages are the file's own, shared with every process that maps or reads the same file.
+//
+// A line is the text up to a newline, which the view leaves out, together with a carriage return
+// just before it; text after the last newline makes a last line.  Empty lines are kept, so that
+// line n is the one an editor numbers n + 1.  The views, and the contents, remain valid until the
+// file is released with FreeMappedFile.  The file must not be truncated or rewritten in place
+// meanwhile (replacing it by renaming another file over it is safe).
+//
+// A mapped file may be read by any number of threads at once.
+
+#ifndef __MAPPED_FILE_H__
+#define __MAPPED_FILE_H__
+
+#include "stdafx.h"
+#include "string_view.h"
+
+/**
+ * @brief Mapping flag: tell the kernel the file will be read from start to
+ * end (MADV_SEQUENTIAL), so that it reads ahead aggressively and drops pages
+ * soon after they have been read.
+ */
+#ifndef MAPPED_FILE_SEQUENTIAL
+#define MAPPED_FILE_SEQUENTIAL        0x1
+#endif //MAPPED_FILE_SEQUENTIAL
+
+/**
+ * @brief Mapping flag: read the whole file in while mapping it
+ * (MAP_POPULATE), so that indexing it, and reading its lines afterwards,
+ * never waits for the disk.
+ */
+#ifndef MAPPED_FILE_POPULATE
+#define MAPPED_FILE_POPULATE          0x2
+#endif //MAPPED_FILE_POPULATE
+
+/**
+ * @brief A file mapped into memory, with the index of its lines.  Opaque;
+ * create it with MapFile and release it with FreeMappedFile.
+ */
+typedef struct _MAPPED_FILE MAPPED_FILE, *LPMAPPED_FILE;
+
+/**
+ * @brief Unmaps a file, releases its line index and sets the pointer to
+ * NULL.  Views of its contents and lines are no longer valid afterwards.
+ * @param ppFile Address of the pointer to the file.  Nothing happens if it,
+ * or the pointer it points to, is NULL.
+ */
+void FreeMappedFile(LPMAPPED_FILE* ppFile);
+
+/**
+ * @brief Gets a view of the whole contents of a mapped file.
+ * @returns The view, which is empty, with a NULL pchData, if pFile is NULL
+ * or the file is empty.
+ * @remarks The contents are not null-terminated.
+ */
+STRING_VIEW GetMappedFileContents(const MAPPED_FILE* pFile);
+
+/**
+ * @brief Gets a view of one line of a mapped file, without its newline or
+ * a carriage return before that.
+ * @param pFile File whose line is wanted.
+ * @param nLine Number of the line, counting from zero.
+ * @returns The view; an empty view with a NULL pchData if pFile is NULL or
+ * nLine is not less than GetMappedFileLineCount.  An empty line gives an
+ * empty view with a pchData that is not NULL.
+ */
+STRING_VIEW GetMappedFileLine(const MAPPED_FILE* pFile, size_t nLine);
+
+/**
+ * @brief Gets the number of lines of a mapped file: the number of newlines,
+ * plus one if text follows the last of them.
+ * @returns The number of lines, or zero if pFile is NULL.
+ */
+size_t GetMappedFileLineCount(const MAPPED_FILE* pFile);
+
+/**
+ * @brief Maps a file read-only and indexes its lines.
+ * @param pszPath Path of the file.  Required.
+ * @param nFlags Zero, or MAPPED_FILE_* flags.
+ * @param ppFile Address of the pointer that receives the file.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL, the file cannot be opened or mapped (e.g., it is not a
+ * regular file), or memory could not be allocated.
+ * @remarks Indexing reads the whole file once.  Mapping a large file with
+ * MAPPED_FILE_POPULATE reads it in with fewer, larger requests than the page
+ * faults of the scan would make.
+ */
+int MapFile(const char* pszPath, int nFlags, LPMAPPED_FILE* ppFile);
+
+#endif /* __MAPPED_FILE_H__ */
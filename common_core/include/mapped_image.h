@@ -0,0 +1,46 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// mapped_image.h - Files holding built read-only structures (string indexes, prefix sets, Bloom
+// filters) that mmap(2) loads in place, for services that would otherwise rebuild them from text
+// every time they start
+//
+// Each structure can be saved to a file (SaveStringIndexFile, SavePrefixSetFile,
+// SaveBloomFilterFile) and mapped back (MapStringIndexFile, ...).  The file holds the structure's
+// arrays exactly as they lie in memory, behind a 64-byte header, and refers from one array to
+// another by offset, never by address, so mapping it needs no parsing, copying or fixing up: the
+// mapped structure reads the file's pages directly, and the pages fault in as lookups touch them.
+// Processes mapping the same file share its pages.
+//
+// The header carries a magic number, the format version, the kind of structure, a byte-order
+// mark and the size and checksum of the rest.  Mapping checks the header and the sizes, which
+// takes constant time; the checksum covers every byte, so it is checked only if asked for, when
+// mapping (MAPPED_IMAGE_VERIFY) or at any time afterwards (VerifyStringIndex, ...), e.g., from a
+// background thread once the service is up.  Lookups check every offset they follow against the
+// arrays, so that a damaged file gives wrong answers but is never read outside; map files that
+// may be damaged or come from elsewhere with MAPPED_IMAGE_VERIFY to be told of the damage.
+//
+// Files are written to a temporary name and renamed into place, so a process mapping a file
+// never sees it half-written.  They are in the byte order of the machine that wrote them, which
+// must also be the one that maps them.
+
+#ifndef __MAPPED_IMAGE_H__
+#define __MAPPED_IMAGE_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Mapping flag: verify the checksum of the whole file before
+ * returning, which reads every page of it.
+ */
+#ifndef MAPPED_IMAGE_VERIFY
+#define MAPPED_IMAGE_VERIFY           0x1
+#endif //MAPPED_IMAGE_VERIFY
+
+/**
+ * @brief Mapping flag: read the whole file in while mapping it
+ * (MAP_POPULATE), so that lookups never wait for the disk.
+ */
+#ifndef MAPPED_IMAGE_POPULATE
+#define MAPPED_IMAGE_POPULATE         0x2
+#endif //MAPPED_IMAGE_POPULATE
+
+#endif /* __MAPPED_IMAGE_H__ */
@@ -0,0 +1,128 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// prefix_set.h - Sets of prefixes compiled into a compact trie, for finding which of many
+// prefixes a string starts with in one pass over the string
+//
+// Calling StartsWith once for each of a few hundred prefixes (route tables, command tables, URL
+// filters) costs a few hundred comparisons per subject.  A PREFIX_SET is built once from the list
+// of prefixes and then answers "which is the longest prefix of this string" by walking the string
+// once, comparing each byte of it at most once.  A built set is read-only and may be shared by
+// any number of threads.  It can be saved to a file and mapped back in place, as mapped_image.h
+// describes.
+
+#ifndef __PREFIX_SET_H__
+#define __PREFIX_SET_H__
+
+#include "stdafx.h"
+#include "mapped_image.h"
+
+/**
+ * @brief Value returned by MatchPrefixSet when no prefix of the set matches.
+ */
+#ifndef PREFIX_SET_NO_MATCH
+#define PREFIX_SET_NO_MATCH           -1
+#endif //PREFIX_SET_NO_MATCH
+
+/**
+ * @brief A compiled set of prefixes.  Opaque; create it with
+ * CreatePrefixSet or MapPrefixSetFile, and release it with FreePrefixSet.
+ */
+typedef struct _PREFIX_SET PREFIX_SET, *LPPREFIX_SET;
+
+/**
+ * @brief Compiles a list of prefixes into a prefix set.
+ * @param ppszPrefixes Array of the prefixes.  Required unless nPrefixes is
+ * zero; none of the elements may be NULL.  The strings are copied, so they
+ * need not outlive the set.
+ * @param nPrefixes Number of elements in ppszPrefixes.  Must not be negative.
+ * @param ppPrefixSet Address of the pointer that receives the new set.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated.
+ * @remarks The ID of each prefix is its index in ppszPrefixes.  If the same
+ * prefix appears more than once, the lowest index is reported.  The empty
+ * string is a valid prefix and matches every string.  The set is laid out in
+ * a single block of memory, breadth first, so that the first levels of the
+ * trie, which every lookup visits, share a few cache lines.
+ */
+int CreatePrefixSet(const char* const* ppszPrefixes, int nPrefixes,
+    LPPREFIX_SET* ppPrefixSet);
+
+/**
+ * @brief Releases a prefix set, unmapping its file if it was mapped, and
+ * sets the pointer to NULL.
+ * @param ppPrefixSet Address of the pointer to the set.  Nothing happens if
+ * it, or the pointer it points to, is NULL.
+ */
+void FreePrefixSet(LPPREFIX_SET* ppPrefixSet);
+
+/**
+ * @brief Gets the number of prefixes the set was created from.
+ * @returns The number of prefixes, or zero if pPrefixSet is NULL.
+ */
+int GetPrefixSetCount(const PREFIX_SET* pPrefixSet);
+
+/**
+ * @brief Maps a prefix set from a file that SavePrefixSetFile wrote.
+ * @param pszPath Path of the file.  Required.
+ * @param nFlags Zero, or MAPPED_IMAGE_* flags.
+ * @param ppPrefixSet Address of the pointer that receives the set.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL, the file cannot be opened or mapped, does not hold a
+ * prefix set, or fails the checksum with MAPPED_IMAGE_VERIFY, or memory
+ * could not be allocated.
+ * @remarks The set reads the file's pages in place until it is released.
+ * The file may be replaced meanwhile, as SavePrefixSetFile does, but must
+ * not be rewritten.
+ */
+int MapPrefixSetFile(const char* pszPath, int nFlags,
+    LPPREFIX_SET* ppPrefixSet);
+
+/**
+ * @brief Finds the longest prefix in the set that the specified string
+ * starts with.
+ * @param pPrefixSet Set to look in.  Required.
+ * @param pszString String to check.  May be NULL, which matches nothing.
+ * @returns The ID of the longest matching prefix, or PREFIX_SET_NO_MATCH if
+ * none matches or pPrefixSet is NULL (which also sets the last-error
+ * record).
+ * @remarks The string is read only as far as the deepest prefix that could
+ * still match, so the cost depends on the prefixes, not on the length of
+ * the string.  The comparison is case-sensitive.
+ */
+int MatchPrefixSet(const PREFIX_SET* pPrefixSet, const char* pszString);
+
+/**
+ * @brief Finds the longest prefix in the set that the first nLength
+ * characters of the specified string start with.
+ * @param pPrefixSet Set to look in.  Required.
+ * @param pchString Characters to check; need not be null-terminated.  May
+ * be NULL if nLength is zero.
+ * @param nLength Number of characters in pchString.
+ * @returns As for MatchPrefixSet.
+ */
+int MatchPrefixSetN(const PREFIX_SET* pPrefixSet, const char* pchString,
+    size_t nLength);
+
+/**
+ * @brief Saves a prefix set to a file, for MapPrefixSetFile.
+ * @param pPrefixSet Set to save.  Required; may itself be mapped.
+ * @param pszPath Path of the file, which is replaced if it exists.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL or the file cannot be written.
+ */
+int SavePrefixSetFile(const PREFIX_SET* pPrefixSet, const char* pszPath);
+
+/**
+ * @brief Checks the checksum of the file a mapped prefix set lies in.
+ * @param pPrefixSet Set to check.  Required.
+ * @returns OK if the file is intact or the set was built in memory; ERROR,
+ * with the last-error record set, if pPrefixSet is NULL or the file has
+ * been damaged.
+ * @remarks Reads every page of the file, so it may be called from a
+ * background thread once the set is in use.
+ */
+int VerifyPrefixSet(const PREFIX_SET* pPrefixSet);
+
+#endif /* __PREFIX_SET_H__ */
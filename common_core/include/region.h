@@ -0,0 +1,127 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// region.h - Regions: memory that the strings and arrays of one task are allocated from and that
+// is released all at once, for code that would otherwise free every result one by one
+//
+// A region hands out memory by moving a pointer through blocks it allocates as it fills up, each
+// larger than the one before.  Nothing allocated in a region is released on its own: FreeRegion
+// releases all of it, and ResetRegion all of it but the first block, in time that depends on the
+// number of blocks, never on the number of strings.  The functions of common_core.h that return
+// new strings have variants that allocate them in a region (SplitInRegion, JoinStringsInRegion,
+// PrependToInRegion and StringReplaceInRegion), so that, e.g., the tokens of a line need not be
+// counted or freed.
+//
+// MarkRegion records how far a region is filled and RollBackRegion returns it there, releasing
+// everything allocated since, for parsers that backtrack.  A region may also be created inside
+// another one, for work whose results are dropped sooner than the parent's: a child region is
+// released with its parent, or when its parent is reset or rolled back past its creation, if it
+// has not been freed before.
+//
+// A region is not thread-safe; each thread should use regions of its own.
+
+#ifndef __REGION_H__
+#define __REGION_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief A region.  Opaque; create it with CreateRegion and release it with
+ * FreeRegion.
+ */
+typedef struct _REGION REGION, *LPREGION;
+
+/**
+ * @brief A point a region can be rolled back to.  Treat it as opaque: fill
+ * it in with MarkRegion and pass it to RollBackRegion.  It holds no
+ * resources, so it may simply be abandoned.
+ */
+typedef struct _REGION_MARK {
+  void* pvBlock;                  /* block being filled */
+  void* pvNext;                   /* first free byte of it */
+  unsigned long long ullChildren; /* child regions created until then */
+} REGION_MARK, *LPREGION_MARK;
+
+/**
+ * @brief Allocates memory in a region.
+ * @param pRegion Region to allocate in.  Required.
+ * @param nSize Number of bytes to allocate.  Must be positive.
+ * @returns The memory, uninitialized and aligned as malloc aligns; NULL,
+ * with the last-error record set, if an argument is invalid or memory could
+ * not be allocated.
+ * @remarks The memory stays valid until the region is freed, reset or
+ * rolled back past the allocation.  Do not pass it to FreeBuffer.
+ */
+void* AllocateFromRegion(LPREGION pRegion, size_t nSize);
+
+/**
+ * @brief Copies the first nLength characters of a string into a region,
+ * and null-terminates the copy.
+ * @param pRegion Region to copy into.  Required.
+ * @param pchString Characters to copy; need not be null-terminated.  May be
+ * NULL if nLength is zero.
+ * @param nLength Number of characters to copy.
+ * @returns The copy; NULL, with the last-error record set, if an argument
+ * is invalid or memory could not be allocated.
+ */
+char* CopyToRegion(LPREGION pRegion, const char* pchString, size_t nLength);
+
+/**
+ * @brief Creates an empty region.
+ * @param pParent Region to create the new one inside, which then releases
+ * it when it is itself freed, reset or rolled back past this call.  NULL
+ * for a region that lives until FreeRegion is called on it.
+ * @param ppRegion Address of the pointer that receives the new region.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if ppRegion
+ * is NULL or memory could not be allocated.
+ * @remarks Creating a region takes one allocation, which includes its first
+ * block.
+ */
+int CreateRegion(LPREGION pParent, LPREGION* ppRegion);
+
+/**
+ * @brief Releases a region, everything allocated in it and every region
+ * created inside it, and sets the pointer to NULL.
+ * @param ppRegion Address of the pointer to the region.  Nothing happens if
+ * it, or the pointer it points to, is NULL.
+ */
+void FreeRegion(LPREGION* ppRegion);
+
+/**
+ * @brief Gets the number of bytes allocated in a region, alignment padding
+ * included, not counting what its child regions allocated.
+ * @returns The number of bytes, or zero if pRegion is NULL.
+ */
+size_t GetRegionSize(const REGION* pRegion);
+
+/**
+ * @brief Records how far a region is filled, so that it can be rolled back
+ * there.
+ * @param pRegion Region to mark.  Required.
+ * @param pMark Address of the mark to fill in.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL.
+ */
+int MarkRegion(const REGION* pRegion, LPREGION_MARK pMark);
+
+/**
+ * @brief Releases everything allocated in a region and every region created
+ * inside it, keeping the region, and its first block, for reuse.
+ * @param pRegion Region to reset.  Nothing happens if it is NULL.
+ * @remarks Marks of the region are no longer valid afterwards.
+ */
+void ResetRegion(LPREGION pRegion);
+
+/**
+ * @brief Returns a region to a mark, releasing everything allocated in it
+ * since the mark was made, and every region created inside it since.
+ * @param pRegion Region to roll back.  Required.
+ * @param pMark A mark MarkRegion filled in for this region.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL.
+ * @remarks The mark stays valid, so a parser can roll back to it again.
+ * Marks made after it, and marks of a region reset since, are no longer
+ * valid, and rolling back to them gives undefined results.
+ */
+int RollBackRegion(LPREGION pRegion, const REGION_MARK* pMark);
+
+#endif /* __REGION_H__ */
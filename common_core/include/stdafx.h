@@ -11,14 +11,25 @@
 #define _GNU_SOURCE
 
 #include <stdlib.h>
+#include <stddef.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
 #include <wordexp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <limits.h>
+#include <math.h>
 
 #include <../../api_core/api_core/include/api_core.h>
 #include <../../exceptions_core/exceptions_core/include/exceptions_core.h>
@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_hash.h - Fast 64-bit non-cryptographic hashing of strings and byte ranges
+//
+// The hash is of the wyhash family: 64 x 64 -> 128-bit multiplications over 48-byte stripes,
+// with overlapping reads for the tail, so short keys cost a handful of instructions and long
+// ones hash at several bytes per cycle.  It passes avalanche and collision checks (see the
+// verify mode of common_core_bench), but it is not a cryptographic hash: do not use it where an
+// attacker chooses the keys and could profit from collisions, unless the seed is secret.
+//
+// Hashes depend only on the bytes, their number and the seed, so they are the same on every
+// run, thread and (little-endian) machine, and may be stored.  The streaming functions give the
+// same hash as the one-shot functions for the same bytes, however they are split up.  The
+// case-insensitive forms fold ASCII letters only, so that they do not depend on the locale:
+// HashBytesNoCase(s, n) equals HashBytes of s with 'A'-'Z' replaced by 'a'-'z'.
+
+#ifndef __STRING_HASH_H__
+#define __STRING_HASH_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Seed used by the functions that do not take one.
+ */
+#ifndef STRING_HASH_DEFAULT_SEED
+#define STRING_HASH_DEFAULT_SEED      0
+#endif //STRING_HASH_DEFAULT_SEED
+
+/**
+ * @brief State of a hash computed piece by piece.  Treat it as opaque: set
+ * it up with BeginStringHash, feed it with UpdateStringHash and read the
+ * hash with EndStringHash.  It holds no resources, so it may simply be
+ * abandoned.
+ */
+typedef struct _STRING_HASH_STATE {
+  uint64_t ullSeed;               /* as passed to BeginStringHash */
+  uint64_t ullLanes[3];           /* state of the 48-byte stripe loop */
+  uint64_t ullLength;             /* bytes hashed so far */
+  size_t nPending;                /* bytes in buffer not yet hashed */
+  unsigned char buffer[64];       /* last 16 bytes hashed, then pending */
+} STRING_HASH_STATE, *LPSTRING_HASH_STATE;
+
+/**
+ * @brief Starts a hash computed piece by piece.
+ * @param pState State to set up.  Required.
+ * @param ullSeed Seed; the finished hash equals HashBytesSeeded of the same
+ * bytes with this seed.
+ */
+void BeginStringHash(LPSTRING_HASH_STATE pState, uint64_t ullSeed);
+
+/**
+ * @brief Finishes a hash computed piece by piece.
+ * @param pState State fed so far.  Required.  It is not changed, so more
+ * bytes may be fed afterwards to hash a longer input.
+ * @returns The hash of every byte fed since BeginStringHash.
+ */
+uint64_t EndStringHash(const STRING_HASH_STATE* pState);
+
+/**
+ * @brief Hashes a range of bytes with the default seed.
+ * @param pvData Bytes to hash.  May be NULL if nLength is zero.
+ * @param nLength Number of bytes.
+ * @returns The hash; zero, with the last-error record set, if pvData is
+ * NULL and nLength is not zero.
+ */
+uint64_t HashBytes(const void* pvData, size_t nLength);
+
+/**
+ * @brief Hashes a range of bytes, folding ASCII letters to lowercase first.
+ * @returns As for HashBytes.
+ */
+uint64_t HashBytesNoCase(const void* pvData, size_t nLength);
+
+/**
+ * @brief Hashes a range of bytes, folding ASCII letters to lowercase
+ * first, with the seed specified.
+ * @returns As for HashBytes.
+ */
+uint64_t HashBytesNoCaseSeeded(const void* pvData, size_t nLength,
+    uint64_t ullSeed);
+
+/**
+ * @brief Hashes a range of bytes with the seed specified.
+ * @param pvData Bytes to hash.  May be NULL if nLength is zero.
+ * @param nLength Number of bytes.
+ * @param ullSeed Seed.  Different seeds give unrelated hashes, e.g., for
+ * tables whose layout should differ from run to run.
+ * @returns As for HashBytes.
+ */
+uint64_t HashBytesSeeded(const void* pvData, size_t nLength,
+    uint64_t ullSeed);
+
+/**
+ * @brief Hashes a null-terminated string, without its terminator, with the
+ * default seed.
+ * @param pszString String to hash.  NULL hashes as the empty string.
+ */
+uint64_t HashString(const char* pszString);
+
+/**
+ * @brief Hashes a null-terminated string, folding ASCII letters to
+ * lowercase first, with the default seed.
+ * @param pszString String to hash.  NULL hashes as the empty string.
+ * @remarks Strings that EqualsNoCase considers equal hash the same, as long
+ * as they differ only in ASCII letters.
+ */
+uint64_t HashStringNoCase(const char* pszString);
+
+/**
+ * @brief Feeds bytes to a hash computed piece by piece.
+ * @param pState State set up by BeginStringHash.  Required.
+ * @param pvData Bytes to feed.  May be NULL if nLength is zero.
+ * @param nLength Number of bytes.
+ */
+void UpdateStringHash(LPSTRING_HASH_STATE pState, const void* pvData,
+    size_t nLength);
+
+/**
+ * @brief Feeds bytes to a hash computed piece by piece, folding ASCII
+ * letters to lowercase first.
+ * @remarks Pieces fed this way and with UpdateStringHash may be mixed.
+ */
+void UpdateStringHashNoCase(LPSTRING_HASH_STATE pState, const void* pvData,
+    size_t nLength);
+
+#endif /* __STRING_HASH_H__ */
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_index.h - Read-only sorted string lists, prefix-compressed, for looking strings up in
+// large static lists (allow and deny lists loaded from files, word lists, ...)
+//
+// A STRING_INDEX is built once from an array of strings, such as the result of Split, and holds
+// them sorted, without duplicates, in blocks of STRING_INDEX_BLOCK_SIZE.  Within a block, each
+// string is stored as the length of the prefix it shares with the one before it followed by the
+// rest of its characters (front coding), so lists of paths, host names or identifiers, which
+// share long prefixes, take a fraction of their size.  The first string of each block (its head)
+// is kept whole, with the sixteen characters that follow the prefix all strings share in a node of
+// a binary search tree laid out breadth first (the Eytzinger layout): the nodes a search visits
+// first share cache lines, and the ones it may visit next are prefetched while it compares.  A
+// lookup searches the heads, then decodes a single block.
+//
+// Strings are identified by rank, their position in sorted (strcmp) order, so that a range of
+// strings, such as those starting with a prefix, is a range of ranks.  A built index is read-only
+// and may be shared by any number of threads.  It can be saved to a file and mapped back in
+// place, as mapped_image.h describes, so that a service need not sort its lists each time it
+// starts.
+
+#ifndef __STRING_INDEX_H__
+#define __STRING_INDEX_H__
+
+#include "stdafx.h"
+#include "string_view.h"
+#include "mapped_image.h"
+
+/**
+ * @brief Number of strings per front-coded block.  Larger blocks compress
+ * better; smaller ones decode faster.
+ */
+#ifndef STRING_INDEX_BLOCK_SIZE
+#define STRING_INDEX_BLOCK_SIZE       16
+#endif //STRING_INDEX_BLOCK_SIZE
+
+/**
+ * @brief Value returned by FindIndexedString when the index does not have
+ * the string.
+ */
+#ifndef STRING_INDEX_NOT_FOUND
+#define STRING_INDEX_NOT_FOUND        -1
+#endif //STRING_INDEX_NOT_FOUND
+
+/**
+ * @brief A sorted, prefix-compressed list of strings.  Opaque; create it
+ * with CreateStringIndex or MapStringIndexFile, and release it with
+ * FreeStringIndex.
+ */
+typedef struct _STRING_INDEX STRING_INDEX, *LPSTRING_INDEX;
+
+/**
+ * @brief Builds an index of a list of strings.
+ * @param ppszStrings Array of the strings, in any order; the result of Split
+ * will do.  Required unless nCount is zero; none of the elements may be
+ * NULL.  The strings are copied, so they need not outlive the index.
+ * @param nCount Number of elements in ppszStrings.  Must not be negative.
+ * @param ppIndex Address of the pointer that receives the new index.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid, the strings total more than 4 GB once compressed, or
+ * memory could not be allocated.
+ * @remarks Duplicates are stored once, so the index may have fewer strings
+ * than the array.  The index is laid out in a single block of memory.
+ */
+int CreateStringIndex(char* const* ppszStrings, int nCount,
+    LPSTRING_INDEX* ppIndex);
+
+/**
+ * @brief Finds the strings of an index that start with a prefix.
+ * @param pIndex Index to look in.  Required.
+ * @param prefix Prefix to look for.  The empty prefix matches every string.
+ * @param pnCount Address of an int that receives the number of strings that
+ * start with the prefix.  Required.
+ * @returns The rank of the first string that starts with the prefix; if
+ * there is none, the rank the prefix would have.  STRING_INDEX_NOT_FOUND,
+ * with the last-error record set, if an argument is NULL.
+ * @remarks The strings found are those of ranks from the value returned to
+ * the value returned plus *pnCount, minus one.
+ */
+int FindIndexedPrefix(const STRING_INDEX* pIndex, STRING_VIEW prefix,
+    int* pnCount);
+
+/**
+ * @brief Looks a string up in an index.
+ * @param pIndex Index to look in.  Required.
+ * @param key String to look up.
+ * @returns The string's rank, or STRING_INDEX_NOT_FOUND if the index does
+ * not have it or pIndex is NULL (which also sets the last-error record).
+ */
+int FindIndexedString(const STRING_INDEX* pIndex, STRING_VIEW key);
+
+/**
+ * @brief Releases an index, unmapping its file if it was mapped, and sets
+ * the pointer to NULL.
+ * @param ppIndex Address of the pointer to the index.  Nothing happens if
+ * it, or the pointer it points to, is NULL.
+ */
+void FreeStringIndex(LPSTRING_INDEX* ppIndex);
+
+/**
+ * @brief Copies the string of a given rank out of an index.
+ * @param pIndex Index to read.  Required.
+ * @param nRank Rank of the string, from zero to the index's count minus one.
+ * @param pszBuffer Buffer that receives the string, null-terminated, and
+ * truncated if need be, as snprintf(3) would.  May be NULL if nSize is zero.
+ * @param nSize Size of the buffer, in bytes.
+ * @returns The length of the string, which is the size the buffer must
+ * exceed for the string not to be truncated; -1, with the last-error record
+ * set, if pIndex is NULL, nRank is out of range or the string's block is
+ * damaged (see mapped_image.h).
+ */
+int GetIndexedString(const STRING_INDEX* pIndex, int nRank, char* pszBuffer,
+    size_t nSize);
+
+/**
+ * @brief Gets the number of strings of an index that sort before a key.
+ * @param pIndex Index to look in.  Required.
+ * @param key String to rank.  Need not be in the index.
+ * @returns The number of strings that strcmp(3) orders before the key,
+ * which is the key's rank if the index has it; -1, with the last-error
+ * record set, if pIndex is NULL.
+ * @remarks The strings from a to b, b excluded, are those of ranks from
+ * GetIndexedStringRank(a) to GetIndexedStringRank(b), minus one.
+ */
+int GetIndexedStringRank(const STRING_INDEX* pIndex, STRING_VIEW key);
+
+/**
+ * @brief Gets the number of strings in an index.
+ * @returns The number of strings, or zero if pIndex is NULL.
+ */
+int GetStringIndexCount(const STRING_INDEX* pIndex);
+
+/**
+ * @brief Maps an index from a file that SaveStringIndexFile wrote.
+ * @param pszPath Path of the file.  Required.
+ * @param nFlags Zero, or MAPPED_IMAGE_* flags.
+ * @param ppIndex Address of the pointer that receives the index.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL, the file cannot be opened or mapped, does not hold an
+ * index saved by a build with the same STRING_INDEX_BLOCK_SIZE, or fails
+ * the checksum with MAPPED_IMAGE_VERIFY, or memory could not be allocated.
+ * @remarks The index reads the file's pages in place until it is released.
+ * The file may be replaced meanwhile, as SaveStringIndexFile does, but must
+ * not be rewritten.
+ */
+int MapStringIndexFile(const char* pszPath, int nFlags,
+    LPSTRING_INDEX* ppIndex);
+
+/**
+ * @brief Saves an index to a file, for MapStringIndexFile.
+ * @param pIndex Index to save.  Required; may itself be mapped.
+ * @param pszPath Path of the file, which is replaced if it exists.
+ * Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is NULL or the file cannot be written.
+ */
+int SaveStringIndexFile(const STRING_INDEX* pIndex, const char* pszPath);
+
+/**
+ * @brief Checks the checksum of the file a mapped index lies in.
+ * @param pIndex Index to check.  Required.
+ * @returns OK if the file is intact or the index was built in memory;
+ * ERROR, with the last-error record set, if pIndex is NULL or the file has
+ * been damaged.
+ * @remarks Reads every page of the file, so it may be called from a
+ * background thread once the index is in use.
+ */
+int VerifyStringIndex(const STRING_INDEX* pIndex);
+
+#endif /* __STRING_INDEX_H__ */
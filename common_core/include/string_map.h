@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_map.h - Hash maps keyed by strings, for counting and grouping tokens (word counts,
+// field cardinality, ...)
+//
+// The map is an open-addressing table in the style of Swiss tables: beside each slot is a byte
+// holding seven bits of the key's hash, and a lookup compares sixteen of those bytes at once
+// (with SSE2 where available), so it reads the key itself, as a rule, only when it has found
+// it.  Keys are copied into blocks owned by the map, and looked up by view, so counting the
+// tokens of a line needs no temporary strings.
+//
+// Each key has a value of a fixed size, chosen when the map is created: a counter, a pointer,
+// a small struct.  Values start out zero-filled, are aligned to 8 bytes, and stay where they
+// are, as the keys do, until their key is removed or the map is cleared or freed.  A map
+// created with bFoldCase set treats keys as EqualsNoCase compares them.
+//
+// A map may be read by any number of threads at once, but only while no thread modifies it.
+
+#ifndef __STRING_MAP_H__
+#define __STRING_MAP_H__
+
+#include "stdafx.h"
+#include "string_view.h"
+
+/**
+ * @brief A hash map keyed by strings.  Opaque; create it with
+ * CreateStringMap and release it with FreeStringMap.
+ */
+typedef struct _STRING_MAP STRING_MAP, *LPSTRING_MAP;
+
+/**
+ * @brief Removes every key from a map.  The map keeps the memory it has, so
+ * that it can be refilled without allocating; values and keys it gave out
+ * become invalid.
+ * @param pMap Map to clear.  Nothing happens if it is NULL.
+ */
+void ClearStringMap(LPSTRING_MAP pMap);
+
+/**
+ * @brief Creates an empty map.
+ * @param bFoldCase TRUE to compare keys as EqualsNoCase does; FALSE to
+ * compare them as Equals does.
+ * @param nValueSize Size, in bytes, of the value of each key; may be zero,
+ * for a set of strings.
+ * @param ppMap Address of the pointer that receives the new map.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if ppMap
+ * is NULL or memory could not be allocated.
+ * @remarks A case-folding map folds case with tolower(3) as it behaves in
+ * the locale in effect when the map is created.
+ */
+int CreateStringMap(BOOL bFoldCase, size_t nValueSize, LPSTRING_MAP* ppMap);
+
+/**
+ * @brief Looks up a key, without adding it.
+ * @param pMap Map to look in.  Required.
+ * @param key Key to look up.
+ * @returns The key's value, or NULL if the map does not have the key or
+ * pMap is NULL (which also sets the last-error record).
+ */
+void* FindStringMapValue(const STRING_MAP* pMap, STRING_VIEW key);
+
+/**
+ * @brief Releases a map, with its keys and values, and sets the pointer to
+ * NULL.
+ * @param ppMap Address of the pointer to the map.  Nothing happens if it,
+ * or the pointer it points to, is NULL.
+ */
+void FreeStringMap(LPSTRING_MAP* ppMap);
+
+/**
+ * @brief Gets the number of keys in a map.
+ * @returns The number of keys, or zero if pMap is NULL.
+ */
+size_t GetStringMapCount(const STRING_MAP* pMap);
+
+/**
+ * @brief Looks up a key, adding it with a zero-filled value if the map does
+ * not have it yet.
+ * @param pMap Map to look in.  Required.
+ * @param key Key to look up.  Its characters are copied if it is added.
+ * @param pbAdded Address of a BOOL set to TRUE if the key was added, and to
+ * FALSE if the map already had it.  May be NULL.
+ * @returns The key's value; NULL, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated.
+ * @remarks In a case-folding map, a key keeps the spelling it was added
+ * with.  Counting words is ++*(long*) InsertStringMapKey(pMap, word, NULL),
+ * after checking for NULL.
+ */
+void* InsertStringMapKey(LPSTRING_MAP pMap, STRING_VIEW key, BOOL* pbAdded);
+
+/**
+ * @brief Steps through the keys of a map, in no particular order.
+ * @param pMap Map to step through.
+ * @param pnCursor Address of the position reached; set it to zero before the
+ * first call.  Required.
+ * @param pKey Address of a view that receives the next key; its characters
+ * are null-terminated.  May be NULL.
+ * @param ppvValue Address of the pointer that receives the key's value.  May
+ * be NULL.
+ * @returns TRUE if a key was returned; FALSE once every key has been, or if
+ * pMap or pnCursor is NULL.
+ * @remarks The map must not be modified while it is stepped through, except
+ * through the values.
+ */
+BOOL NextStringMapEntry(const STRING_MAP* pMap, size_t* pnCursor,
+    LPSTRING_VIEW pKey, void** ppvValue);
+
+/**
+ * @brief Removes a key, and its value, from a map.
+ * @param pMap Map to remove the key from.  Required.
+ * @param key Key to remove.
+ * @returns TRUE if the key was removed; FALSE if the map did not have it or
+ * pMap is NULL (which also sets the last-error record).
+ * @remarks The memory of a removed key is reused only after the map is
+ * cleared.
+ */
+BOOL RemoveStringMapKey(LPSTRING_MAP pMap, STRING_VIEW key);
+
+#endif /* __STRING_MAP_H__ */
@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_set.h - Set operations (union, intersection, difference, deduplication) on string
+// arrays, such as the token lists Split returns
+//
+// Each operation hashes the strings into a table of their positions, so it runs in expected time
+// linear in the number of strings, where comparing every string of one array with every string of
+// the other takes quadratic time and sorting both n log n.  The strings are not copied into the
+// table, and nothing is allocated per string: the result is built in a single block holding both
+// the array and the strings, which one FreeBuffer call releases.  A result is itself a string
+// array, so results can be fed to further operations.
+//
+// Results keep the order in which their strings first appear in the inputs, left array first,
+// and, with bFoldCase set, the spelling of that first appearance.  Strings are compared as Equals
+// compares them or, with bFoldCase set, as EqualsNoCase does.
+
+#ifndef __STRING_SET_H__
+#define __STRING_SET_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Gets the strings of one array that are also in another.
+ * @param ppszLeft Array whose strings are kept if ppszRight has them.  May
+ * be NULL if nLeft is zero.  None of its elements may be NULL.
+ * @param nLeft Number of elements in ppszLeft.
+ * @param ppszRight Array of the strings to keep.  May be NULL if nRight is
+ * zero.  None of its elements may be NULL.
+ * @param nRight Number of elements in ppszRight.
+ * @param bFoldCase TRUE to compare strings as EqualsNoCase does; FALSE to
+ * compare them as Equals does.
+ * @param pppszResult Address of the pointer that receives the result, a
+ * single block holding the array, which is null-terminated, and its strings.
+ * Release it with FreeBuffer, not FreeStringArray.  Receives NULL if the
+ * result is empty.  Required.
+ * @param pnResultCount Address of an int that receives the number of strings
+ * in the result.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid, the arrays hold more than INT_MAX strings between
+ * them, or memory could not be allocated.
+ * @remarks The result has each string once, however many times the inputs
+ * have it.
+ */
+int IntersectStrings(char* const* ppszLeft, int nLeft,
+    char* const* ppszRight, int nRight, BOOL bFoldCase, char*** pppszResult,
+    int* pnResultCount);
+
+/**
+ * @brief Gets the strings of one array that are not in another.
+ * @param ppszLeft Array whose strings are kept unless ppszRight has them.
+ * @param nLeft Number of elements in ppszLeft.
+ * @param ppszRight Array of the strings to drop.
+ * @param nRight Number of elements in ppszRight.
+ * @param bFoldCase As for IntersectStrings.
+ * @param pppszResult As for IntersectStrings.
+ * @param pnResultCount As for IntersectStrings.
+ * @returns As for IntersectStrings.
+ */
+int SubtractStrings(char* const* ppszLeft, int nLeft,
+    char* const* ppszRight, int nRight, BOOL bFoldCase, char*** pppszResult,
+    int* pnResultCount);
+
+/**
+ * @brief Gets the strings that are in either of two arrays.
+ * @param ppszLeft First array.
+ * @param nLeft Number of elements in ppszLeft.
+ * @param ppszRight Second array.
+ * @param nRight Number of elements in ppszRight.
+ * @param bFoldCase As for IntersectStrings.
+ * @param pppszResult As for IntersectStrings.
+ * @param pnResultCount As for IntersectStrings.
+ * @returns As for IntersectStrings.
+ */
+int UnionStrings(char* const* ppszLeft, int nLeft, char* const* ppszRight,
+    int nRight, BOOL bFoldCase, char*** pppszResult, int* pnResultCount);
+
+/**
+ * @brief Gets the strings of an array without their duplicates, in the
+ * order of their first appearance.
+ * @param ppszStrings Array to deduplicate.  May be NULL if nCount is zero.
+ * None of its elements may be NULL.
+ * @param nCount Number of elements in ppszStrings.
+ * @param bFoldCase As for IntersectStrings.
+ * @param pppszResult As for IntersectStrings.
+ * @param pnResultCount As for IntersectStrings.
+ * @returns As for IntersectStrings.
+ * @remarks The input is left as it is; SortUniqueStrings deduplicates an
+ * array in place, in sorted order.
+ */
+int UniqueStrings(char* const* ppszStrings, int nCount, BOOL bFoldCase,
+    char*** pppszResult, int* pnResultCount);
+
+#endif /* __STRING_SET_H__ */
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_sort.h - Sorting of string arrays, such as the results of Split and the lines of
+// GetSystemCommandOutput, faster than qsort(3) with strcmp(3)
+//
+// qsort compares whole strings, through a function pointer, O(n log n) times, and so reads a
+// prefix that many strings share (a timestamp, a directory) again at every comparison.  These
+// functions look at each string eight characters at a time instead, keeping the eight
+// characters being sorted on in an array next to the pointers: the unstable sort is a multikey
+// quicksort on them, the stable one an MSD radix sort.  Both go deeper into the strings only
+// where a group of them still agrees, so shared prefixes are read about once per string.
+//
+// The orders are those of strcmp(3) (bytes compared as unsigned char) and, with bFoldCase
+// set, strcasecmp(3) in the locale in effect at the time of the call.
+//
+// SortUniqueStrings also drops duplicates, for deduplicating millions of lines at a time.  It
+// cuts the array into runs, which threads sort in parallel, taking runs from each other as they
+// finish; then it merges the runs, also in parallel, each thread taking a range of values out of
+// every run and keeping the first of each set of equal strings it comes across.
+
+#ifndef __STRING_SORT_H__
+#define __STRING_SORT_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Sorts an array of strings in place.
+ * @param ppszStrings Array to sort.  May be NULL if nCount is zero.  None
+ * of its elements may be NULL.
+ * @param nCount Number of elements in the array.
+ * @param bFoldCase TRUE to sort as strcasecmp orders strings; FALSE to sort
+ * as strcmp does.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated, in which case the
+ * array is left as it was.
+ * @remarks Strings that compare equal end up in no particular order, which
+ * matters only with bFoldCase set, or when the pointers themselves matter.
+ * The call needs 16 bytes of scratch memory per string.
+ */
+int SortStrings(char** ppszStrings, int nCount, BOOL bFoldCase);
+
+/**
+ * @brief Sorts an array of strings in place, keeping strings that compare
+ * equal in the order they had.
+ * @param ppszStrings Array to sort.  May be NULL if nCount is zero.  None
+ * of its elements may be NULL.
+ * @param nCount Number of elements in the array.
+ * @param bFoldCase TRUE to sort as strcasecmp orders strings; FALSE to sort
+ * as strcmp does.
+ * @returns As for SortStrings.
+ * @remarks The call needs 32 bytes of scratch memory per string.
+ */
+int SortStringsStable(char** ppszStrings, int nCount, BOOL bFoldCase);
+
+/**
+ * @brief Sorts an array of strings in place and removes the duplicates,
+ * freeing them as FreeStringArray would.
+ * @param ppszStrings Array to sort.  May be NULL if nCount is zero.  Its
+ * elements must have been allocated with malloc, as those of the arrays
+ * Split returns are, and none of them may be NULL.
+ * @param nCount Number of elements in the array.
+ * @param bFoldCase TRUE to sort as strcasecmp orders strings, and to treat
+ * strings that differ only in case as duplicates; FALSE to sort as strcmp
+ * does.
+ * @param nThreads Number of threads to sort on, the calling one among them;
+ * zero for one per processor online.  Fewer are used for small arrays.
+ * @param pnUniqueCount Address of an int that receives the number of
+ * strings kept.  Required.
+ * @returns OK on success; ERROR, with the last-error record set, if an
+ * argument is invalid or memory could not be allocated, in which case the
+ * array is left as it was.
+ * @remarks Of each set of equal strings, the one that came first in the
+ * array is kept; the others are freed.  The strings kept fill the first
+ * *pnUniqueCount elements of the array, in order, and the rest are set to
+ * NULL, so FreeStringArray(&ppszStrings, nCount) still frees the array.
+ * The call needs 32 bytes of scratch memory per string.
+ */
+int SortUniqueStrings(char** ppszStrings, int nCount, BOOL bFoldCase,
+    int nThreads, int* pnUniqueCount);
+
+#endif /* __STRING_SORT_H__ */
@@ -0,0 +1,40 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// string_view.h - Views of strings: a pointer and a length, referring to characters owned by
+// someone else
+//
+// Functions that take views can look up a token in the middle of a line, or a key read from a
+// file, without copying it into a null-terminated string first.  A view's characters need not be
+// null-terminated and may contain nulls; the view is valid only as long as its characters are.
+
+#ifndef __STRING_VIEW_H__
+#define __STRING_VIEW_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief A view of nLength characters starting at pchData.  pchData may be
+ * NULL only if nLength is zero.
+ */
+typedef struct _STRING_VIEW {
+  const char* pchData;
+  size_t nLength;
+} STRING_VIEW, *LPSTRING_VIEW;
+
+/**
+ * @brief Makes a view of nLength characters starting at pchData.
+ */
+static inline STRING_VIEW MakeStringView(const char* pchData, size_t nLength) {
+  STRING_VIEW view = { pchData, nLength };
+  return view;
+}
+
+/**
+ * @brief Makes a view of a null-terminated string, without its terminator.
+ * @param pszString String to view.  NULL gives an empty view.
+ */
+static inline STRING_VIEW StringViewOf(const char* pszString) {
+  STRING_VIEW view = { pszString, pszString == NULL ? 0 : strlen(pszString) };
+  return view;
+}
+
+#endif /* __STRING_VIEW_H__ */
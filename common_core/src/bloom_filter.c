@@ -0,0 +1,629 @@
+// bloom_filter.c - Implementation of blocked Bloom filters of strings
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "bloom_filter.h"
+#include "core_alloc.h"
+#include "core_fold.h"
+#include "core_image.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* A block is a cache line of 64-bit words; a key sets one bit in each */
+#define BLOCK_WORDS             8
+#define BLOCK_SIZE              (BLOCK_WORDS * sizeof(uint64_t))
+
+/* Number of keys the batch functions hash, and prefetch the blocks of,
+ * before touching any block */
+#define BATCH_SIZE              16
+
+/* Saved filters: the magic, the version, the flags, the number of blocks
+ * and the number of keys, little-endian; then the folding table, if the
+ * filter folds case; then the blocks, a little-endian word at a time */
+#define SAVED_MAGIC             0x46424343U     /* "CCBF" */
+#define SAVED_VERSION           1
+#define SAVED_FOLD_CASE         0x1
+#define SAVED_HEADER_SIZE       24
+
+struct _BLOOM_FILTER {
+  uint64_t* pullBlocks;         /* aligned to BLOCK_SIZE */
+  uint32_t nBlocks;
+  int nCount;
+  BOOL bFoldCase;
+  CASE_FOLD fold;
+  IMAGE_MAPPING mapping;        /* the file the blocks lie in, if mapped */
+};
+
+/* The payload of a file holding a filter: this header, then the folding
+ * table, if the filter folds case, then the blocks, which stay on cache
+ * line boundaries once mapped */
+typedef struct _BLOOM_FILTER_IMAGE {
+  uint32_t nBlocks;
+  uint32_t nFlags;              /* SAVED_FOLD_CASE */
+  uint64_t ullCount;
+  uint64_t ullReserved[6];      /* zero */
+} BLOOM_FILTER_IMAGE;
+
+/* Odd multipliers that pick the bit of each word from the low half of the
+ * key's hash; the high half picks the block */
+static const uint32_t s_nSalts[BLOCK_WORDS] = { 0x47b6137bU, 0x44974d91U,
+    0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U,
+    0x5c6bfb31U };
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// HashKey function - Hashes a key, or its lowercase form if the filter folds
+// case.
+//
+
+static inline uint64_t HashKey(const BLOOM_FILTER* pFilter,
+    const char* pchKey, size_t nLength) {
+  return pFilter->bFoldCase ? HashFolded(&pFilter->fold, pchKey, nLength)
+      : HashBytes(pchKey, nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetBlock function - Gets the block a hash falls in, by scaling its high
+// half to the number of blocks.
+//
+
+static inline uint64_t* GetBlock(const BLOOM_FILTER* pFilter,
+    uint64_t ullHash) {
+  const uint64_t BLOCK = ((ullHash >> 32) * pFilter->nBlocks) >> 32;
+  return pFilter->pullBlocks + BLOCK * BLOCK_WORDS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetWordBit function - Gets the bit a hash sets in word w of its block.
+//
+
+static inline uint64_t GetWordBit(uint64_t ullHash, int w) {
+  return 1ULL << (((uint32_t) ullHash * s_nSalts[w]) >> 26);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetBlockBits function - Sets the bits of a hash in its block.
+//
+
+static inline void SetBlockBits(uint64_t* pullBlock, uint64_t ullHash) {
+  for (int w = 0; w < BLOCK_WORDS; w++) {
+    pullBlock[w] |= GetWordBit(ullHash, w);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AreBlockBitsSet function - Tells whether the bits of a hash are all set in
+// its block, testing them all, without branching.
+//
+
+static inline BOOL AreBlockBitsSet(const uint64_t* pullBlock,
+    uint64_t ullHash) {
+  uint64_t ullMissing = 0;
+  for (int w = 0; w < BLOCK_WORDS; w++) {
+    ullMissing |= ~pullBlock[w] & GetWordBit(ullHash, w);
+  }
+  return ullMissing == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AllocateFilter function - Allocates a filter of nBlocks zeroed blocks, in
+// a single block of memory, and sets its folding up.  Returns NULL if memory
+// ran out.
+//
+
+static LPBLOOM_FILTER AllocateFilter(uint32_t nBlocks, BOOL bFoldCase) {
+  const size_t SIZE = sizeof(BLOOM_FILTER) + BLOCK_SIZE
+      + (size_t) nBlocks * BLOCK_SIZE;
+  char* pBlock = (char*) CoreMalloc(SIZE, CORE_ALLOC_BLOOM_FILTER);
+  if (pBlock == NULL) {
+    return NULL;
+  }
+
+  /* The blocks start at the first cache line boundary after the header */
+  LPBLOOM_FILTER pFilter = (LPBLOOM_FILTER) pBlock;
+  memset(pFilter, 0, sizeof(BLOOM_FILTER));
+  pFilter->pullBlocks = (uint64_t*) (((uintptr_t) (pFilter + 1)
+      + BLOCK_SIZE - 1) & ~(uintptr_t) (BLOCK_SIZE - 1));
+  memset(pFilter->pullBlocks, 0, (size_t) nBlocks * BLOCK_SIZE);
+  pFilter->nBlocks = nBlocks;
+  pFilter->bFoldCase = bFoldCase;
+  if (bFoldCase) {
+    BuildCaseFold(&pFilter->fold);
+  }
+
+  return pFilter;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StoreLittleEndian function - Writes the low nSize bytes of a value, least
+// significant first.
+//
+
+static inline unsigned char* StoreLittleEndian(unsigned char* pb,
+    uint64_t ullValue, size_t nSize) {
+  for (size_t i = 0; i < nSize; i++) {
+    pb[i] = (unsigned char) (ullValue >> (8 * i));
+  }
+  return pb + nSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadLittleEndian function - Reads a value written by StoreLittleEndian.
+//
+
+static inline uint64_t LoadLittleEndian(const unsigned char* pb,
+    size_t nSize) {
+  uint64_t ullValue = 0;
+  for (size_t i = 0; i < nSize; i++) {
+    ullValue |= (uint64_t) pb[i] << (8 * i);
+  }
+  return ullValue;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// AddBloomFilterKey function
+
+int AddBloomFilterKey(LPBLOOM_FILTER pFilter, STRING_VIEW key) {
+  CORE_PROBE(CORE_FN_ADD_BLOOM_FILTER_KEY);
+
+  if (pFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "AddBloomFilterKey: pFilter");
+    return ERROR;
+  }
+
+  /* A mapped filter's blocks are the file's read-only pages */
+  if (pFilter->mapping.pvBase != NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "AddBloomFilterKey: pFilter is mapped from a file");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  const uint64_t HASH = HashKey(pFilter, key.pchData, key.nLength);
+  SetBlockBits(GetBlock(pFilter, HASH), HASH);
+  if (pFilter->nCount < INT_MAX) {
+    pFilter->nCount++;
+  }
+
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AddBloomFilterKeys function
+
+int AddBloomFilterKeys(LPBLOOM_FILTER pFilter, char* const* ppszKeys,
+    int nCount) {
+  CORE_PROBE(CORE_FN_ADD_BLOOM_FILTER_KEYS);
+
+  if (pFilter == NULL || (nCount > 0 && ppszKeys == NULL)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pFilter == NULL
+        ? "AddBloomFilterKeys: pFilter" : "AddBloomFilterKeys: ppszKeys");
+    return ERROR;
+  }
+
+  if (nCount < 0) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "AddBloomFilterKeys: nCount");
+    return ERROR;
+  }
+
+  /* A mapped filter's blocks are the file's read-only pages */
+  if (pFilter->mapping.pvBase != NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "AddBloomFilterKeys: pFilter is mapped from a file");
+    return ERROR;
+  }
+
+  for (int i = 0; i < nCount; i++) {
+    if (ppszKeys[i] == NULL) {
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+          "AddBloomFilterKeys: NULL element in ppszKeys");
+      return ERROR;
+    }
+  }
+
+  uint64_t ullHashes[BATCH_SIZE];
+  for (int nDone = 0; nDone < nCount; nDone += BATCH_SIZE) {
+    const int BATCH = nCount - nDone < BATCH_SIZE ? nCount - nDone
+        : BATCH_SIZE;
+    for (int i = 0; i < BATCH; i++) {
+      const size_t LENGTH = strlen(ppszKeys[nDone + i]);
+      CORE_PROBE_BYTES(LENGTH);
+      ullHashes[i] = HashKey(pFilter, ppszKeys[nDone + i], LENGTH);
+      __builtin_prefetch(GetBlock(pFilter, ullHashes[i]), 1);
+    }
+    for (int i = 0; i < BATCH; i++) {
+      SetBlockBits(GetBlock(pFilter, ullHashes[i]), ullHashes[i]);
+    }
+  }
+
+  pFilter->nCount = nCount > INT_MAX - pFilter->nCount ? INT_MAX
+      : pFilter->nCount + nCount;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateBloomFilter function
+
+int CreateBloomFilter(int nExpectedCount, int nBitsPerKey, BOOL bFoldCase,
+    LPBLOOM_FILTER* ppFilter) {
+  CORE_PROBE(CORE_FN_CREATE_BLOOM_FILTER);
+
+  if (ppFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "CreateBloomFilter: ppFilter");
+    return ERROR;
+  }
+  *ppFilter = NULL;
+
+  if (nExpectedCount < 0) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE,
+        "CreateBloomFilter: nExpectedCount");
+    return ERROR;
+  }
+
+  if (nBitsPerKey == 0) {
+    nBitsPerKey = BLOOM_FILTER_DEFAULT_BITS_PER_KEY;
+  }
+  if (nBitsPerKey < 1 || nBitsPerKey > 64) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE,
+        "CreateBloomFilter: nBitsPerKey");
+    return ERROR;
+  }
+
+  /* At most 2^31 keys of 64 bits each fill 2^28 blocks */
+  const uint64_t BITS = (uint64_t) nExpectedCount * nBitsPerKey;
+  const uint32_t BLOCKS = (uint32_t) ((BITS + 8 * BLOCK_SIZE - 1)
+      / (8 * BLOCK_SIZE));
+
+  LPBLOOM_FILTER pFilter = AllocateFilter(BLOCKS > 0 ? BLOCKS : 1, bFoldCase);
+  if (pFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateBloomFilter");
+    return ERROR;
+  }
+
+  *ppFilter = pFilter;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeBloomFilter function
+
+void FreeBloomFilter(LPBLOOM_FILTER* ppFilter) {
+  CORE_PROBE(CORE_FN_FREE_BLOOM_FILTER);
+
+  if (ppFilter == NULL || *ppFilter == NULL) {
+    return;
+  }
+
+  UnmapImageFile(&(*ppFilter)->mapping);
+  CoreFree(*ppFilter);
+  *ppFilter = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetBloomFilterCount function
+
+int GetBloomFilterCount(const BLOOM_FILTER* pFilter) {
+  return pFilter == NULL ? 0 : pFilter->nCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadBloomFilter function
+
+int LoadBloomFilter(const void* pvData, size_t nSize,
+    LPBLOOM_FILTER* ppFilter) {
+  CORE_PROBE(CORE_FN_LOAD_BLOOM_FILTER);
+
+  if (ppFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "LoadBloomFilter: ppFilter");
+    return ERROR;
+  }
+  *ppFilter = NULL;
+
+  if (pvData == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "LoadBloomFilter: pvData");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nSize);
+
+  /* The size must be exactly that of the filter the header describes */
+  const unsigned char* pb = (const unsigned char*) pvData;
+  const uint64_t FLAGS = nSize < SAVED_HEADER_SIZE ? 0
+      : LoadLittleEndian(pb + 8, 4);
+  const uint64_t BLOCKS = nSize < SAVED_HEADER_SIZE ? 0
+      : LoadLittleEndian(pb + 12, 4);
+  const uint64_t COUNT = nSize < SAVED_HEADER_SIZE ? 0
+      : LoadLittleEndian(pb + 16, 8);
+  const size_t FOLD_SIZE = (FLAGS & SAVED_FOLD_CASE) ? UCHAR_MAX + 1 : 0;
+  if (nSize < SAVED_HEADER_SIZE
+      || LoadLittleEndian(pb, 4) != SAVED_MAGIC
+      || LoadLittleEndian(pb + 4, 4) != SAVED_VERSION
+      || (FLAGS & ~(uint64_t) SAVED_FOLD_CASE) != 0 || BLOCKS == 0
+      || COUNT > INT_MAX || nSize - SAVED_HEADER_SIZE < FOLD_SIZE
+      || (nSize - SAVED_HEADER_SIZE - FOLD_SIZE) / BLOCK_SIZE != BLOCKS
+      || (nSize - SAVED_HEADER_SIZE - FOLD_SIZE) % BLOCK_SIZE != 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "LoadBloomFilter: pvData does not hold a saved filter");
+    return ERROR;
+  }
+
+  LPBLOOM_FILTER pFilter = AllocateFilter((uint32_t) BLOCKS,
+      FOLD_SIZE > 0);
+  if (pFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "LoadBloomFilter");
+    return ERROR;
+  }
+
+  pb += SAVED_HEADER_SIZE;
+  pFilter->nCount = (int) COUNT;
+
+  /* Fold as the filter folded where it was saved */
+  if (FOLD_SIZE > 0) {
+    pFilter->fold.bAsciiOnly = TRUE;
+    for (int i = 0; i <= UCHAR_MAX; i++) {
+      pFilter->fold.table[i] = pb[i];
+      if (pb[i] != (i >= 'A' && i <= 'Z' ? i + 'a' - 'A' : i)) {
+        pFilter->fold.bAsciiOnly = FALSE;
+      }
+    }
+    pb += FOLD_SIZE;
+  }
+
+  for (size_t i = 0; i < BLOCKS * BLOCK_WORDS; i++) {
+    pFilter->pullBlocks[i] = LoadLittleEndian(pb + 8 * i, 8);
+  }
+
+  *ppFilter = pFilter;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MapBloomFilterFile function
+
+int MapBloomFilterFile(const char* pszPath, int nFlags,
+    LPBLOOM_FILTER* ppFilter) {
+  CORE_PROBE(CORE_FN_MAP_BLOOM_FILTER_FILE);
+
+  if (pszPath == NULL || ppFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pszPath == NULL ? "MapBloomFilterFile: pszPath"
+            : "MapBloomFilterFile: ppFilter");
+    return ERROR;
+  }
+
+  *ppFilter = NULL;
+
+  IMAGE_MAPPING mapping;
+  if (MapImageFile(pszPath, IMAGE_KIND_BLOOM_FILTER, nFlags, &mapping,
+      "MapBloomFilterFile") != OK) {
+    return ERROR;
+  }
+
+  const BLOOM_FILTER_IMAGE* pImage = (const BLOOM_FILTER_IMAGE*)
+      mapping.pbPayload;
+  const size_t FOLD_SIZE = mapping.nPayloadSize < sizeof(BLOOM_FILTER_IMAGE)
+      || !(pImage->nFlags & SAVED_FOLD_CASE) ? 0 : UCHAR_MAX + 1;
+  if (mapping.nPayloadSize < sizeof(BLOOM_FILTER_IMAGE)
+      || (pImage->nFlags & ~(uint32_t) SAVED_FOLD_CASE) != 0
+      || pImage->nBlocks == 0 || pImage->ullCount > INT_MAX
+      || mapping.nPayloadSize != sizeof(BLOOM_FILTER_IMAGE) + FOLD_SIZE
+          + (uint64_t) pImage->nBlocks * BLOCK_SIZE) {
+    UnmapImageFile(&mapping);
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "MapBloomFilterFile: not a Bloom filter");
+    return ERROR;
+  }
+
+  LPBLOOM_FILTER pFilter = (LPBLOOM_FILTER) CoreMalloc(sizeof(BLOOM_FILTER),
+      CORE_ALLOC_BLOOM_FILTER);
+  if (pFilter == NULL) {
+    UnmapImageFile(&mapping);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "MapBloomFilterFile");
+    return ERROR;
+  }
+
+  /* Fold as the filter folded where it was saved */
+  const unsigned char* pbFold = mapping.pbPayload
+      + sizeof(BLOOM_FILTER_IMAGE);
+  memset(pFilter, 0, sizeof(BLOOM_FILTER));
+  pFilter->pullBlocks = (uint64_t*) (pbFold + FOLD_SIZE);
+  pFilter->nBlocks = pImage->nBlocks;
+  pFilter->nCount = (int) pImage->ullCount;
+  pFilter->bFoldCase = FOLD_SIZE > 0;
+  if (FOLD_SIZE > 0) {
+    pFilter->fold.bAsciiOnly = TRUE;
+    for (int i = 0; i <= UCHAR_MAX; i++) {
+      pFilter->fold.table[i] = pbFold[i];
+      if (pbFold[i] != (i >= 'A' && i <= 'Z' ? i + 'a' - 'A' : i)) {
+        pFilter->fold.bAsciiOnly = FALSE;
+      }
+    }
+  }
+  pFilter->mapping = mapping;
+
+  CORE_PROBE_BYTES(mapping.nMappingSize);
+
+  *ppFilter = pFilter;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SaveBloomFilter function
+
+int SaveBloomFilter(const BLOOM_FILTER* pFilter, void** ppvData,
+    size_t* pnSize) {
+  CORE_PROBE(CORE_FN_SAVE_BLOOM_FILTER);
+
+  if (pFilter == NULL || ppvData == NULL || pnSize == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pFilter == NULL
+        ? "SaveBloomFilter: pFilter" : ppvData == NULL
+            ? "SaveBloomFilter: ppvData" : "SaveBloomFilter: pnSize");
+    return ERROR;
+  }
+  *ppvData = NULL;
+  *pnSize = 0;
+
+  const size_t FOLD_SIZE = pFilter->bFoldCase ? UCHAR_MAX + 1 : 0;
+  const size_t SIZE = SAVED_HEADER_SIZE + FOLD_SIZE
+      + (size_t) pFilter->nBlocks * BLOCK_SIZE;
+  CORE_PROBE_BYTES(SIZE);
+
+  unsigned char* pbData = (unsigned char*) CoreMalloc(SIZE,
+      CORE_ALLOC_BLOOM_FILTER);
+  if (pbData == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "SaveBloomFilter");
+    return ERROR;
+  }
+
+  unsigned char* pb = StoreLittleEndian(pbData, SAVED_MAGIC, 4);
+  pb = StoreLittleEndian(pb, SAVED_VERSION, 4);
+  pb = StoreLittleEndian(pb, pFilter->bFoldCase ? SAVED_FOLD_CASE : 0, 4);
+  pb = StoreLittleEndian(pb, pFilter->nBlocks, 4);
+  pb = StoreLittleEndian(pb, (uint64_t) pFilter->nCount, 8);
+  if (FOLD_SIZE > 0) {
+    memcpy(pb, pFilter->fold.table, FOLD_SIZE);
+    pb += FOLD_SIZE;
+  }
+
+  for (size_t i = 0; i < (size_t) pFilter->nBlocks * BLOCK_WORDS; i++) {
+    pb = StoreLittleEndian(pb, pFilter->pullBlocks[i], 8);
+  }
+
+  *ppvData = pbData;
+  *pnSize = SIZE;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SaveBloomFilterFile function
+
+int SaveBloomFilterFile(const BLOOM_FILTER* pFilter, const char* pszPath) {
+  CORE_PROBE(CORE_FN_SAVE_BLOOM_FILTER_FILE);
+
+  if (pFilter == NULL || pszPath == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pFilter == NULL ? "SaveBloomFilterFile: pFilter"
+            : "SaveBloomFilterFile: pszPath");
+    return ERROR;
+  }
+
+  BLOOM_FILTER_IMAGE image;
+  memset(&image, 0, sizeof(image));
+  image.nBlocks = pFilter->nBlocks;
+  image.nFlags = pFilter->bFoldCase ? SAVED_FOLD_CASE : 0;
+  image.ullCount = (uint64_t) pFilter->nCount;
+
+  struct iovec pieces[3];
+  pieces[0].iov_base = &image;
+  pieces[0].iov_len = sizeof(image);
+  pieces[1].iov_base = (void*) pFilter->fold.table;
+  pieces[1].iov_len = pFilter->bFoldCase ? UCHAR_MAX + 1 : 0;
+  pieces[2].iov_base = pFilter->pullBlocks;
+  pieces[2].iov_len = (size_t) pFilter->nBlocks * BLOCK_SIZE;
+
+  CORE_PROBE_BYTES(sizeof(image) + pieces[1].iov_len + pieces[2].iov_len);
+
+  return WriteImageFile(pszPath, IMAGE_KIND_BLOOM_FILTER, pieces, 3,
+      "SaveBloomFilterFile");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TestBloomFilterKey function
+
+BOOL TestBloomFilterKey(const BLOOM_FILTER* pFilter, STRING_VIEW key) {
+  CORE_PROBE(CORE_FN_TEST_BLOOM_FILTER_KEY);
+
+  if (pFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "TestBloomFilterKey: pFilter");
+    return FALSE;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  const uint64_t HASH = HashKey(pFilter, key.pchData, key.nLength);
+  return AreBlockBitsSet(GetBlock(pFilter, HASH), HASH);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TestBloomFilterKeys function
+
+int TestBloomFilterKeys(const BLOOM_FILTER* pFilter, char* const* ppszKeys,
+    int nCount, BOOL* pbResults) {
+  CORE_PROBE(CORE_FN_TEST_BLOOM_FILTER_KEYS);
+
+  if (pFilter == NULL || (nCount > 0 && ppszKeys == NULL)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pFilter == NULL
+        ? "TestBloomFilterKeys: pFilter" : "TestBloomFilterKeys: ppszKeys");
+    return -1;
+  }
+
+  if (nCount < 0) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "TestBloomFilterKeys: nCount");
+    return -1;
+  }
+
+  for (int i = 0; i < nCount; i++) {
+    if (ppszKeys[i] == NULL) {
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+          "TestBloomFilterKeys: NULL element in ppszKeys");
+      return -1;
+    }
+  }
+
+  uint64_t ullHashes[BATCH_SIZE];
+  int nMaybe = 0;
+  for (int nDone = 0; nDone < nCount; nDone += BATCH_SIZE) {
+    const int BATCH = nCount - nDone < BATCH_SIZE ? nCount - nDone
+        : BATCH_SIZE;
+    for (int i = 0; i < BATCH; i++) {
+      const size_t LENGTH = strlen(ppszKeys[nDone + i]);
+      CORE_PROBE_BYTES(LENGTH);
+      ullHashes[i] = HashKey(pFilter, ppszKeys[nDone + i], LENGTH);
+      __builtin_prefetch(GetBlock(pFilter, ullHashes[i]));
+    }
+    for (int i = 0; i < BATCH; i++) {
+      const BOOL MAYBE = AreBlockBitsSet(GetBlock(pFilter, ullHashes[i]),
+          ullHashes[i]);
+      if (pbResults != NULL) {
+        pbResults[nDone + i] = MAYBE;
+      }
+      nMaybe += MAYBE;
+    }
+  }
+
+  return nMaybe;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// VerifyBloomFilter function
+
+int VerifyBloomFilter(const BLOOM_FILTER* pFilter) {
+  CORE_PROBE(CORE_FN_VERIFY_BLOOM_FILTER);
+
+  if (pFilter == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "VerifyBloomFilter: pFilter");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(pFilter->mapping.nPayloadSize);
+
+  if (!IsImageChecksumValid(&pFilter->mapping)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "VerifyBloomFilter: checksum mismatch");
+    return ERROR;
+  }
+
+  return OK;
+}
@@ -1,20 +1,351 @@
 // common_core.c - Implementations of commonly-used functions
 
+/* This file defines the exported versions of the functions that
+ * common_core_inline.h can inline, so it must not see the inline ones. */
+#undef COMMON_CORE_INLINE
+
 #include "stdafx.h"
 #include "common_core.h"
+#include "core_alloc.h"
+#include "core_kernels.h"
+#include "core_region.h"
+#include "core_stats_internal.h"
 
 ///////////////////////////////////////////////////////////////////////////////
 // Internal-use-only functions
 
+///////////////////////////////////////////////////////////////////////////////
+// RaiseError function - Records an error in the calling thread's last-error
+// record.  Under the legacy error model, also writes the message to stderr and
+// terminates the program with the exit code specified.  Returns ERROR so
+// callers can write 'return RaiseError(...);'.
+//
+
+static int RaiseError(int nCode, const char* pszMessage, int nExitCode) {
+  SetLastCoreError(nCode, pszMessage);
+
+#if COMMON_CORE_LEGACY_ERRORS
+  WriteDiagnostic(pszMessage);
+  exit(nExitCode);
+#endif //COMMON_CORE_LEGACY_ERRORS
+
+  return ERROR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RaiseOutOfRange function - Records an argument-out-of-range error in the
+// calling thread's last-error record.  Under the legacy error model, also
+// throws an ArgumentOutOfRangeException for the parameter named.
+//
+
+static int RaiseOutOfRange(const char* pszParamName) {
+  SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, pszParamName);
+
+#if COMMON_CORE_LEGACY_ERRORS
+  ThrowArgumentOutOfRangeException(pszParamName);
+#endif //COMMON_CORE_LEGACY_ERRORS
+
+  return ERROR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchesNoCase function - Compares nLength characters of two character
+// sequences, ignoring case the way strcasecmp(3) does.
+//
+
+static BOOL MatchesNoCase(const char* pchLeft, const char* pchRight,
+    size_t nLength) {
+  for (size_t i = 0; i < nLength; i++) {
+    if (pchLeft[i] != pchRight[i] && tolower((unsigned char) pchLeft[i])
+        != tolower((unsigned char) pchRight[i])) {
+      return FALSE;
+    }
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WipeBytes function - Zeroes a range of bytes in a way the compiler may not
+// optimize away, as explicit_bzero(3) does: the barrier tells it the bytes
+// are read afterwards, even when the buffer is about to be freed or go out
+// of scope.  memset stores as wide as the processor allows.
+//
+
+static inline void WipeBytes(void* pvBuffer, size_t nSize) {
+  memset(pvBuffer, 0, nSize);
+  __asm__ __volatile__("" : : "r" (pvBuffer) : "memory");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GrowTokenArray function - Gives the array of tokens Split is filling room
+// for nCapacity of them, keeping the nCount it holds.  Returns the array,
+// which may have moved, or NULL if memory could not be allocated, in which
+// case the old array is left as it was.
+//
+
+static char** GrowTokenArray(LPREGION pRegion, char** ppszTokens, int nCount,
+    int nCapacity) {
+  if (pRegion == NULL) {
+    return (char**) CoreRealloc(ppszTokens, nCapacity * sizeof(char*),
+        CORE_ALLOC_SPLIT);
+  }
+
+  char** ppszGrown = (char**) AllocateRegionBytes(pRegion,
+      nCapacity * sizeof(char*), _Alignof(char*));
+  if (ppszGrown != NULL && nCount > 0) {
+    memcpy(ppszGrown, ppszTokens, nCount * sizeof(char*));
+  }
+  return ppszGrown;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseTokens function - Releases the tokens of a failed Split: frees them
+// and their array, or rolls the region they are in back to the mark.
+//
+
+static void ReleaseTokens(LPREGION pRegion, const REGION_MARK* pMark,
+    char*** pppszTokens, int nCount) {
+  if (pRegion != NULL) {
+    RollBackRegion(pRegion, pMark);
+  } else {
+    FreeStringArray(pppszTokens, nCount);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReplaceInto function - Does the work of StringReplace and
+// StringReplaceInRegion once the arguments are checked, allocating the result
+// in pRegion, or from the heap if it is NULL.  Returns OK, or ERROR if the
+// result could not be allocated.
+//
+
+static int ReplaceInto(LPREGION pRegion, const char* pszSrc,
+    const char* pszFindWhat, const char* pszReplaceWith, char** ppszResult) {
+  int nSrcLen = strlen(pszSrc);
+  int nFindWhatLen = strlen(pszFindWhat);
+  int nReplaceWithLen = strlen(pszReplaceWith);
+  const int DELTA = nReplaceWithLen - nFindWhatLen;
+
+  /* In order to determine the proper size for the result
+   buffer, count the occurrences of findWhat in pszSrc.
+   But, there is no need to bother if the DELTA is zero,
+   since this means the src and dest strings will be of
+   identical length. In this case, set nOccurrences to a
+   default value of zero. */
+  int nOccurrences = DELTA == 0
+      ? 0
+        :
+        GetSubstringOccurrenceCount(pszSrc, pszFindWhat);
+  if (nOccurrences < 0) {
+    return ERROR; // unknown error
+  }
+
+  /* Determine the appropriate size for the block of memory
+   * in which to store the result. */
+  const int BUFSIZE = DELTA == 0
+      ? nSrcLen
+        :
+        nSrcLen + nOccurrences * DELTA;
+
+  *ppszResult = pRegion != NULL
+      ? (char*) AllocateRegionBytes(pRegion, BUFSIZE + 1, 1)
+      : (char*) CoreMalloc((BUFSIZE + 1) * sizeof(char),
+          CORE_ALLOC_STRING_REPLACE);
+  if (*ppszResult == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY,
+        ERROR_FAILED_ALLOC_STRING_BUFFER);
+    return ERROR;
+  }
+  memset(*ppszResult, 0, BUFSIZE + 1);
+
+  int i = 0;
+  while (*pszSrc) {
+    // compare the substring with the result
+    if (strstr(pszSrc, pszFindWhat) == pszSrc) {
+      strcpy(&((*ppszResult)[i]), pszReplaceWith);
+      i += nReplaceWithLen;
+      pszSrc += nFindWhatLen;
+      //*ppszResult += nReplaceWithLen;
+    } else {
+      (*ppszResult)[i] = *pszSrc;
+      pszSrc++;
+      i++;
+    }
+  }
+
+  (*ppszResult)[i] = '\0';
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SplitInto function - Does the work of Split and SplitInRegion, allocating
+// the tokens and the array in pRegion, or from the heap if it is NULL.
+//
+
+static int SplitInto(LPREGION pRegion, char* pszStringToSplit,
+    int nStringToSplitSize, const char* pszDelimiters, char*** pppszStrings,
+    int* pnResultCount) {
+  if (IsNullOrWhiteSpace(pszStringToSplit)) {
+    return OK;  /* nothing to split */
+  }
+
+  if (pppszStrings == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "Split: pppszStrings");
+    return ERROR;
+  }
+
+  if (nStringToSplitSize <= 0) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "Split: nStringToSplitSize");
+    return ERROR;
+  }
+
+  if (pszDelimiters == NULL || pszDelimiters[0] == '\0') {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "Split: pszDelimiters");
+    return ERROR;
+  }
+
+  if (pnResultCount == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "Split: pnResultCount");
+    return ERROR;
+  }
+
+  const CORE_KERNELS* pKernels = GetCoreKernels();
+  const size_t DELIMITER_COUNT = strlen(pszDelimiters);
+
+  /* Work out where the trimmed string starts and ends, keeping
+   at most nStringToSplitSize characters of it.  No copy of the
+   string is made; the tokens are copied straight out of it. */
+  const size_t STRING_LENGTH = strlen(pszStringToSplit);
+  const size_t BEGIN = SpanSpace(pKernels, pszStringToSplit, STRING_LENGTH);
+  size_t nEnd = STRING_LENGTH - ReverseSpanSpace(pKernels,
+      pszStringToSplit + BEGIN, STRING_LENGTH - BEGIN);
+  if (nEnd - BEGIN > (size_t) nStringToSplitSize) {
+    nEnd = BEGIN + nStringToSplitSize;
+  }
+
+  /* Tokenize the same way strtok(3) does: a token is the "stuff
+   between the delimiters", and a run of several delimiters in a
+   row separates just two tokens, so no token is ever empty.  Each
+   token is copied into a dynamically-allocated string, the address
+   of which is stored in a dynamically-allocated array of strings
+   that doubles in size whenever it fills up.  In a region, the
+   array is copied when it grows, and a failed call releases what
+   it allocated by rolling the region back. */
+
+  *pnResultCount = 0; /* initialize result count to zero */
+  *pppszStrings = NULL; /* initialize result array to NULL */
+
+  REGION_MARK mark;
+  if (pRegion != NULL) {
+    MarkRegion(pRegion, &mark);
+  }
+
+  char** ppszResultArray = NULL;
+  int nReturnedElementCount = 0; /* how many tokens thus far */
+  int nCapacity = 0; /* how many the array can hold */
+
+  size_t nPosition = BEGIN;
+  for (;;) {
+    /* Skip the delimiters in front of the next token */
+    while (nPosition < nEnd && memchr(pszDelimiters,
+        pszStringToSplit[nPosition], DELIMITER_COUNT) != NULL) {
+      nPosition++;
+    }
+
+    if (nPosition == nEnd) {
+      break; /* done splitting */
+    }
+
+    /* The token runs up to the next delimiter, or to the end */
+    const size_t TOKEN_LENGTH = pKernels->pfnFindAnyOf(
+        pszStringToSplit + nPosition, nEnd - nPosition, pszDelimiters,
+        DELIMITER_COUNT);
+
+    char* pszNextResult = pRegion != NULL
+        ? (char*) AllocateRegionBytes(pRegion, TOKEN_LENGTH + 1, 1)
+        : (char*) CoreMalloc((TOKEN_LENGTH + 1) * sizeof(char),
+            CORE_ALLOC_SPLIT);
+    if (pszNextResult == NULL) {
+      ReleaseTokens(pRegion, &mark, &ppszResultArray, nReturnedElementCount);
+      return RaiseError(CORE_ERROR_OUT_OF_MEMORY,
+          ERROR_FAILED_ALLOC_STRING_BUFFER, EXIT_FAILURE);
+    }
+
+    memcpy(pszNextResult, pszStringToSplit + nPosition, TOKEN_LENGTH);
+    pszNextResult[TOKEN_LENGTH] = '\0';
+
+    /* grow the array of strings if it is full and then
+     initialize the element on the end with the address of
+     pszNextResult. */
+    if (nReturnedElementCount == nCapacity) {
+      const int GROWN_CAPACITY = nCapacity == 0 ? 8 : 2 * nCapacity;
+      char** ppszGrownArray = GrowTokenArray(pRegion, ppszResultArray,
+          nReturnedElementCount, GROWN_CAPACITY);
+      if (ppszGrownArray == NULL) {
+        if (pRegion == NULL) {
+          FreeBuffer((void**) &pszNextResult);
+        }
+        ReleaseTokens(pRegion, &mark, &ppszResultArray,
+            nReturnedElementCount);
+        return RaiseError(CORE_ERROR_OUT_OF_MEMORY,
+            ERROR_FAILED_ALLOC_ARRAY, EXIT_FAILURE);
+      }
+      ppszResultArray = ppszGrownArray;
+      nCapacity = GROWN_CAPACITY;
+    }
+    ppszResultArray[nReturnedElementCount] = pszNextResult;
+
+    /* Increment our counters, and then wash, rinse, repeat. */
+    nReturnedElementCount += 1;
+    nPosition += TOKEN_LENGTH;
+  }
+
+  /* Save the count of returned elements in the
+   variable at the address given by pnResultCount */
+  *pnResultCount = nReturnedElementCount;
+
+  /* Tell the caller where in the machine's memory
+   the first element of our array of token strings
+   is stored. */
+  *pppszStrings = ppszResultArray;
+
+  /* Done */
+  return OK;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Publicly-exposed functions
 
+///////////////////////////////////////////////////////////////////////////////
+// AllocateBuffer function - Allocates a buffer that FreeBuffer releases.
+//
+
+void* AllocateBuffer(size_t nSize) {
+  CORE_PROBE(CORE_FN_ALLOCATE_BUFFER);
+
+  if (nSize == 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "AllocateBuffer: nSize");
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(nSize);
+
+  void* pvBuffer = CoreMalloc(nSize, CORE_ALLOC_BUFFER);
+  if (pvBuffer == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "AllocateBuffer");
+  }
+  return pvBuffer;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Contains function - Checks whether one string contains another (case-
 // sensitive).
 //
 
 BOOL Contains(const char* pszString, const char* pszSubstring) {
+  CORE_PROBE(CORE_FN_CONTAINS);
+
   if (IsNullOrWhiteSpace(pszString)) {
     return FALSE;
   }
@@ -23,6 +354,8 @@ BOOL Contains(const char* pszString, const char* pszSubstring) {
     return FALSE;
   }
 
+  CORE_PROBE_BYTES(strlen(pszString));
+
   return strstr(pszString, pszSubstring) != NULL;
 }
 
@@ -31,6 +364,8 @@ BOOL Contains(const char* pszString, const char* pszSubstring) {
 //
 
 BOOL ContainsNoCase(const char* pszString, const char* pszSubstring) {
+  CORE_PROBE(CORE_FN_CONTAINS_NO_CASE);
+
   if (IsNullOrWhiteSpace(pszString)) {
     return FALSE;
   }
@@ -39,29 +374,116 @@ BOOL ContainsNoCase(const char* pszString, const char* pszSubstring) {
     return FALSE;
   }
 
+  CORE_PROBE_BYTES(strlen(pszString));
+
   return strcasestr(pszString, pszSubstring) != NULL;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // ClearString function
 
-void ClearString(char* pszBuffer, int nSize) {
-  if (IsNullOrWhiteSpace(pszBuffer)) {
-    // Nothing to do, string is already blank
-    return;
+int ClearString(char* pszBuffer, int nSize) {
+  CORE_PROBE(CORE_FN_CLEAR_STRING);
+
+  if (pszBuffer == NULL) {
+    return OK;  // Nothing to clear
   }
 
   if (nSize <= 0) {
-    ThrowArgumentOutOfRangeException("nSize");
+    return RaiseOutOfRange("nSize");
   }
 
-  memset(pszBuffer, 0, nSize);
+  CORE_PROBE_BYTES(nSize);
+
+  // The whole buffer is cleared even if it looks blank, since whatever
+  // follows a leading null or whitespace may still be worth hiding
+  WipeBytes(pszBuffer, nSize);
+
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndsWith function
+
+BOOL EndsWith(const char* pszString, const char* pszSuffix) {
+  CORE_PROBE(CORE_FN_ENDS_WITH);
+
+  if (pszString == NULL || pszSuffix == NULL) {
+    return FALSE;
+  }
+
+  const size_t STRING_LENGTH = strlen(pszString);
+  const size_t SUFFIX_LENGTH = strlen(pszSuffix);
+
+  CORE_PROBE_BYTES(STRING_LENGTH);
+
+  return STRING_LENGTH >= SUFFIX_LENGTH
+      && memcmp(pszString + STRING_LENGTH - SUFFIX_LENGTH, pszSuffix,
+          SUFFIX_LENGTH) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndsWithN function
+
+BOOL EndsWithN(const char* pchString, size_t nLength, const char* pchSuffix,
+    size_t nSuffixLength) {
+  CORE_PROBE(CORE_FN_ENDS_WITH_N);
+
+  if (pchString == NULL || pchSuffix == NULL) {
+    return FALSE;
+  }
+
+  CORE_PROBE_BYTES(nSuffixLength);
+
+  return nLength >= nSuffixLength
+      && memcmp(pchString + nLength - nSuffixLength, pchSuffix,
+          nSuffixLength) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndsWithNoCase function
+
+BOOL EndsWithNoCase(const char* pszString, const char* pszSuffix) {
+  CORE_PROBE(CORE_FN_ENDS_WITH_NO_CASE);
+
+  if (pszString == NULL || pszSuffix == NULL) {
+    return FALSE;
+  }
+
+  const size_t STRING_LENGTH = strlen(pszString);
+  const size_t SUFFIX_LENGTH = strlen(pszSuffix);
+
+  CORE_PROBE_BYTES(STRING_LENGTH);
+
+  return STRING_LENGTH >= SUFFIX_LENGTH
+      && MatchesNoCase(pszString + STRING_LENGTH - SUFFIX_LENGTH, pszSuffix,
+          SUFFIX_LENGTH);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndsWithNoCaseN function
+
+BOOL EndsWithNoCaseN(const char* pchString, size_t nLength,
+    const char* pchSuffix, size_t nSuffixLength) {
+  CORE_PROBE(CORE_FN_ENDS_WITH_NO_CASE_N);
+
+  if (pchString == NULL || pchSuffix == NULL) {
+    return FALSE;
+  }
+
+  CORE_PROBE_BYTES(nSuffixLength);
+
+  return nLength >= nSuffixLength
+      && MatchesNoCase(pchString + nLength - nSuffixLength, pchSuffix,
+          nSuffixLength);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // Equals function - Are strings equal to each other?
 
 BOOL Equals(const char* pszDest, const char* pszSrc) {
+  CORE_PROBE(CORE_FN_EQUALS);
+
   return strcmp(pszDest, pszSrc) == 0;
 }
 
@@ -69,6 +491,8 @@ BOOL Equals(const char* pszDest, const char* pszSrc) {
 // EqualsNoCase function - Are strings equal to each other? (case-insensitive)
 
 BOOL EqualsNoCase(const char* pszDest, const char* pszSrc) {
+  CORE_PROBE(CORE_FN_EQUALS_NO_CASE);
+
   return strcasecmp(pszDest, pszSrc) == 0;
 }
 
@@ -76,25 +500,34 @@ BOOL EqualsNoCase(const char* pszDest, const char* pszSrc) {
 // FormatDate function - Formats the current system date/time into a string.
 //
 
-void FormatDate(char* pszBuffer, int nSize, const char* pszFormat) {
+int FormatDate(char* pszBuffer, int nSize, const char* pszFormat) {
+  CORE_PROBE(CORE_FN_FORMAT_DATE);
+
   if (pszBuffer == NULL || nSize <= 0) {
-    fprintf(stderr, "FormatDate: Invalid buffer and/or size passed.\n");
-    exit(ERROR);
+    return RaiseError(CORE_ERROR_INVALID_ARGUMENT,
+        "FormatDate: Invalid buffer and/or size passed.\n", ERROR);
   }
 
   if (IsNullOrWhiteSpace(pszFormat)) {
-    fprintf(stderr, "FormatDate: Format string is missing.\n");
-    exit(ERROR);
+    return RaiseError(CORE_ERROR_INVALID_ARGUMENT,
+        "FormatDate: Format string is missing.\n", ERROR);
   }
 
   time_t now;
 
-  struct tm* tm_info;
+  struct tm tm_info;
 
   time(&now);
-  tm_info = localtime(&now);
+  if (localtime_r(&now, &tm_info) == NULL) {
+    return RaiseError(CORE_ERROR_SYSTEM,
+        "FormatDate: Failed to determine the local time.\n", ERROR);
+  }
 
-  strftime(pszBuffer, nSize, pszFormat, tm_info);
+  CORE_PROBE_BYTES(nSize);
+
+  strftime(pszBuffer, nSize, pszFormat, &tm_info);
+
+  return OK;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -109,11 +542,13 @@ void FormatDate(char* pszBuffer, int nSize, const char* pszFormat) {
  * to this function to void**
  */
 void FreeBuffer(void **ppBuffer) {
+  CORE_PROBE(CORE_FN_FREE_BUFFER);
+
   if (ppBuffer == NULL || *ppBuffer == NULL) {
     return;     // Nothing to do since there is no address referenced
   }
 
-  free(*ppBuffer);
+  CoreFree(*ppBuffer);
   *ppBuffer = NULL;
 }
 
@@ -121,6 +556,8 @@ void FreeBuffer(void **ppBuffer) {
 // FreeStringArray function
 
 void FreeStringArray(char*** pppszStringArray, int nElementCount) {
+  CORE_PROBE(CORE_FN_FREE_STRING_ARRAY);
+
   if (pppszStringArray == NULL
       || *pppszStringArray == NULL) {
     return;
@@ -145,6 +582,8 @@ void FreeStringArray(char*** pppszStringArray, int nElementCount) {
 
 int GetSubstringOccurrenceCount(const char* pszSrc,
     const char* pszFindWhat) {
+  CORE_PROBE(CORE_FN_GET_SUBSTRING_OCCURRENCE_COUNT);
+
   int nResult = 0;
   if (pszSrc == NULL || pszSrc[0] == '\0') {
     // NOTE: do not use IsNullOrWhiteSpace here to check pszSrc
@@ -158,13 +597,14 @@ int GetSubstringOccurrenceCount(const char* pszSrc,
 
   const int FIND_WHAT_LEN = strlen(pszFindWhat);
 
-  for (int i = 0; i < strlen(pszSrc)
-      && pszSrc[i] != '\0'; i++) {
-    if (strstr(&pszSrc[i], pszFindWhat) != &pszSrc[i]) {
-      continue;
-    }
+  CORE_PROBE_BYTES(strlen(pszSrc));
+
+  /* Count the occurrences StringReplace replaces: from the left, resuming
+   right after each one, so that adjacent occurrences all count and
+   overlapping ones do not */
+  for (const char* pszFound = strstr(pszSrc, pszFindWhat); pszFound != NULL;
+      pszFound = strstr(pszFound + FIND_WHAT_LEN, pszFindWhat)) {
     nResult++;
-    i += FIND_WHAT_LEN;
   }
 
   return nResult;
@@ -173,15 +613,27 @@ int GetSubstringOccurrenceCount(const char* pszSrc,
 ///////////////////////////////////////////////////////////////////////////////
 // HandleError function
 
-void HandleError(const char* pszErrorMessage) {
+int HandleError(const char* pszErrorMessage) {
+  CORE_PROBE(CORE_FN_HANDLE_ERROR);
+
   if (IsNullOrWhiteSpace(pszErrorMessage)) {
-    return;
+    return OK;
   }
 
-  fprintf(stderr, "%s\n", pszErrorMessage);
+  SetLastCoreError(CORE_ERROR_SYSTEM, pszErrorMessage);
 
-  perror(NULL);
+  // Same output as the former fprintf(stderr, ...) followed by perror(NULL),
+  // in full and before returning (or exiting), as that was
+  char szSystemError[128];
+  WriteDiagnosticFormat("%s\n%s\n", pszErrorMessage,
+      strerror_r(GetLastCoreErrorNumber(), szSystemError,
+          sizeof(szSystemError)));
+
+#if COMMON_CORE_LEGACY_ERRORS
   exit(ERROR);
+#endif //COMMON_CORE_LEGACY_ERRORS
+
+  return ERROR;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -192,64 +644,64 @@ void HandleError(const char* pszErrorMessage) {
 //
 
 BOOL IsAlphaNumeric(const char* pszTest) {
+  CORE_PROBE(CORE_FN_IS_ALPHA_NUMERIC);
+
   if (IsNullOrWhiteSpace(pszTest)) {
     return FALSE;	// Surely, a blank string cannot be alphanumeric!
   }
 
+  const size_t TEST_LENGTH = strlen(pszTest);
+
+  CORE_PROBE_BYTES(TEST_LENGTH);
+
   // The string pszTest is alphanumeric if and only if
   // every character is either a letter or a number.
   // Anything else anywhere else in the string, and too bad.
-  while (*pszTest != 0) {
-    if (!isalnum(*pszTest)) {
-      return FALSE;
-    }
-    pszTest++;
-  }
-  return TRUE;
+  return SpanAlnum(GetCoreKernels(), pszTest, TEST_LENGTH) == TEST_LENGTH;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // IsNullOrWhiteSpace function
 
 BOOL IsNullOrWhiteSpace(const char* pszTest) {
-  if (pszTest == NULL || strlen(pszTest) == 0) {
-    return TRUE;
-  }
+  CORE_PROBE(CORE_FN_IS_NULL_OR_WHITE_SPACE);
 
-  char szTrimResult[strlen(pszTest) + 1];
-  Trim(szTrimResult, strlen(pszTest) + 1, pszTest);
-  if (strlen(szTrimResult) == 0) {
+  if (pszTest == NULL || pszTest[0] == '\0') {
     return TRUE;
   }
 
-  return FALSE;
+  const size_t TEST_LENGTH = strlen(pszTest);
+
+  CORE_PROBE_BYTES(TEST_LENGTH);
+
+  return SpanSpace(GetCoreKernels(), pszTest, TEST_LENGTH) == TEST_LENGTH;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // IsNumeric function
 
 BOOL IsNumeric(const char* pszTest) {
+  CORE_PROBE(CORE_FN_IS_NUMERIC);
+
   if (IsNullOrWhiteSpace(pszTest)) {
     return FALSE;
   }
 
-  // The string pszTest is alphanumeric if and only if
-  // every character is either a letter or a number.
-  // Anything else anywhere else in the string, and too bad.
-  while (*pszTest != 0) {
-    if (!isdigit(*pszTest)) {
-      return FALSE;
-    }
-    pszTest++;
-  }
+  const size_t TEST_LENGTH = strlen(pszTest);
 
-  return TRUE;
+  CORE_PROBE_BYTES(TEST_LENGTH);
+
+  // The string pszTest is numeric if and only if every
+  // character is a digit.
+  return SpanDigits(GetCoreKernels(), pszTest, TEST_LENGTH) == TEST_LENGTH;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // IsOneOf function
 
 BOOL IsOneOf(char chTest, const char* pszPossibilities, int nPossibilities) {
+  CORE_PROBE(CORE_FN_IS_ONE_OF);
+
   BOOL bResult = FALSE;
 
   if (chTest == '\0')
@@ -259,12 +711,13 @@ BOOL IsOneOf(char chTest, const char* pszPossibilities, int nPossibilities) {
     return bResult;
   }
 
-  if (nPossibilities != strlen(pszPossibilities) + 1) {
+  if ((size_t) nPossibilities != strlen(pszPossibilities) + 1) {
     /* In this case, either we are passed non-string binary data, or
      * someone is trying to mess with us.  Either way, we only take strings
      * and nPossibilities needs to be equal to strlen(pszPossibilities) + 1.
      */
-    ThrowArgumentOutOfRangeException("nPosssibilities");
+    RaiseOutOfRange("nPossibilities");
+    return bResult;
   }
 
   if (nPossibilities <= 0) {
@@ -286,35 +739,32 @@ BOOL IsOneOf(char chTest, const char* pszPossibilities, int nPossibilities) {
 // IsUppercase function
 
 BOOL IsUppercase(const char* pszTest) {
+  CORE_PROBE(CORE_FN_IS_UPPERCASE);
+
   if (IsNullOrWhiteSpace(pszTest)) {
     return FALSE;
   }
 
-  const int TEST_SIZE = strlen(pszTest) + 1;
-
-  char* pszTrimResult = (char*) malloc(TEST_SIZE * sizeof(char));
-
-  Trim(pszTrimResult, TEST_SIZE, pszTest);
-
-// The string pszTest is alphanumeric if and only if
-// every character is either a letter or a number.
-// Anything else anywhere else in the string, and too bad.
-  for (int i = 0; i < TEST_SIZE; i++) {
-    if (pszTrimResult[i] == '\0') {
-      continue;
+  const size_t TEST_LENGTH = strlen(pszTest);
+
+  CORE_PROBE_BYTES(TEST_LENGTH);
+
+  // The string pszTest is uppercase if and only if every
+  // character other than whitespace is an uppercase letter.
+  const CORE_KERNELS* pKernels = GetCoreKernels();
+  size_t nChecked = 0;
+  for (;;) {
+    nChecked += SpanUpper(pKernels, pszTest + nChecked,
+        TEST_LENGTH - nChecked);
+    nChecked += SpanSpace(pKernels, pszTest + nChecked,
+        TEST_LENGTH - nChecked);
+    if (nChecked == TEST_LENGTH) {
+      return TRUE;
     }
-    if (!isupper(pszTrimResult[i])) {
-      free(pszTrimResult);
-      pszTrimResult = NULL;
-
+    if (!isupper((unsigned char) pszTest[nChecked])) {
       return FALSE;
     }
   }
-
-  free(pszTrimResult);
-  pszTrimResult = NULL;
-
-  return TRUE;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -323,6 +773,8 @@ BOOL IsUppercase(const char* pszTest) {
 void JoinStrings(char* ppszSourceStringArray[],
     int nSourceStringArrayLength, char** ppszOutput,
     int *pnOutputLength) {
+  CORE_PROBE(CORE_FN_JOIN_STRINGS);
+
   if (ppszSourceStringArray == NULL) {
     return;
   }
@@ -344,34 +796,101 @@ void JoinStrings(char* ppszSourceStringArray[],
     const int CURRENT_ENTRY_SIZE
     = strlen(ppszSourceStringArray[i]) + 1;
     nTotalBytes += CURRENT_ENTRY_SIZE;
-    *ppszOutput = (char*) realloc(*ppszOutput,
-        (nTotalBytes) * sizeof(char));
+    *ppszOutput = (char*) CoreRealloc(*ppszOutput,
+        (nTotalBytes) * sizeof(char), CORE_ALLOC_JOIN_STRINGS);
     if (i == 0) {
       memset(*ppszOutput, 0, nTotalBytes);
     }
     strcat(*ppszOutput, ppszSourceStringArray[i]);
   }
   const int FINISHED_STRING_SIZE = strlen(*ppszOutput) + 1;
-  *ppszOutput = (char*) realloc(*ppszOutput,
-      (FINISHED_STRING_SIZE) * sizeof(char));
+  *ppszOutput = (char*) CoreRealloc(*ppszOutput,
+      (FINISHED_STRING_SIZE) * sizeof(char), CORE_ALLOC_JOIN_STRINGS);
   (*ppszOutput)[FINISHED_STRING_SIZE - 1] = '\0';
   *pnOutputLength = FINISHED_STRING_SIZE;
+
+  CORE_PROBE_BYTES(nTotalBytes);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// JoinStringsInRegion function
+
+int JoinStringsInRegion(LPREGION pRegion, char* ppszSourceStringArray[],
+    int nSourceStringArrayLength, char** ppszOutput, int* pnOutputLength) {
+  CORE_PROBE(CORE_FN_JOIN_STRINGS_IN_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "JoinStringsInRegion: pRegion");
+    return ERROR;
+  }
+
+  if (nSourceStringArrayLength < 0) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE,
+        "JoinStringsInRegion: nSourceStringArrayLength");
+    return ERROR;
+  }
+
+  if (ppszOutput == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "JoinStringsInRegion: ppszOutput");
+    return ERROR;
+  }
+
+  size_t nTotalLength = 0;
+  for (int i = 0; i < nSourceStringArrayLength; i++) {
+    if (ppszSourceStringArray == NULL || ppszSourceStringArray[i] == NULL) {
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+          "JoinStringsInRegion: ppszSourceStringArray");
+      return ERROR;
+    }
+    nTotalLength += strlen(ppszSourceStringArray[i]);
+  }
+
+  if (nTotalLength >= INT_MAX) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE,
+        "JoinStringsInRegion: ppszSourceStringArray");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nTotalLength);
+
+  char* pszResult = (char*) AllocateRegionBytes(pRegion, nTotalLength + 1, 1);
+  if (pszResult == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "JoinStringsInRegion");
+    return ERROR;
+  }
+
+  char* pchEnd = pszResult;
+  *pchEnd = '\0';
+  for (int i = 0; i < nSourceStringArrayLength; i++) {
+    pchEnd = stpcpy(pchEnd, ppszSourceStringArray[i]);
+  }
+
+  *ppszOutput = pszResult;
+  if (pnOutputLength != NULL) {
+    *pnOutputLength = (int) nTotalLength + 1;
+  }
+  return OK;
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // MinimumOf function
 
 int MinimumOf(int a, int b) {
-  if (a <= b)
-    return a;
+  CORE_PROBE(CORE_FN_MINIMUM_OF);
 
-  return b;
+  /* All ones when a is the minimum, all zeros when b is */
+  const int A_MASK = -(a <= b);
+  return (a & A_MASK) | (b & ~A_MASK);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
 // PrependTo function
 
 void PrependTo(char** ppszDest, const char* pszPrefix, const char* pszSrc) {
+  CORE_PROBE(CORE_FN_PREPEND_TO);
+
 // Double-check that we have valid pointers and non-blank
 // prefix and source strings in the input
   if (ppszDest == NULL) {
@@ -393,10 +912,13 @@ void PrependTo(char** ppszDest, const char* pszPrefix, const char* pszSrc) {
 // null-terminator
   const int TOTAL_SIZE = strlen(pszPrefix) + strlen(pszSrc) + 1;
 
+  CORE_PROBE_BYTES(TOTAL_SIZE - 1);
+
 // Allocate a block of memory that is TOTAL_SIZE characters
 // in length to prepare for gluing the prefix and source
 // strings together
-  char* pszResult = (char*) malloc(TOTAL_SIZE * sizeof(char));
+  char* pszResult = (char*) CoreMalloc(TOTAL_SIZE * sizeof(char),
+      CORE_ALLOC_PREPEND_TO);
   if (pszResult == NULL) {
     return;			// Failed to allocate memory
   }
@@ -412,159 +934,184 @@ void PrependTo(char** ppszDest, const char* pszPrefix, const char* pszSrc) {
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// Split function
+// PrependToInRegion function
 
-void Split(char* pszStringToSplit, int nStringToSplitSize,
-    const char* pszDelimiters, char*** pppszStrings, int* pnResultCount) {
-  if (IsNullOrWhiteSpace(pszStringToSplit)) {
-    return;
+int PrependToInRegion(LPREGION pRegion, char** ppszDest,
+    const char* pszPrefix, const char* pszSrc) {
+  CORE_PROBE(CORE_FN_PREPEND_TO_IN_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "PrependToInRegion: pRegion");
+    return ERROR;
   }
 
-  if (pppszStrings == NULL) {
-    return;
+  if (ppszDest == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "PrependToInRegion: ppszDest");
+    return ERROR;
   }
 
-  if (nStringToSplitSize <= 0) {
-    return;
+  if (pszPrefix == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "PrependToInRegion: pszPrefix");
+    return ERROR;
   }
 
-  if (pszDelimiters == NULL || pszDelimiters[0] == '\0') {
-    return;
+  if (pszSrc == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "PrependToInRegion: pszSrc");
+    return ERROR;
   }
 
-  if (pnResultCount == NULL) {
-    return;
+  const size_t PREFIX_LENGTH = strlen(pszPrefix);
+  const size_t SRC_LENGTH = strlen(pszSrc);
+
+  CORE_PROBE_BYTES(PREFIX_LENGTH + SRC_LENGTH);
+
+  char* pszResult = (char*) AllocateRegionBytes(pRegion,
+      PREFIX_LENGTH + SRC_LENGTH + 1, 1);
+  if (pszResult == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "PrependToInRegion");
+    return ERROR;
   }
 
-  const int STRING_TO_SPLIT_SIZE = nStringToSplitSize + 1;
+  memcpy(pszResult, pszPrefix, PREFIX_LENGTH);
+  memcpy(pszResult + PREFIX_LENGTH, pszSrc, SRC_LENGTH + 1);
+  *ppszDest = pszResult;
+  return OK;
+}
 
-  char szTrimmedStringToSplit[STRING_TO_SPLIT_SIZE];
-  memset(szTrimmedStringToSplit, 0, STRING_TO_SPLIT_SIZE);
-  Trim(szTrimmedStringToSplit, STRING_TO_SPLIT_SIZE, pszStringToSplit);
+///////////////////////////////////////////////////////////////////////////////
+// SecureClear function
 
-  /* This function tokenizes the string pszStringToSplit on the
-   character(s) in pszDelimiters using strtok() over and over
-   again, copying each result into a dynamically-allocated
-   array of strings, and then returns the address of the array
-   of strings.  Each member of the array of strings is itself
-   dynamically-allocated.  Each time strtok() returns a non-NULL
-   result, the string returned is copied using strcpy() into the
-   current dynamically-allocated string, the address of which
-   is then stored in the dynamically-allocated array of strings.
-   Then, the array of strings is grown by one, and the tokenization
-   is attempted again. */
+int SecureClear(void* pvBuffer, size_t nSize) {
+  CORE_PROBE(CORE_FN_SECURE_CLEAR);
 
-  *pnResultCount = 0; /* initialize result count to zero */
-  *pppszStrings = NULL; /* initialize result array to NULL */
+  if (nSize == 0) {
+    return OK;
+  }
 
-  /* Attempt to extract the first token from the string
-   ( a token is defined as the "stuff between the delimiters" ) */
-  char *pszCurrentResult = strtok(szTrimmedStringToSplit, pszDelimiters);
-  if (pszCurrentResult == NULL) {
-    return; /* nothing came of splitting the string */
-  }
-
-  /* Measure the amount of storage that needs to be allocated
-   for the first element of the output.  Be sure to include
-   space for the null terminator. Base the amount of storage
-   needed off of the length of the token string just extracted.*/
-  const int FIRST_RESULT_SIZE = strlen(pszCurrentResult) + 1;
-
-  /* Allocate storage for the first token's text to be copied
-   into and initialize it to all zeroes (a best practice).*/
-  char* pszFirstElement = (char*) malloc(
-      FIRST_RESULT_SIZE * sizeof(char));
-  if (pszFirstElement == NULL) {
-    fprintf(stderr, ERROR_FAILED_ALLOC_STRING_BUFFER);
-    exit(EXIT_FAILURE);
-  }
-  memset(pszFirstElement, 0,
-      FIRST_RESULT_SIZE * sizeof(char));
-
-  /* Copy the text pointed to by pszCurrent Result into the
-   storage referenced by pszFirstElement. */
-  strcpy(pszFirstElement, pszCurrentResult);
-
-  /* Allocate storage for an array of char* pointers that is
-   currently needing to be just one element in size (since
-   as of right now, we just have one thing to put into it) */
-  char** ppszResultArray = (char**) malloc(1 * sizeof(char*));
-  if (ppszResultArray == NULL) {
-    fprintf(stderr, ERROR_FAILED_ALLOC_ARRAY);
-    exit(EXIT_FAILURE);
-  }
-  memset(ppszResultArray, 0, 1 * sizeof(char*));
-
-  /* Initialize the first element of the array of strings
-   to contain the address of the first token */
-  ppszResultArray[0] = pszFirstElement;
-
-  int nCurArrayElement = 1; /* new current array element */
-  int nReturnedElementCount = 1; /* how many tokens thus far */
-
-  while (pszCurrentResult != NULL) {
-    /* Try again to tokenize the string.  If we get NULL
-     as the answer, then there's no more tokens (parts of
-     the input string that are between the delimiters are known
-     as tokens) to process, so we stop */
-    pszCurrentResult = strtok(NULL, pszDelimiters);
-    if (pszCurrentResult == NULL) {
-      break; /* done splitting */
-    }
+  if (pvBuffer == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "SecureClear: pvBuffer");
+    return ERROR;
+  }
 
-    /* Using the length of the current result string (plus one,
-     for the null terminator) as the size, allocate a fresh
-     block of storage to hold the text referenced by
-     pszCurrentResult. */
-    int CURRENT_RESULT_SIZE = strlen(pszCurrentResult) + 1;
-    char* pszNextResult = (char*) malloc(
-        CURRENT_RESULT_SIZE * sizeof(char));
-    if (pszNextResult == NULL) {
-      fprintf(stderr, ERROR_FAILED_ALLOC_ARRAY);
-      exit(EXIT_FAILURE);
-    }
+  CORE_PROBE_BYTES(nSize);
 
-    memset(pszNextResult, 0,
-        CURRENT_RESULT_SIZE * sizeof(char));
+  WipeBytes(pvBuffer, nSize);
+  return OK;
+}
 
-    /* Copy the text in pszCurrentResult into the newly-allocated
-     storage at the address specified by pszNextResult */
-    strcpy(pszNextResult, pszCurrentResult);
+///////////////////////////////////////////////////////////////////////////////
+// Split function
 
-    /* grow the array of strings by one and then initialize
-     the element on the end with the address of
-     pszNextElement. */
-    ppszResultArray = (char**) realloc(ppszResultArray,
-        (nReturnedElementCount + 1) * sizeof(char*));
-    ppszResultArray[nCurArrayElement] = pszNextResult;
+int Split(char* pszStringToSplit, int nStringToSplitSize,
+    const char* pszDelimiters, char*** pppszStrings, int* pnResultCount) {
+  CORE_PROBE(CORE_FN_SPLIT);
+  CORE_PROBE_BYTES(nStringToSplitSize > 0 ? nStringToSplitSize : 0);
 
-    /* Increment our counters, and then wash, rinse, repeat. */
-    nCurArrayElement += 1;
-    nReturnedElementCount += 1;
-  }
+  return SplitInto(NULL, pszStringToSplit, nStringToSplitSize, pszDelimiters,
+      pppszStrings, pnResultCount);
+}
 
-  /* Save the count of returned elements in the
-   variable at the address given by pnResultCount */
-  *pnResultCount = nReturnedElementCount;
+///////////////////////////////////////////////////////////////////////////////
+// SplitInRegion function
 
-  /* Tell the caller where in the machine's memory
-   the first element of our array of token strings
-   is stored. */
-  *pppszStrings = ppszResultArray;
+int SplitInRegion(LPREGION pRegion, char* pszStringToSplit,
+    int nStringToSplitSize, const char* pszDelimiters, char*** pppszStrings,
+    int* pnResultCount) {
+  CORE_PROBE(CORE_FN_SPLIT_IN_REGION);
 
-  /* Done */
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "SplitInRegion: pRegion");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nStringToSplitSize > 0 ? nStringToSplitSize : 0);
+
+  return SplitInto(pRegion, pszStringToSplit, nStringToSplitSize,
+      pszDelimiters, pppszStrings, pnResultCount);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
-// StartsWith function
+// StartsWith function - Compares only as far as the prefix goes, or up to
+// the first difference.  The subject string is never scanned to its end.
+//
 
 BOOL StartsWith(const char *str, const char *startsWith) {
-  size_t prefixLength = strlen(startsWith);
-  size_t stringLength = strlen(str);
-  return
-  stringLength < prefixLength ?
-                                FALSE :
-                                strncmp(startsWith, str, prefixLength) == 0;
+  CORE_PROBE(CORE_FN_STARTS_WITH);
+
+  if (str == NULL || startsWith == NULL) {
+    return FALSE;
+  }
+
+  size_t compared = 0;
+  while (startsWith[compared] != '\0'
+      && str[compared] == startsWith[compared]) {
+    compared++;
+  }
+
+  CORE_PROBE_BYTES(compared);
+
+  return startsWith[compared] == '\0';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StartsWithN function
+
+BOOL StartsWithN(const char* pchString, size_t nLength,
+    const char* pchPrefix, size_t nPrefixLength) {
+  CORE_PROBE(CORE_FN_STARTS_WITH_N);
+
+  if (pchString == NULL || pchPrefix == NULL) {
+    return FALSE;
+  }
+
+  CORE_PROBE_BYTES(nPrefixLength);
+
+  return nLength >= nPrefixLength
+      && memcmp(pchString, pchPrefix, nPrefixLength) == 0;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StartsWithNoCase function
+
+BOOL StartsWithNoCase(const char* pszString, const char* pszPrefix) {
+  CORE_PROBE(CORE_FN_STARTS_WITH_NO_CASE);
+
+  if (pszString == NULL || pszPrefix == NULL) {
+    return FALSE;
+  }
+
+  // The null terminator of a shorter pszString never matches a character
+  // of pszPrefix, so the loop cannot run past the end of either string
+  size_t nCompared = 0;
+  while (pszPrefix[nCompared] != '\0'
+      && MatchesNoCase(pszString + nCompared, pszPrefix + nCompared, 1)) {
+    nCompared++;
+  }
+
+  CORE_PROBE_BYTES(nCompared);
+
+  return pszPrefix[nCompared] == '\0';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StartsWithNoCaseN function
+
+BOOL StartsWithNoCaseN(const char* pchString, size_t nLength,
+    const char* pchPrefix, size_t nPrefixLength) {
+  CORE_PROBE(CORE_FN_STARTS_WITH_NO_CASE_N);
+
+  if (pchString == NULL || pchPrefix == NULL) {
+    return FALSE;
+  }
+
+  CORE_PROBE_BYTES(nPrefixLength);
+
+  return nLength >= nPrefixLength
+      && MatchesNoCase(pchString, pchPrefix, nPrefixLength);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -573,6 +1120,8 @@ BOOL StartsWith(const char *str, const char *startsWith) {
 void StringReplace(const char* pszSrc,
     const char* pszFindWhat, const char* pszReplaceWith,
     char** ppszResult) {
+  CORE_PROBE(CORE_FN_STRING_REPLACE);
+
   if (pszSrc == NULL || pszSrc[0] == '\0') {  // do not use IsNullOrWhiteSpace
     return; // Required parameter
   }
@@ -585,51 +1134,52 @@ void StringReplace(const char* pszSrc,
     return; // Required parameter
   }
 
-  int nSrcLen = strlen(pszSrc);
-  int nFindWhatLen = strlen(pszFindWhat);
-  int nReplaceWithLen = strlen(pszReplaceWith);
-  const int DELTA = nReplaceWithLen - nFindWhatLen;
+  CORE_PROBE_BYTES(strlen(pszSrc));
 
-  /* In order to determine the proper size for the result
-   buffer, count the occurrences of findWhat in pszSrc.
-   But, there is no need to bother if the DELTA is zero,
-   since this means the src and dest strings will be of
-   identical length. In this case, set nOccurrences to a
-   default value of zero. */
-  int nOccurrences = DELTA == 0
-      ? 0
-        :
-        GetSubstringOccurrenceCount(pszSrc, pszFindWhat);
-  if (nOccurrences < 0) {
-    return; // unknown error
+  ReplaceInto(NULL, pszSrc, pszFindWhat, pszReplaceWith, ppszResult);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StringReplaceInRegion function
+
+int StringReplaceInRegion(LPREGION pRegion, const char* pszSrc,
+    const char* pszFindWhat, const char* pszReplaceWith, char** ppszResult) {
+  CORE_PROBE(CORE_FN_STRING_REPLACE_IN_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "StringReplaceInRegion: pRegion");
+    return ERROR;
   }
 
-  /* Determine the appropriate size for the block of memory
-   * in which to store the result. */
-  const int BUFSIZE = DELTA == 0
-      ? nSrcLen
-        :
-        nSrcLen + nOccurrences * DELTA;
+  if (pszSrc == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "StringReplaceInRegion: pszSrc");
+    return ERROR;
+  }
 
-  *ppszResult = (char*) malloc((BUFSIZE + 1) * sizeof(char));
-  memset(*ppszResult, 0, BUFSIZE + 1);
+  if (pszFindWhat == NULL || pszFindWhat[0] == '\0') {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "StringReplaceInRegion: pszFindWhat");
+    return ERROR;
+  }
 
-  int i = 0;
-  while (*pszSrc) {
-    // compare the substring with the result
-    if (strstr(pszSrc, pszFindWhat) == pszSrc) {
-      strcpy(&((*ppszResult)[i]), pszReplaceWith);
-      i += nReplaceWithLen;
-      pszSrc += nFindWhatLen;
-      //*ppszResult += nReplaceWithLen;
-    } else {
-      (*ppszResult)[i] = *pszSrc;
-      pszSrc++;
-      i++;
-    }
+  if (pszReplaceWith == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "StringReplaceInRegion: pszReplaceWith");
+    return ERROR;
   }
 
-  (*ppszResult)[i] = '\0';
+  if (ppszResult == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "StringReplaceInRegion: ppszResult");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(strlen(pszSrc));
+
+  return ReplaceInto(pRegion, pszSrc, pszFindWhat, pszReplaceWith,
+      ppszResult);
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -637,39 +1187,25 @@ void StringReplace(const char* pszSrc,
 
 // Stores the trimmed input string into the given output buffer,
 // which must be large enough to store the result.  If it is too small,
-// the output is truncated.  Shout out to Stack Overflow
+// the output is truncated.  The rest of the buffer is zero-filled.
 void Trim(char *out, size_t len, const char *str) {
+  CORE_PROBE(CORE_FN_TRIM);
+
   if (len == 0)
     return;
 
-  memset(out, 0, len);
-
-  const char *end;
+  CORE_PROBE_BYTES(len);
 
-  int leading_space_trimmed = 0;
+  const CORE_KERNELS* pKernels = GetCoreKernels();
 
-  end = str + strlen(str) - 1;
-  if (!isspace((unsigned char )*str)) {
-    *out = *str;
-    out++;
+  const size_t length = strlen(str);
+  const size_t leading = SpanSpace(pKernels, str, length);
+  size_t kept = length - leading
+      - ReverseSpanSpace(pKernels, str + leading, length - leading);
+  if (kept > len - 1) {
+    kept = len - 1;
   }
 
-  while (*str++ != 0 && str <= end && strlen(out) <= len) {
-    if (isspace((unsigned char )*end)) {
-      end--;
-    }
-
-    if (!leading_space_trimmed && isspace((unsigned char )*str)) {
-      continue;
-    }
-
-    if (str == end && isspace((unsigned char )*str)
-        && isspace((unsigned char )*end)) {
-      break;
-    }
-
-    leading_space_trimmed = 1;
-    *out = *str;
-    out++;
-  }
+  memmove(out, str + leading, kept);
+  memset(out + kept, 0, len - kept);
 }
@@ -0,0 +1,395 @@
+// core_alloc.c - Implementation of the allocation hooks and allocation accounting
+
+#include "stdafx.h"
+#include "alloc_stats.h"
+#include "core_alloc.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only variables
+
+static const char* s_pszSiteNames[CORE_ALLOC_SITE_COUNT] = {
+  "CreateBloomFilter",
+  "AllocateBuffer",
+  "InternString",
+  "JoinStrings",
+  "MapFile",
+  "CreatePrefixSet",
+  "PrependTo",
+  "CreateRegion",
+  "Split",
+  "CreateStringIndex",
+  "InsertStringMapKey",
+  "UnionStrings",
+  "StringReplace"
+};
+
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+
+/* Initial number of slots in the table of live blocks; always a power of 2 */
+#define INITIAL_BLOCK_TABLE_SIZE    1024
+
+typedef struct _TRACKED_BLOCK {
+  void* pvBlock;              /* NULL if the slot is empty */
+  size_t nSize;
+  CORE_ALLOC_SITE nSite;
+} TRACKED_BLOCK;
+
+/* Open-addressing table of live blocks, keyed by address, plus the per-API
+ * counters.  Tracking is a diagnostic mode, so one lock guards everything. */
+static pthread_mutex_t s_trackingLock = PTHREAD_MUTEX_INITIALIZER;
+static TRACKED_BLOCK* s_pBlocks = NULL;
+static size_t s_nBlockSlots = 0;
+static size_t s_nLiveBlocks = 0;
+static CORE_ALLOC_STATS s_stats[CORE_ALLOC_SITE_COUNT];
+
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+
+static CORE_ALLOC_STATS s_benchmarkBaseline[CORE_ALLOC_SITE_COUNT];
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+
+///////////////////////////////////////////////////////////////////////////////
+// HashAddress function - Mixes the bits of a block address into a table
+// index.
+//
+
+static inline size_t HashAddress(const void* pvBlock) {
+  unsigned long long ullKey = (unsigned long long) (uintptr_t) pvBlock;
+  ullKey ^= ullKey >> 33;
+  ullKey *= 0xff51afd7ed558ccdULL;
+  ullKey ^= ullKey >> 33;
+  return (size_t) ullKey;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InsertBlock function - Adds a block to the table, which must have a free
+// slot.  Must be called with s_trackingLock held.
+//
+
+static void InsertBlock(void* pvBlock, size_t nSize, CORE_ALLOC_SITE nSite) {
+  size_t nMask = s_nBlockSlots - 1;
+  size_t i = HashAddress(pvBlock) & nMask;
+  while (s_pBlocks[i].pvBlock != NULL) {
+    i = (i + 1) & nMask;
+  }
+
+  s_pBlocks[i].pvBlock = pvBlock;
+  s_pBlocks[i].nSize = nSize;
+  s_pBlocks[i].nSite = nSite;
+  s_nLiveBlocks++;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GrowBlockTable function - Doubles the size of the table.  Must be called
+// with s_trackingLock held.  Returns FALSE if memory ran out, in which case
+// the table is left as it was.
+//
+
+static BOOL GrowBlockTable(void) {
+  size_t nNewSlots = s_nBlockSlots == 0
+      ? INITIAL_BLOCK_TABLE_SIZE : s_nBlockSlots * 2;
+  TRACKED_BLOCK* pNewBlocks = (TRACKED_BLOCK*) calloc(nNewSlots,
+      sizeof(TRACKED_BLOCK));
+  if (pNewBlocks == NULL) {
+    return FALSE;
+  }
+
+  TRACKED_BLOCK* pOldBlocks = s_pBlocks;
+  size_t nOldSlots = s_nBlockSlots;
+
+  s_pBlocks = pNewBlocks;
+  s_nBlockSlots = nNewSlots;
+  s_nLiveBlocks = 0;
+
+  for (size_t i = 0; i < nOldSlots; i++) {
+    if (pOldBlocks[i].pvBlock != NULL) {
+      InsertBlock(pOldBlocks[i].pvBlock, pOldBlocks[i].nSize,
+          pOldBlocks[i].nSite);
+    }
+  }
+
+  free(pOldBlocks);
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// TrackBlock function - Records a newly-allocated block against the API
+// that allocated it.
+//
+
+static void TrackBlock(void* pvBlock, size_t nSize, CORE_ALLOC_SITE nSite) {
+  pthread_mutex_lock(&s_trackingLock);
+
+  /* Keep the load factor at or below one half */
+  if ((s_nLiveBlocks + 1) * 2 > s_nBlockSlots && !GrowBlockTable()) {
+    pthread_mutex_unlock(&s_trackingLock);
+    return;     // The block goes untracked rather than failing the caller
+  }
+
+  InsertBlock(pvBlock, nSize, nSite);
+
+  CORE_ALLOC_STATS* pStats = &s_stats[nSite];
+  pStats->ullAllocations++;
+  pStats->ullBytes += nSize;
+  pStats->ullLiveBlocks++;
+  pStats->ullLiveBytes += nSize;
+  if (pStats->ullLiveBytes > pStats->ullPeakLiveBytes) {
+    pStats->ullPeakLiveBytes = pStats->ullLiveBytes;
+  }
+
+  pthread_mutex_unlock(&s_trackingLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UntrackBlock function - Forgets a block that is being released or
+// reallocated, if it is being tracked at all.  Returns FALSE if it was not;
+// otherwise, fills in the size and site it was tracked with.
+//
+
+static BOOL UntrackBlock(void* pvBlock, size_t* pnSize,
+    CORE_ALLOC_SITE* pnSite) {
+  pthread_mutex_lock(&s_trackingLock);
+
+  if (s_nBlockSlots == 0) {
+    pthread_mutex_unlock(&s_trackingLock);
+    return FALSE;
+  }
+
+  size_t nMask = s_nBlockSlots - 1;
+  size_t i = HashAddress(pvBlock) & nMask;
+  while (s_pBlocks[i].pvBlock != NULL && s_pBlocks[i].pvBlock != pvBlock) {
+    i = (i + 1) & nMask;
+  }
+
+  if (s_pBlocks[i].pvBlock == NULL) {
+    pthread_mutex_unlock(&s_trackingLock);
+    return FALSE;     // Not ours, e.g., a buffer the caller allocated
+  }
+
+  *pnSize = s_pBlocks[i].nSize;
+  *pnSite = s_pBlocks[i].nSite;
+
+  CORE_ALLOC_STATS* pStats = &s_stats[s_pBlocks[i].nSite];
+  pStats->ullFrees++;
+  pStats->ullLiveBlocks--;
+  pStats->ullLiveBytes -= s_pBlocks[i].nSize;
+
+  /* Backward-shift deletion keeps probe sequences intact without tombstones */
+  size_t nHole = i;
+  for (size_t j = (i + 1) & nMask; s_pBlocks[j].pvBlock != NULL;
+      j = (j + 1) & nMask) {
+    size_t nHome = HashAddress(s_pBlocks[j].pvBlock) & nMask;
+    if (((j - nHome) & nMask) >= ((j - nHole) & nMask)) {
+      s_pBlocks[nHole] = s_pBlocks[j];
+      nHole = j;
+    }
+  }
+  s_pBlocks[nHole].pvBlock = NULL;
+  s_nLiveBlocks--;
+
+  pthread_mutex_unlock(&s_trackingLock);
+  return TRUE;
+}
+
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+
+///////////////////////////////////////////////////////////////////////////////
+// Allocation hooks - used by the library's own functions
+
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+
+///////////////////////////////////////////////////////////////////////////////
+// CoreFree function
+
+void CoreFree(void* pvBlock) {
+  if (pvBlock == NULL) {
+    return;
+  }
+
+  size_t nSize;
+  CORE_ALLOC_SITE nSite;
+  UntrackBlock(pvBlock, &nSize, &nSite);
+  ReleaseBlock(pvBlock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CoreMalloc function
+
+void* CoreMalloc(size_t nSize, CORE_ALLOC_SITE nSite) {
+  void* pvResult = AllocateBlock(nSize);
+  if (pvResult != NULL) {
+    TrackBlock(pvResult, nSize, nSite);
+  }
+
+  return pvResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CoreRealloc function
+
+void* CoreRealloc(void* pvBlock, size_t nSize, CORE_ALLOC_SITE nSite) {
+  /* Untrack first: once realloc returns, the old address may already have
+   * been handed out again by another thread. */
+  size_t nOldSize = 0;
+  CORE_ALLOC_SITE nOldSite = nSite;
+  BOOL bWasTracked = pvBlock != NULL
+      && UntrackBlock(pvBlock, &nOldSize, &nOldSite);
+
+  void* pvResult = ReallocateBlock(pvBlock, nSize);
+  if (pvResult != NULL) {
+    TrackBlock(pvResult, nSize, nSite);
+  } else if (bWasTracked) {
+    TrackBlock(pvBlock, nOldSize, nOldSite);   // The old block is still live
+  }
+
+  return pvResult;
+}
+
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// BeginAllocationBenchmark function
+
+void BeginAllocationBenchmark(void) {
+  for (int i = 0; i < CORE_ALLOC_SITE_COUNT; i++) {
+    GetAllocationStats((CORE_ALLOC_SITE) i, &s_benchmarkBaseline[i]);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndAllocationBenchmark function
+
+void EndAllocationBenchmark(FILE* fp, const char* pszLabel,
+    unsigned long long ullOperations) {
+  if (fp == NULL || ullOperations == 0) {
+    return;
+  }
+
+  for (int i = 0; i < CORE_ALLOC_SITE_COUNT; i++) {
+    CORE_ALLOC_STATS current;
+    GetAllocationStats((CORE_ALLOC_SITE) i, &current);
+
+    unsigned long long ullAllocations =
+        current.ullAllocations - s_benchmarkBaseline[i].ullAllocations;
+    if (ullAllocations == 0) {
+      continue;
+    }
+
+    unsigned long long ullBytes =
+        current.ullBytes - s_benchmarkBaseline[i].ullBytes;
+    fprintf(fp, "%s\t%s\tallocs/op=%.3f\tbytes/op=%.1f\n",
+        pszLabel == NULL ? "-" : pszLabel, s_pszSiteNames[i],
+        (double) ullAllocations / ullOperations,
+        (double) ullBytes / ullOperations);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetAllocationSiteName function
+
+const char* GetAllocationSiteName(CORE_ALLOC_SITE nSite) {
+  if ((int) nSite < 0 || nSite >= CORE_ALLOC_SITE_COUNT) {
+    return NULL;
+  }
+
+  return s_pszSiteNames[nSite];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetAllocationStats function
+
+void GetAllocationStats(CORE_ALLOC_SITE nSite, LPCORE_ALLOC_STATS pStats) {
+  if (pStats == NULL) {
+    return;
+  }
+
+  memset(pStats, 0, sizeof(CORE_ALLOC_STATS));
+
+  if ((int) nSite < 0 || nSite >= CORE_ALLOC_SITE_COUNT) {
+    return;
+  }
+
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+  pthread_mutex_lock(&s_trackingLock);
+  memcpy(pStats, &s_stats[nSite], sizeof(CORE_ALLOC_STATS));
+  pthread_mutex_unlock(&s_trackingLock);
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsAllocationTrackingEnabled function
+
+BOOL IsAllocationTrackingEnabled(void) {
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+  return TRUE;
+#else
+  return FALSE;
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReportLeaks function
+
+unsigned long long ReportLeaks(FILE* fp) {
+  unsigned long long ullLeaks = 0;
+
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+  pthread_mutex_lock(&s_trackingLock);
+
+  for (int i = 0; i < CORE_ALLOC_SITE_COUNT; i++) {
+    if (s_stats[i].ullLiveBlocks == 0) {
+      continue;
+    }
+
+    ullLeaks += s_stats[i].ullLiveBlocks;
+    if (fp != NULL) {
+      fprintf(fp, "%s: %llu block(s), %llu byte(s) not released\n",
+          s_pszSiteNames[i], s_stats[i].ullLiveBlocks,
+          s_stats[i].ullLiveBytes);
+    }
+  }
+
+  if (fp != NULL) {
+    for (size_t i = 0; i < s_nBlockSlots; i++) {
+      if (s_pBlocks[i].pvBlock != NULL) {
+        fprintf(fp, "  %p\t%zu byte(s)\tfrom %s\n", s_pBlocks[i].pvBlock,
+            s_pBlocks[i].nSize, s_pszSiteNames[s_pBlocks[i].nSite]);
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&s_trackingLock);
+#else
+  (void) fp;
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+
+  return ullLeaks;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ResetAllocationStats function
+
+void ResetAllocationStats(void) {
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+  pthread_mutex_lock(&s_trackingLock);
+
+  for (int i = 0; i < CORE_ALLOC_SITE_COUNT; i++) {
+    unsigned long long ullLiveBlocks = s_stats[i].ullLiveBlocks;
+    unsigned long long ullLiveBytes = s_stats[i].ullLiveBytes;
+    memset(&s_stats[i], 0, sizeof(CORE_ALLOC_STATS));
+    s_stats[i].ullLiveBlocks = ullLiveBlocks;
+    s_stats[i].ullLiveBytes = ullLiveBytes;
+    s_stats[i].ullPeakLiveBytes = ullLiveBytes;
+  }
+
+  pthread_mutex_unlock(&s_trackingLock);
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+
+  memset(s_benchmarkBaseline, 0, sizeof(s_benchmarkBaseline));
+}
@@ -0,0 +1,41 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_alloc.h - Allocation hooks through which the library's own functions obtain and release
+// the heap memory they hand out
+//
+// Blocks come from malloc or, if the library is built with COMMON_CORE_STRING_POOL defined, from
+// the size-class pool of core_pool.h.  Unless the library is built with
+// COMMON_CORE_TRACK_ALLOCATIONS defined, these are inline pass-throughs to core_pool.h.
+
+#ifndef __CORE_ALLOC_H__
+#define __CORE_ALLOC_H__
+
+#include "stdafx.h"
+#include "alloc_stats.h"
+#include "core_pool.h"
+
+#ifdef COMMON_CORE_TRACK_ALLOCATIONS
+
+void CoreFree(void* pvBlock);
+void* CoreMalloc(size_t nSize, CORE_ALLOC_SITE nSite);
+void* CoreRealloc(void* pvBlock, size_t nSize, CORE_ALLOC_SITE nSite);
+
+#else
+
+static inline void CoreFree(void* pvBlock) {
+  ReleaseBlock(pvBlock);
+}
+
+static inline void* CoreMalloc(size_t nSize, CORE_ALLOC_SITE nSite) {
+  (void) nSite;
+  return AllocateBlock(nSize);
+}
+
+static inline void* CoreRealloc(void* pvBlock, size_t nSize,
+    CORE_ALLOC_SITE nSite) {
+  (void) nSite;
+  return ReallocateBlock(pvBlock, nSize);
+}
+
+#endif //COMMON_CORE_TRACK_ALLOCATIONS
+
+#endif /* __CORE_ALLOC_H__ */
@@ -0,0 +1,69 @@
+// core_error.c - Implementation of the thread-local last-error record
+
+#include "stdafx.h"
+#include "core_error.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only variables
+
+static __thread CORE_ERROR_INFO s_lastError;
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// ClearLastCoreError function
+
+void ClearLastCoreError(void) {
+  s_lastError.nCode = CORE_ERROR_NONE;
+  s_lastError.nErrno = 0;
+  s_lastError.szMessage[0] = '\0';
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetLastCoreError function
+
+int GetLastCoreError(void) {
+  return s_lastError.nCode;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetLastCoreErrorInfo function
+
+void GetLastCoreErrorInfo(LPCORE_ERROR_INFO pInfo) {
+  if (pInfo == NULL) {
+    return;
+  }
+
+  memcpy(pInfo, &s_lastError, sizeof(CORE_ERROR_INFO));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetLastCoreErrorMessage function
+
+const char* GetLastCoreErrorMessage(void) {
+  return s_lastError.szMessage;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetLastCoreErrorNumber function
+
+int GetLastCoreErrorNumber(void) {
+  return s_lastError.nErrno;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetLastCoreError function
+
+void SetLastCoreError(int nCode, const char* pszMessage) {
+  s_lastError.nErrno = errno;
+  s_lastError.nCode = nCode;
+
+  if (pszMessage == NULL) {
+    s_lastError.szMessage[0] = '\0';
+    return;
+  }
+
+  strncpy(s_lastError.szMessage, pszMessage, CORE_ERROR_MESSAGE_SIZE - 1);
+  s_lastError.szMessage[CORE_ERROR_MESSAGE_SIZE - 1] = '\0';
+}
@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_fold.h - Case folding as EqualsNoCase does it, for the structures that hash and compare
+// strings without regard to case
+//
+// EqualsNoCase folds with tolower(3), which depends on the locale; a structure snapshots the
+// folding into a table when it is created, so that its hashes stay consistent however the
+// locale changes afterwards.  In the C locale, and in the UTF-8 locales, the table folds ASCII
+// letters only, and long keys are then hashed with the word-at-a-time HashBytesNoCase; short
+// ones fold through the table faster than they can be set up for it.
+
+#ifndef __CORE_FOLD_H__
+#define __CORE_FOLD_H__
+
+#include "stdafx.h"
+#include "string_hash.h"
+
+/* tolower(3) of every byte, as of when the table was built */
+typedef struct _CASE_FOLD {
+  BOOL bAsciiOnly;                  /* folds 'A'-'Z' and nothing else */
+  unsigned char table[UCHAR_MAX + 1];
+} CASE_FOLD;
+
+/**
+ * @brief Snapshots tolower(3) in the current locale.
+ */
+static inline void BuildCaseFold(CASE_FOLD* pFold) {
+  pFold->bAsciiOnly = TRUE;
+  for (int i = 0; i <= UCHAR_MAX; i++) {
+    pFold->table[i] = (unsigned char) tolower(i);
+    if (pFold->table[i] != (i >= 'A' && i <= 'Z' ? i + 'a' - 'A' : i)) {
+      pFold->bAsciiOnly = FALSE;
+    }
+  }
+}
+
+/**
+ * @brief Hashes nLength characters folded through the table; strings that
+ * EqualsFolded finds equal hash the same.
+ */
+static inline uint64_t HashFolded(const CASE_FOLD* pFold, const char* pchKey,
+    size_t nLength) {
+  unsigned char chunk[256];
+  if (nLength <= sizeof(chunk)) {
+    for (size_t i = 0; i < nLength; i++) {
+      chunk[i] = pFold->table[(unsigned char) pchKey[i]];
+    }
+    return HashBytes(chunk, nLength);
+  }
+
+  if (pFold->bAsciiOnly) {
+    return HashBytesNoCase(pchKey, nLength);
+  }
+
+  STRING_HASH_STATE state;
+  BeginStringHash(&state, STRING_HASH_DEFAULT_SEED);
+  for (size_t nDone = 0; nDone < nLength; ) {
+    const size_t PIECE = nLength - nDone < sizeof(chunk)
+        ? nLength - nDone : sizeof(chunk);
+    for (size_t i = 0; i < PIECE; i++) {
+      chunk[i] = pFold->table[(unsigned char) pchKey[nDone + i]];
+    }
+    UpdateStringHash(&state, chunk, PIECE);
+    nDone += PIECE;
+  }
+  return EndStringHash(&state);
+}
+
+/**
+ * @brief Compares nLength characters of two strings folded through the
+ * table, as EqualsNoCase would.
+ */
+static inline BOOL EqualsFolded(const CASE_FOLD* pFold, const char* pchLeft,
+    const char* pchRight, size_t nLength) {
+  for (size_t i = 0; i < nLength; i++) {
+    if (pFold->table[(unsigned char) pchLeft[i]]
+        != pFold->table[(unsigned char) pchRight[i]]) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+#endif /* __CORE_FOLD_H__ */
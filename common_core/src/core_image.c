@@ -0,0 +1,220 @@
+// core_image.c - Implementation of the files of mapped_image.h
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "core_image.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define IMAGE_MAGIC             0x4d494343U     /* "CCIM" */
+#define IMAGE_BYTE_ORDER        0x01020304U
+#define IMAGE_VERSION           1
+
+/* The first 64 bytes of every file, in the byte order of the writer */
+typedef struct _IMAGE_HEADER {
+  uint32_t nMagic;
+  uint32_t nByteOrder;          /* IMAGE_BYTE_ORDER, as the writer stores it */
+  uint32_t nVersion;
+  uint32_t nKind;
+  uint64_t ullPayloadSize;
+  uint64_t ullChecksum;         /* HashBytes of the payload */
+  uint64_t ullReserved[4];      /* zero */
+} IMAGE_HEADER;
+
+/* Tells temporary files of the same process apart */
+static atomic_uint s_nTemporaryFiles;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// SetImageError function - Records an error about a file, naming the
+// public function and the file.
+//
+
+static void SetImageError(int nCode, const char* pszCaller,
+    const char* pszWhat, const char* pszPath) {
+  char szMessage[CORE_ERROR_MESSAGE_SIZE];
+  snprintf(szMessage, sizeof(szMessage), "%s: %s %s", pszCaller, pszWhat,
+      pszPath);
+  SetLastCoreError(nCode, szMessage);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteFully function - Writes all of a range of bytes, however many calls
+// it takes.  Returns FALSE, with errno set, if writing failed.
+//
+
+static BOOL WriteFully(int nFile, const void* pvData, size_t nSize) {
+  const char* pch = (const char*) pvData;
+  while (nSize > 0) {
+    const ssize_t WRITTEN = write(nFile, pch, nSize);
+    if (WRITTEN < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return FALSE;
+    }
+    pch += WRITTEN;
+    nSize -= (size_t) WRITTEN;
+  }
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// IsImageChecksumValid function
+
+BOOL IsImageChecksumValid(const IMAGE_MAPPING* pMapping) {
+  if (pMapping->pvBase == NULL) {
+    return TRUE;
+  }
+
+  const IMAGE_HEADER* pHeader = (const IMAGE_HEADER*) pMapping->pvBase;
+  return HashBytes(pMapping->pbPayload, pMapping->nPayloadSize)
+      == pHeader->ullChecksum;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MapImageFile function
+
+int MapImageFile(const char* pszPath, IMAGE_KIND nKind, int nFlags,
+    IMAGE_MAPPING* pMapping, const char* pszCaller) {
+  memset(pMapping, 0, sizeof(IMAGE_MAPPING));
+
+  const int DESCRIPTOR = open(pszPath, O_RDONLY | O_CLOEXEC);
+  if (DESCRIPTOR < 0) {
+    SetImageError(CORE_ERROR_SYSTEM, pszCaller, "cannot open", pszPath);
+    return ERROR;
+  }
+
+  struct stat fileStat;
+  if (fstat(DESCRIPTOR, &fileStat) != 0) {
+    SetImageError(CORE_ERROR_SYSTEM, pszCaller, "cannot stat", pszPath);
+    close(DESCRIPTOR);
+    return ERROR;
+  }
+
+  if ((uint64_t) fileStat.st_size < sizeof(IMAGE_HEADER)
+      || (uint64_t) fileStat.st_size > SIZE_MAX) {
+    SetImageError(CORE_ERROR_INVALID_ARGUMENT, pszCaller,
+        "no structure in", pszPath);
+    close(DESCRIPTOR);
+    return ERROR;
+  }
+
+  /* The mapping outlives the descriptor */
+  const size_t SIZE = (size_t) fileStat.st_size;
+  void* pvBase = mmap(NULL, SIZE, PROT_READ, MAP_PRIVATE
+      | ((nFlags & MAPPED_IMAGE_POPULATE) ? MAP_POPULATE : 0), DESCRIPTOR, 0);
+  close(DESCRIPTOR);
+  if (pvBase == MAP_FAILED) {
+    SetImageError(CORE_ERROR_SYSTEM, pszCaller, "cannot map", pszPath);
+    return ERROR;
+  }
+
+  pMapping->pvBase = pvBase;
+  pMapping->nMappingSize = SIZE;
+  pMapping->pbPayload = (const unsigned char*) pvBase + sizeof(IMAGE_HEADER);
+  pMapping->nPayloadSize = SIZE - sizeof(IMAGE_HEADER);
+
+  const IMAGE_HEADER* pHeader = (const IMAGE_HEADER*) pvBase;
+  const char* pszProblem = NULL;
+  if (pHeader->nMagic != IMAGE_MAGIC) {
+    pszProblem = "no structure in";
+  } else if (pHeader->nByteOrder != IMAGE_BYTE_ORDER) {
+    pszProblem = "wrong byte order in";
+  } else if (pHeader->nVersion != IMAGE_VERSION) {
+    pszProblem = "unsupported version in";
+  } else if (pHeader->nKind != (uint32_t) nKind) {
+    pszProblem = "wrong kind of structure in";
+  } else if (pHeader->ullPayloadSize != pMapping->nPayloadSize) {
+    pszProblem = "truncated structure in";
+  } else if ((nFlags & MAPPED_IMAGE_VERIFY)
+      && !IsImageChecksumValid(pMapping)) {
+    pszProblem = "checksum mismatch in";
+  }
+
+  if (pszProblem != NULL) {
+    SetImageError(CORE_ERROR_INVALID_ARGUMENT, pszCaller, pszProblem,
+        pszPath);
+    UnmapImageFile(pMapping);
+    return ERROR;
+  }
+
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UnmapImageFile function
+
+void UnmapImageFile(IMAGE_MAPPING* pMapping) {
+  if (pMapping->pvBase == NULL) {
+    return;
+  }
+
+  munmap(pMapping->pvBase, pMapping->nMappingSize);
+  memset(pMapping, 0, sizeof(IMAGE_MAPPING));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteImageFile function
+
+int WriteImageFile(const char* pszPath, IMAGE_KIND nKind,
+    const struct iovec* pPieces, int nPieces, const char* pszCaller) {
+  IMAGE_HEADER header;
+  STRING_HASH_STATE hashState;
+  memset(&header, 0, sizeof(header));
+  header.nMagic = IMAGE_MAGIC;
+  header.nByteOrder = IMAGE_BYTE_ORDER;
+  header.nVersion = IMAGE_VERSION;
+  header.nKind = (uint32_t) nKind;
+
+  BeginStringHash(&hashState, STRING_HASH_DEFAULT_SEED);
+  for (int i = 0; i < nPieces; i++) {
+    UpdateStringHash(&hashState, pPieces[i].iov_base, pPieces[i].iov_len);
+    header.ullPayloadSize += pPieces[i].iov_len;
+  }
+  header.ullChecksum = EndStringHash(&hashState);
+
+  const size_t NAME_SIZE = strlen(pszPath) + 48;
+  char* pszTemporary = (char*) malloc(NAME_SIZE);
+  if (pszTemporary == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, pszCaller);
+    return ERROR;
+  }
+  snprintf(pszTemporary, NAME_SIZE, "%s.%ld.%u.tmp", pszPath,
+      (long) getpid(), atomic_fetch_add(&s_nTemporaryFiles, 1));
+
+  const int DESCRIPTOR = open(pszTemporary,
+      O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (DESCRIPTOR < 0) {
+    SetImageError(CORE_ERROR_SYSTEM, pszCaller, "cannot create", pszPath);
+    free(pszTemporary);
+    return ERROR;
+  }
+
+  BOOL bWritten = WriteFully(DESCRIPTOR, &header, sizeof(header));
+  for (int i = 0; i < nPieces && bWritten; i++) {
+    bWritten = WriteFully(DESCRIPTOR, pPieces[i].iov_base, pPieces[i].iov_len);
+  }
+
+  /* close(2) may report a write that failed late */
+  if (close(DESCRIPTOR) != 0) {
+    bWritten = FALSE;
+  }
+
+  if (!bWritten || rename(pszTemporary, pszPath) != 0) {
+    SetImageError(CORE_ERROR_SYSTEM, pszCaller,
+        bWritten ? "cannot rename to" : "cannot write", pszPath);
+    unlink(pszTemporary);
+    free(pszTemporary);
+    return ERROR;
+  }
+
+  free(pszTemporary);
+  return OK;
+}
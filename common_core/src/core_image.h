@@ -0,0 +1,73 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_image.h - Writing and mapping the files of mapped_image.h, for the structures that save
+// themselves to one
+//
+// A file is an IMAGE_HEADER followed by the payload, which the structure lays out as it likes,
+// with offsets only.  The payload starts 64 bytes into the file, and so on a cache line
+// boundary once mapped.
+
+#ifndef __CORE_IMAGE_H__
+#define __CORE_IMAGE_H__
+
+#include "stdafx.h"
+#include "mapped_image.h"
+
+/* Kinds of structure a file may hold */
+typedef enum _IMAGE_KIND {
+  IMAGE_KIND_STRING_INDEX = 1,
+  IMAGE_KIND_PREFIX_SET = 2,
+  IMAGE_KIND_BLOOM_FILTER = 3
+} IMAGE_KIND;
+
+/* A mapped file.  pvBase is NULL for structures built in memory. */
+typedef struct _IMAGE_MAPPING {
+  void* pvBase;
+  size_t nMappingSize;
+  const unsigned char* pbPayload;
+  size_t nPayloadSize;
+} IMAGE_MAPPING;
+
+/**
+ * @brief Tells whether the checksum of a mapped file matches its payload.
+ * @returns TRUE if it matches, or if pMapping maps nothing.
+ */
+BOOL IsImageChecksumValid(const IMAGE_MAPPING* pMapping);
+
+/**
+ * @brief Maps a file and checks its header, and its checksum if nFlags has
+ * MAPPED_IMAGE_VERIFY.
+ * @param pszPath Path of the file.
+ * @param nKind Kind of structure the file must hold.
+ * @param nFlags MAPPED_IMAGE_* flags.
+ * @param pMapping Receives the mapping.
+ * @param pszCaller Name of the public function, for error messages.
+ * @returns OK on success; ERROR, with the last-error record set, if the
+ * file cannot be opened or mapped, or does not hold an intact structure of
+ * the kind.
+ * @remarks The structure must still check that the payload has the size
+ * its own header says.
+ */
+int MapImageFile(const char* pszPath, IMAGE_KIND nKind, int nFlags,
+    IMAGE_MAPPING* pMapping, const char* pszCaller);
+
+/**
+ * @brief Unmaps a file mapped by MapImageFile.  Nothing happens if
+ * pMapping maps nothing.
+ */
+void UnmapImageFile(IMAGE_MAPPING* pMapping);
+
+/**
+ * @brief Writes a payload, given in pieces, behind a header, to a temporary
+ * file that it then renames to pszPath.
+ * @param pszPath Path of the file.
+ * @param nKind Kind of structure the payload holds.
+ * @param pPieces The pieces of the payload, in order.
+ * @param nPieces Number of pieces.
+ * @param pszCaller Name of the public function, for error messages.
+ * @returns OK on success; ERROR, with the last-error record set, if the
+ * file cannot be written, in which case no file is left behind.
+ */
+int WriteImageFile(const char* pszPath, IMAGE_KIND nKind,
+    const struct iovec* pPieces, int nPieces, const char* pszCaller);
+
+#endif /* __CORE_IMAGE_H__ */
@@ -0,0 +1,321 @@
+// core_kernels.c - Scalar string and integer-array kernels, and selection of the kernel tier for this CPU
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "cpu_dispatch.h"
+#include "core_kernels.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+static const char* s_pszTierNames[CORE_CPU_TIER_COUNT] = {
+  "scalar", "sse42", "avx2", "avx512"
+};
+
+/* Kernels of each tier; NULL for tiers this build cannot run */
+static const CORE_KERNELS* const s_pTierKernels[CORE_CPU_TIER_COUNT] = {
+  &g_scalarCoreKernels,
+#if defined(__x86_64__) || defined(__i386__)
+  &g_sse42CoreKernels,
+  &g_avx2CoreKernels,
+  &g_avx512CoreKernels
+#else
+  NULL, NULL, NULL
+#endif
+};
+
+static CORE_CPU_TIER s_nSupportedTier = CORE_CPU_TIER_SCALAR;
+static _Atomic CORE_CPU_TIER s_nTier = CORE_CPU_TIER_SCALAR;
+
+/* Scalar until the library's constructor has looked at the CPU */
+const CORE_KERNELS* _Atomic g_pCoreKernels = &g_scalarCoreKernels;
+
+///////////////////////////////////////////////////////////////////////////////
+// Scalar kernels
+
+static size_t ScalarSpanDigits(const char* pchData, size_t nLength) {
+  size_t i = 0;
+  while (i < nLength && (unsigned char) (pchData[i] - '0') < 10) {
+    i++;
+  }
+  return i;
+}
+
+static size_t ScalarSpanAlnum(const char* pchData, size_t nLength) {
+  size_t i = 0;
+  while (i < nLength && ((unsigned char) (pchData[i] - '0') < 10
+      || (unsigned char) ((pchData[i] | 0x20) - 'a') < 26)) {
+    i++;
+  }
+  return i;
+}
+
+static size_t ScalarSpanUpper(const char* pchData, size_t nLength) {
+  size_t i = 0;
+  while (i < nLength && (unsigned char) (pchData[i] - 'A') < 26) {
+    i++;
+  }
+  return i;
+}
+
+static inline BOOL IsAsciiSpace(char ch) {
+  return ch == ' ' || (unsigned char) (ch - '\t') < 5;
+}
+
+static size_t ScalarSpanSpace(const char* pchData, size_t nLength) {
+  size_t i = 0;
+  while (i < nLength && IsAsciiSpace(pchData[i])) {
+    i++;
+  }
+  return i;
+}
+
+static size_t ScalarReverseSpanSpace(const char* pchData, size_t nLength) {
+  size_t i = 0;
+  while (i < nLength && IsAsciiSpace(pchData[nLength - i - 1])) {
+    i++;
+  }
+  return i;
+}
+
+static size_t ScalarFindAnyOf(const char* pchData, size_t nLength,
+    const char* pchSet, size_t nSet) {
+  if (nSet == 1) {
+    const char* pchFound = (const char*) memchr(pchData, pchSet[0], nLength);
+    return pchFound != NULL ? (size_t) (pchFound - pchData) : nLength;
+  }
+
+  return FindAnyOfByTable(pchData, nLength, pchSet, nSet);
+}
+
+static size_t ScalarCountByte(const char* pchData, size_t nLength,
+    char chFind) {
+  size_t nCount = 0;
+  for (size_t i = 0; i < nLength; i++) {
+    nCount += pchData[i] == chFind;
+  }
+  return nCount;
+}
+
+/* Every byte's offset is stored; only a match moves past it */
+static size_t ScalarFindByteOffsets(const char* pchData, size_t nLength,
+    char chFind, uint32_t nBase, uint32_t* pnOffsets) {
+  size_t nCount = 0;
+  for (size_t i = 0; i < nLength; i++) {
+    pnOffsets[nCount] = nBase + (uint32_t) i;
+    nCount += pchData[i] == chFind;
+  }
+  return nCount;
+}
+
+/* The conditional expressions compile to conditional moves, so random data
+ * costs no mispredicted branches */
+#define SCALAR_EXTREMUM_KERNEL(Name, Type, Identity, Op)                     \
+static Type Scalar##Name(const Type* pValues, size_t nCount) {                \
+  Type result = Identity;                                                     \
+  for (size_t i = 0; i < nCount; i++) {                                       \
+    result = pValues[i] Op result ? pValues[i] : result;                      \
+  }                                                                           \
+  return result;                                                              \
+}
+
+SCALAR_EXTREMUM_KERNEL(MinimumInt, int, INT_MAX, <)
+SCALAR_EXTREMUM_KERNEL(MaximumInt, int, INT_MIN, >)
+SCALAR_EXTREMUM_KERNEL(MinimumInt64, int64_t, INT64_MAX, <)
+SCALAR_EXTREMUM_KERNEL(MaximumInt64, int64_t, INT64_MIN, >)
+SCALAR_EXTREMUM_KERNEL(MinimumUint64, uint64_t, UINT64_MAX, <)
+SCALAR_EXTREMUM_KERNEL(MaximumUint64, uint64_t, 0, >)
+
+static int64_t ScalarSumInt(const int* pnValues, size_t nCount) {
+  int64_t llSum = 0;
+  for (size_t i = 0; i < nCount; i++) {
+    llSum += pnValues[i];
+  }
+  return llSum;
+}
+
+static uint64_t ScalarSumUint64(const uint64_t* pullValues, size_t nCount) {
+  uint64_t ullSum = 0;
+  for (size_t i = 0; i < nCount; i++) {
+    ullSum += pullValues[i];
+  }
+  return ullSum;
+}
+
+#define SCALAR_CLAMP_KERNEL(Name, Type)                                       \
+static void Scalar##Name(Type* pValues, size_t nCount, Type low,              \
+    Type high) {                                                              \
+  for (size_t i = 0; i < nCount; i++) {                                       \
+    const Type VALUE = pValues[i] < low ? low : pValues[i];                   \
+    pValues[i] = VALUE > high ? high : VALUE;                                 \
+  }                                                                           \
+}
+
+SCALAR_CLAMP_KERNEL(ClampInt, int)
+SCALAR_CLAMP_KERNEL(ClampInt64, int64_t)
+SCALAR_CLAMP_KERNEL(ClampUint64, uint64_t)
+
+const CORE_KERNELS g_scalarCoreKernels = {
+  ScalarSpanDigits,
+  ScalarSpanAlnum,
+  ScalarSpanUpper,
+  ScalarSpanSpace,
+  ScalarReverseSpanSpace,
+  ScalarFindAnyOf,
+  ScalarCountByte,
+  ScalarFindByteOffsets,
+  ScalarMinimumInt,
+  ScalarMaximumInt,
+  ScalarMinimumInt64,
+  ScalarMaximumInt64,
+  ScalarMinimumUint64,
+  ScalarMaximumUint64,
+  ScalarSumInt,
+  ScalarSumUint64,
+  ScalarClampInt,
+  ScalarClampInt64,
+  ScalarClampUint64
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// DetectSupportedTier function - Asks the CPU, and through it the operating
+// system, which tiers can run.  Each tier needs every extension its kernels
+// are compiled for (see core_kernels_x86.c), POPCNT included: a hypervisor
+// may hide that one while exposing the vector extensions.
+//
+
+static CORE_CPU_TIER DetectSupportedTier(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+
+  if (!__builtin_cpu_supports("popcnt")) {
+    return CORE_CPU_TIER_SCALAR;
+  }
+
+  if (__builtin_cpu_supports("avx512f")
+      && __builtin_cpu_supports("avx512bw")) {
+    return CORE_CPU_TIER_AVX512;
+  }
+
+  if (__builtin_cpu_supports("avx2")) {
+    return CORE_CPU_TIER_AVX2;
+  }
+
+  if (__builtin_cpu_supports("sse4.2")) {
+    return CORE_CPU_TIER_SSE42;
+  }
+#endif
+
+  return CORE_CPU_TIER_SCALAR;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UseTier function - Publishes the kernels of a tier.
+//
+
+static void UseTier(CORE_CPU_TIER nTier) {
+  atomic_store(&s_nTier, nTier);
+  atomic_store(&g_pCoreKernels, s_pTierKernels[nTier]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InitializeCoreKernels function - Picks the tier when the library is
+// loaded: the best one supported, unless COMMON_CORE_CPU_TIER asks for
+// another.
+//
+
+__attribute__((constructor))
+static void InitializeCoreKernels(void) {
+  s_nSupportedTier = DetectSupportedTier();
+
+  CORE_CPU_TIER nTier = s_nSupportedTier;
+
+  const char* pszRequested = getenv(COMMON_CORE_CPU_TIER_ENV);
+  if (pszRequested != NULL && pszRequested[0] != '\0') {
+    int nRequested = 0;
+    while (nRequested < CORE_CPU_TIER_COUNT
+        && strcasecmp(pszRequested, s_pszTierNames[nRequested]) != 0) {
+      nRequested++;
+    }
+
+    if (nRequested == CORE_CPU_TIER_COUNT) {
+      LogDiagnosticFormat("common_core: ignoring unknown %s '%s'.\n",
+          COMMON_CORE_CPU_TIER_ENV, pszRequested);
+    } else if (nRequested > (int) s_nSupportedTier) {
+      LogDiagnosticFormat("common_core: %s '%s' is not supported by this "
+          "CPU; using '%s'.\n", COMMON_CORE_CPU_TIER_ENV, pszRequested,
+          s_pszTierNames[s_nSupportedTier]);
+    } else {
+      nTier = (CORE_CPU_TIER) nRequested;
+    }
+  }
+
+  UseTier(nTier);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// FindAnyOfByTable function
+
+size_t FindAnyOfByTable(const char* pchData, size_t nLength,
+    const char* pchSet, size_t nSet) {
+  BOOL bInSet[256] = { FALSE };
+  for (size_t i = 0; i < nSet; i++) {
+    bInSet[(unsigned char) pchSet[i]] = TRUE;
+  }
+
+  size_t i = 0;
+  while (i < nLength && !bInSet[(unsigned char) pchData[i]]) {
+    i++;
+  }
+  return i;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetCoreCpuTier function
+
+CORE_CPU_TIER GetCoreCpuTier(void) {
+  return atomic_load(&s_nTier);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetCoreCpuTierName function
+
+const char* GetCoreCpuTierName(CORE_CPU_TIER nTier) {
+  if ((int) nTier < 0 || nTier >= CORE_CPU_TIER_COUNT) {
+    return NULL;
+  }
+
+  return s_pszTierNames[nTier];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetSupportedCoreCpuTier function
+
+CORE_CPU_TIER GetSupportedCoreCpuTier(void) {
+  return s_nSupportedTier;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SetCoreCpuTier function
+
+int SetCoreCpuTier(CORE_CPU_TIER nTier) {
+  if ((int) nTier < 0 || nTier >= CORE_CPU_TIER_COUNT) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "SetCoreCpuTier: nTier");
+    return ERROR;
+  }
+
+  if (nTier > s_nSupportedTier) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "SetCoreCpuTier: tier not supported by this CPU");
+    return ERROR;
+  }
+
+  UseTier(nTier);
+  return OK;
+}
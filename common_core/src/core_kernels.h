@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_kernels.h - Vectorized string and integer-array kernels and the table through which the
+// library calls the variant selected for this CPU
+//
+// The kernels classify ASCII only, which every locale glibc supports agrees on.  A span stops at
+// the first byte outside the class, including any byte of 0x80 and up; the Span* wrappers below
+// then consult the C library's locale-aware classification for such bytes, so the results match
+// isdigit, isalnum, isupper and isspace exactly.
+//
+// The integer kernels reduce or clamp arrays of int, int64_t and uint64_t without branching on the
+// data, so that their speed does not depend on its order.
+
+#ifndef __CORE_KERNELS_H__
+#define __CORE_KERNELS_H__
+
+#include "stdafx.h"
+#include "cpu_dispatch.h"
+
+/**
+ * @brief Largest delimiter set FindAnyOf kernels handle with vector
+ * instructions; larger sets fall back to a lookup table.
+ */
+#define CORE_KERNEL_MAX_VECTOR_SET    16
+
+/**
+ * @brief One tier's implementation of every kernel.  All of them take an
+ * explicit length and do not stop at null bytes.
+ */
+typedef struct _CORE_KERNELS {
+  /* Number of leading bytes that are ASCII digits */
+  size_t (*pfnSpanDigits)(const char* pchData, size_t nLength);
+
+  /* Number of leading bytes that are ASCII letters or digits */
+  size_t (*pfnSpanAlnum)(const char* pchData, size_t nLength);
+
+  /* Number of leading bytes that are ASCII uppercase letters */
+  size_t (*pfnSpanUpper)(const char* pchData, size_t nLength);
+
+  /* Number of leading bytes that are ASCII whitespace, " \t\n\v\f\r" */
+  size_t (*pfnSpanSpace)(const char* pchData, size_t nLength);
+
+  /* Number of trailing bytes that are ASCII whitespace */
+  size_t (*pfnReverseSpanSpace)(const char* pchData, size_t nLength);
+
+  /* Index of the first byte that is one of the nSet bytes of pchSet, or
+   * nLength if there is none */
+  size_t (*pfnFindAnyOf)(const char* pchData, size_t nLength,
+      const char* pchSet, size_t nSet);
+
+  /* Number of bytes equal to chFind */
+  size_t (*pfnCountByte)(const char* pchData, size_t nLength, char chFind);
+
+  /* Writes nBase plus the index of each byte equal to chFind, in order, to
+   * pnOffsets, and returns how many it wrote.  pnOffsets has room for
+   * nLength offsets, which the kernel may write past its last one, and
+   * nBase + nLength does not exceed 2^32. */
+  size_t (*pfnFindByteOffsets)(const char* pchData, size_t nLength,
+      char chFind, uint32_t nBase, uint32_t* pnOffsets);
+
+  /* Least and greatest of nCount values; the type's largest and smallest
+   * value, respectively, if nCount is zero */
+  int (*pfnMinimumInt)(const int* pnValues, size_t nCount);
+  int (*pfnMaximumInt)(const int* pnValues, size_t nCount);
+  int64_t (*pfnMinimumInt64)(const int64_t* pllValues, size_t nCount);
+  int64_t (*pfnMaximumInt64)(const int64_t* pllValues, size_t nCount);
+  uint64_t (*pfnMinimumUint64)(const uint64_t* pullValues, size_t nCount);
+  uint64_t (*pfnMaximumUint64)(const uint64_t* pullValues, size_t nCount);
+
+  /* Sum of nCount ints, which cannot overflow for fewer than 2^32 of them */
+  int64_t (*pfnSumInt)(const int* pnValues, size_t nCount);
+
+  /* Sum of nCount 64-bit values modulo 2^64, which also serves int64_t */
+  uint64_t (*pfnSumUint64)(const uint64_t* pullValues, size_t nCount);
+
+  /* Replaces each of nCount values with the nearest value in [low, high],
+   * low <= high */
+  void (*pfnClampInt)(int* pnValues, size_t nCount, int low, int high);
+  void (*pfnClampInt64)(int64_t* pllValues, size_t nCount, int64_t low,
+      int64_t high);
+  void (*pfnClampUint64)(uint64_t* pullValues, size_t nCount, uint64_t low,
+      uint64_t high);
+} CORE_KERNELS, *LPCORE_KERNELS;
+
+extern const CORE_KERNELS g_scalarCoreKernels;
+
+#if defined(__x86_64__) || defined(__i386__)
+extern const CORE_KERNELS g_sse42CoreKernels;
+extern const CORE_KERNELS g_avx2CoreKernels;
+extern const CORE_KERNELS g_avx512CoreKernels;
+#endif
+
+/* Table of the tier in use; see GetCoreKernels */
+extern const CORE_KERNELS* _Atomic g_pCoreKernels;
+
+/**
+ * @brief Gets the kernels of the tier in use.  Fetch them once per call of a
+ * public function, so that the call runs on one tier throughout.
+ */
+static inline const CORE_KERNELS* GetCoreKernels(void) {
+  return atomic_load_explicit(&g_pCoreKernels, memory_order_relaxed);
+}
+
+/**
+ * @brief Finds the lookup-table answer to FindAnyOf; shared by the tiers for
+ * sets too large for their vector code.
+ */
+size_t FindAnyOfByTable(const char* pchData, size_t nLength,
+    const char* pchSet, size_t nSet);
+
+/**
+ * @brief Extends an ASCII span across the non-ASCII bytes that the locale
+ * puts in the class.
+ */
+static inline size_t SpanClass(size_t (*pfnSpan)(const char*, size_t),
+    int (*pfnIsClass)(int), const char* pchData, size_t nLength) {
+  size_t nSpan = 0;
+
+  for (;;) {
+    nSpan += pfnSpan(pchData + nSpan, nLength - nSpan);
+    if (nSpan == nLength || (unsigned char) pchData[nSpan] < 0x80
+        || !pfnIsClass((unsigned char) pchData[nSpan])) {
+      return nSpan;
+    }
+    nSpan++;
+  }
+}
+
+static inline size_t SpanDigits(const CORE_KERNELS* pKernels,
+    const char* pchData, size_t nLength) {
+  return SpanClass(pKernels->pfnSpanDigits, isdigit, pchData, nLength);
+}
+
+static inline size_t SpanAlnum(const CORE_KERNELS* pKernels,
+    const char* pchData, size_t nLength) {
+  return SpanClass(pKernels->pfnSpanAlnum, isalnum, pchData, nLength);
+}
+
+static inline size_t SpanUpper(const CORE_KERNELS* pKernels,
+    const char* pchData, size_t nLength) {
+  return SpanClass(pKernels->pfnSpanUpper, isupper, pchData, nLength);
+}
+
+static inline size_t SpanSpace(const CORE_KERNELS* pKernels,
+    const char* pchData, size_t nLength) {
+  return SpanClass(pKernels->pfnSpanSpace, isspace, pchData, nLength);
+}
+
+/**
+ * @brief Number of trailing whitespace bytes, locale-aware like SpanSpace.
+ */
+static inline size_t ReverseSpanSpace(const CORE_KERNELS* pKernels,
+    const char* pchData, size_t nLength) {
+  size_t nSpan = 0;
+
+  for (;;) {
+    nSpan += pKernels->pfnReverseSpanSpace(pchData, nLength - nSpan);
+    if (nSpan == nLength) {
+      return nSpan;
+    }
+
+    const unsigned char CH = (unsigned char) pchData[nLength - nSpan - 1];
+    if (CH < 0x80 || !isspace(CH)) {
+      return nSpan;
+    }
+    nSpan++;
+  }
+}
+
+#endif /* __CORE_KERNELS_H__ */
@@ -0,0 +1,933 @@
+// core_kernels_x86.c - SSE4.2, AVX2 and AVX-512BW variants of the string and integer-array
+// kernels
+//
+// Each function carries the target attribute of its tier, so this file builds with the
+// library's ordinary flags; the dispatcher in core_kernels.c only calls a tier's functions on a
+// CPU that supports it.  Vector loops never read past the end of the data: SSE4.2 and AVX2
+// finish on the scalar kernels, and AVX-512 uses masked loads.  Minimum and maximum kernels
+// instead finish with vectors that overlap ones already seen, which does not change the result.
+
+#include "stdafx.h"
+#include "core_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define TARGET_SSE42      __attribute__((target("sse4.2,popcnt")))
+#define TARGET_AVX2       __attribute__((target("avx2,popcnt")))
+#define TARGET_AVX512     __attribute__((target("avx512f,avx512bw,popcnt")))
+
+/* Mask of the first nCount lanes of a 64-lane vector, nCount < 64 */
+#define LOW_LANES_64(nCount)    ((1ULL << (nCount)) - 1)
+
+/* PCMPESTRI mode of FindAnyOf; an immediate, so a macro rather than a const,
+ * which the compiler does not fold at -O0 */
+#define FIND_ANY_MODE           (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY \
+                                 | _SIDD_LEAST_SIGNIFICANT)
+
+/* Writes nBase plus the index of each set bit of ullMatches to pnOffsets,
+ * four at a time, so that the loop branches on the number of matches but
+ * not on where they fall; the last group writes up to three offsets past
+ * the matches.  Setting bit 63 keeps __builtin_ctzll defined once the
+ * matches run out.  Returns the number of matches. */
+static inline size_t AppendMatchOffsets(uint64_t ullMatches, uint32_t nBase,
+    uint32_t* pnOffsets) {
+  const int COUNT = __builtin_popcountll(ullMatches);
+  for (int k = 0; k < COUNT; k += 4) {
+    for (int j = 0; j < 4; j++) {
+      pnOffsets[k + j] = nBase
+          + (uint32_t) __builtin_ctzll(ullMatches | (1ULL << 63));
+      ullMatches &= ullMatches - 1;
+    }
+  }
+  return (size_t) COUNT;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SSE4.2 kernels
+
+/* Lanes of x that lie in [lo, hi]: biased so that one signed compare does */
+TARGET_SSE42
+static inline __m128i Sse42InRange(__m128i x, char lo, char hi) {
+  return _mm_cmplt_epi8(_mm_add_epi8(x, _mm_set1_epi8((char) (0x80 - lo))),
+      _mm_set1_epi8((char) (0x80 + hi - lo + 1)));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42Digits(__m128i x) {
+  return Sse42InRange(x, '0', '9');
+}
+
+TARGET_SSE42
+static inline __m128i Sse42Alnum(__m128i x) {
+  return _mm_or_si128(Sse42InRange(x, '0', '9'),
+      Sse42InRange(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 'z'));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42Upper(__m128i x) {
+  return Sse42InRange(x, 'A', 'Z');
+}
+
+TARGET_SSE42
+static inline __m128i Sse42Space(__m128i x) {
+  return _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+      Sse42InRange(x, '\t', '\r'));
+}
+
+#define SSE42_SPAN_KERNEL(Class)                                              \
+TARGET_SSE42                                                                  \
+static size_t Sse42Span##Class(const char* pchData, size_t nLength) {         \
+  size_t i = 0;                                                               \
+  for (; i + 16 <= nLength; i += 16) {                                        \
+    const __m128i DATA = _mm_loadu_si128((const __m128i*) (pchData + i));     \
+    const unsigned OUTSIDE =                                                  \
+        (unsigned) _mm_movemask_epi8(Sse42##Class(DATA)) ^ 0xFFFFU;           \
+    if (OUTSIDE != 0) {                                                       \
+      return i + __builtin_ctz(OUTSIDE);                                      \
+    }                                                                         \
+  }                                                                           \
+  return i + g_scalarCoreKernels.pfnSpan##Class(pchData + i, nLength - i);    \
+}
+
+SSE42_SPAN_KERNEL(Digits)
+SSE42_SPAN_KERNEL(Alnum)
+SSE42_SPAN_KERNEL(Upper)
+SSE42_SPAN_KERNEL(Space)
+
+TARGET_SSE42
+static size_t Sse42ReverseSpanSpace(const char* pchData, size_t nLength) {
+  size_t nSpan = 0;
+  for (; nLength - nSpan >= 16; nSpan += 16) {
+    const __m128i DATA = _mm_loadu_si128(
+        (const __m128i*) (pchData + nLength - nSpan - 16));
+    const unsigned OUTSIDE =
+        (unsigned) _mm_movemask_epi8(Sse42Space(DATA)) ^ 0xFFFFU;
+    if (OUTSIDE != 0) {
+      return nSpan + __builtin_clz(OUTSIDE) - 16;
+    }
+  }
+  return nSpan + g_scalarCoreKernels.pfnReverseSpanSpace(pchData,
+      nLength - nSpan);
+}
+
+/* PCMPESTRI compares each byte of the data against up to 16 set bytes */
+TARGET_SSE42
+static size_t Sse42FindAnyOf(const char* pchData, size_t nLength,
+    const char* pchSet, size_t nSet) {
+  if (nSet == 1) {
+    // glibc's memchr is already vectorized for this CPU
+    const char* pchFound = (const char*) memchr(pchData, pchSet[0], nLength);
+    return pchFound != NULL ? (size_t) (pchFound - pchData) : nLength;
+  }
+
+  if (nSet > CORE_KERNEL_MAX_VECTOR_SET) {
+    return FindAnyOfByTable(pchData, nLength, pchSet, nSet);
+  }
+
+  char chSet[16] = { 0 };
+  memcpy(chSet, pchSet, nSet);
+  const __m128i SET = _mm_loadu_si128((const __m128i*) chSet);
+
+  size_t i = 0;
+  for (; i + 16 <= nLength; i += 16) {
+    const int INDEX = _mm_cmpestri(SET, (int) nSet,
+        _mm_loadu_si128((const __m128i*) (pchData + i)), 16, FIND_ANY_MODE);
+    if (INDEX < 16) {
+      return i + INDEX;
+    }
+  }
+
+  const int REMAINING = (int) (nLength - i);
+  if (REMAINING == 0) {
+    return nLength;
+  }
+
+  char chTail[16] = { 0 };
+  memcpy(chTail, pchData + i, REMAINING);
+  const int INDEX = _mm_cmpestri(SET, (int) nSet,
+      _mm_loadu_si128((const __m128i*) chTail), REMAINING, FIND_ANY_MODE);
+
+  return INDEX < REMAINING ? i + INDEX : nLength;
+}
+
+TARGET_SSE42
+static size_t Sse42CountByte(const char* pchData, size_t nLength,
+    char chFind) {
+  const __m128i FIND = _mm_set1_epi8(chFind);
+  size_t nCount = 0;
+
+  size_t i = 0;
+  for (; i + 16 <= nLength; i += 16) {
+    const __m128i DATA = _mm_loadu_si128((const __m128i*) (pchData + i));
+    nCount += __builtin_popcount(
+        (unsigned) _mm_movemask_epi8(_mm_cmpeq_epi8(DATA, FIND)));
+  }
+
+  return nCount + g_scalarCoreKernels.pfnCountByte(pchData + i, nLength - i,
+      chFind);
+}
+
+/* Matches are gathered 64 bytes at a time, so that a full group of
+ * AppendMatchOffsets stays within the room for those 64 offsets */
+TARGET_SSE42
+static size_t Sse42FindByteOffsets(const char* pchData, size_t nLength,
+    char chFind, uint32_t nBase, uint32_t* pnOffsets) {
+  const __m128i FIND = _mm_set1_epi8(chFind);
+  size_t nCount = 0;
+
+  size_t i = 0;
+  for (; i + 64 <= nLength; i += 64) {
+    uint64_t ullMatches = 0;
+    for (int k = 0; k < 4; k++) {
+      const __m128i DATA = _mm_loadu_si128(
+          (const __m128i*) (pchData + i + 16 * k));
+      ullMatches |= (uint64_t) (unsigned) _mm_movemask_epi8(
+          _mm_cmpeq_epi8(DATA, FIND)) << (16 * k);
+    }
+    nCount += AppendMatchOffsets(ullMatches, nBase + (uint32_t) i,
+        pnOffsets + nCount);
+  }
+
+  return nCount + g_scalarCoreKernels.pfnFindByteOffsets(pchData + i,
+      nLength - i, chFind, nBase + (uint32_t) i, pnOffsets + nCount);
+}
+
+/* SSE4.2 has no 64-bit minimum or maximum; a PCMPGTQ and a blend make one.
+ * Flipping the sign bits maps unsigned order onto signed order. */
+TARGET_SSE42
+static inline __m128i Sse42MinEpi64(__m128i a, __m128i b) {
+  return _mm_blendv_epi8(a, b, _mm_cmpgt_epi64(a, b));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42MaxEpi64(__m128i a, __m128i b) {
+  return _mm_blendv_epi8(b, a, _mm_cmpgt_epi64(a, b));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42GreaterEpu64(__m128i a, __m128i b) {
+  const __m128i SIGN = _mm_set1_epi64x(INT64_MIN);
+  return _mm_cmpgt_epi64(_mm_xor_si128(a, SIGN), _mm_xor_si128(b, SIGN));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42MinEpu64(__m128i a, __m128i b) {
+  return _mm_blendv_epi8(a, b, Sse42GreaterEpu64(a, b));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42MaxEpu64(__m128i a, __m128i b) {
+  return _mm_blendv_epi8(b, a, Sse42GreaterEpu64(a, b));
+}
+
+TARGET_SSE42
+static inline __m128i Sse42Load(const void* pvData) {
+  return _mm_loadu_si128((const __m128i*) pvData);
+}
+
+/* Four accumulators, so that each Pick waits on its load rather than on
+ * the Pick before it; the blends of the 64-bit ones take several cycles */
+#define SSE42_EXTREMUM_KERNEL(Name, Type, Pick)                               \
+TARGET_SSE42                                                                  \
+static Type Sse42##Name(const Type* pValues, size_t nCount) {                 \
+  const size_t LANES = 16 / sizeof(Type);                                     \
+  if (nCount < 4 * LANES) {                                                   \
+    return g_scalarCoreKernels.pfn##Name(pValues, nCount);                    \
+  }                                                                           \
+                                                                              \
+  __m128i acc0 = Sse42Load(pValues);                                          \
+  __m128i acc1 = Sse42Load(pValues + LANES);                                  \
+  __m128i acc2 = Sse42Load(pValues + 2 * LANES);                              \
+  __m128i acc3 = Sse42Load(pValues + 3 * LANES);                              \
+  for (size_t i = 4 * LANES; i < nCount; i += 4 * LANES) {                    \
+    /* The last block ends at the end of the data */                          \
+    const Type* pBlock = i + 4 * LANES <= nCount                              \
+        ? pValues + i : pValues + nCount - 4 * LANES;                         \
+    acc0 = Pick(acc0, Sse42Load(pBlock));                                     \
+    acc1 = Pick(acc1, Sse42Load(pBlock + LANES));                             \
+    acc2 = Pick(acc2, Sse42Load(pBlock + 2 * LANES));                         \
+    acc3 = Pick(acc3, Sse42Load(pBlock + 3 * LANES));                         \
+  }                                                                           \
+                                                                              \
+  Type lanes[16 / sizeof(Type)];                                              \
+  _mm_storeu_si128((__m128i*) lanes,                                          \
+      Pick(Pick(acc0, acc1), Pick(acc2, acc3)));                              \
+  return g_scalarCoreKernels.pfn##Name(lanes, LANES);                         \
+}
+
+SSE42_EXTREMUM_KERNEL(MinimumInt, int, _mm_min_epi32)
+SSE42_EXTREMUM_KERNEL(MaximumInt, int, _mm_max_epi32)
+SSE42_EXTREMUM_KERNEL(MinimumInt64, int64_t, Sse42MinEpi64)
+SSE42_EXTREMUM_KERNEL(MaximumInt64, int64_t, Sse42MaxEpi64)
+SSE42_EXTREMUM_KERNEL(MinimumUint64, uint64_t, Sse42MinEpu64)
+SSE42_EXTREMUM_KERNEL(MaximumUint64, uint64_t, Sse42MaxEpu64)
+
+/* Sign-extends each int to 64 bits before adding it */
+TARGET_SSE42
+static int64_t Sse42SumInt(const int* pnValues, size_t nCount) {
+  __m128i sum = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (; i + 4 <= nCount; i += 4) {
+    const __m128i DATA = _mm_loadu_si128((const __m128i*) (pnValues + i));
+    sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(DATA));
+    sum = _mm_add_epi64(sum, _mm_cvtepi32_epi64(_mm_srli_si128(DATA, 8)));
+  }
+
+  int64_t llLanes[2];
+  _mm_storeu_si128((__m128i*) llLanes, sum);
+  return llLanes[0] + llLanes[1]
+      + g_scalarCoreKernels.pfnSumInt(pnValues + i, nCount - i);
+}
+
+TARGET_SSE42
+static uint64_t Sse42SumUint64(const uint64_t* pullValues, size_t nCount) {
+  __m128i sum = _mm_setzero_si128();
+
+  size_t i = 0;
+  for (; i + 2 <= nCount; i += 2) {
+    sum = _mm_add_epi64(sum,
+        _mm_loadu_si128((const __m128i*) (pullValues + i)));
+  }
+
+  uint64_t ullLanes[2];
+  _mm_storeu_si128((__m128i*) ullLanes, sum);
+  return ullLanes[0] + ullLanes[1]
+      + g_scalarCoreKernels.pfnSumUint64(pullValues + i, nCount - i);
+}
+
+#define SSE42_CLAMP_KERNEL(Name, Type, Splat, Min, Max)                       \
+TARGET_SSE42                                                                  \
+static void Sse42##Name(Type* pValues, size_t nCount, Type low, Type high) {  \
+  const size_t LANES = 16 / sizeof(Type);                                     \
+  const __m128i LOW = Splat(low);                                             \
+  const __m128i HIGH = Splat(high);                                           \
+                                                                              \
+  size_t i = 0;                                                               \
+  for (; i + LANES <= nCount; i += LANES) {                                   \
+    __m128i* pVector = (__m128i*) (pValues + i);                              \
+    _mm_storeu_si128(pVector, Min(Max(_mm_loadu_si128(pVector), LOW), HIGH)); \
+  }                                                                           \
+  g_scalarCoreKernels.pfn##Name(pValues + i, nCount - i, low, high);          \
+}
+
+SSE42_CLAMP_KERNEL(ClampInt, int, _mm_set1_epi32, _mm_min_epi32,
+    _mm_max_epi32)
+SSE42_CLAMP_KERNEL(ClampInt64, int64_t, _mm_set1_epi64x, Sse42MinEpi64,
+    Sse42MaxEpi64)
+SSE42_CLAMP_KERNEL(ClampUint64, uint64_t, _mm_set1_epi64x, Sse42MinEpu64,
+    Sse42MaxEpu64)
+
+const CORE_KERNELS g_sse42CoreKernels = {
+  Sse42SpanDigits,
+  Sse42SpanAlnum,
+  Sse42SpanUpper,
+  Sse42SpanSpace,
+  Sse42ReverseSpanSpace,
+  Sse42FindAnyOf,
+  Sse42CountByte,
+  Sse42FindByteOffsets,
+  Sse42MinimumInt,
+  Sse42MaximumInt,
+  Sse42MinimumInt64,
+  Sse42MaximumInt64,
+  Sse42MinimumUint64,
+  Sse42MaximumUint64,
+  Sse42SumInt,
+  Sse42SumUint64,
+  Sse42ClampInt,
+  Sse42ClampInt64,
+  Sse42ClampUint64
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX2 kernels
+
+TARGET_AVX2
+static inline __m256i Avx2InRange(__m256i x, char lo, char hi) {
+  return _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (0x80 + hi - lo + 1)),
+      _mm256_add_epi8(x, _mm256_set1_epi8((char) (0x80 - lo))));
+}
+
+TARGET_AVX2
+static inline __m256i Avx2Digits(__m256i x) {
+  return Avx2InRange(x, '0', '9');
+}
+
+TARGET_AVX2
+static inline __m256i Avx2Alnum(__m256i x) {
+  return _mm256_or_si256(Avx2InRange(x, '0', '9'),
+      Avx2InRange(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 'z'));
+}
+
+TARGET_AVX2
+static inline __m256i Avx2Upper(__m256i x) {
+  return Avx2InRange(x, 'A', 'Z');
+}
+
+TARGET_AVX2
+static inline __m256i Avx2Space(__m256i x) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+      Avx2InRange(x, '\t', '\r'));
+}
+
+#define AVX2_SPAN_KERNEL(Class)                                               \
+TARGET_AVX2                                                                   \
+static size_t Avx2Span##Class(const char* pchData, size_t nLength) {          \
+  size_t i = 0;                                                               \
+  for (; i + 32 <= nLength; i += 32) {                                        \
+    const __m256i DATA = _mm256_loadu_si256((const __m256i*) (pchData + i));  \
+    const unsigned OUTSIDE = ~(unsigned) _mm256_movemask_epi8(                \
+        Avx2##Class(DATA));                                                   \
+    if (OUTSIDE != 0) {                                                       \
+      return i + __builtin_ctz(OUTSIDE);                                      \
+    }                                                                         \
+  }                                                                           \
+  return i + Sse42Span##Class(pchData + i, nLength - i);                      \
+}
+
+AVX2_SPAN_KERNEL(Digits)
+AVX2_SPAN_KERNEL(Alnum)
+AVX2_SPAN_KERNEL(Upper)
+AVX2_SPAN_KERNEL(Space)
+
+TARGET_AVX2
+static size_t Avx2ReverseSpanSpace(const char* pchData, size_t nLength) {
+  size_t nSpan = 0;
+  for (; nLength - nSpan >= 32; nSpan += 32) {
+    const __m256i DATA = _mm256_loadu_si256(
+        (const __m256i*) (pchData + nLength - nSpan - 32));
+    const unsigned OUTSIDE = ~(unsigned) _mm256_movemask_epi8(
+        Avx2Space(DATA));
+    if (OUTSIDE != 0) {
+      return nSpan + __builtin_clz(OUTSIDE);
+    }
+  }
+  return nSpan + Sse42ReverseSpanSpace(pchData, nLength - nSpan);
+}
+
+/* Up to this many set bytes, one compare per set byte beats PCMPESTRI */
+#define AVX_FIND_ANY_OF_MAX_SET   8
+
+TARGET_AVX2
+static size_t Avx2FindAnyOf(const char* pchData, size_t nLength,
+    const char* pchSet, size_t nSet) {
+  if (nSet == 1 || nSet > AVX_FIND_ANY_OF_MAX_SET) {
+    return Sse42FindAnyOf(pchData, nLength, pchSet, nSet);
+  }
+
+  __m256i sets[AVX_FIND_ANY_OF_MAX_SET];
+  for (size_t s = 0; s < nSet; s++) {
+    sets[s] = _mm256_set1_epi8(pchSet[s]);
+  }
+
+  size_t i = 0;
+  for (; i + 32 <= nLength; i += 32) {
+    const __m256i DATA = _mm256_loadu_si256((const __m256i*) (pchData + i));
+    __m256i matches = _mm256_cmpeq_epi8(DATA, sets[0]);
+    for (size_t s = 1; s < nSet; s++) {
+      matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(DATA, sets[s]));
+    }
+
+    const unsigned MATCHES = (unsigned) _mm256_movemask_epi8(matches);
+    if (MATCHES != 0) {
+      return i + __builtin_ctz(MATCHES);
+    }
+  }
+
+  return i + Sse42FindAnyOf(pchData + i, nLength - i, pchSet, nSet);
+}
+
+TARGET_AVX2
+static size_t Avx2CountByte(const char* pchData, size_t nLength,
+    char chFind) {
+  const __m256i FIND = _mm256_set1_epi8(chFind);
+  size_t nCount = 0;
+
+  size_t i = 0;
+  for (; i + 32 <= nLength; i += 32) {
+    const __m256i DATA = _mm256_loadu_si256((const __m256i*) (pchData + i));
+    nCount += __builtin_popcount(
+        (unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(DATA, FIND)));
+  }
+
+  return nCount + Sse42CountByte(pchData + i, nLength - i, chFind);
+}
+
+TARGET_AVX2
+static size_t Avx2FindByteOffsets(const char* pchData, size_t nLength,
+    char chFind, uint32_t nBase, uint32_t* pnOffsets) {
+  const __m256i FIND = _mm256_set1_epi8(chFind);
+  size_t nCount = 0;
+
+  size_t i = 0;
+  for (; i + 64 <= nLength; i += 64) {
+    const __m256i LOW = _mm256_loadu_si256((const __m256i*) (pchData + i));
+    const __m256i HIGH = _mm256_loadu_si256(
+        (const __m256i*) (pchData + i + 32));
+    const uint64_t MATCHES = (uint64_t) (unsigned) _mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(LOW, FIND)) | (uint64_t) (unsigned)
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(HIGH, FIND)) << 32;
+    nCount += AppendMatchOffsets(MATCHES, nBase + (uint32_t) i,
+        pnOffsets + nCount);
+  }
+
+  return nCount + Sse42FindByteOffsets(pchData + i, nLength - i, chFind,
+      nBase + (uint32_t) i, pnOffsets + nCount);
+}
+
+TARGET_AVX2
+static inline __m256i Avx2Load(const void* pvData) {
+  return _mm256_loadu_si256((const __m256i*) pvData);
+}
+
+TARGET_AVX2
+static inline __m256i Avx2MinEpi64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+}
+
+TARGET_AVX2
+static inline __m256i Avx2MaxEpi64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+}
+
+TARGET_AVX2
+static inline __m256i Avx2GreaterEpu64(__m256i a, __m256i b) {
+  const __m256i SIGN = _mm256_set1_epi64x(INT64_MIN);
+  return _mm256_cmpgt_epi64(_mm256_xor_si256(a, SIGN),
+      _mm256_xor_si256(b, SIGN));
+}
+
+TARGET_AVX2
+static inline __m256i Avx2MinEpu64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(a, b, Avx2GreaterEpu64(a, b));
+}
+
+TARGET_AVX2
+static inline __m256i Avx2MaxEpu64(__m256i a, __m256i b) {
+  return _mm256_blendv_epi8(b, a, Avx2GreaterEpu64(a, b));
+}
+
+#define AVX2_EXTREMUM_KERNEL(Name, Type, Pick)                                \
+TARGET_AVX2                                                                   \
+static Type Avx2##Name(const Type* pValues, size_t nCount) {                  \
+  const size_t LANES = 32 / sizeof(Type);                                     \
+  if (nCount < 4 * LANES) {                                                   \
+    return Sse42##Name(pValues, nCount);                                      \
+  }                                                                           \
+                                                                              \
+  __m256i acc0 = Avx2Load(pValues);                                           \
+  __m256i acc1 = Avx2Load(pValues + LANES);                                   \
+  __m256i acc2 = Avx2Load(pValues + 2 * LANES);                               \
+  __m256i acc3 = Avx2Load(pValues + 3 * LANES);                               \
+  for (size_t i = 4 * LANES; i < nCount; i += 4 * LANES) {                    \
+    /* The last block ends at the end of the data */                          \
+    const Type* pBlock = i + 4 * LANES <= nCount                              \
+        ? pValues + i : pValues + nCount - 4 * LANES;                         \
+    acc0 = Pick(acc0, Avx2Load(pBlock));                                      \
+    acc1 = Pick(acc1, Avx2Load(pBlock + LANES));                              \
+    acc2 = Pick(acc2, Avx2Load(pBlock + 2 * LANES));                          \
+    acc3 = Pick(acc3, Avx2Load(pBlock + 3 * LANES));                          \
+  }                                                                           \
+                                                                              \
+  Type lanes[32 / sizeof(Type)];                                              \
+  _mm256_storeu_si256((__m256i*) lanes,                                       \
+      Pick(Pick(acc0, acc1), Pick(acc2, acc3)));                              \
+  return g_scalarCoreKernels.pfn##Name(lanes, LANES);                         \
+}
+
+AVX2_EXTREMUM_KERNEL(MinimumInt, int, _mm256_min_epi32)
+AVX2_EXTREMUM_KERNEL(MaximumInt, int, _mm256_max_epi32)
+AVX2_EXTREMUM_KERNEL(MinimumInt64, int64_t, Avx2MinEpi64)
+AVX2_EXTREMUM_KERNEL(MaximumInt64, int64_t, Avx2MaxEpi64)
+AVX2_EXTREMUM_KERNEL(MinimumUint64, uint64_t, Avx2MinEpu64)
+AVX2_EXTREMUM_KERNEL(MaximumUint64, uint64_t, Avx2MaxEpu64)
+
+TARGET_AVX2
+static int64_t Avx2SumInt(const int* pnValues, size_t nCount) {
+  __m256i sum = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (; i + 8 <= nCount; i += 8) {
+    sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(
+        _mm_loadu_si128((const __m128i*) (pnValues + i))));
+    sum = _mm256_add_epi64(sum, _mm256_cvtepi32_epi64(
+        _mm_loadu_si128((const __m128i*) (pnValues + i + 4))));
+  }
+
+  int64_t llLanes[4];
+  _mm256_storeu_si256((__m256i*) llLanes, sum);
+  return llLanes[0] + llLanes[1] + llLanes[2] + llLanes[3]
+      + Sse42SumInt(pnValues + i, nCount - i);
+}
+
+TARGET_AVX2
+static uint64_t Avx2SumUint64(const uint64_t* pullValues, size_t nCount) {
+  __m256i sum = _mm256_setzero_si256();
+
+  size_t i = 0;
+  for (; i + 4 <= nCount; i += 4) {
+    sum = _mm256_add_epi64(sum,
+        _mm256_loadu_si256((const __m256i*) (pullValues + i)));
+  }
+
+  uint64_t ullLanes[4];
+  _mm256_storeu_si256((__m256i*) ullLanes, sum);
+  return ullLanes[0] + ullLanes[1] + ullLanes[2] + ullLanes[3]
+      + Sse42SumUint64(pullValues + i, nCount - i);
+}
+
+#define AVX2_CLAMP_KERNEL(Name, Type, Splat, Min, Max)                        \
+TARGET_AVX2                                                                   \
+static void Avx2##Name(Type* pValues, size_t nCount, Type low, Type high) {   \
+  const size_t LANES = 32 / sizeof(Type);                                     \
+  const __m256i LOW = Splat(low);                                             \
+  const __m256i HIGH = Splat(high);                                           \
+                                                                              \
+  size_t i = 0;                                                               \
+  for (; i + LANES <= nCount; i += LANES) {                                   \
+    __m256i* pVector = (__m256i*) (pValues + i);                              \
+    _mm256_storeu_si256(pVector,                                              \
+        Min(Max(_mm256_loadu_si256(pVector), LOW), HIGH));                    \
+  }                                                                           \
+  Sse42##Name(pValues + i, nCount - i, low, high);                            \
+}
+
+AVX2_CLAMP_KERNEL(ClampInt, int, _mm256_set1_epi32, _mm256_min_epi32,
+    _mm256_max_epi32)
+AVX2_CLAMP_KERNEL(ClampInt64, int64_t, _mm256_set1_epi64x, Avx2MinEpi64,
+    Avx2MaxEpi64)
+AVX2_CLAMP_KERNEL(ClampUint64, uint64_t, _mm256_set1_epi64x, Avx2MinEpu64,
+    Avx2MaxEpu64)
+
+const CORE_KERNELS g_avx2CoreKernels = {
+  Avx2SpanDigits,
+  Avx2SpanAlnum,
+  Avx2SpanUpper,
+  Avx2SpanSpace,
+  Avx2ReverseSpanSpace,
+  Avx2FindAnyOf,
+  Avx2CountByte,
+  Avx2FindByteOffsets,
+  Avx2MinimumInt,
+  Avx2MaximumInt,
+  Avx2MinimumInt64,
+  Avx2MaximumInt64,
+  Avx2MinimumUint64,
+  Avx2MaximumUint64,
+  Avx2SumInt,
+  Avx2SumUint64,
+  Avx2ClampInt,
+  Avx2ClampInt64,
+  Avx2ClampUint64
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// AVX-512BW kernels
+
+TARGET_AVX512
+static inline __mmask64 Avx512InRange(__m512i x, char lo, char hi) {
+  return _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, _mm512_set1_epi8(lo)),
+      _mm512_set1_epi8((char) (hi - lo)));
+}
+
+TARGET_AVX512
+static inline __mmask64 Avx512Digits(__m512i x) {
+  return Avx512InRange(x, '0', '9');
+}
+
+TARGET_AVX512
+static inline __mmask64 Avx512Alnum(__m512i x) {
+  return Avx512InRange(x, '0', '9')
+      | Avx512InRange(_mm512_or_si512(x, _mm512_set1_epi8(0x20)), 'a', 'z');
+}
+
+TARGET_AVX512
+static inline __mmask64 Avx512Upper(__m512i x) {
+  return Avx512InRange(x, 'A', 'Z');
+}
+
+TARGET_AVX512
+static inline __mmask64 Avx512Space(__m512i x) {
+  return _mm512_cmpeq_epi8_mask(x, _mm512_set1_epi8(' '))
+      | Avx512InRange(x, '\t', '\r');
+}
+
+#define AVX512_SPAN_KERNEL(Class)                                             \
+TARGET_AVX512                                                                 \
+static size_t Avx512Span##Class(const char* pchData, size_t nLength) {        \
+  size_t i = 0;                                                               \
+  for (; i + 64 <= nLength; i += 64) {                                        \
+    const __mmask64 OUTSIDE = ~Avx512##Class(                                 \
+        _mm512_loadu_si512((const void*) (pchData + i)));                     \
+    if (OUTSIDE != 0) {                                                       \
+      return i + __builtin_ctzll(OUTSIDE);                                    \
+    }                                                                         \
+  }                                                                           \
+  if (i == nLength) {                                                         \
+    return i;                                                                 \
+  }                                                                           \
+  const __mmask64 VALID = LOW_LANES_64(nLength - i);                          \
+  const __mmask64 OUTSIDE = ~Avx512##Class(                                   \
+      _mm512_maskz_loadu_epi8(VALID, pchData + i)) & VALID;                   \
+  return OUTSIDE != 0 ? i + __builtin_ctzll(OUTSIDE) : nLength;               \
+}
+
+AVX512_SPAN_KERNEL(Digits)
+AVX512_SPAN_KERNEL(Alnum)
+AVX512_SPAN_KERNEL(Upper)
+AVX512_SPAN_KERNEL(Space)
+
+TARGET_AVX512
+static size_t Avx512ReverseSpanSpace(const char* pchData, size_t nLength) {
+  size_t nSpan = 0;
+  for (; nLength - nSpan >= 64; nSpan += 64) {
+    const __mmask64 OUTSIDE = ~Avx512Space(_mm512_loadu_si512(
+        (const void*) (pchData + nLength - nSpan - 64)));
+    if (OUTSIDE != 0) {
+      return nSpan + __builtin_clzll(OUTSIDE);
+    }
+  }
+
+  const size_t REMAINING = nLength - nSpan;
+  if (REMAINING == 0) {
+    return nLength;
+  }
+
+  /* The first REMAINING bytes, in the low lanes */
+  const __mmask64 VALID = LOW_LANES_64(REMAINING);
+  const __mmask64 OUTSIDE = ~Avx512Space(
+      _mm512_maskz_loadu_epi8(VALID, pchData)) & VALID;
+  if (OUTSIDE == 0) {
+    return nLength;
+  }
+
+  return nSpan + (REMAINING - 1) - (63 - __builtin_clzll(OUTSIDE));
+}
+
+TARGET_AVX512
+static size_t Avx512FindAnyOf(const char* pchData, size_t nLength,
+    const char* pchSet, size_t nSet) {
+  if (nSet == 1 || nSet > AVX_FIND_ANY_OF_MAX_SET) {
+    return Sse42FindAnyOf(pchData, nLength, pchSet, nSet);
+  }
+
+  __m512i sets[AVX_FIND_ANY_OF_MAX_SET];
+  for (size_t s = 0; s < nSet; s++) {
+    sets[s] = _mm512_set1_epi8(pchSet[s]);
+  }
+
+  size_t i = 0;
+  while (i < nLength) {
+    const __mmask64 VALID = nLength - i >= 64
+        ? ~0ULL
+        : LOW_LANES_64(nLength - i);
+    const __m512i DATA = _mm512_maskz_loadu_epi8(VALID, pchData + i);
+
+    __mmask64 matches = 0;
+    for (size_t s = 0; s < nSet; s++) {
+      matches |= _mm512_cmpeq_epi8_mask(DATA, sets[s]);
+    }
+
+    matches &= VALID;
+    if (matches != 0) {
+      return i + __builtin_ctzll(matches);
+    }
+    i += 64;
+  }
+
+  return nLength;
+}
+
+TARGET_AVX512
+static size_t Avx512CountByte(const char* pchData, size_t nLength,
+    char chFind) {
+  const __m512i FIND = _mm512_set1_epi8(chFind);
+  size_t nCount = 0;
+
+  size_t i = 0;
+  for (; i + 64 <= nLength; i += 64) {
+    nCount += __builtin_popcountll(_mm512_cmpeq_epi8_mask(
+        _mm512_loadu_si512((const void*) (pchData + i)), FIND));
+  }
+
+  if (i < nLength) {
+    const __mmask64 VALID = LOW_LANES_64(nLength - i);
+    nCount += __builtin_popcountll(_mm512_mask_cmpeq_epi8_mask(VALID,
+        _mm512_maskz_loadu_epi8(VALID, pchData + i), FIND));
+  }
+
+  return nCount;
+}
+
+/* The masked tail may have fewer than four offsets' room past its matches,
+ * so it writes them one at a time */
+TARGET_AVX512
+static size_t Avx512FindByteOffsets(const char* pchData, size_t nLength,
+    char chFind, uint32_t nBase, uint32_t* pnOffsets) {
+  const __m512i FIND = _mm512_set1_epi8(chFind);
+  size_t nCount = 0;
+
+  size_t i = 0;
+  for (; i + 64 <= nLength; i += 64) {
+    nCount += AppendMatchOffsets(_mm512_cmpeq_epi8_mask(
+        _mm512_loadu_si512((const void*) (pchData + i)), FIND),
+        nBase + (uint32_t) i, pnOffsets + nCount);
+  }
+
+  if (i < nLength) {
+    const __mmask64 VALID = LOW_LANES_64(nLength - i);
+    uint64_t ullMatches = _mm512_mask_cmpeq_epi8_mask(VALID,
+        _mm512_maskz_loadu_epi8(VALID, pchData + i), FIND);
+    while (ullMatches != 0) {
+      pnOffsets[nCount++] = nBase + (uint32_t) (i
+          + (size_t) __builtin_ctzll(ullMatches));
+      ullMatches &= ullMatches - 1;
+    }
+  }
+
+  return nCount;
+}
+
+TARGET_AVX512
+static inline __m512i Avx512Load(const void* pvData) {
+  return _mm512_loadu_si512(pvData);
+}
+
+#define AVX512_EXTREMUM_KERNEL(Name, Type, Pick, Reduce)                      \
+TARGET_AVX512                                                                 \
+static Type Avx512##Name(const Type* pValues, size_t nCount) {                \
+  const size_t LANES = 64 / sizeof(Type);                                     \
+  if (nCount < 4 * LANES) {                                                   \
+    return Avx2##Name(pValues, nCount);                                       \
+  }                                                                           \
+                                                                              \
+  __m512i acc0 = Avx512Load(pValues);                                         \
+  __m512i acc1 = Avx512Load(pValues + LANES);                                 \
+  __m512i acc2 = Avx512Load(pValues + 2 * LANES);                             \
+  __m512i acc3 = Avx512Load(pValues + 3 * LANES);                             \
+  for (size_t i = 4 * LANES; i < nCount; i += 4 * LANES) {                    \
+    /* The last block ends at the end of the data */                          \
+    const Type* pBlock = i + 4 * LANES <= nCount                              \
+        ? pValues + i : pValues + nCount - 4 * LANES;                         \
+    acc0 = Pick(acc0, Avx512Load(pBlock));                                    \
+    acc1 = Pick(acc1, Avx512Load(pBlock + LANES));                            \
+    acc2 = Pick(acc2, Avx512Load(pBlock + 2 * LANES));                        \
+    acc3 = Pick(acc3, Avx512Load(pBlock + 3 * LANES));                        \
+  }                                                                           \
+                                                                              \
+  return (Type) Reduce(Pick(Pick(acc0, acc1), Pick(acc2, acc3)));             \
+}
+
+AVX512_EXTREMUM_KERNEL(MinimumInt, int, _mm512_min_epi32,
+    _mm512_reduce_min_epi32)
+AVX512_EXTREMUM_KERNEL(MaximumInt, int, _mm512_max_epi32,
+    _mm512_reduce_max_epi32)
+AVX512_EXTREMUM_KERNEL(MinimumInt64, int64_t, _mm512_min_epi64,
+    _mm512_reduce_min_epi64)
+AVX512_EXTREMUM_KERNEL(MaximumInt64, int64_t, _mm512_max_epi64,
+    _mm512_reduce_max_epi64)
+AVX512_EXTREMUM_KERNEL(MinimumUint64, uint64_t, _mm512_min_epu64,
+    _mm512_reduce_min_epu64)
+AVX512_EXTREMUM_KERNEL(MaximumUint64, uint64_t, _mm512_max_epu64,
+    _mm512_reduce_max_epu64)
+
+TARGET_AVX512
+static inline __m512i Avx512WidenAdd(__m512i sum, __m512i data) {
+  sum = _mm512_add_epi64(sum,
+      _mm512_cvtepi32_epi64(_mm512_castsi512_si256(data)));
+  return _mm512_add_epi64(sum,
+      _mm512_cvtepi32_epi64(_mm512_extracti64x4_epi64(data, 1)));
+}
+
+TARGET_AVX512
+static int64_t Avx512SumInt(const int* pnValues, size_t nCount) {
+  __m512i sum = _mm512_setzero_si512();
+
+  size_t i = 0;
+  for (; i + 16 <= nCount; i += 16) {
+    sum = Avx512WidenAdd(sum,
+        _mm512_loadu_si512((const void*) (pnValues + i)));
+  }
+
+  if (i < nCount) {
+    sum = Avx512WidenAdd(sum, _mm512_maskz_loadu_epi32(
+        (__mmask16) LOW_LANES_64(nCount - i), pnValues + i));
+  }
+
+  return _mm512_reduce_add_epi64(sum);
+}
+
+TARGET_AVX512
+static uint64_t Avx512SumUint64(const uint64_t* pullValues, size_t nCount) {
+  __m512i sum = _mm512_setzero_si512();
+
+  size_t i = 0;
+  for (; i + 8 <= nCount; i += 8) {
+    sum = _mm512_add_epi64(sum,
+        _mm512_loadu_si512((const void*) (pullValues + i)));
+  }
+
+  if (i < nCount) {
+    sum = _mm512_add_epi64(sum, _mm512_maskz_loadu_epi64(
+        (__mmask8) LOW_LANES_64(nCount - i), pullValues + i));
+  }
+
+  return (uint64_t) _mm512_reduce_add_epi64(sum);
+}
+
+#define AVX512_CLAMP_KERNEL(Name, Type, Splat, Min, Max, Mask, Width)         \
+TARGET_AVX512                                                                 \
+static void Avx512##Name(Type* pValues, size_t nCount, Type low, Type high) { \
+  const size_t LANES = 64 / sizeof(Type);                                     \
+  const __m512i LOW = Splat(low);                                             \
+  const __m512i HIGH = Splat(high);                                           \
+                                                                              \
+  size_t i = 0;                                                               \
+  for (; i + LANES <= nCount; i += LANES) {                                   \
+    _mm512_storeu_si512((void*) (pValues + i), Min(Max(                       \
+        _mm512_loadu_si512((const void*) (pValues + i)), LOW), HIGH));        \
+  }                                                                           \
+                                                                              \
+  if (i < nCount) {                                                           \
+    const Mask VALID = (Mask) LOW_LANES_64(nCount - i);                       \
+    _mm512_mask_storeu_##Width(pValues + i, VALID, Min(Max(                   \
+        _mm512_maskz_loadu_##Width(VALID, pValues + i), LOW), HIGH));         \
+  }                                                                           \
+}
+
+AVX512_CLAMP_KERNEL(ClampInt, int, _mm512_set1_epi32, _mm512_min_epi32,
+    _mm512_max_epi32, __mmask16, epi32)
+AVX512_CLAMP_KERNEL(ClampInt64, int64_t, _mm512_set1_epi64,
+    _mm512_min_epi64, _mm512_max_epi64, __mmask8, epi64)
+AVX512_CLAMP_KERNEL(ClampUint64, uint64_t, _mm512_set1_epi64,
+    _mm512_min_epu64, _mm512_max_epu64, __mmask8, epi64)
+
+const CORE_KERNELS g_avx512CoreKernels = {
+  Avx512SpanDigits,
+  Avx512SpanAlnum,
+  Avx512SpanUpper,
+  Avx512SpanSpace,
+  Avx512ReverseSpanSpace,
+  Avx512FindAnyOf,
+  Avx512CountByte,
+  Avx512FindByteOffsets,
+  Avx512MinimumInt,
+  Avx512MaximumInt,
+  Avx512MinimumInt64,
+  Avx512MaximumInt64,
+  Avx512MinimumUint64,
+  Avx512MaximumUint64,
+  Avx512SumInt,
+  Avx512SumUint64,
+  Avx512ClampInt,
+  Avx512ClampInt64,
+  Avx512ClampUint64
+};
+
+#endif /* __x86_64__ || __i386__ */
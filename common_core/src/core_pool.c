@@ -0,0 +1,263 @@
+// core_pool.c - Implementation of the size-class pool behind the library's small allocations
+
+#include "stdafx.h"
+#include "core_pool.h"
+
+#ifdef COMMON_CORE_STRING_POOL
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+#define POOL_CLASS_COUNT        16
+#define POOL_QUANTUM            16
+
+/* Blocks start after the chunk's header, on a cache line boundary */
+#define POOL_CHUNK_HEADER_SIZE  64
+
+/* Sizes of the classes: steps of 16 bytes up to 128, then four steps per
+ * doubling, so that no block wastes more than a fifth of itself */
+static const uint32_t s_nClassSizes[POOL_CLASS_COUNT] = { 16, 32, 48, 64, 80,
+    96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512 };
+
+/* Class of a request, by the number of 16-byte quanta it spans */
+static const uint8_t s_nClassOfQuanta[CORE_POOL_MAX_SIZE / POOL_QUANTUM + 1]
+    = { 0, 0, 1, 2, 3, 4, 5, 6, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 12, 12,
+    13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15 };
+
+/* A released block, linked through its first bytes */
+typedef struct _POOL_FREE_BLOCK {
+  struct _POOL_FREE_BLOCK* pNext;
+} POOL_FREE_BLOCK;
+
+/* The blocks one thread allocates from.  Caches are never freed: when a
+ * thread exits, its cache is released for reuse by a later thread, blocks
+ * and chunks included, and blocks of it released meanwhile wait on its
+ * remote list.  The remote list, which other threads write, has a cache
+ * line to itself. */
+typedef struct _POOL_CACHE {
+  _Atomic(POOL_FREE_BLOCK*) pRemote;
+  struct _POOL_CACHE* pNext;
+  atomic_int bInUse;
+  char padding[64 - 2 * sizeof(void*) - sizeof(atomic_int)];
+  POOL_FREE_BLOCK* pFree[POOL_CLASS_COUNT];
+  unsigned char* pbBump[POOL_CLASS_COUNT];  /* unused end of the class's */
+  unsigned char* pbLimit[POOL_CLASS_COUNT]; /* newest chunk */
+} POOL_CACHE;
+
+/* The header of a chunk: the cache that owns its blocks, and their class */
+typedef struct _POOL_CHUNK {
+  POOL_CACHE* pOwner;
+  size_t nClass;
+} POOL_CHUNK;
+
+atomic_uintptr_t g_uPoolBase = 0;
+atomic_size_t g_nPoolSpan = 0;
+
+/* Offset of the next chunk to carve, from g_uPoolBase */
+static atomic_size_t s_nNextChunk = 0;
+
+static _Atomic(POOL_CACHE*) s_pCacheList = NULL;
+static __thread POOL_CACHE* s_pThreadCache = NULL;
+
+static pthread_once_t s_initOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_cacheKey;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// GetChunk function - Gets the chunk a pool block lies in.
+//
+
+static inline POOL_CHUNK* GetChunk(const void* pvBlock) {
+  return (POOL_CHUNK*) ((uintptr_t) pvBlock
+      & ~(uintptr_t) (CORE_POOL_CHUNK_SIZE - 1));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseCache function - pthread key destructor that hands the cache of an
+// exiting thread back for reuse.  Blocks the thread releases after this go
+// to the remote list, like any other thread's.
+//
+
+static void ReleaseCache(void* pvCache) {
+  POOL_CACHE* pCache = (POOL_CACHE*) pvCache;
+  s_pThreadCache = NULL;
+  atomic_store_explicit(&pCache->bInUse, 0, memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InitializePool function - One-time setup: creates the thread key and
+// reserves the range the chunks are carved from, aligned to the chunk size.
+// If the range cannot be reserved, the pool stays empty and every request
+// falls through to malloc.
+//
+
+static void InitializePool(void) {
+  pthread_key_create(&s_cacheKey, ReleaseCache);
+
+  void* pvRange = mmap(NULL, CORE_POOL_RESERVE_SIZE + CORE_POOL_CHUNK_SIZE,
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+      -1, 0);
+  if (pvRange == MAP_FAILED) {
+    return;
+  }
+
+  const uintptr_t BASE = ((uintptr_t) pvRange + CORE_POOL_CHUNK_SIZE - 1)
+      & ~(uintptr_t) (CORE_POOL_CHUNK_SIZE - 1);
+  atomic_store_explicit(&g_uPoolBase, BASE, memory_order_relaxed);
+  atomic_store_explicit(&g_nPoolSpan, CORE_POOL_RESERVE_SIZE,
+      memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetThreadCache function - Gets the calling thread's cache, claiming a
+// released one or allocating a new one on first use.  Returns NULL if the
+// pool has no range or no cache could be allocated.
+//
+
+static POOL_CACHE* GetThreadCache(void) {
+  if (s_pThreadCache != NULL) {
+    return s_pThreadCache;
+  }
+
+  pthread_once(&s_initOnce, InitializePool);
+  if (atomic_load_explicit(&g_nPoolSpan, memory_order_acquire) == 0) {
+    return NULL;
+  }
+
+  POOL_CACHE* pCache = NULL;
+  for (POOL_CACHE* pCandidate = atomic_load_explicit(&s_pCacheList,
+      memory_order_acquire); pCandidate != NULL;
+      pCandidate = pCandidate->pNext) {
+    int bExpected = 0;
+    if (atomic_compare_exchange_strong(&pCandidate->bInUse, &bExpected, 1)) {
+      pCache = pCandidate;
+      break;
+    }
+  }
+
+  if (pCache == NULL) {
+    pCache = (POOL_CACHE*) aligned_alloc(64, sizeof(POOL_CACHE));
+    if (pCache == NULL) {
+      return NULL;
+    }
+    memset(pCache, 0, sizeof(POOL_CACHE));
+    atomic_init(&pCache->pRemote, NULL);
+    atomic_init(&pCache->bInUse, 1);
+
+    POOL_CACHE* pHead = atomic_load_explicit(&s_pCacheList,
+        memory_order_relaxed);
+    do {
+      pCache->pNext = pHead;
+    } while (!atomic_compare_exchange_weak_explicit(&s_pCacheList, &pHead,
+        pCache, memory_order_release, memory_order_relaxed));
+  }
+
+  pthread_setspecific(s_cacheKey, pCache);
+  s_pThreadCache = pCache;
+  return pCache;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RefillClass function - Slow path of AllocatePoolBlock, for a class whose
+// free list is empty: takes back the blocks other threads released, then
+// cuts a block from the class's newest chunk, then carves a new chunk.
+// Returns NULL if the range is used up.
+//
+
+static void* RefillClass(POOL_CACHE* pCache, size_t nClass) {
+  POOL_FREE_BLOCK* pRemote = atomic_exchange_explicit(&pCache->pRemote, NULL,
+      memory_order_acquire);
+  while (pRemote != NULL) {
+    POOL_FREE_BLOCK* pNext = pRemote->pNext;
+    const size_t CLASS = GetChunk(pRemote)->nClass;
+    pRemote->pNext = pCache->pFree[CLASS];
+    pCache->pFree[CLASS] = pRemote;
+    pRemote = pNext;
+  }
+
+  POOL_FREE_BLOCK* pBlock = pCache->pFree[nClass];
+  if (pBlock != NULL) {
+    pCache->pFree[nClass] = pBlock->pNext;
+    return pBlock;
+  }
+
+  const size_t SIZE = s_nClassSizes[nClass];
+  if (pCache->pbLimit[nClass] - pCache->pbBump[nClass] < (ptrdiff_t) SIZE) {
+    const size_t OFFSET = atomic_fetch_add_explicit(&s_nNextChunk,
+        CORE_POOL_CHUNK_SIZE, memory_order_relaxed);
+    if (OFFSET >= CORE_POOL_RESERVE_SIZE) {
+      return NULL;
+    }
+
+    POOL_CHUNK* pChunk = (POOL_CHUNK*) (atomic_load_explicit(&g_uPoolBase,
+        memory_order_relaxed) + OFFSET);
+    pChunk->pOwner = pCache;
+    pChunk->nClass = nClass;
+    pCache->pbBump[nClass] = (unsigned char*) pChunk
+        + POOL_CHUNK_HEADER_SIZE;
+    pCache->pbLimit[nClass] = (unsigned char*) pChunk + CORE_POOL_CHUNK_SIZE;
+  }
+
+  void* pvBlock = pCache->pbBump[nClass];
+  pCache->pbBump[nClass] += SIZE;
+  return pvBlock;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// AllocatePoolBlock function
+
+void* AllocatePoolBlock(size_t nSize) {
+  POOL_CACHE* pCache = GetThreadCache();
+  if (pCache == NULL) {
+    return malloc(nSize);
+  }
+
+  const size_t CLASS = s_nClassOfQuanta[(nSize + POOL_QUANTUM - 1)
+      / POOL_QUANTUM];
+  POOL_FREE_BLOCK* pBlock = pCache->pFree[CLASS];
+  if (pBlock != NULL) {
+    pCache->pFree[CLASS] = pBlock->pNext;
+    return pBlock;
+  }
+
+  void* pvBlock = RefillClass(pCache, CLASS);
+  return pvBlock != NULL ? pvBlock : malloc(nSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreePoolBlock function
+
+void FreePoolBlock(void* pvBlock) {
+  const POOL_CHUNK* pChunk = GetChunk(pvBlock);
+  POOL_CACHE* pOwner = pChunk->pOwner;
+  POOL_FREE_BLOCK* pBlock = (POOL_FREE_BLOCK*) pvBlock;
+
+  if (pOwner == s_pThreadCache) {
+    pBlock->pNext = pOwner->pFree[pChunk->nClass];
+    pOwner->pFree[pChunk->nClass] = pBlock;
+    return;
+  }
+
+  /* Only the owner takes blocks off, and only all at once, so a push cannot
+   * be fooled by a block that left and came back */
+  POOL_FREE_BLOCK* pHead = atomic_load_explicit(&pOwner->pRemote,
+      memory_order_relaxed);
+  do {
+    pBlock->pNext = pHead;
+  } while (!atomic_compare_exchange_weak_explicit(&pOwner->pRemote, &pHead,
+      pBlock, memory_order_release, memory_order_relaxed));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetPoolBlockSize function
+
+size_t GetPoolBlockSize(const void* pvBlock) {
+  return s_nClassSizes[GetChunk(pvBlock)->nClass];
+}
+
+#endif //COMMON_CORE_STRING_POOL
@@ -0,0 +1,135 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_pool.h - Size-class pool from which the library allocates the small blocks it hands out
+// (tokens, joined and replaced strings), so that allocating and releasing them rarely reaches
+// malloc
+//
+// Requests of up to CORE_POOL_MAX_SIZE bytes are rounded up to one of sixteen size classes and
+// served from chunks carved out of one reserved range of address space.  Each thread allocates
+// from a cache of its own, without locks: a free list per class, and the unused end of its newest
+// chunk of each class.  A block released by the thread that allocated it goes back on that
+// thread's free list; one released by another thread is pushed, without locks, onto a list of the
+// owning cache that the owner takes back whole when its free list runs dry.  Larger requests, and
+// all requests once the range is used up, fall through to malloc.
+//
+// Whether a block is the pool's is told by its address alone, so CoreFree can release blocks the
+// caller allocated with malloc as well.  Chunks are never returned to the system: the pool keeps
+// what the busiest moment needed, as malloc's arenas do.
+//
+// The pool is built only if the library is built with COMMON_CORE_STRING_POOL defined.  Without
+// it, every block comes from malloc, so callers may go on releasing the library's strings with
+// free(), as its documentation has always allowed; define it only for programs that release
+// them all with FreeBuffer or FreeStringArray.
+
+#ifndef __CORE_POOL_H__
+#define __CORE_POOL_H__
+
+#include "stdafx.h"
+
+/* Largest request the pool serves, which is the size of its largest class */
+#define CORE_POOL_MAX_SIZE            512
+
+/* Address space reserved for chunks; only the pages used are backed */
+#ifndef CORE_POOL_RESERVE_SIZE
+#define CORE_POOL_RESERVE_SIZE        (256UL * 1024 * 1024)
+#endif //CORE_POOL_RESERVE_SIZE
+
+/* Size and alignment of a chunk, which holds blocks of one class */
+#ifndef CORE_POOL_CHUNK_SIZE
+#define CORE_POOL_CHUNK_SIZE          (64UL * 1024)
+#endif //CORE_POOL_CHUNK_SIZE
+
+#ifdef COMMON_CORE_STRING_POOL
+
+/* Start of the reserved range, and its size once it has been reserved (zero
+ * until then, and if it could not be) */
+extern atomic_uintptr_t g_uPoolBase;
+extern atomic_size_t g_nPoolSpan;
+
+/**
+ * @brief Allocates a block of up to CORE_POOL_MAX_SIZE bytes from the pool,
+ * or from malloc if the pool has run out.
+ * @returns The block, aligned as malloc aligns, or NULL if memory ran out.
+ */
+void* AllocatePoolBlock(size_t nSize);
+
+/**
+ * @brief Releases a block for which IsPoolBlock is TRUE.
+ */
+void FreePoolBlock(void* pvBlock);
+
+/**
+ * @brief Gets the number of bytes a block for which IsPoolBlock is TRUE can
+ * hold, which is its size class.
+ */
+size_t GetPoolBlockSize(const void* pvBlock);
+
+/**
+ * @brief Tells whether a block, which may be NULL or come from malloc, was
+ * allocated from the pool.
+ */
+static inline BOOL IsPoolBlock(const void* pvBlock) {
+  const size_t SPAN = atomic_load_explicit(&g_nPoolSpan,
+      memory_order_acquire);
+  return (uintptr_t) pvBlock - atomic_load_explicit(&g_uPoolBase,
+      memory_order_relaxed) < SPAN;
+}
+
+/**
+ * @brief Allocates a block from the pool or from malloc, by size.
+ */
+static inline void* AllocateBlock(size_t nSize) {
+  return nSize <= CORE_POOL_MAX_SIZE ? AllocatePoolBlock(nSize)
+      : malloc(nSize);
+}
+
+/**
+ * @brief Releases a block, whichever allocated it.
+ */
+static inline void ReleaseBlock(void* pvBlock) {
+  if (IsPoolBlock(pvBlock)) {
+    FreePoolBlock(pvBlock);
+  } else {
+    free(pvBlock);
+  }
+}
+
+/**
+ * @brief Resizes a block as realloc(3) would, whichever allocated it.  A
+ * pool block that is still large enough is kept; on failure, the block is
+ * left as it was.
+ */
+static inline void* ReallocateBlock(void* pvBlock, size_t nSize) {
+  if (!IsPoolBlock(pvBlock)) {
+    return pvBlock == NULL ? AllocateBlock(nSize) : realloc(pvBlock, nSize);
+  }
+
+  const size_t OLD_SIZE = GetPoolBlockSize(pvBlock);
+  if (nSize <= OLD_SIZE) {
+    return pvBlock;
+  }
+
+  void* pvResult = AllocateBlock(nSize);
+  if (pvResult != NULL) {
+    memcpy(pvResult, pvBlock, OLD_SIZE);
+    FreePoolBlock(pvBlock);
+  }
+  return pvResult;
+}
+
+#else
+
+static inline void* AllocateBlock(size_t nSize) {
+  return malloc(nSize);
+}
+
+static inline void ReleaseBlock(void* pvBlock) {
+  free(pvBlock);
+}
+
+static inline void* ReallocateBlock(void* pvBlock, size_t nSize) {
+  return realloc(pvBlock, nSize);
+}
+
+#endif //COMMON_CORE_STRING_POOL
+
+#endif /* __CORE_POOL_H__ */
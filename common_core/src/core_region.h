@@ -0,0 +1,64 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_region.h - Layout of regions, and the allocation fast path, for the library's functions
+// that allocate their results in one
+//
+// Those functions allocate with AllocateRegionBytes, which neither probes nor sets the last-error
+// record, and strings with an alignment of one, so that tokens lie packed one after another.
+
+#ifndef __CORE_REGION_H__
+#define __CORE_REGION_H__
+
+#include "stdafx.h"
+#include "region.h"
+
+/* A block of a region.  Blocks are chained from the newest to the oldest,
+ * which is allocated with the region itself. */
+typedef struct _REGION_BLOCK {
+  struct _REGION_BLOCK* pOlder;
+  size_t nSize;                   /* bytes in data */
+  size_t nUsed;                   /* bytes used, once a newer block exists */
+  _Alignas(max_align_t) unsigned char data[];
+} REGION_BLOCK;
+
+/* Child regions are chained from the newest to the oldest, and numbered in
+ * the order they were created, from one. */
+struct _REGION {
+  REGION_BLOCK* pBlock;           /* block being filled */
+  unsigned char* pbNext;          /* first free byte of it */
+  unsigned char* pbLimit;         /* end of it */
+  struct _REGION* pParent;
+  struct _REGION* pNewestChild;
+  struct _REGION* pNewer;         /* siblings */
+  struct _REGION* pOlder;
+  unsigned long long ullChildren; /* children ever created */
+  unsigned long long ullOrdinal;  /* number among the parent's children */
+  REGION_BLOCK* pFirstBlock;      /* follows the region in memory */
+};
+
+/**
+ * @brief Slow path of AllocateRegionBytes: starts a new block large enough
+ * for the request, and allocates from its start, which is aligned as
+ * strictly as any request may ask.
+ * @returns The memory, or NULL if it could not be allocated.
+ */
+void* GrowRegion(LPREGION pRegion, size_t nSize);
+
+/**
+ * @brief Allocates nSize bytes, aligned to nAlignment, which must be a power
+ * of 2 no larger than _Alignof(max_align_t), in a region.
+ * @returns The memory, or NULL if it could not be allocated.
+ */
+static inline void* AllocateRegionBytes(LPREGION pRegion, size_t nSize,
+    size_t nAlignment) {
+  unsigned char* pbResult = (unsigned char*) (((uintptr_t) pRegion->pbNext
+      + nAlignment - 1) & ~(uintptr_t) (nAlignment - 1));
+  if (pbResult > pRegion->pbLimit
+      || nSize > (size_t) (pRegion->pbLimit - pbResult)) {
+    return GrowRegion(pRegion, nSize);
+  }
+
+  pRegion->pbNext = pbResult + nSize;
+  return pbResult;
+}
+
+#endif /* __CORE_REGION_H__ */
@@ -0,0 +1,424 @@
+// core_stats.c - Implementation of the per-function call counters and latency histograms
+
+#include "stdafx.h"
+#include "core_stats.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only variables
+
+static const char* s_pszFunctionNames[CORE_FN_COUNT] = {
+  "AddBloomFilterKey",
+  "AddBloomFilterKeys",
+  "AllocateBuffer",
+  "AllocateFromRegion",
+  "Contains",
+  "ContainsNoCase",
+  "ClampInt64s",
+  "ClampInts",
+  "ClampSizes",
+  "ClearString",
+  "ClearStringMap",
+  "CopyToRegion",
+  "CreateBloomFilter",
+  "CreateInternPool",
+  "CreatePrefixSet",
+  "CreateRegion",
+  "CreateStringIndex",
+  "CreateStringMap",
+  "EndsWith",
+  "EndsWithN",
+  "EndsWithNoCase",
+  "EndsWithNoCaseN",
+  "Equals",
+  "EqualsNoCase",
+  "FindIndexedPrefix",
+  "FindIndexedString",
+  "FindInternedString",
+  "FindInternedStringN",
+  "FindStringMapValue",
+  "FormatDate",
+  "FreeBloomFilter",
+  "FreeBuffer",
+  "FreeInternPool",
+  "FreeMappedFile",
+  "FreePrefixSet",
+  "FreeRegion",
+  "FreeStringArray",
+  "FreeStringIndex",
+  "FreeStringMap",
+  "GetIndexedString",
+  "GetIndexedStringRank",
+  "GetSubstringOccurrenceCount",
+  "HandleError",
+  "HashBytes",
+  "HashBytesNoCase",
+  "HashBytesNoCaseSeeded",
+  "HashBytesSeeded",
+  "HashString",
+  "HashStringNoCase",
+  "IndexOfMinimumOfInt64s",
+  "IndexOfMinimumOfInts",
+  "IndexOfMinimumOfSizes",
+  "InsertStringMapKey",
+  "InternString",
+  "InternStringN",
+  "IntersectStrings",
+  "IsAlphaNumeric",
+  "IsNullOrWhiteSpace",
+  "IsNumeric",
+  "IsOneOf",
+  "IsUppercase",
+  "JoinStrings",
+  "JoinStringsInRegion",
+  "LoadBloomFilter",
+  "MapBloomFilterFile",
+  "MapFile",
+  "MapPrefixSetFile",
+  "MapStringIndexFile",
+  "MarkRegion",
+  "MatchPrefixSet",
+  "MatchPrefixSetN",
+  "MaximumOfInt64s",
+  "MaximumOfInts",
+  "MaximumOfSizes",
+  "MinimumOf",
+  "MinimumOfInt64s",
+  "MinimumOfInts",
+  "MinimumOfSizes",
+  "PrependTo",
+  "PrependToInRegion",
+  "RemoveStringMapKey",
+  "ResetRegion",
+  "RollBackRegion",
+  "SaveBloomFilter",
+  "SaveBloomFilterFile",
+  "SavePrefixSetFile",
+  "SaveStringIndexFile",
+  "SecureClear",
+  "SortStrings",
+  "SortStringsStable",
+  "SortUniqueStrings",
+  "Split",
+  "SplitInRegion",
+  "StartsWith",
+  "StartsWithN",
+  "StartsWithNoCase",
+  "StartsWithNoCaseN",
+  "StringReplace",
+  "StringReplaceInRegion",
+  "SubtractStrings",
+  "SumOfInt64s",
+  "SumOfInts",
+  "SumOfSizes",
+  "TestBloomFilterKey",
+  "TestBloomFilterKeys",
+  "Trim",
+  "UnionStrings",
+  "UniqueStrings",
+  "UpdateStringHash",
+  "UpdateStringHashNoCase",
+  "VerifyBloomFilter",
+  "VerifyPrefixSet",
+  "VerifyStringIndex"
+};
+
+#ifdef COMMON_CORE_INSTRUMENT
+
+/* Counters of one thread.  Only the owning thread writes them; snapshots read
+ * them concurrently, so every access is a relaxed atomic, which costs nothing
+ * extra on the platforms we build for.  Blocks are never freed: when a thread
+ * exits, its block is released for reuse by a later thread, and the counts
+ * already in it carry on. */
+typedef struct _THREAD_STATS {
+  atomic_ullong ullCalls[CORE_FN_COUNT];
+  atomic_ullong ullBytes[CORE_FN_COUNT];
+  atomic_ullong ullNanoseconds[CORE_FN_COUNT];
+  atomic_ullong ullHistogram[CORE_FN_COUNT][CORE_STATS_HISTOGRAM_BUCKETS];
+  atomic_int bInUse;
+  struct _THREAD_STATS* pNext;
+} THREAD_STATS;
+
+static _Atomic(THREAD_STATS*) s_pStatsList = NULL;
+static __thread THREAD_STATS* s_pThreadStats = NULL;
+
+static pthread_once_t s_initOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_statsKey;
+
+#endif //COMMON_CORE_INSTRUMENT
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+#ifdef COMMON_CORE_INSTRUMENT
+
+///////////////////////////////////////////////////////////////////////////////
+// AddCounter function - Adds to a counter that only the calling thread ever
+// writes.
+//
+
+static inline void AddCounter(atomic_ullong* pCounter,
+    unsigned long long ullValue) {
+  atomic_store_explicit(pCounter,
+      atomic_load_explicit(pCounter, memory_order_relaxed) + ullValue,
+      memory_order_relaxed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetHistogramBucket function - Determines which histogram bucket a latency
+// falls in.
+//
+
+static inline int GetHistogramBucket(unsigned long long ullNanoseconds) {
+  int nBucket = 63 - __builtin_clzll(ullNanoseconds | 1);
+  return nBucket < CORE_STATS_HISTOGRAM_BUCKETS
+      ? nBucket : CORE_STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseThreadStats function - pthread key destructor that hands the block
+// of an exiting thread back for reuse.
+//
+
+static void ReleaseThreadStats(void* pvStats) {
+  THREAD_STATS* pStats = (THREAD_STATS*) pvStats;
+  atomic_store_explicit(&pStats->bInUse, 0, memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InitializeStats function - One-time setup of the thread key.
+//
+
+static void InitializeStats(void) {
+  pthread_key_create(&s_statsKey, ReleaseThreadStats);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetThreadStats function - Gets the calling thread's counters, claiming a
+// released block or allocating a new one on first use.  Returns NULL if no
+// block could be allocated, in which case the call goes uncounted.
+//
+
+static THREAD_STATS* GetThreadStats(void) {
+  if (s_pThreadStats != NULL) {
+    return s_pThreadStats;
+  }
+
+  pthread_once(&s_initOnce, InitializeStats);
+
+  THREAD_STATS* pStats = NULL;
+  for (THREAD_STATS* pCandidate = atomic_load_explicit(&s_pStatsList,
+      memory_order_acquire); pCandidate != NULL;
+      pCandidate = pCandidate->pNext) {
+    int bExpected = 0;
+    if (atomic_compare_exchange_strong(&pCandidate->bInUse, &bExpected, 1)) {
+      pStats = pCandidate;
+      break;
+    }
+  }
+
+  if (pStats == NULL) {
+    pStats = (THREAD_STATS*) calloc(1, sizeof(THREAD_STATS));
+    if (pStats == NULL) {
+      return NULL;
+    }
+    atomic_init(&pStats->bInUse, 1);
+
+    THREAD_STATS* pHead = atomic_load_explicit(&s_pStatsList,
+        memory_order_relaxed);
+    do {
+      pStats->pNext = pHead;
+    } while (!atomic_compare_exchange_weak_explicit(&s_pStatsList, &pHead,
+        pStats, memory_order_release, memory_order_relaxed));
+  }
+
+  pthread_setspecific(s_statsKey, pStats);
+  s_pThreadStats = pStats;
+
+  return pStats;
+}
+
+#endif //COMMON_CORE_INSTRUMENT
+
+///////////////////////////////////////////////////////////////////////////////
+// GetPercentileBound function - Gets the upper bound, in nanoseconds, of the
+// histogram bucket in which the percentile specified falls.
+//
+
+static unsigned long long GetPercentileBound(
+    const CORE_FUNCTION_STATS* pStats, double dPercentile) {
+  unsigned long long ullRank =
+      (unsigned long long) (dPercentile * pStats->ullCalls);
+  unsigned long long ullSeen = 0;
+
+  for (int i = 0; i < CORE_STATS_HISTOGRAM_BUCKETS; i++) {
+    ullSeen += pStats->ullHistogram[i];
+    if (ullSeen > ullRank) {
+      return 2ULL << i;
+    }
+  }
+
+  return 2ULL << (CORE_STATS_HISTOGRAM_BUCKETS - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Probe functions - used by the CORE_PROBE macros
+
+#ifdef COMMON_CORE_INSTRUMENT
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadCoreClock function - Reads the monotonic clock, in nanoseconds.
+//
+
+unsigned long long ReadCoreClock(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long) now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndCoreProbe function - Counts a completed call into the calling thread's
+// statistics.
+//
+
+void EndCoreProbe(CORE_PROBE* pProbe) {
+  unsigned long long ullElapsed = ReadCoreClock() - pProbe->ullStart;
+
+  /* Preserve errno: the probe runs after the function has set it */
+  int nSavedErrno = errno;
+
+  THREAD_STATS* pStats = GetThreadStats();
+  if (pStats != NULL) {
+    const int nFunction = pProbe->nFunction;
+    AddCounter(&pStats->ullCalls[nFunction], 1);
+    AddCounter(&pStats->ullBytes[nFunction], pProbe->ullBytes);
+    AddCounter(&pStats->ullNanoseconds[nFunction], ullElapsed);
+    AddCounter(&pStats->ullHistogram[nFunction]
+        [GetHistogramBucket(ullElapsed)], 1);
+  }
+
+  errno = nSavedErrno;
+}
+
+#endif //COMMON_CORE_INSTRUMENT
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// DumpCoreStats function
+
+void DumpCoreStats(FILE* fp, const CORE_STATS_SNAPSHOT* pSnapshot) {
+  if (fp == NULL || pSnapshot == NULL) {
+    return;
+  }
+
+  fprintf(fp, "%-28s %12s %14s %10s %10s %10s %10s\n", "function", "calls",
+      "bytes", "avg ns", "p50 ns<", "p99 ns<", "p999 ns<");
+
+  for (int i = 0; i < CORE_FN_COUNT; i++) {
+    const CORE_FUNCTION_STATS* pStats = &pSnapshot->functions[i];
+    if (pStats->ullCalls == 0) {
+      continue;
+    }
+
+    fprintf(fp, "%-28s %12llu %14llu %10llu %10llu %10llu %10llu\n",
+        s_pszFunctionNames[i], pStats->ullCalls, pStats->ullBytes,
+        pStats->ullNanoseconds / pStats->ullCalls,
+        GetPercentileBound(pStats, 0.50), GetPercentileBound(pStats, 0.99),
+        GetPercentileBound(pStats, 0.999));
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetCoreFunctionName function
+
+const char* GetCoreFunctionName(CORE_FUNCTION_ID nFunction) {
+  if ((int) nFunction < 0 || nFunction >= CORE_FN_COUNT) {
+    return NULL;
+  }
+
+  return s_pszFunctionNames[nFunction];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetCoreStatsSnapshot function
+
+void GetCoreStatsSnapshot(LPCORE_STATS_SNAPSHOT pSnapshot) {
+  if (pSnapshot == NULL) {
+    return;
+  }
+
+  memset(pSnapshot, 0, sizeof(CORE_STATS_SNAPSHOT));
+
+#ifdef COMMON_CORE_INSTRUMENT
+  for (THREAD_STATS* pStats = atomic_load_explicit(&s_pStatsList,
+      memory_order_acquire); pStats != NULL; pStats = pStats->pNext) {
+    for (int i = 0; i < CORE_FN_COUNT; i++) {
+      CORE_FUNCTION_STATS* pDest = &pSnapshot->functions[i];
+      pDest->ullCalls += atomic_load_explicit(&pStats->ullCalls[i],
+          memory_order_relaxed);
+      pDest->ullBytes += atomic_load_explicit(&pStats->ullBytes[i],
+          memory_order_relaxed);
+      pDest->ullNanoseconds += atomic_load_explicit(
+          &pStats->ullNanoseconds[i], memory_order_relaxed);
+      for (int j = 0; j < CORE_STATS_HISTOGRAM_BUCKETS; j++) {
+        pDest->ullHistogram[j] += atomic_load_explicit(
+            &pStats->ullHistogram[i][j], memory_order_relaxed);
+      }
+    }
+  }
+#endif //COMMON_CORE_INSTRUMENT
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsCoreStatsEnabled function
+
+BOOL IsCoreStatsEnabled(void) {
+#ifdef COMMON_CORE_INSTRUMENT
+  return TRUE;
+#else
+  return FALSE;
+#endif //COMMON_CORE_INSTRUMENT
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MergeCoreStatsSnapshot function
+
+void MergeCoreStatsSnapshot(LPCORE_STATS_SNAPSHOT pDest,
+    const CORE_STATS_SNAPSHOT* pSrc) {
+  if (pDest == NULL || pSrc == NULL) {
+    return;
+  }
+
+  for (int i = 0; i < CORE_FN_COUNT; i++) {
+    pDest->functions[i].ullCalls += pSrc->functions[i].ullCalls;
+    pDest->functions[i].ullBytes += pSrc->functions[i].ullBytes;
+    pDest->functions[i].ullNanoseconds += pSrc->functions[i].ullNanoseconds;
+    for (int j = 0; j < CORE_STATS_HISTOGRAM_BUCKETS; j++) {
+      pDest->functions[i].ullHistogram[j] +=
+          pSrc->functions[i].ullHistogram[j];
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ResetCoreStats function
+
+void ResetCoreStats(void) {
+#ifdef COMMON_CORE_INSTRUMENT
+  for (THREAD_STATS* pStats = atomic_load_explicit(&s_pStatsList,
+      memory_order_acquire); pStats != NULL; pStats = pStats->pNext) {
+    for (int i = 0; i < CORE_FN_COUNT; i++) {
+      atomic_store_explicit(&pStats->ullCalls[i], 0, memory_order_relaxed);
+      atomic_store_explicit(&pStats->ullBytes[i], 0, memory_order_relaxed);
+      atomic_store_explicit(&pStats->ullNanoseconds[i], 0,
+          memory_order_relaxed);
+      for (int j = 0; j < CORE_STATS_HISTOGRAM_BUCKETS; j++) {
+        atomic_store_explicit(&pStats->ullHistogram[i][j], 0,
+            memory_order_relaxed);
+      }
+    }
+  }
+#endif //COMMON_CORE_INSTRUMENT
+}
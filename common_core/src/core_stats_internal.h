@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_stats_internal.h - Probe macros used by the library's own functions to feed core_stats
+//
+// Put CORE_PROBE(id) as the first statement of an instrumented function; the call is counted
+// and timed when the enclosing scope is left, however that happens.  CORE_PROBE_BYTES(n)
+// records how many input bytes the call processed.  Unless the library is built with
+// COMMON_CORE_INSTRUMENT defined, both macros expand to nothing, and their arguments are not
+// evaluated.
+
+#ifndef __CORE_STATS_INTERNAL_H__
+#define __CORE_STATS_INTERNAL_H__
+
+#include "stdafx.h"
+#include "core_stats.h"
+
+#ifdef COMMON_CORE_INSTRUMENT
+
+typedef struct _CORE_PROBE {
+  CORE_FUNCTION_ID nFunction;
+  unsigned long long ullStart;
+  unsigned long long ullBytes;
+} CORE_PROBE;
+
+void EndCoreProbe(CORE_PROBE* pProbe);
+
+unsigned long long ReadCoreClock(void);
+
+#define CORE_PROBE(id) \
+  CORE_PROBE __coreProbe __attribute__((cleanup(EndCoreProbe))) = \
+    { (id), ReadCoreClock(), 0 }
+
+#define CORE_PROBE_BYTES(n) \
+  (__coreProbe.ullBytes = (unsigned long long) (n))
+
+#else
+
+#define CORE_PROBE(id)          ((void) 0)
+#define CORE_PROBE_BYTES(n)     ((void) 0)
+
+#endif //COMMON_CORE_INSTRUMENT
+
+#endif /* __CORE_STATS_INTERNAL_H__ */
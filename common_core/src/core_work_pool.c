@@ -0,0 +1,177 @@
+// core_work_pool.c - Implementation of work-stealing execution of task batches
+
+#include "stdafx.h"
+#include "core_work_pool.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* The task numbers a thread has yet to run, [nNext, nEnd).  Each share
+ * has a cache line of its own, so that threads taking tasks from their own
+ * shares do not slow each other down. */
+typedef struct _WORK_SHARE {
+  pthread_mutex_t lock;
+  size_t nNext;
+  size_t nEnd;
+} __attribute__((aligned(64))) WORK_SHARE;
+
+typedef struct _WORK_BATCH {
+  void (*pfnTask)(void* pvContext, size_t nTask);
+  void* pvContext;
+  int nThreads;
+  WORK_SHARE shares[WORK_POOL_MAX_THREADS];
+} WORK_BATCH;
+
+typedef struct _WORKER {
+  WORK_BATCH* pBatch;
+  int nIndex;
+} WORKER;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// TakeTask function - Takes the next task of a thread's own share.  Returns
+// FALSE if the share is empty.
+//
+
+static BOOL TakeTask(WORK_SHARE* pShare, size_t* pnTask) {
+  BOOL bTaken = FALSE;
+
+  pthread_mutex_lock(&pShare->lock);
+  if (pShare->nNext < pShare->nEnd) {
+    *pnTask = pShare->nNext++;
+    bTaken = TRUE;
+  }
+  pthread_mutex_unlock(&pShare->lock);
+
+  return bTaken;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StealTasks function - Moves the back half of another thread's remaining
+// share into the share of thread nThief.  Returns FALSE if every other share
+// is empty, which, since tasks never add tasks, means the thread is done.
+//
+
+static BOOL StealTasks(WORK_BATCH* pBatch, int nThief) {
+  for (int i = 1; i < pBatch->nThreads; i++) {
+    WORK_SHARE* pVictim = &pBatch->shares[(nThief + i) % pBatch->nThreads];
+
+    pthread_mutex_lock(&pVictim->lock);
+    const size_t END = pVictim->nEnd;
+    const size_t LEFT = END - pVictim->nNext;
+    pVictim->nEnd -= (LEFT + 1) / 2;
+    pthread_mutex_unlock(&pVictim->lock);
+
+    if (LEFT > 0) {
+      WORK_SHARE* pShare = &pBatch->shares[nThief];
+      pthread_mutex_lock(&pShare->lock);
+      pShare->nNext = END - (LEFT + 1) / 2;
+      pShare->nEnd = END;
+      pthread_mutex_unlock(&pShare->lock);
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RunWorker function - Runs the tasks of a thread's share, then those it
+// steals, until there are none left.
+//
+
+static void* RunWorker(void* pvWorker) {
+  const WORKER* pWorker = (const WORKER*) pvWorker;
+  WORK_BATCH* pBatch = pWorker->pBatch;
+  size_t nTask = 0;
+
+  do {
+    while (TakeTask(&pBatch->shares[pWorker->nIndex], &nTask)) {
+      pBatch->pfnTask(pBatch->pvContext, nTask);
+    }
+  } while (StealTasks(pBatch, pWorker->nIndex));
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// GetWorkPoolThreadCount function
+
+int GetWorkPoolThreadCount(int nRequested, size_t nTasks) {
+  long lThreads = nRequested;
+  if (lThreads <= 0) {
+    lThreads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+
+  if (lThreads > WORK_POOL_MAX_THREADS) {
+    lThreads = WORK_POOL_MAX_THREADS;
+  }
+  if ((size_t) lThreads > nTasks) {
+    lThreads = (long) nTasks;
+  }
+
+  return lThreads < 1 ? 1 : (int) lThreads;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RunWorkPool function
+
+void RunWorkPool(int nThreads, size_t nTasks,
+    void (*pfnTask)(void* pvContext, size_t nTask), void* pvContext) {
+  nThreads = GetWorkPoolThreadCount(nThreads, nTasks);
+
+  if (nThreads == 1) {
+    for (size_t i = 0; i < nTasks; i++) {
+      pfnTask(pvContext, i);
+    }
+    return;
+  }
+
+  WORK_BATCH* pBatch = (WORK_BATCH*) aligned_alloc(64, sizeof(WORK_BATCH));
+  if (pBatch == NULL) {
+    for (size_t i = 0; i < nTasks; i++) {
+      pfnTask(pvContext, i);
+    }
+    return;
+  }
+
+  pBatch->pfnTask = pfnTask;
+  pBatch->pvContext = pvContext;
+  pBatch->nThreads = nThreads;
+  for (int i = 0; i < nThreads; i++) {
+    pthread_mutex_init(&pBatch->shares[i].lock, NULL);
+    pBatch->shares[i].nNext = nTasks * i / nThreads;
+    pBatch->shares[i].nEnd = nTasks * (i + 1) / nThreads;
+  }
+
+  /* The shares of threads that cannot be created are stolen by the others */
+  WORKER workers[WORK_POOL_MAX_THREADS];
+  pthread_t threads[WORK_POOL_MAX_THREADS];
+  BOOL bCreated[WORK_POOL_MAX_THREADS] = { FALSE };
+  for (int i = 0; i < nThreads; i++) {
+    workers[i].pBatch = pBatch;
+    workers[i].nIndex = i;
+    if (i > 0) {
+      bCreated[i] = pthread_create(&threads[i], NULL, RunWorker,
+          &workers[i]) == 0;
+    }
+  }
+
+  RunWorker(&workers[0]);
+
+  for (int i = 1; i < nThreads; i++) {
+    if (bCreated[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  for (int i = 0; i < nThreads; i++) {
+    pthread_mutex_destroy(&pBatch->shares[i].lock);
+  }
+  free(pBatch);
+}
@@ -0,0 +1,42 @@
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// core_work_pool.h - Work-stealing execution of a batch of independent tasks, for the functions
+// that split large inputs across threads
+//
+// The tasks are numbered, and each thread starts with an even share of the numbers.  A thread
+// that runs out steals the back half of another thread's remaining share, so tasks that take
+// longer than others (a sort run full of long shared prefixes, say) do not leave the other
+// threads idle.  The threads are created for the batch and joined before RunWorkPool returns;
+// the batches this library runs are large enough that creating them costs next to nothing.
+
+#ifndef __CORE_WORK_POOL_H__
+#define __CORE_WORK_POOL_H__
+
+#include "stdafx.h"
+
+/**
+ * @brief Most threads a batch runs on.
+ */
+#define WORK_POOL_MAX_THREADS       64
+
+/**
+ * @brief Works out how many threads to run a batch on.
+ * @param nRequested Threads the caller asked for; zero or less for one per
+ * processor online.
+ * @param nTasks Number of tasks in the batch; there are never more threads
+ * than tasks.
+ * @returns A count between 1 and WORK_POOL_MAX_THREADS.
+ */
+int GetWorkPoolThreadCount(int nRequested, size_t nTasks);
+
+/**
+ * @brief Runs pfnTask(pvContext, i) for every i from 0 to nTasks - 1, on
+ * nThreads threads, the calling one among them, and returns when every task
+ * has finished.
+ * @remarks Tasks run in no particular order, and must not depend on each
+ * other.  If threads cannot be created, the ones that could, or the calling
+ * thread alone, run all the tasks.
+ */
+void RunWorkPool(int nThreads, size_t nTasks,
+    void (*pfnTask)(void* pvContext, size_t nTask), void* pvContext);
+
+#endif /* __CORE_WORK_POOL_H__ */
@@ -0,0 +1,519 @@
+// diagnostics.c - Implementation of the asynchronous diagnostic log
+
+#include "stdafx.h"
+#include "diagnostics.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Maximum number of ring slots gathered into one writev call */
+#define DIAGNOSTIC_WRITE_BATCH      64
+
+typedef struct _DIAGNOSTIC_SLOT {
+  size_t nLength;
+  char szText[DIAGNOSTIC_MESSAGE_SIZE];
+} DIAGNOSTIC_SLOT;
+
+/* Single-producer/single-consumer ring.  The owning thread is the only
+ * producer and advances nHead; whoever holds s_drainLock is the only consumer
+ * and advances nTail.  Rings are never freed: when a thread exits, its ring
+ * is released for reuse by a later thread. */
+typedef struct _DIAGNOSTIC_RING {
+  atomic_size_t nHead;
+  atomic_size_t nTail;
+  atomic_long lDropped;
+  atomic_long lDroppedReported; /* written by the consumer only */
+  atomic_int bInUse;
+  struct _DIAGNOSTIC_RING* pNext;
+  DIAGNOSTIC_SLOT slots[DIAGNOSTIC_RING_SLOTS];
+} DIAGNOSTIC_RING;
+
+static _Atomic(DIAGNOSTIC_RING*) s_pRingList = NULL;
+static __thread DIAGNOSTIC_RING* s_pThreadRing = NULL;
+
+static pthread_once_t s_initOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t s_ringKey;
+static pthread_mutex_t s_drainLock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int s_bDrainThreadRunning = 0;
+
+/* The drain thread parks on s_wakeCondition when every ring is empty, with
+ * s_bDrainThreadParked set; producers signal it after queueing a message,
+ * if the flag says it is parked.  A child process of fork() gets no drain
+ * thread, so it starts its own on its first message. */
+static pthread_mutex_t s_wakeLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_wakeCondition = PTHREAD_COND_INITIALIZER;
+static atomic_int s_bDrainThreadParked = 0;
+static atomic_int s_bRestartDrainThread = 0;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteFully function - Writes every byte described by the array of iovec
+// structures to stderr, resuming after partial writes and interruptions.
+//
+
+static void WriteFully(struct iovec* pVectors, int nVectors) {
+  while (nVectors > 0) {
+    ssize_t nWritten = writev(STDERR_FILENO, pVectors, nVectors);
+    if (nWritten < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return;     // Nothing sensible left to do with the messages
+    }
+
+    while (nVectors > 0 && (size_t) nWritten >= pVectors->iov_len) {
+      nWritten -= pVectors->iov_len;
+      pVectors++;
+      nVectors--;
+    }
+
+    if (nVectors > 0) {
+      pVectors->iov_base = (char*) pVectors->iov_base + nWritten;
+      pVectors->iov_len -= nWritten;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DrainRing function - Writes out everything queued in the ring specified.
+// Must be called with s_drainLock held.  Returns the count of messages
+// written.
+//
+
+static size_t DrainRing(DIAGNOSTIC_RING* pRing) {
+  size_t nDrained = 0;
+
+  long lDropped = atomic_load_explicit(&pRing->lDropped, memory_order_relaxed);
+  long lReported = atomic_load_explicit(&pRing->lDroppedReported,
+      memory_order_relaxed);
+  if (lDropped != lReported) {
+    char szNotice[80];
+    int nNoticeLength = snprintf(szNotice, sizeof(szNotice),
+        "[%ld diagnostic message(s) dropped]\n", lDropped - lReported);
+    struct iovec notice = { szNotice, (size_t) nNoticeLength };
+    WriteFully(&notice, 1);
+    atomic_store_explicit(&pRing->lDroppedReported, lDropped,
+        memory_order_relaxed);
+  }
+
+  for (;;) {
+    size_t nTail = atomic_load_explicit(&pRing->nTail, memory_order_relaxed);
+    size_t nHead = atomic_load_explicit(&pRing->nHead, memory_order_acquire);
+    if (nTail == nHead) {
+      break;
+    }
+
+    struct iovec vectors[DIAGNOSTIC_WRITE_BATCH];
+    int nVectors = 0;
+    for (size_t i = nTail; i != nHead && nVectors < DIAGNOSTIC_WRITE_BATCH;
+        i++) {
+      DIAGNOSTIC_SLOT* pSlot = &pRing->slots[i % DIAGNOSTIC_RING_SLOTS];
+      vectors[nVectors].iov_base = pSlot->szText;
+      vectors[nVectors].iov_len = pSlot->nLength;
+      nVectors++;
+    }
+
+    WriteFully(vectors, nVectors);
+
+    /* Only now may the producer reuse the slots we just wrote out */
+    atomic_store_explicit(&pRing->nTail, nTail + nVectors,
+        memory_order_release);
+    nDrained += nVectors;
+  }
+
+  return nDrained;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DrainAllRings function - Writes out everything queued in every ring.
+// Returns the count of messages written.
+//
+
+static size_t DrainAllRings(void) {
+  size_t nDrained = 0;
+
+  pthread_mutex_lock(&s_drainLock);
+  for (DIAGNOSTIC_RING* pRing = atomic_load_explicit(&s_pRingList,
+      memory_order_acquire); pRing != NULL; pRing = pRing->pNext) {
+    nDrained += DrainRing(pRing);
+  }
+  pthread_mutex_unlock(&s_drainLock);
+
+  return nDrained;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HasQueuedDiagnostics function - Tells whether any ring holds a message or
+// a dropped-message count not yet written.
+//
+
+static BOOL HasQueuedDiagnostics(void) {
+  for (DIAGNOSTIC_RING* pRing = atomic_load_explicit(&s_pRingList,
+      memory_order_acquire); pRing != NULL; pRing = pRing->pNext) {
+    if (atomic_load_explicit(&pRing->nHead, memory_order_relaxed)
+        != atomic_load_explicit(&pRing->nTail, memory_order_relaxed)
+        || atomic_load_explicit(&pRing->lDropped, memory_order_relaxed)
+        != atomic_load_explicit(&pRing->lDroppedReported,
+            memory_order_relaxed)) {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WakeDrainThread function - Signals the drain thread if it is parked.
+// Called by producers after they change a ring.  The fence pairs with the
+// one in DrainThreadProc: either the producer sees the thread parked and
+// signals it, or the thread sees the change and does not park.
+//
+
+static void WakeDrainThread(void) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (!atomic_load_explicit(&s_bDrainThreadParked, memory_order_relaxed)) {
+    return;
+  }
+
+  pthread_mutex_lock(&s_wakeLock);
+  pthread_cond_signal(&s_wakeCondition);
+  pthread_mutex_unlock(&s_wakeLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// DrainThreadProc function - Body of the background thread that empties the
+// rings.  Parks while every ring is empty, so that an idle process does not
+// wake it.
+//
+
+static void* DrainThreadProc(void* pvArg) {
+  (void) pvArg;
+
+  for (;;) {
+    if (DrainAllRings() > 0) {
+      continue;
+    }
+
+    pthread_mutex_lock(&s_wakeLock);
+    atomic_store_explicit(&s_bDrainThreadParked, 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (!HasQueuedDiagnostics()) {
+      pthread_cond_wait(&s_wakeCondition, &s_wakeLock);
+    }
+    atomic_store_explicit(&s_bDrainThreadParked, 0, memory_order_relaxed);
+    pthread_mutex_unlock(&s_wakeLock);
+  }
+
+  return NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// StartDrainThread function - Starts the drain thread, with every signal
+// blocked.
+//
+
+static void StartDrainThread(void) {
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+  /* The drain thread must not receive signals meant for the application */
+  sigset_t allSignals, oldSignals;
+  sigfillset(&allSignals);
+  pthread_sigmask(SIG_SETMASK, &allSignals, &oldSignals);
+
+  pthread_t drainThread;
+  if (pthread_create(&drainThread, &attr, DrainThreadProc, NULL) == 0) {
+    atomic_store(&s_bDrainThreadRunning, 1);
+  }
+
+  pthread_sigmask(SIG_SETMASK, &oldSignals, NULL);
+  pthread_attr_destroy(&attr);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LockForFork function - pthread_atfork prepare handler: holds the locks
+// across fork(), so that the child does not inherit one held by a thread
+// that it does not have.
+//
+
+static void LockForFork(void) {
+  pthread_mutex_lock(&s_drainLock);
+  pthread_mutex_lock(&s_wakeLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UnlockAfterFork function - pthread_atfork parent handler.
+//
+
+static void UnlockAfterFork(void) {
+  pthread_mutex_unlock(&s_wakeLock);
+  pthread_mutex_unlock(&s_drainLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ResetAfterFork function - pthread_atfork child handler.  The child has
+// only the thread that forked: the messages queued before the fork are the
+// parent's to write, the rings of the other threads are free for reuse, and
+// the drain thread is restarted by the child's first message.
+//
+
+static void ResetAfterFork(void) {
+  for (DIAGNOSTIC_RING* pRing = atomic_load_explicit(&s_pRingList,
+      memory_order_acquire); pRing != NULL; pRing = pRing->pNext) {
+    atomic_store(&pRing->nTail, atomic_load(&pRing->nHead));
+    atomic_store(&pRing->lDroppedReported, atomic_load(&pRing->lDropped));
+    atomic_store(&pRing->bInUse, pRing == s_pThreadRing);
+  }
+
+  pthread_cond_init(&s_wakeCondition, NULL);
+  atomic_store(&s_bDrainThreadParked, 0);
+  atomic_store(&s_bRestartDrainThread,
+      atomic_exchange(&s_bDrainThreadRunning, 0));
+
+  UnlockAfterFork();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseRing function - pthread key destructor that hands the ring of an
+// exiting thread back for reuse.  Anything still queued in it is drained
+// normally, since the indices survive the change of owner.
+//
+
+static void ReleaseRing(void* pvRing) {
+  DIAGNOSTIC_RING* pRing = (DIAGNOSTIC_RING*) pvRing;
+  atomic_store_explicit(&pRing->bInUse, 0, memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InitializeDiagnostics function - One-time setup: creates the thread key,
+// arranges for a flush at exit and for fork(), and starts the drain thread.
+//
+
+static void InitializeDiagnostics(void) {
+  pthread_key_create(&s_ringKey, ReleaseRing);
+  atexit(FlushDiagnostics);
+  pthread_atfork(LockForFork, UnlockAfterFork, ResetAfterFork);
+
+  StartDrainThread();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetThreadRing function - Gets the calling thread's ring, claiming a
+// released one or allocating a new one on first use.  Returns NULL if no
+// ring could be allocated.
+//
+
+static DIAGNOSTIC_RING* GetThreadRing(void) {
+  if (s_pThreadRing != NULL) {
+    return s_pThreadRing;
+  }
+
+  pthread_once(&s_initOnce, InitializeDiagnostics);
+
+  DIAGNOSTIC_RING* pRing = NULL;
+  for (DIAGNOSTIC_RING* pCandidate = atomic_load_explicit(&s_pRingList,
+      memory_order_acquire); pCandidate != NULL;
+      pCandidate = pCandidate->pNext) {
+    int bExpected = 0;
+    if (atomic_compare_exchange_strong(&pCandidate->bInUse, &bExpected, 1)) {
+      pRing = pCandidate;
+      break;
+    }
+  }
+
+  if (pRing == NULL) {
+    pRing = (DIAGNOSTIC_RING*) calloc(1, sizeof(DIAGNOSTIC_RING));
+    if (pRing == NULL) {
+      return NULL;
+    }
+    atomic_init(&pRing->bInUse, 1);
+
+    DIAGNOSTIC_RING* pHead = atomic_load_explicit(&s_pRingList,
+        memory_order_relaxed);
+    do {
+      pRing->pNext = pHead;
+    } while (!atomic_compare_exchange_weak_explicit(&s_pRingList, &pHead,
+        pRing, memory_order_release, memory_order_relaxed));
+  }
+
+  pthread_setspecific(s_ringKey, pRing);
+  s_pThreadRing = pRing;
+
+  return pRing;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteDirectly function - Writes a message to stderr before returning,
+// after whatever the calling thread queued before it.
+//
+
+static void WriteDirectly(const char* pszText, size_t nLength) {
+  struct iovec direct = { (void*) pszText, nLength };
+
+  /* The fork handlers must be in place before s_drainLock is ever held */
+  pthread_once(&s_initOnce, InitializeDiagnostics);
+
+  pthread_mutex_lock(&s_drainLock);
+  if (s_pThreadRing != NULL) {
+    DrainRing(s_pThreadRing);
+  }
+  WriteFully(&direct, 1);
+  pthread_mutex_unlock(&s_drainLock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EnqueueDiagnostic function - Places a message of known length into the
+// calling thread's ring, or writes it directly if it does not fit in a slot
+// or asynchronous logging is unavailable.
+//
+
+static void EnqueueDiagnostic(const char* pszText, size_t nLength) {
+  if (nLength >= DIAGNOSTIC_MESSAGE_SIZE) {
+    WriteDirectly(pszText, nLength);
+    return;
+  }
+
+  int bRestart = 1;
+  if (atomic_load_explicit(&s_bRestartDrainThread, memory_order_relaxed)
+      && atomic_compare_exchange_strong(&s_bRestartDrainThread, &bRestart,
+          0)) {
+    StartDrainThread();
+  }
+
+  DIAGNOSTIC_RING* pRing = GetThreadRing();
+  if (pRing == NULL || !atomic_load(&s_bDrainThreadRunning)) {
+    WriteDirectly(pszText, nLength);
+    return;
+  }
+
+  size_t nHead = atomic_load_explicit(&pRing->nHead, memory_order_relaxed);
+  size_t nTail = atomic_load_explicit(&pRing->nTail, memory_order_acquire);
+  if (nHead - nTail >= DIAGNOSTIC_RING_SLOTS) {
+    atomic_fetch_add_explicit(&pRing->lDropped, 1, memory_order_relaxed);
+    WakeDrainThread();
+    return;
+  }
+
+  DIAGNOSTIC_SLOT* pSlot = &pRing->slots[nHead % DIAGNOSTIC_RING_SLOTS];
+  memcpy(pSlot->szText, pszText, nLength);
+  pSlot->szText[nLength] = '\0';
+  pSlot->nLength = nLength;
+
+  atomic_store_explicit(&pRing->nHead, nHead + 1, memory_order_release);
+  WakeDrainThread();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FormatDiagnostic function - Formats a message and queues it, or writes it
+// directly if bDirect is set.  A message too long for a ring slot is
+// formatted again, in full, into a block of its own and written directly.
+//
+
+static void FormatDiagnostic(BOOL bDirect, const char* pszFormat,
+    va_list args) {
+  char szMessage[DIAGNOSTIC_MESSAGE_SIZE];
+
+  va_list argsAgain;
+  va_copy(argsAgain, args);
+  int nLength = vsnprintf(szMessage, sizeof(szMessage), pszFormat, args);
+
+  if (nLength > 0 && (size_t) nLength < sizeof(szMessage)) {
+    if (bDirect) {
+      WriteDirectly(szMessage, (size_t) nLength);
+    } else {
+      EnqueueDiagnostic(szMessage, (size_t) nLength);
+    }
+  } else if (nLength > 0) {
+    char* pszLong = (char*) malloc((size_t) nLength + 1);
+    if (pszLong != NULL) {
+      vsnprintf(pszLong, (size_t) nLength + 1, pszFormat, argsAgain);
+      WriteDirectly(pszLong, (size_t) nLength);
+      free(pszLong);
+    } else {
+      WriteDirectly(szMessage, sizeof(szMessage) - 1);
+    }
+  }
+
+  va_end(argsAgain);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// FlushDiagnostics function
+
+void FlushDiagnostics(void) {
+  if (atomic_load_explicit(&s_pRingList, memory_order_acquire) == NULL) {
+    return;     // Nothing has ever been logged
+  }
+
+  DrainAllRings();
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetDroppedDiagnosticCount function
+
+long GetDroppedDiagnosticCount(void) {
+  long lResult = 0;
+
+  for (DIAGNOSTIC_RING* pRing = atomic_load_explicit(&s_pRingList,
+      memory_order_acquire); pRing != NULL; pRing = pRing->pNext) {
+    lResult += atomic_load_explicit(&pRing->lDropped, memory_order_relaxed);
+  }
+
+  return lResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LogDiagnostic function
+
+void LogDiagnostic(const char* pszMessage) {
+  if (pszMessage == NULL || pszMessage[0] == '\0') {
+    return;
+  }
+
+  EnqueueDiagnostic(pszMessage, strlen(pszMessage));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LogDiagnosticFormat function
+
+void LogDiagnosticFormat(const char* pszFormat, ...) {
+  if (pszFormat == NULL || pszFormat[0] == '\0') {
+    return;
+  }
+
+  va_list args;
+  va_start(args, pszFormat);
+  FormatDiagnostic(FALSE, pszFormat, args);
+  va_end(args);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteDiagnostic function
+
+void WriteDiagnostic(const char* pszMessage) {
+  if (pszMessage == NULL || pszMessage[0] == '\0') {
+    return;
+  }
+
+  WriteDirectly(pszMessage, strlen(pszMessage));
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteDiagnosticFormat function
+
+void WriteDiagnosticFormat(const char* pszFormat, ...) {
+  if (pszFormat == NULL || pszFormat[0] == '\0') {
+    return;
+  }
+
+  va_list args;
+  va_start(args, pszFormat);
+  FormatDiagnostic(TRUE, pszFormat, args);
+  va_end(args);
+}
@@ -0,0 +1,410 @@
+// int_array.c - Implementation of the reductions over arrays of integers
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "int_array.h"
+#include "core_kernels.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Number of values IndexOfMinimumOf* reduces at a time; the block holding
+ * the minimum is read again to find it, so smaller blocks reread less and
+ * larger ones call the kernel less often */
+#ifndef INT_ARRAY_SEARCH_BLOCK
+#define INT_ARRAY_SEARCH_BLOCK        4096
+#endif //INT_ARRAY_SEARCH_BLOCK
+
+/* Number of values below which IndexOfMinimumOf* stops halving the block
+ * and compares the values one by one */
+#ifndef INT_ARRAY_SCAN_LENGTH
+#define INT_ARRAY_SCAN_LENGTH         64
+#endif //INT_ARRAY_SCAN_LENGTH
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// HasValues function - Tells whether an array has values to work on, and
+// records an error if it is NULL but said not to be empty.
+//
+
+static BOOL HasValues(const void* pvValues, size_t nCount,
+    const char* pszError) {
+  if (pvValues == NULL && nCount > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pszError);
+    return FALSE;
+  }
+
+  return nCount > 0;
+}
+
+static inline int MinimumInt(const CORE_KERNELS* pKernels,
+    const int* pnValues, size_t nCount) {
+  return pKernels->pfnMinimumInt(pnValues, nCount);
+}
+
+static inline int64_t MinimumInt64(const CORE_KERNELS* pKernels,
+    const int64_t* pllValues, size_t nCount) {
+  return pKernels->pfnMinimumInt64(pllValues, nCount);
+}
+
+#if SIZE_MAX == UINT64_MAX
+
+/* size_t is as wide as uint64_t, so arrays of it run on those kernels */
+static inline size_t MinimumSize(const CORE_KERNELS* pKernels,
+    const size_t* pnValues, size_t nCount) {
+  return (size_t) pKernels->pfnMinimumUint64((const uint64_t*) pnValues,
+      nCount);
+}
+
+static inline size_t MaximumSize(const CORE_KERNELS* pKernels,
+    const size_t* pnValues, size_t nCount) {
+  return (size_t) pKernels->pfnMaximumUint64((const uint64_t*) pnValues,
+      nCount);
+}
+
+static inline size_t SumSize(const CORE_KERNELS* pKernels,
+    const size_t* pnValues, size_t nCount) {
+  return (size_t) pKernels->pfnSumUint64((const uint64_t*) pnValues, nCount);
+}
+
+static inline void ClampSize(const CORE_KERNELS* pKernels, size_t* pnValues,
+    size_t nCount, size_t nLow, size_t nHigh) {
+  pKernels->pfnClampUint64((uint64_t*) pnValues, nCount, nLow, nHigh);
+}
+
+#else
+
+/* Narrower size_t arrays have no kernels; these loops are branch-free as
+ * the scalar kernels are */
+static inline size_t MinimumSize(const CORE_KERNELS* pKernels,
+    const size_t* pnValues, size_t nCount) {
+  size_t nMinimum = SIZE_MAX;
+  for (size_t i = 0; i < nCount; i++) {
+    nMinimum = pnValues[i] < nMinimum ? pnValues[i] : nMinimum;
+  }
+  return nMinimum;
+}
+
+static inline size_t MaximumSize(const CORE_KERNELS* pKernels,
+    const size_t* pnValues, size_t nCount) {
+  size_t nMaximum = 0;
+  for (size_t i = 0; i < nCount; i++) {
+    nMaximum = pnValues[i] > nMaximum ? pnValues[i] : nMaximum;
+  }
+  return nMaximum;
+}
+
+static inline size_t SumSize(const CORE_KERNELS* pKernels,
+    const size_t* pnValues, size_t nCount) {
+  size_t nSum = 0;
+  for (size_t i = 0; i < nCount; i++) {
+    nSum += pnValues[i];
+  }
+  return nSum;
+}
+
+static inline void ClampSize(const CORE_KERNELS* pKernels, size_t* pnValues,
+    size_t nCount, size_t nLow, size_t nHigh) {
+  for (size_t i = 0; i < nCount; i++) {
+    const size_t VALUE = pnValues[i] < nLow ? nLow : pnValues[i];
+    pnValues[i] = VALUE > nHigh ? nHigh : VALUE;
+  }
+}
+
+#endif //SIZE_MAX == UINT64_MAX
+
+///////////////////////////////////////////////////////////////////////////////
+// FindFirstMinimum* functions - Find the first occurrence of the minimum of
+// a non-empty array: the minimum of each block comes from the kernel, and
+// the first block whose minimum is the least is halved, keeping the first
+// half that holds it, until few enough values are left to compare one by
+// one.  The halves add up to about one more reading of the block.
+//
+
+#define FIND_FIRST_MINIMUM(Suffix, Type)                                      \
+static size_t FindFirstMinimum##Suffix(const CORE_KERNELS* pKernels,          \
+    const Type* pValues, size_t nCount) {                                     \
+  Type minimum = pValues[0];                                                  \
+  size_t nStart = 0;                                                          \
+  size_t nLength = 0;                                                         \
+  for (size_t i = 0; i < nCount; i += INT_ARRAY_SEARCH_BLOCK) {               \
+    const size_t LENGTH = nCount - i < INT_ARRAY_SEARCH_BLOCK                 \
+        ? nCount - i : INT_ARRAY_SEARCH_BLOCK;                                \
+    const Type BLOCK_MINIMUM = Minimum##Suffix(pKernels, pValues + i,         \
+        LENGTH);                                                              \
+    if (i == 0 || BLOCK_MINIMUM < minimum) {                                  \
+      minimum = BLOCK_MINIMUM;                                                \
+      nStart = i;                                                             \
+      nLength = LENGTH;                                                       \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  while (nLength > INT_ARRAY_SCAN_LENGTH) {                                   \
+    const size_t HALF = nLength / 2;                                          \
+    if (Minimum##Suffix(pKernels, pValues + nStart, HALF) == minimum) {       \
+      nLength = HALF;                                                         \
+    } else {                                                                  \
+      nStart += HALF;                                                         \
+      nLength -= HALF;                                                        \
+    }                                                                         \
+  }                                                                           \
+                                                                              \
+  while (pValues[nStart] != minimum) {                                        \
+    nStart++;                                                                 \
+  }                                                                           \
+  return nStart;                                                              \
+}
+
+FIND_FIRST_MINIMUM(Int, int)
+FIND_FIRST_MINIMUM(Int64, int64_t)
+FIND_FIRST_MINIMUM(Size, size_t)
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// ClampInt64s function
+
+int ClampInt64s(int64_t* pllValues, size_t nCount, int64_t llLow,
+    int64_t llHigh) {
+  CORE_PROBE(CORE_FN_CLAMP_INT64S);
+
+  if (pllValues == NULL && nCount > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "ClampInt64s: pllValues");
+    return ERROR;
+  }
+
+  if (llLow > llHigh) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "ClampInt64s: llLow");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int64_t));
+
+  if (nCount > 0) {
+    GetCoreKernels()->pfnClampInt64(pllValues, nCount, llLow, llHigh);
+  }
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ClampInts function
+
+int ClampInts(int* pnValues, size_t nCount, int nLow, int nHigh) {
+  CORE_PROBE(CORE_FN_CLAMP_INTS);
+
+  if (pnValues == NULL && nCount > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "ClampInts: pnValues");
+    return ERROR;
+  }
+
+  if (nLow > nHigh) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "ClampInts: nLow");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int));
+
+  if (nCount > 0) {
+    GetCoreKernels()->pfnClampInt(pnValues, nCount, nLow, nHigh);
+  }
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ClampSizes function
+
+int ClampSizes(size_t* pnValues, size_t nCount, size_t nLow, size_t nHigh) {
+  CORE_PROBE(CORE_FN_CLAMP_SIZES);
+
+  if (pnValues == NULL && nCount > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "ClampSizes: pnValues");
+    return ERROR;
+  }
+
+  if (nLow > nHigh) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "ClampSizes: nLow");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(size_t));
+
+  if (nCount > 0) {
+    ClampSize(GetCoreKernels(), pnValues, nCount, nLow, nHigh);
+  }
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexOfMinimumOfInt64s function
+
+size_t IndexOfMinimumOfInt64s(const int64_t* pllValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_INDEX_OF_MINIMUM_OF_INT64S);
+
+  if (!HasValues(pllValues, nCount, "IndexOfMinimumOfInt64s: pllValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int64_t));
+  return FindFirstMinimumInt64(GetCoreKernels(), pllValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexOfMinimumOfInts function
+
+size_t IndexOfMinimumOfInts(const int* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_INDEX_OF_MINIMUM_OF_INTS);
+
+  if (!HasValues(pnValues, nCount, "IndexOfMinimumOfInts: pnValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int));
+  return FindFirstMinimumInt(GetCoreKernels(), pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexOfMinimumOfSizes function
+
+size_t IndexOfMinimumOfSizes(const size_t* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_INDEX_OF_MINIMUM_OF_SIZES);
+
+  if (!HasValues(pnValues, nCount, "IndexOfMinimumOfSizes: pnValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(size_t));
+  return FindFirstMinimumSize(GetCoreKernels(), pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MaximumOfInt64s function
+
+int64_t MaximumOfInt64s(const int64_t* pllValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_MAXIMUM_OF_INT64S);
+
+  if (!HasValues(pllValues, nCount, "MaximumOfInt64s: pllValues")) {
+    return INT64_MIN;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int64_t));
+  return GetCoreKernels()->pfnMaximumInt64(pllValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MaximumOfInts function
+
+int MaximumOfInts(const int* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_MAXIMUM_OF_INTS);
+
+  if (!HasValues(pnValues, nCount, "MaximumOfInts: pnValues")) {
+    return INT_MIN;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int));
+  return GetCoreKernels()->pfnMaximumInt(pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MaximumOfSizes function
+
+size_t MaximumOfSizes(const size_t* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_MAXIMUM_OF_SIZES);
+
+  if (!HasValues(pnValues, nCount, "MaximumOfSizes: pnValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(size_t));
+  return MaximumSize(GetCoreKernels(), pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MinimumOfInt64s function
+
+int64_t MinimumOfInt64s(const int64_t* pllValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_MINIMUM_OF_INT64S);
+
+  if (!HasValues(pllValues, nCount, "MinimumOfInt64s: pllValues")) {
+    return INT64_MAX;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int64_t));
+  return MinimumInt64(GetCoreKernels(), pllValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MinimumOfInts function
+
+int MinimumOfInts(const int* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_MINIMUM_OF_INTS);
+
+  if (!HasValues(pnValues, nCount, "MinimumOfInts: pnValues")) {
+    return INT_MAX;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int));
+  return MinimumInt(GetCoreKernels(), pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MinimumOfSizes function
+
+size_t MinimumOfSizes(const size_t* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_MINIMUM_OF_SIZES);
+
+  if (!HasValues(pnValues, nCount, "MinimumOfSizes: pnValues")) {
+    return SIZE_MAX;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(size_t));
+  return MinimumSize(GetCoreKernels(), pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SumOfInt64s function
+
+int64_t SumOfInt64s(const int64_t* pllValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_SUM_OF_INT64S);
+
+  if (!HasValues(pllValues, nCount, "SumOfInt64s: pllValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int64_t));
+
+  /* Added as unsigned values, which wrap instead of overflowing */
+  return (int64_t) GetCoreKernels()->pfnSumUint64(
+      (const uint64_t*) pllValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SumOfInts function
+
+int64_t SumOfInts(const int* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_SUM_OF_INTS);
+
+  if (!HasValues(pnValues, nCount, "SumOfInts: pnValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(int));
+  return GetCoreKernels()->pfnSumInt(pnValues, nCount);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SumOfSizes function
+
+size_t SumOfSizes(const size_t* pnValues, size_t nCount) {
+  CORE_PROBE(CORE_FN_SUM_OF_SIZES);
+
+  if (!HasValues(pnValues, nCount, "SumOfSizes: pnValues")) {
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nCount * sizeof(size_t));
+  return SumSize(GetCoreKernels(), pnValues, nCount);
+}
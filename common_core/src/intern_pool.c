@@ -0,0 +1,502 @@
+// intern_pool.c - Implementation of pools of interned strings
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "intern_pool.h"
+#include "core_alloc.h"
+#include "core_fold.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Slots in a new pool's hash table; always a power of 2 */
+#ifndef INTERN_POOL_INITIAL_SLOTS
+#define INTERN_POOL_INITIAL_SLOTS     64
+#endif //INTERN_POOL_INITIAL_SLOTS
+
+/* Size of the blocks the canonical strings are carved from */
+#ifndef INTERN_POOL_BLOCK_SIZE
+#define INTERN_POOL_BLOCK_SIZE        (64 * 1024)
+#endif //INTERN_POOL_BLOCK_SIZE
+
+/* The ID-to-string table is a list of chunks, each twice the size of the one
+ * before it, so that it can grow without moving what readers may be reading.
+ * The first chunk holds INTERN_POOL_ID_BASE IDs; 24 chunks cover INT_MAX. */
+#define INTERN_POOL_ID_BASE           256
+#define INTERN_POOL_ID_CHUNKS         24
+
+/* A canonical string.  Canonical pointers point at szText, so the rest of
+ * the entry can be found from them. */
+typedef struct _INTERN_ENTRY {
+  uint64_t ullHash;
+  size_t nLength;
+  int nId;
+  char szText[];
+} INTERN_ENTRY;
+
+/* Open-addressing hash table of the entries, probed linearly.  A table is
+ * replaced, never resized in place, and tables it replaced stay allocated
+ * until the pool is freed, since readers may still be probing them. */
+typedef struct _INTERN_TABLE {
+  struct _INTERN_TABLE* pRetired;   /* the table this one replaced */
+  size_t nMask;                     /* number of slots - 1 */
+  _Atomic(INTERN_ENTRY*) pSlots[];
+} INTERN_TABLE;
+
+typedef struct _INTERN_BLOCK {
+  struct _INTERN_BLOCK* pNext;
+  size_t nUsed;
+  size_t nSize;
+  _Alignas(INTERN_ENTRY) char data[];
+} INTERN_BLOCK;
+
+/* Readers load pTable, the slots, nCount and the ID chunks with acquire
+ * semantics; writers, one at a time under lock, fill in everything an entry
+ * needs before publishing it with release semantics. */
+struct _INTERN_POOL {
+  BOOL bFoldCase;
+  CASE_FOLD fold;                   /* tolower(3), when the pool was made */
+  _Atomic(INTERN_TABLE*) pTable;
+  atomic_int nCount;
+  _Atomic(INTERN_ENTRY**) ppIdChunks[INTERN_POOL_ID_CHUNKS];
+  pthread_mutex_t lock;
+  INTERN_BLOCK* pBlocks;            /* block being carved first */
+};
+
+#define ENTRY_OF(pszInterned) \
+  ((const INTERN_ENTRY*) ((pszInterned) - offsetof(INTERN_ENTRY, szText)))
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// HashKey function - Hashes a string, or its lowercase form if the pool folds
+// case.
+//
+
+static inline uint64_t HashKey(const INTERN_POOL* pPool, const char* pchKey,
+    size_t nLength) {
+  return pPool->bFoldCase ? HashFolded(&pPool->fold, pchKey, nLength)
+      : HashBytes(pchKey, nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchesKey function - Determines whether an entry holds the key specified.
+//
+
+static inline BOOL MatchesKey(const INTERN_POOL* pPool,
+    const INTERN_ENTRY* pEntry, uint64_t ullHash, const char* pchKey,
+    size_t nLength) {
+  if (pEntry->ullHash != ullHash || pEntry->nLength != nLength) {
+    return FALSE;
+  }
+
+  if (!pPool->bFoldCase) {
+    return nLength == 0 || memcmp(pEntry->szText, pchKey, nLength) == 0;
+  }
+  return EqualsFolded(&pPool->fold, pEntry->szText, pchKey, nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindEntry function - Probes the current table for a key.  Returns the
+// entry, or NULL if the key has not been interned.
+//
+
+static const INTERN_ENTRY* FindEntry(const INTERN_POOL* pPool,
+    const char* pchKey, size_t nLength, uint64_t ullHash) {
+  INTERN_TABLE* pTable = atomic_load_explicit(&pPool->pTable,
+      memory_order_acquire);
+
+  for (size_t i = ullHash & pTable->nMask; ; i = (i + 1) & pTable->nMask) {
+    const INTERN_ENTRY* pEntry = atomic_load_explicit(&pTable->pSlots[i],
+        memory_order_acquire);
+    if (pEntry == NULL
+        || MatchesKey(pPool, pEntry, ullHash, pchKey, nLength)) {
+      return pEntry;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LocateId function - Gets the chunk of the ID-to-string table an ID is in,
+// and its index in that chunk.
+//
+
+static inline int LocateId(int nId, size_t* pnIndex) {
+  const unsigned long long BUCKET =
+      (unsigned long long) nId / INTERN_POOL_ID_BASE + 1;
+  const int CHUNK = 63 - __builtin_clzll(BUCKET);
+  *pnIndex = (size_t) nId - INTERN_POOL_ID_BASE * ((1ULL << CHUNK) - 1);
+  return CHUNK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateTable function - Allocates an empty table of nSlots slots.
+//
+
+static INTERN_TABLE* CreateTable(size_t nSlots) {
+  INTERN_TABLE* pTable = (INTERN_TABLE*) CoreMalloc(sizeof(INTERN_TABLE)
+      + nSlots * sizeof(pTable->pSlots[0]), CORE_ALLOC_INTERN_POOL);
+  if (pTable == NULL) {
+    return NULL;
+  }
+
+  pTable->pRetired = NULL;
+  pTable->nMask = nSlots - 1;
+  for (size_t i = 0; i < nSlots; i++) {
+    atomic_init(&pTable->pSlots[i], NULL);
+  }
+  return pTable;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PlaceEntry function - Puts an entry in the first free slot of its probe
+// sequence.  Caller must hold the pool's lock.
+//
+
+static void PlaceEntry(INTERN_TABLE* pTable, INTERN_ENTRY* pEntry) {
+  size_t i = pEntry->ullHash & pTable->nMask;
+  while (atomic_load_explicit(&pTable->pSlots[i], memory_order_relaxed)
+      != NULL) {
+    i = (i + 1) & pTable->nMask;
+  }
+  atomic_store_explicit(&pTable->pSlots[i], pEntry, memory_order_release);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GrowTable function - Replaces the pool's table with one twice its size.
+// Caller must hold the pool's lock.  Returns FALSE if memory ran out.
+//
+
+static BOOL GrowTable(LPINTERN_POOL pPool) {
+  INTERN_TABLE* pOld = atomic_load_explicit(&pPool->pTable,
+      memory_order_relaxed);
+  INTERN_TABLE* pNew = CreateTable(2 * (pOld->nMask + 1));
+  if (pNew == NULL) {
+    return FALSE;
+  }
+
+  for (size_t i = 0; i <= pOld->nMask; i++) {
+    INTERN_ENTRY* pEntry = atomic_load_explicit(&pOld->pSlots[i],
+        memory_order_relaxed);
+    if (pEntry != NULL) {
+      PlaceEntry(pNew, pEntry);
+    }
+  }
+
+  pNew->pRetired = pOld;
+  atomic_store_explicit(&pPool->pTable, pNew, memory_order_release);
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AllocateEntry function - Carves an entry for nLength characters out of
+// the pool's blocks.  Caller must hold the pool's lock.
+//
+
+static INTERN_ENTRY* AllocateEntry(LPINTERN_POOL pPool, size_t nLength) {
+  const size_t ALIGNMENT = _Alignof(INTERN_ENTRY);
+  const size_t SIZE = (sizeof(INTERN_ENTRY) + nLength + 1 + ALIGNMENT - 1)
+      / ALIGNMENT * ALIGNMENT;
+
+  INTERN_BLOCK* pBlock = pPool->pBlocks;
+  if (pBlock == NULL || pBlock->nSize - pBlock->nUsed < SIZE) {
+    /* Large strings get a block of their own, behind the one being carved */
+    const BOOL LARGE = SIZE > INTERN_POOL_BLOCK_SIZE / 4;
+    const BOOL DEDICATED = LARGE && pPool->pBlocks != NULL;
+    const size_t BLOCK_SIZE = LARGE ? SIZE : INTERN_POOL_BLOCK_SIZE;
+
+    pBlock = (INTERN_BLOCK*) CoreMalloc(sizeof(INTERN_BLOCK) + BLOCK_SIZE,
+        CORE_ALLOC_INTERN_POOL);
+    if (pBlock == NULL) {
+      return NULL;
+    }
+
+    pBlock->nUsed = 0;
+    pBlock->nSize = BLOCK_SIZE;
+    if (DEDICATED) {
+      pBlock->pNext = pPool->pBlocks->pNext;
+      pPool->pBlocks->pNext = pBlock;
+    } else {
+      pBlock->pNext = pPool->pBlocks;
+      pPool->pBlocks = pBlock;
+    }
+  }
+
+  INTERN_ENTRY* pEntry = (INTERN_ENTRY*) (pBlock->data + pBlock->nUsed);
+  pBlock->nUsed += SIZE;
+  return pEntry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AddEntry function - Adds a key the pool does not have.  Caller must hold
+// the pool's lock.  Returns NULL, with the last-error record set, on
+// failure.
+//
+
+static const INTERN_ENTRY* AddEntry(LPINTERN_POOL pPool, const char* pchKey,
+    size_t nLength, uint64_t ullHash) {
+  const int ID = atomic_load_explicit(&pPool->nCount, memory_order_relaxed);
+  if (ID == INT_MAX) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "InternString: pool is full");
+    return NULL;
+  }
+
+  /* Keep the table at most half full, so probe sequences stay short */
+  INTERN_TABLE* pTable = atomic_load_explicit(&pPool->pTable,
+      memory_order_relaxed);
+  if ((size_t) ID + 1 > (pTable->nMask + 1) / 2 && !GrowTable(pPool)) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "InternString");
+    return NULL;
+  }
+
+  size_t nIndex = 0;
+  const int CHUNK = LocateId(ID, &nIndex);
+  INTERN_ENTRY** ppChunk = atomic_load_explicit(&pPool->ppIdChunks[CHUNK],
+      memory_order_relaxed);
+  if (ppChunk == NULL) {
+    ppChunk = (INTERN_ENTRY**) CoreMalloc(
+        ((size_t) INTERN_POOL_ID_BASE << CHUNK) * sizeof(INTERN_ENTRY*),
+        CORE_ALLOC_INTERN_POOL);
+    if (ppChunk == NULL) {
+      SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "InternString");
+      return NULL;
+    }
+    atomic_store_explicit(&pPool->ppIdChunks[CHUNK], ppChunk,
+        memory_order_release);
+  }
+
+  INTERN_ENTRY* pEntry = AllocateEntry(pPool, nLength);
+  if (pEntry == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "InternString");
+    return NULL;
+  }
+
+  pEntry->ullHash = ullHash;
+  pEntry->nLength = nLength;
+  pEntry->nId = ID;
+  if (nLength > 0) {
+    memcpy(pEntry->szText, pchKey, nLength);
+  }
+  pEntry->szText[nLength] = '\0';
+
+  ppChunk[nIndex] = pEntry;
+  PlaceEntry(atomic_load_explicit(&pPool->pTable, memory_order_relaxed),
+      pEntry);
+  atomic_store_explicit(&pPool->nCount, ID + 1, memory_order_release);
+  return pEntry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateInternPool function
+
+int CreateInternPool(BOOL bFoldCase, LPINTERN_POOL* ppPool) {
+  CORE_PROBE(CORE_FN_CREATE_INTERN_POOL);
+
+  if (ppPool == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "CreateInternPool: ppPool");
+    return ERROR;
+  }
+  *ppPool = NULL;
+
+  LPINTERN_POOL pPool = (LPINTERN_POOL) CoreMalloc(sizeof(INTERN_POOL),
+      CORE_ALLOC_INTERN_POOL);
+  INTERN_TABLE* pTable = CreateTable(INTERN_POOL_INITIAL_SLOTS);
+  if (pPool == NULL || pTable == NULL) {
+    CoreFree(pPool);
+    CoreFree(pTable);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateInternPool");
+    return ERROR;
+  }
+
+  pPool->bFoldCase = bFoldCase ? TRUE : FALSE;
+  BuildCaseFold(&pPool->fold);
+  atomic_init(&pPool->pTable, pTable);
+  atomic_init(&pPool->nCount, 0);
+  for (int i = 0; i < INTERN_POOL_ID_CHUNKS; i++) {
+    atomic_init(&pPool->ppIdChunks[i], NULL);
+  }
+  pthread_mutex_init(&pPool->lock, NULL);
+  pPool->pBlocks = NULL;
+
+  *ppPool = pPool;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindInternedString function
+
+const char* FindInternedString(const INTERN_POOL* pPool,
+    const char* pszString) {
+  CORE_PROBE(CORE_FN_FIND_INTERNED_STRING);
+
+  if (pPool == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "FindInternedString: pPool");
+    return NULL;
+  }
+
+  if (pszString == NULL) {
+    return NULL;
+  }
+
+  const size_t LENGTH = strlen(pszString);
+  CORE_PROBE_BYTES(LENGTH);
+
+  const INTERN_ENTRY* pEntry = FindEntry(pPool, pszString, LENGTH,
+      HashKey(pPool, pszString, LENGTH));
+  return pEntry == NULL ? NULL : pEntry->szText;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindInternedStringN function
+
+const char* FindInternedStringN(const INTERN_POOL* pPool,
+    const char* pchString, size_t nLength) {
+  CORE_PROBE(CORE_FN_FIND_INTERNED_STRING_N);
+
+  if (pPool == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "FindInternedStringN: pPool");
+    return NULL;
+  }
+
+  if (pchString == NULL && nLength > 0) {
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  const INTERN_ENTRY* pEntry = FindEntry(pPool, pchString, nLength,
+      HashKey(pPool, pchString, nLength));
+  return pEntry == NULL ? NULL : pEntry->szText;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeInternPool function
+
+void FreeInternPool(LPINTERN_POOL* ppPool) {
+  CORE_PROBE(CORE_FN_FREE_INTERN_POOL);
+
+  if (ppPool == NULL || *ppPool == NULL) {
+    return;
+  }
+
+  LPINTERN_POOL pPool = *ppPool;
+
+  INTERN_TABLE* pTable = atomic_load(&pPool->pTable);
+  while (pTable != NULL) {
+    INTERN_TABLE* pRetired = pTable->pRetired;
+    CoreFree(pTable);
+    pTable = pRetired;
+  }
+
+  while (pPool->pBlocks != NULL) {
+    INTERN_BLOCK* pNext = pPool->pBlocks->pNext;
+    CoreFree(pPool->pBlocks);
+    pPool->pBlocks = pNext;
+  }
+
+  for (int i = 0; i < INTERN_POOL_ID_CHUNKS; i++) {
+    CoreFree(atomic_load(&pPool->ppIdChunks[i]));
+  }
+
+  pthread_mutex_destroy(&pPool->lock);
+  CoreFree(pPool);
+  *ppPool = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetInternedString function
+
+const char* GetInternedString(const INTERN_POOL* pPool, int nId) {
+  if (pPool == NULL || nId < 0 || nId >= atomic_load_explicit(
+      &pPool->nCount, memory_order_acquire)) {
+    return NULL;
+  }
+
+  size_t nIndex = 0;
+  const int CHUNK = LocateId(nId, &nIndex);
+  INTERN_ENTRY** ppChunk = atomic_load_explicit(
+      &pPool->ppIdChunks[CHUNK], memory_order_acquire);
+  return ppChunk[nIndex]->szText;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetInternedStringId function
+
+int GetInternedStringId(const char* pszInterned) {
+  return ENTRY_OF(pszInterned)->nId;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetInternedStringLength function
+
+size_t GetInternedStringLength(const char* pszInterned) {
+  return ENTRY_OF(pszInterned)->nLength;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetInternPoolCount function
+
+int GetInternPoolCount(const INTERN_POOL* pPool) {
+  return pPool == NULL ? 0 : atomic_load_explicit(
+      &pPool->nCount, memory_order_acquire);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InternString function
+
+const char* InternString(LPINTERN_POOL pPool, const char* pszString) {
+  CORE_PROBE(CORE_FN_INTERN_STRING);
+
+  if (pszString == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "InternString: pszString");
+    return NULL;
+  }
+
+  const size_t LENGTH = strlen(pszString);
+  CORE_PROBE_BYTES(LENGTH);
+
+  return InternStringN(pPool, pszString, LENGTH);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InternStringN function
+
+const char* InternStringN(LPINTERN_POOL pPool, const char* pchString,
+    size_t nLength) {
+  CORE_PROBE(CORE_FN_INTERN_STRING_N);
+
+  if (pPool == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "InternStringN: pPool");
+    return NULL;
+  }
+
+  if (pchString == NULL && nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "InternStringN: pchString");
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  const uint64_t HASH = HashKey(pPool, pchString, nLength);
+  const INTERN_ENTRY* pEntry = FindEntry(pPool, pchString, nLength, HASH);
+  if (pEntry != NULL) {
+    return pEntry->szText;
+  }
+
+  /* Another thread may have added it since; look again under the lock */
+  pthread_mutex_lock(&pPool->lock);
+  pEntry = FindEntry(pPool, pchString, nLength, HASH);
+  if (pEntry == NULL) {
+    pEntry = AddEntry(pPool, pchString, nLength, HASH);
+  }
+  pthread_mutex_unlock(&pPool->lock);
+
+  return pEntry == NULL ? NULL : pEntry->szText;
+}
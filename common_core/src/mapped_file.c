@@ -0,0 +1,272 @@
+// mapped_file.c - Implementation of text files mapped into memory and indexed by line
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "mapped_file.h"
+#include "core_alloc.h"
+#include "core_kernels.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Bytes of the file the kernel searches for newlines per call; the index
+ * grows, if it must, between blocks.  A power of 2 no larger than 2^32, so
+ * that no block straddles two segments. */
+#ifndef MAPPED_FILE_SCAN_BLOCK
+#define MAPPED_FILE_SCAN_BLOCK        65536
+#endif //MAPPED_FILE_SCAN_BLOCK
+
+/* The index keeps the low 32 bits of each newline's offset; the segment, the
+ * 4 GiB of the file it lies in, supplies the rest */
+#define SEGMENT_BITS                  32
+
+struct _MAPPED_FILE {
+  const char* pchData;          /* the mapping; NULL if the file is empty */
+  size_t nSize;
+  uint32_t* pnNewlines;         /* low bits of each newline's offset */
+  size_t nNewlines;
+  size_t nLines;
+  size_t nSegments;
+  size_t nSegmentStarts[];      /* index of each segment's first newline */
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// SetFileError function - Records an error about a file, naming it.
+//
+
+static void SetFileError(int nCode, const char* pszWhat,
+    const char* pszPath) {
+  char szMessage[CORE_ERROR_MESSAGE_SIZE];
+  snprintf(szMessage, sizeof(szMessage), "MapFile: %s %s", pszWhat, pszPath);
+  SetLastCoreError(nCode, szMessage);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseMappedFile function - Unmaps a file and releases its index and the
+// file itself.
+//
+
+static void ReleaseMappedFile(LPMAPPED_FILE pFile) {
+  if (pFile->pchData != NULL) {
+    munmap((void*) pFile->pchData, pFile->nSize);
+  }
+
+  CoreFree(pFile->pnNewlines);
+  CoreFree(pFile);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IndexNewlines function - Records the offset of every newline of a file,
+// a block at a time, growing the index so that it always has room for a
+// whole block of newlines, then trimming it to those found.  Returns FALSE
+// if memory ran out.
+//
+
+static BOOL IndexNewlines(LPMAPPED_FILE pFile) {
+  const CORE_KERNELS* pKernels = GetCoreKernels();
+  size_t nCapacity = 0;
+
+  for (size_t nOffset = 0; nOffset < pFile->nSize;
+      nOffset += MAPPED_FILE_SCAN_BLOCK) {
+    const size_t LENGTH = pFile->nSize - nOffset < MAPPED_FILE_SCAN_BLOCK
+        ? pFile->nSize - nOffset : MAPPED_FILE_SCAN_BLOCK;
+    const uint64_t OFFSET = (uint64_t) nOffset;
+    if ((OFFSET & (((uint64_t) 1 << SEGMENT_BITS) - 1)) == 0) {
+      pFile->nSegmentStarts[OFFSET >> SEGMENT_BITS] = pFile->nNewlines;
+    }
+
+    if (pFile->nNewlines + LENGTH > nCapacity) {
+      const size_t CAPACITY = 2 * nCapacity > pFile->nNewlines + LENGTH
+          ? 2 * nCapacity : pFile->nNewlines + LENGTH;
+      uint32_t* pnGrown = (uint32_t*) CoreRealloc(pFile->pnNewlines,
+          CAPACITY * sizeof(uint32_t), CORE_ALLOC_MAPPED_FILE);
+      if (pnGrown == NULL) {
+        return FALSE;
+      }
+      pFile->pnNewlines = pnGrown;
+      nCapacity = CAPACITY;
+    }
+
+    pFile->nNewlines += pKernels->pfnFindByteOffsets(pFile->pchData + nOffset,
+        LENGTH, '\n', (uint32_t) OFFSET, pFile->pnNewlines + pFile->nNewlines);
+  }
+
+  /* A block that cannot shrink in place stays as it is */
+  if (pFile->nNewlines == 0) {
+    CoreFree(pFile->pnNewlines);
+    pFile->pnNewlines = NULL;
+  } else if (pFile->nNewlines < nCapacity) {
+    uint32_t* pnTrimmed = (uint32_t*) CoreRealloc(pFile->pnNewlines,
+        pFile->nNewlines * sizeof(uint32_t), CORE_ALLOC_MAPPED_FILE);
+    if (pnTrimmed != NULL) {
+      pFile->pnNewlines = pnTrimmed;
+    }
+  }
+
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetNewlineOffset function - Gets the offset of a file's newline from its
+// index entry and segment.  Files smaller than 4 GiB have a single segment,
+// so the search costs nothing.
+//
+
+static inline size_t GetNewlineOffset(const MAPPED_FILE* pFile,
+    size_t nNewline) {
+  /* The last segment whose first newline is at or before this one */
+  size_t nLow = 0;
+  size_t nHigh = pFile->nSegments;
+  while (nHigh - nLow > 1) {
+    const size_t MIDDLE = nLow + (nHigh - nLow) / 2;
+    if (pFile->nSegmentStarts[MIDDLE] <= nNewline) {
+      nLow = MIDDLE;
+    } else {
+      nHigh = MIDDLE;
+    }
+  }
+
+  return (size_t) (((uint64_t) nLow << SEGMENT_BITS)
+      | pFile->pnNewlines[nNewline]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeMappedFile function
+
+void FreeMappedFile(LPMAPPED_FILE* ppFile) {
+  CORE_PROBE(CORE_FN_FREE_MAPPED_FILE);
+
+  if (ppFile == NULL || *ppFile == NULL) {
+    return;
+  }
+
+  ReleaseMappedFile(*ppFile);
+  *ppFile = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetMappedFileContents function
+
+STRING_VIEW GetMappedFileContents(const MAPPED_FILE* pFile) {
+  return pFile == NULL ? MakeStringView(NULL, 0)
+      : MakeStringView(pFile->pchData, pFile->nSize);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetMappedFileLine function
+
+STRING_VIEW GetMappedFileLine(const MAPPED_FILE* pFile, size_t nLine) {
+  if (pFile == NULL || nLine >= pFile->nLines) {
+    return MakeStringView(NULL, 0);
+  }
+
+  const size_t BEGIN = nLine == 0 ? 0
+      : GetNewlineOffset(pFile, nLine - 1) + 1;
+  if (nLine == pFile->nNewlines) {
+    return MakeStringView(pFile->pchData + BEGIN, pFile->nSize - BEGIN);
+  }
+
+  size_t nEnd = GetNewlineOffset(pFile, nLine);
+  if (nEnd > BEGIN && pFile->pchData[nEnd - 1] == '\r') {
+    nEnd--;
+  }
+  return MakeStringView(pFile->pchData + BEGIN, nEnd - BEGIN);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetMappedFileLineCount function
+
+size_t GetMappedFileLineCount(const MAPPED_FILE* pFile) {
+  return pFile == NULL ? 0 : pFile->nLines;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MapFile function
+
+int MapFile(const char* pszPath, int nFlags, LPMAPPED_FILE* ppFile) {
+  CORE_PROBE(CORE_FN_MAP_FILE);
+
+  if (pszPath == NULL || ppFile == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pszPath == NULL ? "MapFile: pszPath" : "MapFile: ppFile");
+    return ERROR;
+  }
+
+  *ppFile = NULL;
+
+  const int DESCRIPTOR = open(pszPath, O_RDONLY | O_CLOEXEC);
+  if (DESCRIPTOR < 0) {
+    SetFileError(CORE_ERROR_SYSTEM, "cannot open", pszPath);
+    return ERROR;
+  }
+
+  struct stat fileStat;
+  if (fstat(DESCRIPTOR, &fileStat) != 0) {
+    SetFileError(CORE_ERROR_SYSTEM, "cannot stat", pszPath);
+    close(DESCRIPTOR);
+    return ERROR;
+  }
+
+  if (!S_ISREG(fileStat.st_mode) || (uint64_t) fileStat.st_size > SIZE_MAX) {
+    SetFileError(CORE_ERROR_INVALID_ARGUMENT, "cannot map", pszPath);
+    close(DESCRIPTOR);
+    return ERROR;
+  }
+
+  const size_t SIZE = (size_t) fileStat.st_size;
+  const size_t SEGMENTS = SIZE == 0 ? 0
+      : (size_t) (((uint64_t) SIZE - 1) >> SEGMENT_BITS) + 1;
+  LPMAPPED_FILE pFile = (LPMAPPED_FILE) CoreMalloc(sizeof(MAPPED_FILE)
+      + SEGMENTS * sizeof(size_t), CORE_ALLOC_MAPPED_FILE);
+  if (pFile == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "MapFile");
+    close(DESCRIPTOR);
+    return ERROR;
+  }
+  memset(pFile, 0, sizeof(MAPPED_FILE));
+  pFile->nSegments = SEGMENTS;
+
+  /* mmap(2) refuses to map nothing, so an empty file has no mapping; the
+   * mapping outlives the descriptor */
+  if (SIZE > 0) {
+    void* pvBase = mmap(NULL, SIZE, PROT_READ, MAP_PRIVATE
+        | ((nFlags & MAPPED_FILE_POPULATE) ? MAP_POPULATE : 0),
+        DESCRIPTOR, 0);
+    if (pvBase == MAP_FAILED) {
+      SetFileError(CORE_ERROR_SYSTEM, "cannot map", pszPath);
+      close(DESCRIPTOR);
+      CoreFree(pFile);
+      return ERROR;
+    }
+
+    /* The advice is only advice; the file reads the same without it */
+    if (nFlags & MAPPED_FILE_SEQUENTIAL) {
+      madvise(pvBase, SIZE, MADV_SEQUENTIAL);
+    }
+
+    pFile->pchData = (const char*) pvBase;
+    pFile->nSize = SIZE;
+  }
+  close(DESCRIPTOR);
+
+  if (!IndexNewlines(pFile)) {
+    ReleaseMappedFile(pFile);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "MapFile");
+    return ERROR;
+  }
+
+  pFile->nLines = pFile->nNewlines
+      + (SIZE > 0 && pFile->pchData[SIZE - 1] != '\n');
+
+  CORE_PROBE_BYTES(SIZE);
+
+  *ppFile = pFile;
+  return OK;
+}
@@ -0,0 +1,557 @@
+// prefix_set.c - Implementation of sets of prefixes compiled into a compact trie
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "prefix_set.h"
+#include "core_alloc.h"
+#include "core_image.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Nodes with more edges than this are searched by bisection */
+#ifndef PREFIX_SET_LINEAR_EDGES
+#define PREFIX_SET_LINEAR_EDGES       16
+#endif //PREFIX_SET_LINEAR_EDGES
+
+/* One node of the trie.  The trie is path-compressed: on the way into a
+ * node, the characters of its run must match first.  Then, if a prefix ends
+ * there, nId is its ID, and the next character of the subject selects one of
+ * the node's edges. */
+typedef struct _PREFIX_NODE {
+  uint32_t nRunOffset;          /* run characters, in pchRuns */
+  uint32_t nRunLength;
+  uint32_t nFirstEdge;          /* edges, in pLabels and pnChildren */
+  uint32_t nEdges;
+  int nId;                      /* PREFIX_SET_NO_MATCH if no prefix ends here */
+} PREFIX_NODE;
+
+/* The header and the four arrays live in one block: nodes, in breadth-first
+ * order, then children, then edge labels (sorted within each node), then the
+ * run characters. */
+struct _PREFIX_SET {
+  int nPrefixes;
+  uint32_t nNodes;
+  uint32_t nEdges;
+  uint32_t nRunLength;
+  const PREFIX_NODE* pNodes;
+  const uint32_t* pnChildren;
+  const unsigned char* pLabels;
+  const char* pchRuns;
+  IMAGE_MAPPING mapping;        /* the file the arrays lie in, if mapped */
+};
+
+/* The payload of a file holding a set: this header, then the four arrays as
+ * they lie in memory */
+typedef struct _PREFIX_SET_IMAGE {
+  uint32_t nPrefixes;
+  uint32_t nNodes;
+  uint32_t nEdges;
+  uint32_t nRunLength;
+} PREFIX_SET_IMAGE;
+
+/* A prefix being compiled */
+typedef struct _PREFIX_ENTRY {
+  const char* pszPrefix;
+  size_t nLength;
+  int nId;
+} PREFIX_ENTRY;
+
+/* The entries below a node being compiled: those in [nLow, nHigh), which
+ * agree on their first nDepth characters */
+typedef struct _PREFIX_RANGE {
+  int nLow;
+  int nHigh;
+  size_t nDepth;
+} PREFIX_RANGE;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// ComparePrefixEntries function - qsort(3) callback that orders entries by
+// prefix, and equal prefixes by ID.
+//
+
+static int ComparePrefixEntries(const void* pvLeft, const void* pvRight) {
+  const PREFIX_ENTRY* pLeft = (const PREFIX_ENTRY*) pvLeft;
+  const PREFIX_ENTRY* pRight = (const PREFIX_ENTRY*) pvRight;
+
+  const int RESULT = strcmp(pLeft->pszPrefix, pRight->pszPrefix);
+  if (RESULT != 0) {
+    return RESULT;
+  }
+  return (pLeft->nId > pRight->nId) - (pLeft->nId < pRight->nId);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsNodeInBounds function - Tells whether a node's run and edges lie within
+// the set's arrays, which only a damaged file can make them not do.
+//
+
+static inline BOOL IsNodeInBounds(const PREFIX_SET* pPrefixSet,
+    const PREFIX_NODE* pNode) {
+  return pNode->nRunOffset <= pPrefixSet->nRunLength
+      && pNode->nRunLength <= pPrefixSet->nRunLength - pNode->nRunOffset
+      && pNode->nFirstEdge <= pPrefixSet->nEdges
+      && pNode->nEdges <= pPrefixSet->nEdges - pNode->nFirstEdge;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindChild function - Gets the node the edge labeled ch leads to, or
+// NULL if the node has no such edge, or the edge leads out of the set.
+//
+
+static inline const PREFIX_NODE* FindChild(const PREFIX_SET* pPrefixSet,
+    const PREFIX_NODE* pNode, unsigned char ch) {
+  const unsigned char* pLabels = pPrefixSet->pLabels + pNode->nFirstEdge;
+  const uint32_t* pnChildren = pPrefixSet->pnChildren + pNode->nFirstEdge;
+
+  if (pNode->nEdges <= PREFIX_SET_LINEAR_EDGES) {
+    for (uint32_t i = 0; i < pNode->nEdges && pLabels[i] <= ch; i++) {
+      if (pLabels[i] == ch) {
+        return pnChildren[i] < pPrefixSet->nNodes
+            ? pPrefixSet->pNodes + pnChildren[i] : NULL;
+      }
+    }
+    return NULL;
+  }
+
+  uint32_t nLow = 0;
+  uint32_t nHigh = pNode->nEdges;
+  while (nLow < nHigh) {
+    const uint32_t MIDDLE = nLow + (nHigh - nLow) / 2;
+    if (pLabels[MIDDLE] < ch) {
+      nLow = MIDDLE + 1;
+    } else {
+      nHigh = MIDDLE;
+    }
+  }
+
+  return nLow < pNode->nEdges && pLabels[nLow] == ch
+      && pnChildren[nLow] < pPrefixSet->nNodes
+      ? pPrefixSet->pNodes + pnChildren[nLow] : NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindLongestPrefix function - Walks the trie along pchString.  A length of
+// SIZE_MAX means the string is null-terminated: no run or label contains a
+// null, so the walk stops at the terminator without knowing the length.
+// Every node is checked before it is read, and a null never matches, so
+// that a damaged file can give a wrong ID but never send the walk outside
+// the set or past the terminator.
+//
+
+static int FindLongestPrefix(const PREFIX_SET* pPrefixSet,
+    const char* pchString, size_t nLength) {
+  const PREFIX_NODE* pNode = pPrefixSet->pNodes;
+  int nBest = PREFIX_SET_NO_MATCH;
+  size_t nPosition = 0;
+
+  for (;;) {
+    if (!IsNodeInBounds(pPrefixSet, pNode)) {
+      return nBest;
+    }
+
+    const char* pchRun = pPrefixSet->pchRuns + pNode->nRunOffset;
+    for (uint32_t i = 0; i < pNode->nRunLength; i++, nPosition++) {
+      if (nPosition == nLength || pchString[nPosition] != pchRun[i]
+          || pchRun[i] == '\0') {
+        return nBest;
+      }
+    }
+
+    if (pNode->nId != PREFIX_SET_NO_MATCH) {
+      nBest = pNode->nId;
+    }
+
+    if (nPosition == nLength || pNode->nEdges == 0
+        || pchString[nPosition] == '\0') {
+      return nBest;
+    }
+
+    pNode = FindChild(pPrefixSet, pNode,
+        (unsigned char) pchString[nPosition++]);
+    if (pNode == NULL) {
+      return nBest;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompileNode function - Fills in the node for one range of sorted entries
+// and queues a range for each of its children.  Children are numbered in the
+// order they are queued, which makes the layout breadth-first.
+//
+
+static void CompileNode(const PREFIX_ENTRY* pEntries, PREFIX_RANGE* pRanges,
+    PREFIX_NODE* pNodes, uint32_t nNode, uint32_t* pnNodes,
+    uint32_t* pnChildren, unsigned char* pLabels, uint32_t* pnEdges,
+    char* pchRuns, uint32_t* pnRunLength) {
+  PREFIX_NODE* pNode = &pNodes[nNode];
+  int nLow = pRanges[nNode].nLow;
+  const int HIGH = pRanges[nNode].nHigh;
+  const size_t DEPTH = pRanges[nNode].nDepth;
+
+  /* Sorted entries that agree at both ends of the range agree throughout */
+  size_t nRun = 0;
+  if (nLow < HIGH) {
+    const PREFIX_ENTRY* pFirst = &pEntries[nLow];
+    const PREFIX_ENTRY* pLast = &pEntries[HIGH - 1];
+    while (DEPTH + nRun < pFirst->nLength
+        && pFirst->pszPrefix[DEPTH + nRun] == pLast->pszPrefix[DEPTH + nRun]) {
+      nRun++;
+    }
+    memcpy(pchRuns + *pnRunLength, pFirst->pszPrefix + DEPTH, nRun);
+  }
+
+  pNode->nRunOffset = *pnRunLength;
+  pNode->nRunLength = (uint32_t) nRun;
+  *pnRunLength += (uint32_t) nRun;
+
+  /* Prefixes that end here sort first; the lowest ID among them wins */
+  const size_t END = DEPTH + nRun;
+  pNode->nId = PREFIX_SET_NO_MATCH;
+  if (nLow < HIGH && pEntries[nLow].nLength == END) {
+    pNode->nId = pEntries[nLow].nId;
+  }
+  while (nLow < HIGH && pEntries[nLow].nLength == END) {
+    nLow++;
+  }
+
+  /* The rest group by their next character, one edge per group */
+  pNode->nFirstEdge = *pnEdges;
+  while (nLow < HIGH) {
+    const char NEXT = pEntries[nLow].pszPrefix[END];
+    int nGroupEnd = nLow + 1;
+    while (nGroupEnd < HIGH && pEntries[nGroupEnd].pszPrefix[END] == NEXT) {
+      nGroupEnd++;
+    }
+
+    pLabels[*pnEdges] = (unsigned char) NEXT;
+    pnChildren[*pnEdges] = *pnNodes;
+    (*pnEdges)++;
+
+    pRanges[*pnNodes].nLow = nLow;
+    pRanges[*pnNodes].nHigh = nGroupEnd;
+    pRanges[*pnNodes].nDepth = END + 1;
+    (*pnNodes)++;
+
+    nLow = nGroupEnd;
+  }
+  pNode->nEdges = *pnEdges - pNode->nFirstEdge;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// CreatePrefixSet function
+
+int CreatePrefixSet(const char* const* ppszPrefixes, int nPrefixes,
+    LPPREFIX_SET* ppPrefixSet) {
+  CORE_PROBE(CORE_FN_CREATE_PREFIX_SET);
+
+  if (ppPrefixSet == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "CreatePrefixSet: ppPrefixSet");
+    return ERROR;
+  }
+  *ppPrefixSet = NULL;
+
+  if (nPrefixes < 0 || nPrefixes > INT_MAX / 2 - 1) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "CreatePrefixSet: nPrefixes");
+    return ERROR;
+  }
+
+  if (nPrefixes > 0 && ppszPrefixes == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "CreatePrefixSet: ppszPrefixes");
+    return ERROR;
+  }
+
+  size_t nTotalLength = 0;
+  for (int i = 0; i < nPrefixes; i++) {
+    if (ppszPrefixes[i] == NULL) {
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+          "CreatePrefixSet: NULL element in ppszPrefixes");
+      return ERROR;
+    }
+    nTotalLength += strlen(ppszPrefixes[i]);
+  }
+
+  if (nTotalLength > UINT32_MAX) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE,
+        "CreatePrefixSet: prefixes too long");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(nTotalLength);
+
+  /* Every node but the root ends a prefix or has at least two children, so
+   * there are at most 2n + 1 nodes, and one edge fewer.  The compiler's
+   * working arrays share one scratch block, largest alignment first. */
+  const size_t MAX_NODES = 2 * (size_t) nPrefixes + 1;
+  const size_t RANGES_OFFSET = nPrefixes * sizeof(PREFIX_ENTRY);
+  const size_t NODES_OFFSET = RANGES_OFFSET + MAX_NODES * sizeof(PREFIX_RANGE);
+  const size_t CHILDREN_OFFSET = NODES_OFFSET + MAX_NODES * sizeof(PREFIX_NODE);
+  const size_t LABELS_OFFSET = CHILDREN_OFFSET + MAX_NODES * sizeof(uint32_t);
+  const size_t RUNS_OFFSET = LABELS_OFFSET + MAX_NODES;
+
+  char* pScratch = (char*) malloc(RUNS_OFFSET + nTotalLength + 1);
+  if (pScratch == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreatePrefixSet");
+    return ERROR;
+  }
+
+  PREFIX_ENTRY* pEntries = (PREFIX_ENTRY*) pScratch;
+  PREFIX_RANGE* pRanges = (PREFIX_RANGE*) (pScratch + RANGES_OFFSET);
+  PREFIX_NODE* pNodes = (PREFIX_NODE*) (pScratch + NODES_OFFSET);
+  uint32_t* pnChildren = (uint32_t*) (pScratch + CHILDREN_OFFSET);
+  unsigned char* pLabels = (unsigned char*) (pScratch + LABELS_OFFSET);
+  char* pchRuns = pScratch + RUNS_OFFSET;
+
+  for (int i = 0; i < nPrefixes; i++) {
+    pEntries[i].pszPrefix = ppszPrefixes[i];
+    pEntries[i].nLength = strlen(ppszPrefixes[i]);
+    pEntries[i].nId = i;
+  }
+  qsort(pEntries, nPrefixes, sizeof(PREFIX_ENTRY), ComparePrefixEntries);
+
+  uint32_t nNodes = 1;
+  uint32_t nEdges = 0;
+  uint32_t nRunLength = 0;
+  pRanges[0].nLow = 0;
+  pRanges[0].nHigh = nPrefixes;
+  pRanges[0].nDepth = 0;
+  for (uint32_t nNode = 0; nNode < nNodes; nNode++) {
+    CompileNode(pEntries, pRanges, pNodes, nNode, &nNodes, pnChildren,
+        pLabels, &nEdges, pchRuns, &nRunLength);
+  }
+
+  /* Now that the sizes are known, copy the arrays into the set's own block.
+   * The header's size is a multiple of the nodes' alignment. */
+  const size_t SET_CHILDREN_OFFSET = sizeof(PREFIX_SET)
+      + nNodes * sizeof(PREFIX_NODE);
+  const size_t SET_LABELS_OFFSET = SET_CHILDREN_OFFSET
+      + nEdges * sizeof(uint32_t);
+  const size_t SET_RUNS_OFFSET = SET_LABELS_OFFSET + nEdges;
+
+  char* pBlock = (char*) CoreMalloc(SET_RUNS_OFFSET + nRunLength,
+      CORE_ALLOC_PREFIX_SET);
+  if (pBlock == NULL) {
+    free(pScratch);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreatePrefixSet");
+    return ERROR;
+  }
+
+  LPPREFIX_SET pPrefixSet = (LPPREFIX_SET) pBlock;
+  pPrefixSet->nPrefixes = nPrefixes;
+  pPrefixSet->nNodes = nNodes;
+  pPrefixSet->nEdges = nEdges;
+  pPrefixSet->nRunLength = nRunLength;
+  pPrefixSet->pNodes = (const PREFIX_NODE*) memcpy(
+      pBlock + sizeof(PREFIX_SET), pNodes, nNodes * sizeof(PREFIX_NODE));
+  pPrefixSet->pnChildren = (const uint32_t*) memcpy(
+      pBlock + SET_CHILDREN_OFFSET, pnChildren, nEdges * sizeof(uint32_t));
+  pPrefixSet->pLabels = (const unsigned char*) memcpy(
+      pBlock + SET_LABELS_OFFSET, pLabels, nEdges);
+  pPrefixSet->pchRuns = (const char*) memcpy(pBlock + SET_RUNS_OFFSET,
+      pchRuns, nRunLength);
+  memset(&pPrefixSet->mapping, 0, sizeof(IMAGE_MAPPING));
+
+  free(pScratch);
+
+  *ppPrefixSet = pPrefixSet;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreePrefixSet function
+
+void FreePrefixSet(LPPREFIX_SET* ppPrefixSet) {
+  CORE_PROBE(CORE_FN_FREE_PREFIX_SET);
+
+  if (ppPrefixSet == NULL || *ppPrefixSet == NULL) {
+    return;
+  }
+
+  UnmapImageFile(&(*ppPrefixSet)->mapping);
+  CoreFree(*ppPrefixSet);
+  *ppPrefixSet = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetPrefixSetCount function
+
+int GetPrefixSetCount(const PREFIX_SET* pPrefixSet) {
+  return pPrefixSet == NULL ? 0 : pPrefixSet->nPrefixes;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MapPrefixSetFile function
+
+int MapPrefixSetFile(const char* pszPath, int nFlags,
+    LPPREFIX_SET* ppPrefixSet) {
+  CORE_PROBE(CORE_FN_MAP_PREFIX_SET_FILE);
+
+  if (pszPath == NULL || ppPrefixSet == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pszPath == NULL ? "MapPrefixSetFile: pszPath"
+            : "MapPrefixSetFile: ppPrefixSet");
+    return ERROR;
+  }
+
+  *ppPrefixSet = NULL;
+
+  IMAGE_MAPPING mapping;
+  if (MapImageFile(pszPath, IMAGE_KIND_PREFIX_SET, nFlags, &mapping,
+      "MapPrefixSetFile") != OK) {
+    return ERROR;
+  }
+
+  /* Every node but the root is the child of one edge, and the arrays must
+   * fill the payload exactly */
+  const PREFIX_SET_IMAGE* pImage = (const PREFIX_SET_IMAGE*)
+      mapping.pbPayload;
+  if (mapping.nPayloadSize < sizeof(PREFIX_SET_IMAGE)
+      || pImage->nPrefixes > INT_MAX || pImage->nNodes == 0
+      || pImage->nEdges != pImage->nNodes - 1
+      || mapping.nPayloadSize != sizeof(PREFIX_SET_IMAGE)
+          + (uint64_t) pImage->nNodes * sizeof(PREFIX_NODE)
+          + (uint64_t) pImage->nEdges * (sizeof(uint32_t) + 1)
+          + pImage->nRunLength) {
+    UnmapImageFile(&mapping);
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "MapPrefixSetFile: not a prefix set");
+    return ERROR;
+  }
+
+  LPPREFIX_SET pPrefixSet = (LPPREFIX_SET) CoreMalloc(sizeof(PREFIX_SET),
+      CORE_ALLOC_PREFIX_SET);
+  if (pPrefixSet == NULL) {
+    UnmapImageFile(&mapping);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "MapPrefixSetFile");
+    return ERROR;
+  }
+
+  const unsigned char* pbArrays = mapping.pbPayload
+      + sizeof(PREFIX_SET_IMAGE);
+  const size_t CHILDREN_OFFSET = pImage->nNodes * sizeof(PREFIX_NODE);
+  const size_t LABELS_OFFSET = CHILDREN_OFFSET
+      + pImage->nEdges * sizeof(uint32_t);
+  pPrefixSet->nPrefixes = (int) pImage->nPrefixes;
+  pPrefixSet->nNodes = pImage->nNodes;
+  pPrefixSet->nEdges = pImage->nEdges;
+  pPrefixSet->nRunLength = pImage->nRunLength;
+  pPrefixSet->pNodes = (const PREFIX_NODE*) pbArrays;
+  pPrefixSet->pnChildren = (const uint32_t*) (pbArrays + CHILDREN_OFFSET);
+  pPrefixSet->pLabels = pbArrays + LABELS_OFFSET;
+  pPrefixSet->pchRuns = (const char*) (pbArrays + LABELS_OFFSET
+      + pImage->nEdges);
+  pPrefixSet->mapping = mapping;
+
+  CORE_PROBE_BYTES(mapping.nMappingSize);
+
+  *ppPrefixSet = pPrefixSet;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchPrefixSet function
+
+int MatchPrefixSet(const PREFIX_SET* pPrefixSet, const char* pszString) {
+  CORE_PROBE(CORE_FN_MATCH_PREFIX_SET);
+
+  if (pPrefixSet == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "MatchPrefixSet: pPrefixSet");
+    return PREFIX_SET_NO_MATCH;
+  }
+
+  if (pszString == NULL) {
+    return PREFIX_SET_NO_MATCH;
+  }
+
+  return FindLongestPrefix(pPrefixSet, pszString, SIZE_MAX);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchPrefixSetN function
+
+int MatchPrefixSetN(const PREFIX_SET* pPrefixSet, const char* pchString,
+    size_t nLength) {
+  CORE_PROBE(CORE_FN_MATCH_PREFIX_SET_N);
+
+  if (pPrefixSet == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "MatchPrefixSetN: pPrefixSet");
+    return PREFIX_SET_NO_MATCH;
+  }
+
+  if (pchString == NULL) {
+    nLength = 0;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  return FindLongestPrefix(pPrefixSet, pchString, nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SavePrefixSetFile function
+
+int SavePrefixSetFile(const PREFIX_SET* pPrefixSet, const char* pszPath) {
+  CORE_PROBE(CORE_FN_SAVE_PREFIX_SET_FILE);
+
+  if (pPrefixSet == NULL || pszPath == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pPrefixSet == NULL ? "SavePrefixSetFile: pPrefixSet"
+            : "SavePrefixSetFile: pszPath");
+    return ERROR;
+  }
+
+  /* The arrays follow one another from the nodes on, whether the set was
+   * built or mapped */
+  PREFIX_SET_IMAGE image;
+  image.nPrefixes = (uint32_t) pPrefixSet->nPrefixes;
+  image.nNodes = pPrefixSet->nNodes;
+  image.nEdges = pPrefixSet->nEdges;
+  image.nRunLength = pPrefixSet->nRunLength;
+
+  struct iovec pieces[2];
+  pieces[0].iov_base = &image;
+  pieces[0].iov_len = sizeof(image);
+  pieces[1].iov_base = (void*) pPrefixSet->pNodes;
+  pieces[1].iov_len = (size_t) (pPrefixSet->pchRuns + image.nRunLength
+      - (const char*) pPrefixSet->pNodes);
+
+  CORE_PROBE_BYTES(sizeof(image) + pieces[1].iov_len);
+
+  return WriteImageFile(pszPath, IMAGE_KIND_PREFIX_SET, pieces, 2,
+      "SavePrefixSetFile");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// VerifyPrefixSet function
+
+int VerifyPrefixSet(const PREFIX_SET* pPrefixSet) {
+  CORE_PROBE(CORE_FN_VERIFY_PREFIX_SET);
+
+  if (pPrefixSet == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "VerifyPrefixSet: pPrefixSet");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(pPrefixSet->mapping.nPayloadSize);
+
+  if (!IsImageChecksumValid(&pPrefixSet->mapping)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "VerifyPrefixSet: checksum mismatch");
+    return ERROR;
+  }
+
+  return OK;
+}
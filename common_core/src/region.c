@@ -0,0 +1,305 @@
+// region.c - Implementation of regions
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "region.h"
+#include "core_alloc.h"
+#include "core_region.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Size of the allocation that holds a region and its first block */
+#ifndef REGION_INITIAL_SIZE
+#define REGION_INITIAL_SIZE           4096
+#endif //REGION_INITIAL_SIZE
+
+/* Largest block a region grows to, except to hold a larger request */
+#ifndef REGION_MAX_BLOCK_SIZE
+#define REGION_MAX_BLOCK_SIZE         (1024 * 1024)
+#endif //REGION_MAX_BLOCK_SIZE
+
+/* Offset of the first block from the start of its region */
+#define REGION_HEADER_SIZE \
+  ((sizeof(REGION) + _Alignof(REGION_BLOCK) - 1) \
+      & ~(_Alignof(REGION_BLOCK) - 1))
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+static void ReleaseRegion(LPREGION pRegion);
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseBlocksAfter function - Releases the blocks of a region newer than
+// the one specified, which becomes the block being filled.
+//
+
+static void ReleaseBlocksAfter(LPREGION pRegion, REGION_BLOCK* pKeep) {
+  while (pRegion->pBlock != pKeep) {
+    REGION_BLOCK* pOlder = pRegion->pBlock->pOlder;
+    CoreFree(pRegion->pBlock);
+    pRegion->pBlock = pOlder;
+  }
+
+  pRegion->pbLimit = pKeep->data + pKeep->nSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseChildrenAfter function - Releases the child regions of a region
+// created after the one having the number specified.
+//
+
+static void ReleaseChildrenAfter(LPREGION pRegion,
+    unsigned long long ullOrdinal) {
+  while (pRegion->pNewestChild != NULL
+      && pRegion->pNewestChild->ullOrdinal > ullOrdinal) {
+    ReleaseRegion(pRegion->pNewestChild);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReleaseRegion function - Releases a region, its children and its blocks,
+// after unlinking it from its parent.
+//
+
+static void ReleaseRegion(LPREGION pRegion) {
+  ReleaseChildrenAfter(pRegion, 0);
+  ReleaseBlocksAfter(pRegion, pRegion->pFirstBlock);
+
+  if (pRegion->pParent != NULL) {
+    if (pRegion->pNewer != NULL) {
+      pRegion->pNewer->pOlder = pRegion->pOlder;
+    } else {
+      pRegion->pParent->pNewestChild = pRegion->pOlder;
+    }
+    if (pRegion->pOlder != NULL) {
+      pRegion->pOlder->pNewer = pRegion->pNewer;
+    }
+  }
+
+  CoreFree(pRegion);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// AllocateFromRegion function
+
+void* AllocateFromRegion(LPREGION pRegion, size_t nSize) {
+  CORE_PROBE(CORE_FN_ALLOCATE_FROM_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "AllocateFromRegion: pRegion");
+    return NULL;
+  }
+
+  if (nSize == 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "AllocateFromRegion: nSize");
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(nSize);
+
+  void* pvResult = AllocateRegionBytes(pRegion, nSize, _Alignof(max_align_t));
+  if (pvResult == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "AllocateFromRegion");
+  }
+  return pvResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CopyToRegion function
+
+char* CopyToRegion(LPREGION pRegion, const char* pchString, size_t nLength) {
+  CORE_PROBE(CORE_FN_COPY_TO_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "CopyToRegion: pRegion");
+    return NULL;
+  }
+
+  if (pchString == NULL && nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "CopyToRegion: pchString");
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  char* pszCopy = (char*) AllocateRegionBytes(pRegion, nLength + 1, 1);
+  if (pszCopy == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CopyToRegion");
+    return NULL;
+  }
+
+  if (nLength > 0) {
+    memcpy(pszCopy, pchString, nLength);
+  }
+  pszCopy[nLength] = '\0';
+  return pszCopy;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateRegion function
+
+int CreateRegion(LPREGION pParent, LPREGION* ppRegion) {
+  CORE_PROBE(CORE_FN_CREATE_REGION);
+
+  if (ppRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "CreateRegion: ppRegion");
+    return ERROR;
+  }
+
+  LPREGION pRegion = (LPREGION) CoreMalloc(REGION_INITIAL_SIZE,
+      CORE_ALLOC_REGION);
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateRegion");
+    return ERROR;
+  }
+
+  memset(pRegion, 0, sizeof(REGION));
+  pRegion->pFirstBlock = (REGION_BLOCK*) ((unsigned char*) pRegion
+      + REGION_HEADER_SIZE);
+  pRegion->pFirstBlock->pOlder = NULL;
+  pRegion->pFirstBlock->nSize = REGION_INITIAL_SIZE - REGION_HEADER_SIZE
+      - sizeof(REGION_BLOCK);
+  pRegion->pFirstBlock->nUsed = 0;
+  pRegion->pBlock = pRegion->pFirstBlock;
+  pRegion->pbNext = pRegion->pFirstBlock->data;
+  pRegion->pbLimit = pRegion->pbNext + pRegion->pFirstBlock->nSize;
+
+  if (pParent != NULL) {
+    pRegion->pParent = pParent;
+    pRegion->ullOrdinal = ++pParent->ullChildren;
+    pRegion->pOlder = pParent->pNewestChild;
+    if (pRegion->pOlder != NULL) {
+      pRegion->pOlder->pNewer = pRegion;
+    }
+    pParent->pNewestChild = pRegion;
+  }
+
+  *ppRegion = pRegion;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeRegion function
+
+void FreeRegion(LPREGION* ppRegion) {
+  CORE_PROBE(CORE_FN_FREE_REGION);
+
+  if (ppRegion == NULL || *ppRegion == NULL) {
+    return;
+  }
+
+  ReleaseRegion(*ppRegion);
+  *ppRegion = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetRegionSize function
+
+size_t GetRegionSize(const REGION* pRegion) {
+  if (pRegion == NULL) {
+    return 0;
+  }
+
+  size_t nSize = (size_t) (pRegion->pbNext - pRegion->pBlock->data);
+  for (const REGION_BLOCK* pBlock = pRegion->pBlock->pOlder; pBlock != NULL;
+      pBlock = pBlock->pOlder) {
+    nSize += pBlock->nUsed;
+  }
+  return nSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GrowRegion function
+
+void* GrowRegion(LPREGION pRegion, size_t nSize) {
+  /* Blocks double up to REGION_MAX_BLOCK_SIZE, and the data of each is
+   * aligned as strictly as any request may ask */
+  size_t nBlockSize = pRegion->pBlock->nSize < REGION_MAX_BLOCK_SIZE / 2
+      ? 2 * pRegion->pBlock->nSize : REGION_MAX_BLOCK_SIZE;
+  if (nBlockSize < nSize) {
+    if (nSize > SIZE_MAX - sizeof(REGION_BLOCK)) {
+      return NULL;
+    }
+    nBlockSize = nSize;
+  }
+
+  REGION_BLOCK* pBlock = (REGION_BLOCK*) CoreMalloc(sizeof(REGION_BLOCK)
+      + nBlockSize, CORE_ALLOC_REGION);
+  if (pBlock == NULL) {
+    return NULL;
+  }
+
+  pRegion->pBlock->nUsed = (size_t) (pRegion->pbNext - pRegion->pBlock->data);
+  pBlock->pOlder = pRegion->pBlock;
+  pBlock->nSize = nBlockSize;
+  pBlock->nUsed = 0;
+  pRegion->pBlock = pBlock;
+  pRegion->pbNext = pBlock->data + nSize;
+  pRegion->pbLimit = pBlock->data + nBlockSize;
+  return pBlock->data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MarkRegion function
+
+int MarkRegion(const REGION* pRegion, LPREGION_MARK pMark) {
+  CORE_PROBE(CORE_FN_MARK_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "MarkRegion: pRegion");
+    return ERROR;
+  }
+
+  if (pMark == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "MarkRegion: pMark");
+    return ERROR;
+  }
+
+  pMark->pvBlock = pRegion->pBlock;
+  pMark->pvNext = pRegion->pbNext;
+  pMark->ullChildren = pRegion->ullChildren;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ResetRegion function
+
+void ResetRegion(LPREGION pRegion) {
+  CORE_PROBE(CORE_FN_RESET_REGION);
+
+  if (pRegion == NULL) {
+    return;
+  }
+
+  ReleaseChildrenAfter(pRegion, 0);
+  ReleaseBlocksAfter(pRegion, pRegion->pFirstBlock);
+  pRegion->pbNext = pRegion->pFirstBlock->data;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RollBackRegion function
+
+int RollBackRegion(LPREGION pRegion, const REGION_MARK* pMark) {
+  CORE_PROBE(CORE_FN_ROLL_BACK_REGION);
+
+  if (pRegion == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "RollBackRegion: pRegion");
+    return ERROR;
+  }
+
+  if (pMark == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "RollBackRegion: pMark");
+    return ERROR;
+  }
+
+  ReleaseChildrenAfter(pRegion, pMark->ullChildren);
+  ReleaseBlocksAfter(pRegion, (REGION_BLOCK*) pMark->pvBlock);
+  pRegion->pbNext = (unsigned char*) pMark->pvNext;
+  return OK;
+}
@@ -0,0 +1,397 @@
+// string_hash.c - Implementation of the 64-bit string hash
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "string_hash.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Bytes of a stripe of the main loop */
+#define STRIPE_SIZE                   48
+
+/* Bytes folded at a time by the case-insensitive functions */
+#define FOLD_CHUNK_SIZE               256
+
+/* Odd constants with well-spread bits, as wyhash uses */
+static const uint64_t s_ullSecret[4] = {
+  0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL,
+  0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+static inline size_t SmallerOf(size_t a, size_t b) {
+  return a < b ? a : b;
+}
+
+static inline uint64_t Read8(const unsigned char* p) {
+  uint64_t ullValue;
+  memcpy(&ullValue, p, sizeof(ullValue));
+  return ullValue;
+}
+
+static inline uint64_t Read4(const unsigned char* p) {
+  uint32_t nValue;
+  memcpy(&nValue, p, sizeof(nValue));
+  return nValue;
+}
+
+/* Multiplies a by b, leaving the low half of the product in a and the high
+ * half in b */
+static inline void Multiply(uint64_t* pA, uint64_t* pB) {
+  const unsigned __int128 PRODUCT = (unsigned __int128) *pA * *pB;
+  *pA = (uint64_t) PRODUCT;
+  *pB = (uint64_t) (PRODUCT >> 64);
+}
+
+static inline uint64_t Mix(uint64_t a, uint64_t b) {
+  Multiply(&a, &b);
+  return a ^ b;
+}
+
+static inline uint64_t MixSeed(uint64_t ullSeed) {
+  return ullSeed ^ Mix(ullSeed ^ s_ullSecret[0], s_ullSecret[1]);
+}
+
+/* Hashes the 16 bytes at p into the lane */
+static inline uint64_t MixPair(const unsigned char* p, uint64_t ullLane) {
+  return Mix(Read8(p) ^ s_ullSecret[1], Read8(p + 8) ^ ullLane);
+}
+
+static inline void MixStripe(uint64_t ullLanes[3], const unsigned char* p) {
+  ullLanes[0] = Mix(Read8(p) ^ s_ullSecret[1], Read8(p + 8) ^ ullLanes[0]);
+  ullLanes[1] = Mix(Read8(p + 16) ^ s_ullSecret[2],
+      Read8(p + 24) ^ ullLanes[1]);
+  ullLanes[2] = Mix(Read8(p + 32) ^ s_ullSecret[3],
+      Read8(p + 40) ^ ullLanes[2]);
+}
+
+static inline uint64_t Finish(uint64_t a, uint64_t b, uint64_t ullSeed,
+    uint64_t ullLength) {
+  a ^= s_ullSecret[1];
+  b ^= ullSeed;
+  Multiply(&a, &b);
+  return Mix(a ^ s_ullSecret[0] ^ ullLength, b ^ s_ullSecret[1]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashTail function - Hashes the last 1 to 48 bytes of an input of more
+// than 16 bytes.  The bytes before p may be read: the last reads overlap the
+// bytes hashed already rather than pad.
+//
+
+static inline uint64_t HashTail(const unsigned char* p, size_t nRemaining,
+    uint64_t ullSeed, uint64_t ullLength) {
+  while (nRemaining > 16) {
+    ullSeed = MixPair(p, ullSeed);
+    p += 16;
+    nRemaining -= 16;
+  }
+  return Finish(Read8(p + nRemaining - 16), Read8(p + nRemaining - 8),
+      ullSeed, ullLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Hash function - Hashes nLength bytes in one go.
+//
+
+static uint64_t Hash(const unsigned char* p, size_t nLength,
+    uint64_t ullSeed) {
+  ullSeed = MixSeed(ullSeed);
+
+  if (nLength <= 16) {
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (nLength >= 4) {
+      const size_t MIDDLE = (nLength >> 3) << 2;
+      a = (Read4(p) << 32) | Read4(p + MIDDLE);
+      b = (Read4(p + nLength - 4) << 32) | Read4(p + nLength - 4 - MIDDLE);
+    } else if (nLength > 0) {
+      a = ((uint64_t) p[0] << 16) | ((uint64_t) p[nLength >> 1] << 8)
+          | p[nLength - 1];
+    }
+    return Finish(a, b, ullSeed, nLength);
+  }
+
+  size_t nRemaining = nLength;
+  if (nRemaining > STRIPE_SIZE) {
+    uint64_t ullLanes[3] = { ullSeed, ullSeed, ullSeed };
+    do {
+      MixStripe(ullLanes, p);
+      p += STRIPE_SIZE;
+      nRemaining -= STRIPE_SIZE;
+    } while (nRemaining > STRIPE_SIZE);
+    ullSeed = ullLanes[0] ^ ullLanes[1] ^ ullLanes[2];
+  }
+
+  return HashTail(p, nRemaining, ullSeed, nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FoldAscii function - Copies bytes, replacing 'A'-'Z' with 'a'-'z', eight
+// at a time: adding 0x3f and 0x25 to the low seven bits of each byte sets its
+// top bit from 'A' and past 'Z' respectively, without carries between bytes.
+//
+
+static inline void FoldAscii(unsigned char* pDest, const unsigned char* pSrc,
+    size_t nLength) {
+  const uint64_t ONES = 0x0101010101010101ULL;
+  size_t i = 0;
+
+  for (; i + 8 <= nLength; i += 8) {
+    uint64_t x;
+    memcpy(&x, pSrc + i, 8);
+    const uint64_t LOW = x & (0x7f * ONES);
+    const uint64_t UPPER = ((LOW + 0x3f * ONES) ^ (LOW + 0x25 * ONES)) & ~x
+        & (0x80 * ONES);
+    x |= UPPER >> 2;
+    memcpy(pDest + i, &x, 8);
+  }
+
+  for (; i < nLength; i++) {
+    pDest[i] = pSrc[i] | ((unsigned char) (pSrc[i] - 'A') < 26) << 5;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Update function - Feeds bytes to a streamed hash.  A stripe is hashed
+// only once it is known not to be the last 48 bytes of the input, since the
+// one-shot hash handles those differently.
+//
+
+static void Update(LPSTRING_HASH_STATE pState, const unsigned char* p,
+    size_t nLength) {
+  pState->ullLength += nLength;
+
+  while (nLength > 0) {
+    if (pState->nPending == STRIPE_SIZE) {
+      MixStripe(pState->ullLanes, pState->buffer + 16);
+      memcpy(pState->buffer, pState->buffer + STRIPE_SIZE, 16);
+      pState->nPending = 0;
+    }
+
+    /* Stripes wholly in the input need not pass through the buffer */
+    if (pState->nPending == 0 && nLength > STRIPE_SIZE) {
+      do {
+        MixStripe(pState->ullLanes, p);
+        p += STRIPE_SIZE;
+        nLength -= STRIPE_SIZE;
+      } while (nLength > STRIPE_SIZE);
+      memcpy(pState->buffer, p - 16, 16);
+    }
+
+    const size_t TAKE = SmallerOf(STRIPE_SIZE - pState->nPending, nLength);
+    memcpy(pState->buffer + 16 + pState->nPending, p, TAKE);
+    pState->nPending += TAKE;
+    p += TAKE;
+    nLength -= TAKE;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashNoCase function - Hashes nLength bytes folded to lowercase, in one go
+// if they fit in a chunk and streamed otherwise.
+//
+
+static uint64_t HashNoCase(const unsigned char* p, size_t nLength,
+    uint64_t ullSeed) {
+  unsigned char folded[FOLD_CHUNK_SIZE];
+
+  if (nLength <= sizeof(folded)) {
+    FoldAscii(folded, p, nLength);
+    return Hash(folded, nLength, ullSeed);
+  }
+
+  STRING_HASH_STATE state;
+  BeginStringHash(&state, ullSeed);
+  while (nLength > 0) {
+    const size_t CHUNK = SmallerOf(sizeof(folded), nLength);
+    FoldAscii(folded, p, CHUNK);
+    Update(&state, folded, CHUNK);
+    p += CHUNK;
+    nLength -= CHUNK;
+  }
+  return EndStringHash(&state);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// BeginStringHash function
+
+void BeginStringHash(LPSTRING_HASH_STATE pState, uint64_t ullSeed) {
+  if (pState == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "BeginStringHash: pState");
+    return;
+  }
+
+  memset(pState, 0, sizeof(STRING_HASH_STATE));
+  pState->ullSeed = ullSeed;
+
+  const uint64_t MIXED_SEED = MixSeed(ullSeed);
+  for (int i = 0; i < 3; i++) {
+    pState->ullLanes[i] = MIXED_SEED;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// EndStringHash function
+
+uint64_t EndStringHash(const STRING_HASH_STATE* pState) {
+  if (pState == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "EndStringHash: pState");
+    return 0;
+  }
+
+  /* Up to 48 bytes, nothing has been hashed yet: they are all pending */
+  if (pState->ullLength <= STRIPE_SIZE) {
+    return Hash(pState->buffer + 16, pState->nPending, pState->ullSeed);
+  }
+
+  return HashTail(pState->buffer + 16, pState->nPending,
+      pState->ullLanes[0] ^ pState->ullLanes[1] ^ pState->ullLanes[2],
+      pState->ullLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashBytes function
+
+uint64_t HashBytes(const void* pvData, size_t nLength) {
+  CORE_PROBE(CORE_FN_HASH_BYTES);
+
+  if (pvData == NULL && nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "HashBytes: pvData");
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  return Hash((const unsigned char*) pvData, nLength,
+      STRING_HASH_DEFAULT_SEED);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashBytesNoCase function
+
+uint64_t HashBytesNoCase(const void* pvData, size_t nLength) {
+  CORE_PROBE(CORE_FN_HASH_BYTES_NO_CASE);
+
+  if (pvData == NULL && nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "HashBytesNoCase: pvData");
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  return HashNoCase((const unsigned char*) pvData, nLength,
+      STRING_HASH_DEFAULT_SEED);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashBytesNoCaseSeeded function
+
+uint64_t HashBytesNoCaseSeeded(const void* pvData, size_t nLength,
+    uint64_t ullSeed) {
+  CORE_PROBE(CORE_FN_HASH_BYTES_NO_CASE_SEEDED);
+
+  if (pvData == NULL && nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "HashBytesNoCaseSeeded: pvData");
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  return HashNoCase((const unsigned char*) pvData, nLength, ullSeed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashBytesSeeded function
+
+uint64_t HashBytesSeeded(const void* pvData, size_t nLength,
+    uint64_t ullSeed) {
+  CORE_PROBE(CORE_FN_HASH_BYTES_SEEDED);
+
+  if (pvData == NULL && nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "HashBytesSeeded: pvData");
+    return 0;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  return Hash((const unsigned char*) pvData, nLength, ullSeed);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashString function
+
+uint64_t HashString(const char* pszString) {
+  CORE_PROBE(CORE_FN_HASH_STRING);
+
+  const size_t LENGTH = pszString == NULL ? 0 : strlen(pszString);
+  CORE_PROBE_BYTES(LENGTH);
+
+  return Hash((const unsigned char*) pszString, LENGTH,
+      STRING_HASH_DEFAULT_SEED);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashStringNoCase function
+
+uint64_t HashStringNoCase(const char* pszString) {
+  CORE_PROBE(CORE_FN_HASH_STRING_NO_CASE);
+
+  const size_t LENGTH = pszString == NULL ? 0 : strlen(pszString);
+  CORE_PROBE_BYTES(LENGTH);
+
+  return HashNoCase((const unsigned char*) pszString, LENGTH,
+      STRING_HASH_DEFAULT_SEED);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UpdateStringHash function
+
+void UpdateStringHash(LPSTRING_HASH_STATE pState, const void* pvData,
+    size_t nLength) {
+  CORE_PROBE(CORE_FN_UPDATE_STRING_HASH);
+
+  if (pState == NULL || (pvData == NULL && nLength > 0)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "UpdateStringHash: pState and/or pvData");
+    return;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  Update(pState, (const unsigned char*) pvData, nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UpdateStringHashNoCase function
+
+void UpdateStringHashNoCase(LPSTRING_HASH_STATE pState, const void* pvData,
+    size_t nLength) {
+  CORE_PROBE(CORE_FN_UPDATE_STRING_HASH_NO_CASE);
+
+  if (pState == NULL || (pvData == NULL && nLength > 0)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "UpdateStringHashNoCase: pState and/or pvData");
+    return;
+  }
+
+  CORE_PROBE_BYTES(nLength);
+
+  const unsigned char* p = (const unsigned char*) pvData;
+  unsigned char folded[FOLD_CHUNK_SIZE];
+  while (nLength > 0) {
+    const size_t CHUNK = SmallerOf(sizeof(folded), nLength);
+    FoldAscii(folded, p, CHUNK);
+    Update(pState, folded, CHUNK);
+    p += CHUNK;
+    nLength -= CHUNK;
+  }
+}
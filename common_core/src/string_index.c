@@ -0,0 +1,845 @@
+// string_index.c - Implementation of read-only, prefix-compressed sorted string lists
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "string_index.h"
+#include "core_alloc.h"
+#include "core_image.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Number of characters of a block head kept in its node, as 64-bit words */
+#define HEAD_WORDS              2
+
+/* A node of the search tree over the block heads.  Every string starts with
+ * the index's common prefix, so the node keeps the characters that follow
+ * it, which tell heads apart far more often; only heads that tie with the
+ * key on all of them are read.  The tree is stored in Eytzinger order: node
+ * 1 is the root, and the children of node k are nodes 2k and 2k + 1; node 0
+ * is unused.  An in-order walk visits the heads in order.  The block of
+ * node k is kept apart, in pnNodeBlocks[k], so that four nodes fit in a
+ * cache line. */
+typedef struct _INDEX_NODE {
+  uint64_t ullHead[HEAD_WORDS]; /* characters of the head after the common
+                                   prefix, packed most significant first,
+                                   zero-padded */
+} INDEX_NODE;
+
+/* The header and the four arrays live in one block: the nodes, then the
+ * block of each node, then the offset of each block's data (and of the end
+ * of the data), then the data.
+ * A block's data is a run of entries, each the length of the prefix shared
+ * with the string before (zero for the head), then the length of the rest
+ * of the string, both as 7-bit varints, then the rest of the string. */
+struct _STRING_INDEX {
+  int nCount;
+  int nBlocks;
+  uint32_t nCommonLength;       /* length of the prefix all strings share */
+  const INDEX_NODE* pNodes;
+  const uint32_t* pnNodeBlocks;
+  const uint32_t* pnBlockOffsets;
+  const unsigned char* pbData;
+  IMAGE_MAPPING mapping;        /* the file the arrays lie in, if mapped */
+};
+
+/* The payload of a file holding an index: this header, then the nodes, the
+ * node blocks, the block offsets and the data, each as it lies in memory */
+typedef struct _INDEX_IMAGE {
+  uint32_t nBlockSize;          /* STRING_INDEX_BLOCK_SIZE of the writer */
+  uint32_t nHeadWords;          /* HEAD_WORDS of the writer */
+  uint32_t nCount;
+  uint32_t nBlocks;
+  uint32_t nCommonLength;
+  uint32_t nDataSize;
+  uint64_t ullReserved;         /* zero */
+} INDEX_IMAGE;
+
+/* A key being searched for.  In prefix mode, strings that start with the
+ * key count as less than it, so that searching finds the end of the range
+ * of strings that start with it. */
+typedef struct _INDEX_KEY {
+  const unsigned char* pch;
+  size_t nLength;
+  uint64_t ullPacked[HEAD_WORDS];       /* packed as the heads are, from
+                                           the end of the common prefix */
+  uint64_t ullMask[HEAD_WORDS];         /* bits of ullPacked that a head
+                                           must match */
+  BOOL bPrefix;
+} INDEX_KEY;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// PackPrefix function - Packs the first eight characters of a string, most
+// significant first, so that comparing the packed values compares the
+// characters.
+//
+
+static inline uint64_t PackPrefix(const unsigned char* pch, size_t nLength) {
+  uint64_t ullPacked = 0;
+  for (size_t i = 0; i < 8 && i < nLength; i++) {
+    ullPacked |= (uint64_t) pch[i] << (56 - 8 * i);
+  }
+  return ullPacked;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PackHead function - Packs the first HEAD_WORDS * 8 characters of a string
+// into as many words.
+//
+
+static inline void PackHead(uint64_t* pullPacked, const unsigned char* pch,
+    size_t nLength) {
+  for (size_t w = 0; w < HEAD_WORDS; w++) {
+    pullPacked[w] = nLength > 8 * w ? PackPrefix(pch + 8 * w, nLength - 8 * w)
+        : 0;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MakeIndexKey function - Sets a key up for searching an index.
+//
+
+static void MakeIndexKey(const STRING_INDEX* pIndex, INDEX_KEY* pKey,
+    STRING_VIEW view, BOOL bPrefix) {
+  const size_t COMMON = pIndex->nCommonLength;
+  pKey->pch = (const unsigned char*) view.pchData;
+  pKey->nLength = view.pchData == NULL ? 0 : view.nLength;
+  pKey->bPrefix = bPrefix;
+
+  /* A prefix matches heads on its own characters only */
+  const size_t REST = pKey->nLength > COMMON ? pKey->nLength - COMMON : 0;
+  PackHead(pKey->ullPacked, REST > 0 ? pKey->pch + COMMON : NULL, REST);
+  for (size_t w = 0; w < HEAD_WORDS; w++) {
+    const size_t WORD_LENGTH = REST > 8 * w ? REST - 8 * w : 0;
+    pKey->ullMask[w] = ~0ULL;
+    if (bPrefix && WORD_LENGTH < 8) {
+      pKey->ullMask[w] = WORD_LENGTH == 0 ? 0
+          : ~0ULL << (64 - 8 * WORD_LENGTH);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetVarintSize function - Gets the number of bytes WriteVarint writes.
+//
+
+static inline size_t GetVarintSize(size_t nValue) {
+  size_t nSize = 1;
+  while (nValue >= 0x80) {
+    nValue >>= 7;
+    nSize++;
+  }
+  return nSize;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// WriteVarint function - Writes a value seven bits at a time, least
+// significant first, with the high bit set on every byte but the last.
+//
+
+static inline unsigned char* WriteVarint(unsigned char* pb, size_t nValue) {
+  while (nValue >= 0x80) {
+    *pb++ = (unsigned char) (nValue | 0x80);
+    nValue >>= 7;
+  }
+  *pb++ = (unsigned char) nValue;
+  return pb;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadVarint function - Reads a value written by WriteVarint from data that
+// ends at pbEnd.  Returns SIZE_MAX if the value runs past pbEnd or does not
+// fit, which only a damaged file can make happen.  Lengths are nearly all
+// under 128, so the single byte is read first.
+//
+
+static inline size_t ReadVarint(const unsigned char** ppb,
+    const unsigned char* pbEnd) {
+  const unsigned char* pb = *ppb;
+  if (pb < pbEnd && *pb < 0x80) {
+    *ppb = pb + 1;
+    return *pb;
+  }
+
+  size_t nValue = 0;
+  for (int nShift = 0; pb < pbEnd && nShift < (int) (8 * sizeof(size_t));
+      nShift += 7) {
+    nValue |= (size_t) (*pb & 0x7f) << nShift;
+    if ((*pb++ & 0x80) == 0) {
+      *ppb = pb;
+      return nValue;
+    }
+  }
+  *ppb = pb;
+  return SIZE_MAX;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ReadEntry function - Reads the two lengths that start an entry of a
+// block, leaving *ppb at the rest of its string.  Returns FALSE if the entry
+// runs past pbEnd.
+//
+
+static inline BOOL ReadEntry(const unsigned char** ppb,
+    const unsigned char* pbEnd, size_t* pnShared, size_t* pnRest) {
+  *pnShared = ReadVarint(ppb, pbEnd);
+  *pnRest = ReadVarint(ppb, pbEnd);
+  return *pnShared != SIZE_MAX && *pnRest <= (size_t) (pbEnd - *ppb);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetBlockData function - Gets where the data of a block begins and ends.
+// Returns FALSE if the block, or its data, lies outside the index, which
+// only a damaged file can make happen; a lookup that meets one gives a
+// wrong answer rather than read outside the file.
+//
+
+static inline BOOL GetBlockData(const STRING_INDEX* pIndex, uint32_t nBlock,
+    const unsigned char** ppb, const unsigned char** ppbEnd) {
+  if (nBlock >= (uint32_t) pIndex->nBlocks
+      || pIndex->pnBlockOffsets[nBlock] > pIndex->pnBlockOffsets[nBlock + 1]
+      || pIndex->pnBlockOffsets[nBlock + 1]
+          > pIndex->pnBlockOffsets[pIndex->nBlocks]) {
+    return FALSE;
+  }
+
+  *ppb = pIndex->pbData + pIndex->pnBlockOffsets[nBlock];
+  *ppbEnd = pIndex->pbData + pIndex->pnBlockOffsets[nBlock + 1];
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetSharedLength function - Gets the length of the prefix two strings
+// share.
+//
+
+static inline size_t GetSharedLength(const char* pszLeft,
+    const char* pszRight) {
+  size_t nShared = 0;
+  while (pszLeft[nShared] != '\0' && pszLeft[nShared] == pszRight[nShared]) {
+    nShared++;
+  }
+  return nShared;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsBeforeKey function - Tells whether a string, whose characters from
+// nFrom on are at pchRest and which is known to match the key up to nFrom,
+// orders before the key.  Stores how far the two match.
+//
+
+static inline BOOL IsBeforeKey(const unsigned char* pchRest, size_t nFrom,
+    size_t nLength, const INDEX_KEY* pKey, size_t* pnMatched) {
+  size_t nMatched = nFrom;
+  while (nMatched < nLength && nMatched < pKey->nLength
+      && pchRest[nMatched - nFrom] == pKey->pch[nMatched]) {
+    nMatched++;
+  }
+  *pnMatched = nMatched;
+
+  if (nMatched == pKey->nLength) {
+    return pKey->bPrefix;
+  }
+  if (nMatched == nLength) {
+    return TRUE;
+  }
+  return pchRest[nMatched - nFrom] < pKey->pch[nMatched];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsHeadAfterKey function - Tells whether the head of a node's block orders
+// after a key that starts with the common prefix, reading the head itself
+// only if the characters the node keeps do not tell.
+//
+
+static inline BOOL IsHeadAfterKey(const STRING_INDEX* pIndex, size_t k,
+    const INDEX_KEY* pKey) {
+  for (size_t w = 0; w < HEAD_WORDS; w++) {
+    const uint64_t HEAD = pIndex->pNodes[k].ullHead[w] & pKey->ullMask[w];
+    const uint64_t KEY = pKey->ullPacked[w] & pKey->ullMask[w];
+    if (HEAD != KEY) {
+      return HEAD > KEY;
+    }
+  }
+
+  const unsigned char* pb = NULL;
+  const unsigned char* pbEnd = NULL;
+  size_t nShared = 0;
+  size_t nLength = 0;
+  const size_t COMMON = pIndex->nCommonLength;
+  if (!GetBlockData(pIndex, pIndex->pnNodeBlocks[k], &pb, &pbEnd)
+      || !ReadEntry(&pb, pbEnd, &nShared, &nLength) || nLength < COMMON) {
+    return TRUE;
+  }
+
+  size_t nMatched = 0;
+  if (IsBeforeKey(pb + COMMON, COMMON, nLength, pKey, &nMatched)) {
+    return FALSE;
+  }
+  return nMatched != pKey->nLength || nMatched != nLength;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SeekInBlock function - Finds the first string of a block that does not
+// order before the key, decoding the block as it goes, but not rebuilding
+// its strings.  Returns its position in the block, or the number of strings
+// in the block if there is none.  Sets *pbEqual if the string found equals
+// the key.
+//
+
+static int SeekInBlock(const STRING_INDEX* pIndex, int nBlock,
+    const INDEX_KEY* pKey, BOOL* pbEqual) {
+  const unsigned char* pb = NULL;
+  const unsigned char* pbEnd = NULL;
+  size_t nMatched = 0;
+  int i = 0;
+
+  *pbEqual = FALSE;
+  if (!GetBlockData(pIndex, (uint32_t) nBlock, &pb, &pbEnd)) {
+    return 0;
+  }
+
+  for (; pb < pbEnd; i++) {
+    size_t nShared = 0;
+    size_t nRest = 0;
+    if (!ReadEntry(&pb, pbEnd, &nShared, &nRest)) {
+      return i;
+    }
+
+    const unsigned char* pchRest = pb;
+    pb += nRest;
+
+    /* The string before matched the key up to nMatched, then ordered before
+     * it.  A string that parts from it sooner orders after it, and so after
+     * the key; one that parts from it later orders before the key, too. */
+    if (nShared < nMatched) {
+      return i;
+    }
+    if (nShared > nMatched) {
+      continue;
+    }
+
+    if (!IsBeforeKey(pchRest, nShared, nShared + nRest, pKey, &nMatched)) {
+      *pbEqual = nMatched == pKey->nLength && nMatched == nShared + nRest;
+      return i;
+    }
+  }
+
+  return i;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SeekIndex function - Finds the rank of the first string of the index that
+// does not order before the key.  Sets *pbEqual if that string equals the
+// key.
+//
+
+static int SeekIndex(const STRING_INDEX* pIndex, const INDEX_KEY* pKey,
+    BOOL* pbEqual) {
+  const size_t NODES = (size_t) pIndex->nBlocks;
+  const size_t COMMON = pIndex->nCommonLength;
+  size_t k = 1;
+
+  /* A key that parts from the common prefix orders before or after every
+   * string, and one that stops short of it is a prefix of every string */
+  *pbEqual = FALSE;
+  if (COMMON > 0) {
+    const unsigned char* pchFirst = NULL;
+    const unsigned char* pbEnd = NULL;
+    size_t nShared = 0;
+    size_t nLength = 0;
+    if (!GetBlockData(pIndex, 0, &pchFirst, &pbEnd)
+        || !ReadEntry(&pchFirst, pbEnd, &nShared, &nLength)
+        || nLength < COMMON) {
+      return 0;
+    }
+
+    const size_t LIMIT = pKey->nLength < COMMON ? pKey->nLength : COMMON;
+    size_t nMatched = 0;
+    while (nMatched < LIMIT && pKey->pch[nMatched] == pchFirst[nMatched]) {
+      nMatched++;
+    }
+    if (nMatched < LIMIT) {
+      return pKey->pch[nMatched] < pchFirst[nMatched] ? 0 : pIndex->nCount;
+    }
+    if (pKey->nLength < COMMON) {
+      return pKey->bPrefix ? pIndex->nCount : 0;
+    }
+  }
+
+  /* Descend to a leaf, going right past heads that do not order after the
+   * key; the nodes two levels down share a cache line, and are fetched
+   * early */
+  while (k <= NODES) {
+    __builtin_prefetch(pIndex->pNodes + 4 * k);
+    k = 2 * k + !IsHeadAfterKey(pIndex, k, pKey);
+  }
+
+  /* Undo the right turns taken after the last left turn, which leaves the
+   * first head that orders after the key; none, if k is zero.  The string
+   * sought is in the block before that head's, or is that head, which does
+   * not equal the key */
+  k >>= __builtin_ffsll(~(long long) k);
+  const uint32_t NEXT_BLOCK = k == 0 ? (uint32_t) pIndex->nBlocks
+      : pIndex->pnNodeBlocks[k];
+
+  if (NEXT_BLOCK == 0) {
+    return 0;
+  }
+  if (NEXT_BLOCK > (uint32_t) pIndex->nBlocks) {
+    return pIndex->nCount;
+  }
+
+  const int POSITION = SeekInBlock(pIndex, (int) NEXT_BLOCK - 1, pKey,
+      pbEqual);
+  return ((int) NEXT_BLOCK - 1) * STRING_INDEX_BLOCK_SIZE + POSITION;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FillNodes function - Stores the block heads in the nodes in Eytzinger
+// order, by walking the tree in order from node k.
+//
+
+static void FillNodes(INDEX_NODE* pNodes, uint32_t* pnNodeBlocks,
+    size_t nNodes, size_t k, char* const* ppszHeads, size_t nCommon,
+    uint32_t* pnNextBlock) {
+  if (k > nNodes) {
+    return;
+  }
+
+  FillNodes(pNodes, pnNodeBlocks, nNodes, 2 * k, ppszHeads, nCommon,
+      pnNextBlock);
+
+  const char* pszHead = ppszHeads[*pnNextBlock * STRING_INDEX_BLOCK_SIZE];
+  PackHead(pNodes[k].ullHead, (const unsigned char*) pszHead + nCommon,
+      strlen(pszHead) - nCommon);
+  pnNodeBlocks[k] = (*pnNextBlock)++;
+
+  FillNodes(pNodes, pnNodeBlocks, nNodes, 2 * k + 1, ppszHeads, nCommon,
+      pnNextBlock);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateStringIndex function
+
+int CreateStringIndex(char* const* ppszStrings, int nCount,
+    LPSTRING_INDEX* ppIndex) {
+  CORE_PROBE(CORE_FN_CREATE_STRING_INDEX);
+
+  if (ppIndex == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "CreateStringIndex: ppIndex");
+    return ERROR;
+  }
+  *ppIndex = NULL;
+
+  if (nCount < 0) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "CreateStringIndex: nCount");
+    return ERROR;
+  }
+
+  if (nCount > 0 && ppszStrings == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "CreateStringIndex: ppszStrings");
+    return ERROR;
+  }
+
+  char** ppszSorted = (char**) malloc(((size_t) nCount + 1) * sizeof(char*));
+  if (ppszSorted == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateStringIndex");
+    return ERROR;
+  }
+
+  for (int i = 0; i < nCount; i++) {
+    if (ppszStrings[i] == NULL) {
+      free(ppszSorted);
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+          "CreateStringIndex: NULL element in ppszStrings");
+      return ERROR;
+    }
+    ppszSorted[i] = ppszStrings[i];
+  }
+
+  if (SortStrings(ppszSorted, nCount, FALSE) != OK) {
+    free(ppszSorted);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateStringIndex");
+    return ERROR;
+  }
+
+  /* Drop the duplicates, and work out the size of the data */
+  int nUnique = 0;
+  size_t nDataSize = 0;
+  for (int i = 0; i < nCount; i++) {
+    if (nUnique > 0 && Equals(ppszSorted[nUnique - 1], ppszSorted[i])) {
+      continue;
+    }
+
+    const size_t LENGTH = strlen(ppszSorted[i]);
+    const size_t SHARED = nUnique % STRING_INDEX_BLOCK_SIZE == 0 ? 0
+        : GetSharedLength(ppszSorted[nUnique - 1], ppszSorted[i]);
+    nDataSize += GetVarintSize(SHARED) + GetVarintSize(LENGTH - SHARED)
+        + LENGTH - SHARED;
+    ppszSorted[nUnique++] = ppszSorted[i];
+  }
+
+  CORE_PROBE_BYTES(nDataSize);
+
+  if (nDataSize > UINT32_MAX) {
+    free(ppszSorted);
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE,
+        "CreateStringIndex: strings too long");
+    return ERROR;
+  }
+
+  /* The header's size is a multiple of the nodes' alignment */
+  const int BLOCKS = (nUnique + STRING_INDEX_BLOCK_SIZE - 1)
+      / STRING_INDEX_BLOCK_SIZE;
+  const size_t NODE_BLOCKS_OFFSET = sizeof(STRING_INDEX)
+      + (BLOCKS + 1) * sizeof(INDEX_NODE);
+  const size_t OFFSETS_OFFSET = NODE_BLOCKS_OFFSET
+      + (BLOCKS + 1) * sizeof(uint32_t);
+  const size_t DATA_OFFSET = OFFSETS_OFFSET + (BLOCKS + 1) * sizeof(uint32_t);
+
+  char* pBlock = (char*) CoreMalloc(DATA_OFFSET + nDataSize,
+      CORE_ALLOC_STRING_INDEX);
+  if (pBlock == NULL) {
+    free(ppszSorted);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateStringIndex");
+    return ERROR;
+  }
+
+  LPSTRING_INDEX pIndex = (LPSTRING_INDEX) pBlock;
+  INDEX_NODE* pNodes = (INDEX_NODE*) (pBlock + sizeof(STRING_INDEX));
+  uint32_t* pnNodeBlocks = (uint32_t*) (pBlock + NODE_BLOCKS_OFFSET);
+  uint32_t* pnBlockOffsets = (uint32_t*) (pBlock + OFFSETS_OFFSET);
+  unsigned char* pbData = (unsigned char*) (pBlock + DATA_OFFSET);
+
+  unsigned char* pb = pbData;
+  for (int i = 0; i < nUnique; i++) {
+    if (i % STRING_INDEX_BLOCK_SIZE == 0) {
+      pnBlockOffsets[i / STRING_INDEX_BLOCK_SIZE] = (uint32_t) (pb - pbData);
+    }
+
+    const size_t LENGTH = strlen(ppszSorted[i]);
+    const size_t SHARED = i % STRING_INDEX_BLOCK_SIZE == 0 ? 0
+        : GetSharedLength(ppszSorted[i - 1], ppszSorted[i]);
+    pb = WriteVarint(pb, SHARED);
+    pb = WriteVarint(pb, LENGTH - SHARED);
+    memcpy(pb, ppszSorted[i] + SHARED, LENGTH - SHARED);
+    pb += LENGTH - SHARED;
+  }
+  pnBlockOffsets[BLOCKS] = (uint32_t) nDataSize;
+
+  /* The strings are sorted, so the first and the last share the prefix they
+   * all share */
+  const size_t COMMON = nUnique == 0 ? 0
+      : GetSharedLength(ppszSorted[0], ppszSorted[nUnique - 1]);
+
+  memset(&pNodes[0], 0, sizeof(INDEX_NODE));
+  pnNodeBlocks[0] = 0;
+  uint32_t nNextBlock = 0;
+  FillNodes(pNodes, pnNodeBlocks, BLOCKS, 1, ppszSorted, COMMON, &nNextBlock);
+
+  pIndex->nCount = nUnique;
+  pIndex->nBlocks = BLOCKS;
+  pIndex->nCommonLength = (uint32_t) COMMON;
+  pIndex->pNodes = pNodes;
+  pIndex->pnNodeBlocks = pnNodeBlocks;
+  pIndex->pnBlockOffsets = pnBlockOffsets;
+  pIndex->pbData = pbData;
+  memset(&pIndex->mapping, 0, sizeof(IMAGE_MAPPING));
+
+  free(ppszSorted);
+
+  *ppIndex = pIndex;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindIndexedPrefix function
+
+int FindIndexedPrefix(const STRING_INDEX* pIndex, STRING_VIEW prefix,
+    int* pnCount) {
+  CORE_PROBE(CORE_FN_FIND_INDEXED_PREFIX);
+
+  if (pIndex == NULL || pnCount == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pIndex == NULL ? "FindIndexedPrefix: pIndex"
+            : "FindIndexedPrefix: pnCount");
+    return STRING_INDEX_NOT_FOUND;
+  }
+
+  CORE_PROBE_BYTES(prefix.nLength);
+
+  INDEX_KEY key;
+  BOOL bEqual = FALSE;
+  MakeIndexKey(pIndex, &key, prefix, FALSE);
+  const int FIRST = SeekIndex(pIndex, &key, &bEqual);
+  MakeIndexKey(pIndex, &key, prefix, TRUE);
+  *pnCount = SeekIndex(pIndex, &key, &bEqual) - FIRST;
+
+  return FIRST;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindIndexedString function
+
+int FindIndexedString(const STRING_INDEX* pIndex, STRING_VIEW key) {
+  CORE_PROBE(CORE_FN_FIND_INDEXED_STRING);
+
+  if (pIndex == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "FindIndexedString: pIndex");
+    return STRING_INDEX_NOT_FOUND;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  INDEX_KEY indexKey;
+  BOOL bEqual = FALSE;
+  MakeIndexKey(pIndex, &indexKey, key, FALSE);
+  const int RANK = SeekIndex(pIndex, &indexKey, &bEqual);
+
+  return bEqual ? RANK : STRING_INDEX_NOT_FOUND;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeStringIndex function
+
+void FreeStringIndex(LPSTRING_INDEX* ppIndex) {
+  CORE_PROBE(CORE_FN_FREE_STRING_INDEX);
+
+  if (ppIndex == NULL || *ppIndex == NULL) {
+    return;
+  }
+
+  UnmapImageFile(&(*ppIndex)->mapping);
+  CoreFree(*ppIndex);
+  *ppIndex = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetIndexedString function - Writes the rest of every string of the block
+// up to the one wanted over the buffer, in order.  A character the string
+// wanted shares with the one before it was last written by the string that
+// put it there, so what is left in the buffer is the string wanted.
+//
+
+int GetIndexedString(const STRING_INDEX* pIndex, int nRank, char* pszBuffer,
+    size_t nSize) {
+  CORE_PROBE(CORE_FN_GET_INDEXED_STRING);
+
+  if (pIndex == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "GetIndexedString: pIndex");
+    return -1;
+  }
+
+  if (nRank < 0 || nRank >= pIndex->nCount) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "GetIndexedString: nRank");
+    return -1;
+  }
+
+  if (pszBuffer == NULL) {
+    nSize = 0;
+  }
+
+  const unsigned char* pb = NULL;
+  const unsigned char* pbEnd = NULL;
+  BOOL bDamaged = !GetBlockData(pIndex,
+      (uint32_t) (nRank / STRING_INDEX_BLOCK_SIZE), &pb, &pbEnd);
+  size_t nLength = 0;
+  for (int i = 0; !bDamaged && i <= nRank % STRING_INDEX_BLOCK_SIZE; i++) {
+    size_t nShared = 0;
+    size_t nRest = 0;
+
+    /* A string shares no more than the whole of the one before it */
+    if (!ReadEntry(&pb, pbEnd, &nShared, &nRest) || nShared > nLength) {
+      bDamaged = TRUE;
+      break;
+    }
+
+    if (nShared + 1 < nSize) {
+      memcpy(pszBuffer + nShared, pb,
+          nShared + nRest < nSize ? nRest : nSize - 1 - nShared);
+    }
+    pb += nRest;
+    nLength = nShared + nRest;
+  }
+
+  if (bDamaged || nLength > INT_MAX) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "GetIndexedString: damaged index");
+    return -1;
+  }
+
+  if (nSize > 0) {
+    pszBuffer[nLength < nSize ? nLength : nSize - 1] = '\0';
+  }
+
+  CORE_PROBE_BYTES(nLength);
+  return (int) nLength;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetIndexedStringRank function
+
+int GetIndexedStringRank(const STRING_INDEX* pIndex, STRING_VIEW key) {
+  CORE_PROBE(CORE_FN_GET_INDEXED_STRING_RANK);
+
+  if (pIndex == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "GetIndexedStringRank: pIndex");
+    return -1;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  INDEX_KEY indexKey;
+  BOOL bEqual = FALSE;
+  MakeIndexKey(pIndex, &indexKey, key, FALSE);
+  return SeekIndex(pIndex, &indexKey, &bEqual);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetStringIndexCount function
+
+int GetStringIndexCount(const STRING_INDEX* pIndex) {
+  return pIndex == NULL ? 0 : pIndex->nCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MapStringIndexFile function
+
+int MapStringIndexFile(const char* pszPath, int nFlags,
+    LPSTRING_INDEX* ppIndex) {
+  CORE_PROBE(CORE_FN_MAP_STRING_INDEX_FILE);
+
+  if (pszPath == NULL || ppIndex == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pszPath == NULL ? "MapStringIndexFile: pszPath"
+            : "MapStringIndexFile: ppIndex");
+    return ERROR;
+  }
+
+  *ppIndex = NULL;
+
+  IMAGE_MAPPING mapping;
+  if (MapImageFile(pszPath, IMAGE_KIND_STRING_INDEX, nFlags, &mapping,
+      "MapStringIndexFile") != OK) {
+    return ERROR;
+  }
+
+  /* The arrays must fill the payload exactly, and the data end where the
+   * last block offset says */
+  const INDEX_IMAGE* pImage = (const INDEX_IMAGE*) mapping.pbPayload;
+  const uint64_t BLOCKS = mapping.nPayloadSize < sizeof(INDEX_IMAGE) ? 0
+      : ((uint64_t) pImage->nCount + STRING_INDEX_BLOCK_SIZE - 1)
+          / STRING_INDEX_BLOCK_SIZE;
+  const uint64_t ARRAYS_SIZE = (BLOCKS + 1)
+      * (sizeof(INDEX_NODE) + 2 * sizeof(uint32_t));
+  const uint32_t* pnBlockOffsets = (const uint32_t*) (mapping.pbPayload
+      + sizeof(INDEX_IMAGE) + (BLOCKS + 1)
+          * (sizeof(INDEX_NODE) + sizeof(uint32_t)));
+  if (mapping.nPayloadSize < sizeof(INDEX_IMAGE)
+      || pImage->nBlockSize != STRING_INDEX_BLOCK_SIZE
+      || pImage->nHeadWords != HEAD_WORDS || pImage->nCount > INT_MAX
+      || pImage->nBlocks != BLOCKS
+      || mapping.nPayloadSize
+          != sizeof(INDEX_IMAGE) + ARRAYS_SIZE + pImage->nDataSize
+      || pnBlockOffsets[BLOCKS] != pImage->nDataSize) {
+    UnmapImageFile(&mapping);
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "MapStringIndexFile: not a string index of this build");
+    return ERROR;
+  }
+
+  LPSTRING_INDEX pIndex = (LPSTRING_INDEX) CoreMalloc(sizeof(STRING_INDEX),
+      CORE_ALLOC_STRING_INDEX);
+  if (pIndex == NULL) {
+    UnmapImageFile(&mapping);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "MapStringIndexFile");
+    return ERROR;
+  }
+
+  const unsigned char* pbArrays = mapping.pbPayload + sizeof(INDEX_IMAGE);
+  pIndex->nCount = (int) pImage->nCount;
+  pIndex->nBlocks = (int) pImage->nBlocks;
+  pIndex->nCommonLength = pImage->nCommonLength;
+  pIndex->pNodes = (const INDEX_NODE*) pbArrays;
+  pIndex->pnNodeBlocks = (const uint32_t*) (pbArrays
+      + (BLOCKS + 1) * sizeof(INDEX_NODE));
+  pIndex->pnBlockOffsets = pnBlockOffsets;
+  pIndex->pbData = pbArrays + ARRAYS_SIZE;
+  pIndex->mapping = mapping;
+
+  CORE_PROBE_BYTES(mapping.nMappingSize);
+
+  *ppIndex = pIndex;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SaveStringIndexFile function
+
+int SaveStringIndexFile(const STRING_INDEX* pIndex, const char* pszPath) {
+  CORE_PROBE(CORE_FN_SAVE_STRING_INDEX_FILE);
+
+  if (pIndex == NULL || pszPath == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        pIndex == NULL ? "SaveStringIndexFile: pIndex"
+            : "SaveStringIndexFile: pszPath");
+    return ERROR;
+  }
+
+  /* The arrays follow one another from the nodes on, whether the index was
+   * built or mapped */
+  INDEX_IMAGE image;
+  memset(&image, 0, sizeof(image));
+  image.nBlockSize = STRING_INDEX_BLOCK_SIZE;
+  image.nHeadWords = HEAD_WORDS;
+  image.nCount = (uint32_t) pIndex->nCount;
+  image.nBlocks = (uint32_t) pIndex->nBlocks;
+  image.nCommonLength = pIndex->nCommonLength;
+  image.nDataSize = pIndex->pnBlockOffsets[pIndex->nBlocks];
+
+  struct iovec pieces[2];
+  pieces[0].iov_base = &image;
+  pieces[0].iov_len = sizeof(image);
+  pieces[1].iov_base = (void*) pIndex->pNodes;
+  pieces[1].iov_len = (size_t) (pIndex->pbData + image.nDataSize
+      - (const unsigned char*) pIndex->pNodes);
+
+  CORE_PROBE_BYTES(sizeof(image) + pieces[1].iov_len);
+
+  return WriteImageFile(pszPath, IMAGE_KIND_STRING_INDEX, pieces, 2,
+      "SaveStringIndexFile");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// VerifyStringIndex function
+
+int VerifyStringIndex(const STRING_INDEX* pIndex) {
+  CORE_PROBE(CORE_FN_VERIFY_STRING_INDEX);
+
+  if (pIndex == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "VerifyStringIndex: pIndex");
+    return ERROR;
+  }
+
+  CORE_PROBE_BYTES(pIndex->mapping.nPayloadSize);
+
+  if (!IsImageChecksumValid(&pIndex->mapping)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "VerifyStringIndex: checksum mismatch");
+    return ERROR;
+  }
+
+  return OK;
+}
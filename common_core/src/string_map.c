@@ -0,0 +1,532 @@
+// string_map.c - Implementation of hash maps keyed by strings
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "string_map.h"
+#include "core_alloc.h"
+#include "core_fold.h"
+#include "core_stats_internal.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Size of the blocks the entries are carved from */
+#ifndef STRING_MAP_BLOCK_SIZE
+#define STRING_MAP_BLOCK_SIZE         (64 * 1024)
+#endif //STRING_MAP_BLOCK_SIZE
+
+/* Slots are probed in groups of GROUP_SIZE, aligned to a multiple of it; a
+ * table has a power of 2 of groups */
+#define GROUP_SIZE                    16
+
+/* Control bytes: a full slot's holds the top seven bits of its key's hash,
+ * so it is never negative */
+#define CTRL_EMPTY                    ((signed char) -128)
+#define CTRL_DELETED                  ((signed char) -2)
+
+#define H2(ullHash)                   ((signed char) ((ullHash) >> 57))
+
+/* Alignment of the entries, and of the values in them */
+#define ENTRY_ALIGNMENT               8
+
+/* A key and its value.  The value follows the header, rounded up to
+ * ENTRY_ALIGNMENT; the key, null-terminated, follows the value. */
+typedef struct _MAP_ENTRY {
+  uint64_t ullHash;
+  size_t nLength;
+} MAP_ENTRY;
+
+typedef struct _MAP_BLOCK {
+  struct _MAP_BLOCK* pNext;
+  size_t nUsed;
+  size_t nSize;
+  _Alignas(ENTRY_ALIGNMENT) char data[];
+} MAP_BLOCK;
+
+struct _STRING_MAP {
+  BOOL bFoldCase;
+  CASE_FOLD fold;                   /* tolower(3), when the map was made */
+  size_t nValueSize;                /* rounded up to ENTRY_ALIGNMENT */
+  size_t nGroupMask;                /* number of groups - 1 */
+  MAP_ENTRY** ppSlots;              /* the slots, then their control bytes */
+  signed char* pCtrl;
+  size_t nCount;
+  size_t nGrowthLeft;               /* empty slots that may still be filled */
+  MAP_BLOCK* pBlocks;               /* block being carved first */
+};
+
+#define VALUE_OF(pEntry)    ((char*) (pEntry) + sizeof(MAP_ENTRY))
+#define KEY_OF(pMap, pEntry) \
+  ((char*) (pEntry) + sizeof(MAP_ENTRY) + (pMap)->nValueSize)
+
+#define NOT_FOUND           ((size_t) -1)
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchGroup function - Gets a mask with bit i set if control byte i of the
+// group equals chCtrl.
+//
+
+static inline unsigned int MatchGroup(const signed char* pGroup,
+    signed char chCtrl) {
+#if defined(__SSE2__)
+  const __m128i GROUP = _mm_loadu_si128((const __m128i*) pGroup);
+  return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(GROUP,
+      _mm_set1_epi8(chCtrl)));
+#else
+  unsigned int nMask = 0;
+  for (int i = 0; i < GROUP_SIZE; i++) {
+    nMask |= (unsigned int) (pGroup[i] == chCtrl) << i;
+  }
+  return nMask;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchGroupFree function - Gets a mask with bit i set if slot i of the
+// group is empty or deleted, i.e., if its control byte is negative.
+//
+
+static inline unsigned int MatchGroupFree(const signed char* pGroup) {
+#if defined(__SSE2__)
+  return (unsigned int) _mm_movemask_epi8(_mm_loadu_si128(
+      (const __m128i*) pGroup));
+#else
+  unsigned int nMask = 0;
+  for (int i = 0; i < GROUP_SIZE; i++) {
+    nMask |= (unsigned int) (pGroup[i] < 0) << i;
+  }
+  return nMask;
+#endif
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// HashKey function - Hashes a key, or its lowercase form if the map folds
+// case.
+//
+
+static inline uint64_t HashKey(const STRING_MAP* pMap, STRING_VIEW key) {
+  return pMap->bFoldCase ? HashFolded(&pMap->fold, key.pchData, key.nLength)
+      : HashBytes(key.pchData, key.nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MatchesKey function - Determines whether an entry holds the key specified.
+//
+
+static inline BOOL MatchesKey(const STRING_MAP* pMap,
+    const MAP_ENTRY* pEntry, uint64_t ullHash, STRING_VIEW key) {
+  if (pEntry->ullHash != ullHash || pEntry->nLength != key.nLength) {
+    return FALSE;
+  }
+
+  if (!pMap->bFoldCase) {
+    return key.nLength == 0
+        || memcmp(KEY_OF(pMap, pEntry), key.pchData, key.nLength) == 0;
+  }
+  return EqualsFolded(&pMap->fold, KEY_OF(pMap, pEntry), key.pchData,
+      key.nLength);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindSlot function - Probes for a key, group by group, until it is found
+// or a group with an empty slot shows that it is absent.  Returns the index
+// of its slot, or NOT_FOUND.
+//
+
+static size_t FindSlot(const STRING_MAP* pMap, uint64_t ullHash,
+    STRING_VIEW key) {
+  const signed char CTRL = H2(ullHash);
+
+  for (size_t g = ullHash & pMap->nGroupMask, nStep = 0; ;
+      g = (g + ++nStep) & pMap->nGroupMask) {
+    const signed char* pGroup = pMap->pCtrl + g * GROUP_SIZE;
+    for (unsigned int nMask = MatchGroup(pGroup, CTRL); nMask != 0;
+        nMask &= nMask - 1) {
+      const size_t SLOT = g * GROUP_SIZE + __builtin_ctz(nMask);
+      if (MatchesKey(pMap, pMap->ppSlots[SLOT], ullHash, key)) {
+        return SLOT;
+      }
+    }
+
+    if (MatchGroup(pGroup, CTRL_EMPTY) != 0) {
+      return NOT_FOUND;
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindFreeSlot function - Gets the first empty or deleted slot of a hash's
+// probe sequence.  The table always has an empty slot.
+//
+
+static size_t FindFreeSlot(const STRING_MAP* pMap, uint64_t ullHash) {
+  for (size_t g = ullHash & pMap->nGroupMask, nStep = 0; ;
+      g = (g + ++nStep) & pMap->nGroupMask) {
+    const unsigned int MASK = MatchGroupFree(pMap->pCtrl + g * GROUP_SIZE);
+    if (MASK != 0) {
+      return g * GROUP_SIZE + __builtin_ctz(MASK);
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MaximumLoad function - Gets how many of nSlots slots may be full before
+// the table is rehashed: seven in eight.
+//
+
+static inline size_t MaximumLoad(size_t nSlots) {
+  return nSlots - nSlots / 8;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AllocateTable function - Allocates the slots and control bytes of a table
+// of nSlots slots, all of them empty.  Returns FALSE if memory ran out.
+//
+
+static BOOL AllocateTable(size_t nSlots, MAP_ENTRY*** pppSlots,
+    signed char** ppCtrl) {
+  MAP_ENTRY** ppSlots = (MAP_ENTRY**) CoreMalloc(nSlots * (sizeof(MAP_ENTRY*)
+      + 1), CORE_ALLOC_STRING_MAP);
+  if (ppSlots == NULL) {
+    return FALSE;
+  }
+
+  *pppSlots = ppSlots;
+  *ppCtrl = (signed char*) (ppSlots + nSlots);
+  memset(*ppCtrl, CTRL_EMPTY, nSlots);
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Rehash function - Moves the entries to a table of nSlots slots, dropping
+// the deleted slots.  Returns FALSE if memory ran out.
+//
+
+static BOOL Rehash(LPSTRING_MAP pMap, size_t nSlots) {
+  const size_t OLD_SLOTS = (pMap->nGroupMask + 1) * GROUP_SIZE;
+  MAP_ENTRY** ppOldSlots = pMap->ppSlots;
+  const signed char* pOldCtrl = pMap->pCtrl;
+
+  if (!AllocateTable(nSlots, &pMap->ppSlots, &pMap->pCtrl)) {
+    return FALSE;
+  }
+
+  pMap->nGroupMask = nSlots / GROUP_SIZE - 1;
+  for (size_t i = 0; i < OLD_SLOTS; i++) {
+    if (pOldCtrl[i] >= 0) {
+      MAP_ENTRY* pEntry = ppOldSlots[i];
+      const size_t SLOT = FindFreeSlot(pMap, pEntry->ullHash);
+      pMap->ppSlots[SLOT] = pEntry;
+      pMap->pCtrl[SLOT] = H2(pEntry->ullHash);
+    }
+  }
+
+  pMap->nGrowthLeft = MaximumLoad(nSlots) - pMap->nCount;
+  CoreFree(ppOldSlots);
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// AllocateEntry function - Carves an entry for a key of nLength characters
+// out of the map's blocks.
+//
+
+static MAP_ENTRY* AllocateEntry(LPSTRING_MAP pMap, size_t nLength) {
+  const size_t SIZE = (sizeof(MAP_ENTRY) + pMap->nValueSize + nLength + 1
+      + ENTRY_ALIGNMENT - 1) / ENTRY_ALIGNMENT * ENTRY_ALIGNMENT;
+
+  MAP_BLOCK* pBlock = pMap->pBlocks;
+  if (pBlock == NULL || pBlock->nSize - pBlock->nUsed < SIZE) {
+    /* Large entries get a block of their own, behind the one being carved */
+    const BOOL LARGE = SIZE > STRING_MAP_BLOCK_SIZE / 4;
+    const BOOL DEDICATED = LARGE && pMap->pBlocks != NULL;
+    const size_t BLOCK_SIZE = LARGE ? SIZE : STRING_MAP_BLOCK_SIZE;
+
+    pBlock = (MAP_BLOCK*) CoreMalloc(sizeof(MAP_BLOCK) + BLOCK_SIZE,
+        CORE_ALLOC_STRING_MAP);
+    if (pBlock == NULL) {
+      return NULL;
+    }
+
+    pBlock->nUsed = 0;
+    pBlock->nSize = BLOCK_SIZE;
+    if (DEDICATED) {
+      pBlock->pNext = pMap->pBlocks->pNext;
+      pMap->pBlocks->pNext = pBlock;
+    } else {
+      pBlock->pNext = pMap->pBlocks;
+      pMap->pBlocks = pBlock;
+    }
+  }
+
+  MAP_ENTRY* pEntry = (MAP_ENTRY*) (pBlock->data + pBlock->nUsed);
+  pBlock->nUsed += SIZE;
+  return pEntry;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// ClearStringMap function
+
+void ClearStringMap(LPSTRING_MAP pMap) {
+  CORE_PROBE(CORE_FN_CLEAR_STRING_MAP);
+
+  if (pMap == NULL) {
+    return;
+  }
+
+  const size_t SLOTS = (pMap->nGroupMask + 1) * GROUP_SIZE;
+  memset(pMap->pCtrl, CTRL_EMPTY, SLOTS);
+  pMap->nCount = 0;
+  pMap->nGrowthLeft = MaximumLoad(SLOTS);
+
+  /* Keep the block being carved, unless it is one entry's own */
+  MAP_BLOCK* pBlock = pMap->pBlocks;
+  if (pBlock != NULL && pBlock->nSize != STRING_MAP_BLOCK_SIZE) {
+    pMap->pBlocks = NULL;
+  } else if (pBlock != NULL) {
+    pBlock = pBlock->pNext;
+    pMap->pBlocks->pNext = NULL;
+    pMap->pBlocks->nUsed = 0;
+  }
+
+  while (pBlock != NULL) {
+    MAP_BLOCK* pNext = pBlock->pNext;
+    CoreFree(pBlock);
+    pBlock = pNext;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CreateStringMap function
+
+int CreateStringMap(BOOL bFoldCase, size_t nValueSize, LPSTRING_MAP* ppMap) {
+  CORE_PROBE(CORE_FN_CREATE_STRING_MAP);
+
+  if (ppMap == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, "CreateStringMap: ppMap");
+    return ERROR;
+  }
+
+  *ppMap = NULL;
+
+  if (nValueSize > STRING_MAP_BLOCK_SIZE) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, "CreateStringMap: nValueSize");
+    return ERROR;
+  }
+
+  LPSTRING_MAP pMap = (LPSTRING_MAP) CoreMalloc(sizeof(STRING_MAP),
+      CORE_ALLOC_STRING_MAP);
+  if (pMap == NULL || !AllocateTable(GROUP_SIZE, &pMap->ppSlots,
+      &pMap->pCtrl)) {
+    CoreFree(pMap);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "CreateStringMap");
+    return ERROR;
+  }
+
+  pMap->bFoldCase = bFoldCase ? TRUE : FALSE;
+  BuildCaseFold(&pMap->fold);
+  pMap->nValueSize = (nValueSize + ENTRY_ALIGNMENT - 1) / ENTRY_ALIGNMENT
+      * ENTRY_ALIGNMENT;
+  pMap->nGroupMask = 0;
+  pMap->nCount = 0;
+  pMap->nGrowthLeft = MaximumLoad(GROUP_SIZE);
+  pMap->pBlocks = NULL;
+
+  *ppMap = pMap;
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindStringMapValue function
+
+void* FindStringMapValue(const STRING_MAP* pMap, STRING_VIEW key) {
+  CORE_PROBE(CORE_FN_FIND_STRING_MAP_VALUE);
+
+  if (pMap == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "FindStringMapValue: pMap");
+    return NULL;
+  }
+
+  if (key.pchData == NULL && key.nLength > 0) {
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  const size_t SLOT = FindSlot(pMap, HashKey(pMap, key), key);
+  return SLOT == NOT_FOUND ? NULL : VALUE_OF(pMap->ppSlots[SLOT]);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeStringMap function
+
+void FreeStringMap(LPSTRING_MAP* ppMap) {
+  CORE_PROBE(CORE_FN_FREE_STRING_MAP);
+
+  if (ppMap == NULL || *ppMap == NULL) {
+    return;
+  }
+
+  LPSTRING_MAP pMap = *ppMap;
+  while (pMap->pBlocks != NULL) {
+    MAP_BLOCK* pNext = pMap->pBlocks->pNext;
+    CoreFree(pMap->pBlocks);
+    pMap->pBlocks = pNext;
+  }
+
+  CoreFree(pMap->ppSlots);
+  CoreFree(pMap);
+  *ppMap = NULL;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetStringMapCount function
+
+size_t GetStringMapCount(const STRING_MAP* pMap) {
+  return pMap == NULL ? 0 : pMap->nCount;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InsertStringMapKey function
+
+void* InsertStringMapKey(LPSTRING_MAP pMap, STRING_VIEW key, BOOL* pbAdded) {
+  CORE_PROBE(CORE_FN_INSERT_STRING_MAP_KEY);
+
+  if (pbAdded != NULL) {
+    *pbAdded = FALSE;
+  }
+
+  if (pMap == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "InsertStringMapKey: pMap");
+    return NULL;
+  }
+
+  if (key.pchData == NULL && key.nLength > 0) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "InsertStringMapKey: key");
+    return NULL;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  const uint64_t HASH = HashKey(pMap, key);
+  const size_t FOUND = FindSlot(pMap, HASH, key);
+  if (FOUND != NOT_FOUND) {
+    return VALUE_OF(pMap->ppSlots[FOUND]);
+  }
+
+  size_t nSlot = FindFreeSlot(pMap, HASH);
+  if (pMap->pCtrl[nSlot] == CTRL_EMPTY && pMap->nGrowthLeft == 0) {
+    /* Double the table, unless deleted slots are what filled it */
+    const size_t SLOTS = (pMap->nGroupMask + 1) * GROUP_SIZE;
+    if (!Rehash(pMap, pMap->nCount < MaximumLoad(SLOTS) / 2 ? SLOTS
+        : 2 * SLOTS)) {
+      SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "InsertStringMapKey");
+      return NULL;
+    }
+    nSlot = FindFreeSlot(pMap, HASH);
+  }
+
+  MAP_ENTRY* pEntry = AllocateEntry(pMap, key.nLength);
+  if (pEntry == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "InsertStringMapKey");
+    return NULL;
+  }
+
+  pEntry->ullHash = HASH;
+  pEntry->nLength = key.nLength;
+  memset(VALUE_OF(pEntry), 0, pMap->nValueSize);
+  if (key.nLength > 0) {
+    memcpy(KEY_OF(pMap, pEntry), key.pchData, key.nLength);
+  }
+  KEY_OF(pMap, pEntry)[key.nLength] = '\0';
+
+  if (pMap->pCtrl[nSlot] == CTRL_EMPTY) {
+    pMap->nGrowthLeft--;
+  }
+  pMap->ppSlots[nSlot] = pEntry;
+  pMap->pCtrl[nSlot] = H2(HASH);
+  pMap->nCount++;
+
+  if (pbAdded != NULL) {
+    *pbAdded = TRUE;
+  }
+  return VALUE_OF(pEntry);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// NextStringMapEntry function
+
+BOOL NextStringMapEntry(const STRING_MAP* pMap, size_t* pnCursor,
+    LPSTRING_VIEW pKey, void** ppvValue) {
+  if (pMap == NULL || pnCursor == NULL) {
+    return FALSE;
+  }
+
+  const size_t SLOTS = (pMap->nGroupMask + 1) * GROUP_SIZE;
+  for (size_t i = *pnCursor; i < SLOTS; i++) {
+    if (pMap->pCtrl[i] >= 0) {
+      const MAP_ENTRY* pEntry = pMap->ppSlots[i];
+      if (pKey != NULL) {
+        *pKey = MakeStringView(KEY_OF(pMap, pEntry), pEntry->nLength);
+      }
+      if (ppvValue != NULL) {
+        *ppvValue = VALUE_OF(pEntry);
+      }
+      *pnCursor = i + 1;
+      return TRUE;
+    }
+  }
+
+  *pnCursor = SLOTS;
+  return FALSE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RemoveStringMapKey function
+
+BOOL RemoveStringMapKey(LPSTRING_MAP pMap, STRING_VIEW key) {
+  CORE_PROBE(CORE_FN_REMOVE_STRING_MAP_KEY);
+
+  if (pMap == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "RemoveStringMapKey: pMap");
+    return FALSE;
+  }
+
+  if (key.pchData == NULL && key.nLength > 0) {
+    return FALSE;
+  }
+
+  CORE_PROBE_BYTES(key.nLength);
+
+  const size_t SLOT = FindSlot(pMap, HashKey(pMap, key), key);
+  if (SLOT == NOT_FOUND) {
+    return FALSE;
+  }
+
+  /* A probe stops at the first group with an empty slot, so if this group
+   * has one, no key lies beyond it and the slot can simply become empty */
+  const signed char* pGroup = pMap->pCtrl + SLOT / GROUP_SIZE * GROUP_SIZE;
+  if (MatchGroup(pGroup, CTRL_EMPTY) != 0) {
+    pMap->pCtrl[SLOT] = CTRL_EMPTY;
+    pMap->nGrowthLeft++;
+  } else {
+    pMap->pCtrl[SLOT] = CTRL_DELETED;
+  }
+
+  pMap->nCount--;
+  return TRUE;
+}
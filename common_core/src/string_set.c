@@ -0,0 +1,339 @@
+// string_set.c - Implementation of set operations on string arrays
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "string_set.h"
+#include "core_alloc.h"
+#include "core_fold.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* How many strings ahead the table slot of a string is prefetched; large
+ * inputs make tables that do not fit in cache */
+#ifndef STRING_SET_PREFETCH_DISTANCE
+#define STRING_SET_PREFETCH_DISTANCE  8
+#endif //STRING_SET_PREFETCH_DISTANCE
+
+typedef enum _SET_OPERATION {
+  SET_INTERSECT,
+  SET_SUBTRACT,
+  SET_UNION
+} SET_OPERATION;
+
+/* One string of the inputs; those of the left array are numbered first,
+ * then those of the right */
+typedef struct _SET_MEMBER {
+  const char* psz;
+  size_t nLength;
+  uint64_t ullHash;
+  BOOL bTaken;                      /* already in an intersection */
+} SET_MEMBER;
+
+/* Open-addressing table of member numbers, probed linearly, and never more
+ * than half full.  A slot holds the high half of the member's hash, which
+ * rules out most unequal members without reading them, above the member's
+ * number plus one; an empty slot holds zero. */
+typedef struct _STRING_SET {
+  SET_MEMBER* pMembers;
+  uint64_t* pullSlots;
+  size_t nMask;
+  const CASE_FOLD* pFold;
+} STRING_SET;
+
+#define SLOT_TAG_MASK     0xffffffff00000000ULL
+#define SLOT_MEMBER(ullSlot)  ((size_t) ((ullSlot) & 0xffffffffULL) - 1)
+
+#define NO_MEMBER         ((size_t) -1)
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// GetArrayBytes function - Gets the size of the arrays of pointers passed in,
+// which is what the probes record.
+//
+
+static inline size_t GetArrayBytes(int nLeft, int nRight) {
+  return ((nLeft < 0 ? 0 : (size_t) nLeft) + (nRight < 0 ? 0
+      : (size_t) nRight)) * sizeof(char*);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadMembers function - Measures and hashes nCount strings into the
+// members.  Returns FALSE if one of the strings is NULL.
+//
+
+static BOOL LoadMembers(SET_MEMBER* pMembers, char* const* ppszStrings,
+    int nCount, const CASE_FOLD* pFold) {
+  for (int i = 0; i < nCount; i++) {
+    if (ppszStrings[i] == NULL) {
+      return FALSE;
+    }
+
+    pMembers[i].psz = ppszStrings[i];
+    pMembers[i].nLength = strlen(ppszStrings[i]);
+    pMembers[i].ullHash = pFold == NULL
+        ? HashBytes(ppszStrings[i], pMembers[i].nLength)
+        : HashFolded(pFold, ppszStrings[i], pMembers[i].nLength);
+    pMembers[i].bTaken = FALSE;
+  }
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindOrAddMember function - Looks a member up, and adds it if the table
+// has no equal one and bAdd is TRUE.  Returns the number of the equal
+// member already there, nMember if the member was added, or NO_MEMBER.
+//
+
+static size_t FindOrAddMember(STRING_SET* pSet, size_t nMember, BOOL bAdd) {
+  const SET_MEMBER* pMember = &pSet->pMembers[nMember];
+  const uint64_t TAG = pMember->ullHash & SLOT_TAG_MASK;
+
+  for (size_t i = pMember->ullHash & pSet->nMask; ;
+      i = (i + 1) & pSet->nMask) {
+    const uint64_t SLOT = pSet->pullSlots[i];
+    if (SLOT == 0) {
+      if (!bAdd) {
+        return NO_MEMBER;
+      }
+      pSet->pullSlots[i] = TAG | (nMember + 1);
+      return nMember;
+    }
+
+    if ((SLOT & SLOT_TAG_MASK) == TAG) {
+      const SET_MEMBER* pOther = &pSet->pMembers[SLOT_MEMBER(SLOT)];
+      if (pOther->nLength == pMember->nLength && (pSet->pFold == NULL
+          ? memcmp(pOther->psz, pMember->psz, pMember->nLength) == 0
+          : EqualsFolded(pSet->pFold, pOther->psz, pMember->psz,
+              pMember->nLength))) {
+        return SLOT_MEMBER(SLOT);
+      }
+    }
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PrefetchSlot function - Starts loading the slot a member's probe begins
+// at, if there is such a member.
+//
+
+static inline void PrefetchSlot(const STRING_SET* pSet, size_t nMember,
+    size_t nEnd) {
+  if (nMember < nEnd) {
+    __builtin_prefetch(&pSet->pullSlots[pSet->pMembers[nMember].ullHash
+        & pSet->nMask]);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// PackResult function - Copies the members chosen, and an array of pointers
+// to them, into a single block.  Returns the block, or NULL if memory ran
+// out.
+//
+
+static char** PackResult(const SET_MEMBER* pMembers, const size_t* pnChosen,
+    size_t nChosen) {
+  size_t nSize = (nChosen + 1) * sizeof(char*);
+  for (size_t i = 0; i < nChosen; i++) {
+    nSize += pMembers[pnChosen[i]].nLength + 1;
+  }
+
+  char** ppszResult = (char**) CoreMalloc(nSize, CORE_ALLOC_STRING_SET);
+  if (ppszResult == NULL) {
+    return NULL;
+  }
+
+  char* pchNext = (char*) (ppszResult + nChosen + 1);
+  for (size_t i = 0; i < nChosen; i++) {
+    const SET_MEMBER* pMember = &pMembers[pnChosen[i]];
+    memcpy(pchNext, pMember->psz, pMember->nLength + 1);
+    ppszResult[i] = pchNext;
+    pchNext += pMember->nLength + 1;
+  }
+  ppszResult[nChosen] = NULL;
+
+  return ppszResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ChooseMembers function - Works out which members an operation's result
+// has, in order.  Returns how many.
+//
+
+static size_t ChooseMembers(STRING_SET* pSet, SET_OPERATION nOperation,
+    size_t nLeft, size_t nRight, size_t* pnChosen) {
+  const size_t COUNT = nLeft + nRight;
+  size_t nChosen = 0;
+
+  /* Intersections and differences look the left strings up among the right
+   * ones, so the right ones go in first */
+  if (nOperation != SET_UNION) {
+    for (size_t i = nLeft; i < COUNT; i++) {
+      PrefetchSlot(pSet, i + STRING_SET_PREFETCH_DISTANCE, COUNT);
+      FindOrAddMember(pSet, i, TRUE);
+    }
+  }
+
+  for (size_t i = 0; i < nLeft; i++) {
+    PrefetchSlot(pSet, i + STRING_SET_PREFETCH_DISTANCE, nLeft);
+    if (nOperation != SET_INTERSECT) {
+      if (FindOrAddMember(pSet, i, TRUE) == i) {
+        pnChosen[nChosen++] = i;
+      }
+      continue;
+    }
+
+    /* The right string found is marked, so that it is taken only once */
+    const size_t FOUND = FindOrAddMember(pSet, i, FALSE);
+    if (FOUND != NO_MEMBER && !pSet->pMembers[FOUND].bTaken) {
+      pSet->pMembers[FOUND].bTaken = TRUE;
+      pnChosen[nChosen++] = i;
+    }
+  }
+
+  if (nOperation == SET_UNION) {
+    for (size_t i = nLeft; i < COUNT; i++) {
+      PrefetchSlot(pSet, i + STRING_SET_PREFETCH_DISTANCE, COUNT);
+      if (FindOrAddMember(pSet, i, TRUE) == i) {
+        pnChosen[nChosen++] = i;
+      }
+    }
+  }
+
+  return nChosen;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RunSetOperation function - Runs a set operation on two arrays and packs
+// its result.  Returns OK, or ERROR with the last-error record set.
+//
+
+static int RunSetOperation(SET_OPERATION nOperation, char* const* ppszLeft,
+    int nLeft, char* const* ppszRight, int nRight, BOOL bFoldCase,
+    char*** pppszResult, int* pnResultCount, const char* pszFunction) {
+  if (pppszResult == NULL || pnResultCount == NULL || nLeft < 0
+      || nRight < 0 || (ppszLeft == NULL && nLeft > 0)
+      || (ppszRight == NULL && nRight > 0)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pszFunction);
+    return ERROR;
+  }
+
+  *pppszResult = NULL;
+  *pnResultCount = 0;
+
+  /* The result is counted in an int, and a union can hold every string */
+  const size_t COUNT = (size_t) nLeft + (size_t) nRight;
+  if (COUNT > INT_MAX) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_RANGE, pszFunction);
+    return ERROR;
+  }
+
+  if (COUNT == 0) {
+    return OK;
+  }
+
+  size_t nSlots = 16;
+  while (nSlots < 2 * COUNT) {
+    nSlots *= 2;
+  }
+
+  STRING_SET set;
+  set.pMembers = (SET_MEMBER*) malloc(COUNT * sizeof(SET_MEMBER));
+  set.pullSlots = (uint64_t*) calloc(nSlots, sizeof(uint64_t));
+  set.nMask = nSlots - 1;
+  size_t* pnChosen = (size_t*) malloc(COUNT * sizeof(size_t));
+  if (set.pMembers == NULL || set.pullSlots == NULL || pnChosen == NULL) {
+    free(set.pMembers);
+    free(set.pullSlots);
+    free(pnChosen);
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, pszFunction);
+    return ERROR;
+  }
+
+  CASE_FOLD fold;
+  set.pFold = NULL;
+  if (bFoldCase) {
+    BuildCaseFold(&fold);
+    set.pFold = &fold;
+  }
+
+  int nResult = OK;
+  if (!LoadMembers(set.pMembers, ppszLeft, nLeft, set.pFold)
+      || !LoadMembers(set.pMembers + nLeft, ppszRight, nRight, set.pFold)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pszFunction);
+    nResult = ERROR;
+  } else {
+    const size_t CHOSEN = ChooseMembers(&set, nOperation, nLeft, nRight,
+        pnChosen);
+    if (CHOSEN > 0) {
+      *pppszResult = PackResult(set.pMembers, pnChosen, CHOSEN);
+      if (*pppszResult == NULL) {
+        SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, pszFunction);
+        nResult = ERROR;
+      } else {
+        *pnResultCount = (int) CHOSEN;
+      }
+    }
+  }
+
+  free(set.pMembers);
+  free(set.pullSlots);
+  free(pnChosen);
+  return nResult;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// IntersectStrings function
+
+int IntersectStrings(char* const* ppszLeft, int nLeft,
+    char* const* ppszRight, int nRight, BOOL bFoldCase, char*** pppszResult,
+    int* pnResultCount) {
+  CORE_PROBE(CORE_FN_INTERSECT_STRINGS);
+  CORE_PROBE_BYTES(GetArrayBytes(nLeft, nRight));
+
+  return RunSetOperation(SET_INTERSECT, ppszLeft, nLeft, ppszRight, nRight,
+      bFoldCase, pppszResult, pnResultCount, "IntersectStrings");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SubtractStrings function
+
+int SubtractStrings(char* const* ppszLeft, int nLeft,
+    char* const* ppszRight, int nRight, BOOL bFoldCase, char*** pppszResult,
+    int* pnResultCount) {
+  CORE_PROBE(CORE_FN_SUBTRACT_STRINGS);
+  CORE_PROBE_BYTES(GetArrayBytes(nLeft, nRight));
+
+  return RunSetOperation(SET_SUBTRACT, ppszLeft, nLeft, ppszRight, nRight,
+      bFoldCase, pppszResult, pnResultCount, "SubtractStrings");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UnionStrings function
+
+int UnionStrings(char* const* ppszLeft, int nLeft, char* const* ppszRight,
+    int nRight, BOOL bFoldCase, char*** pppszResult, int* pnResultCount) {
+  CORE_PROBE(CORE_FN_UNION_STRINGS);
+  CORE_PROBE_BYTES(GetArrayBytes(nLeft, nRight));
+
+  return RunSetOperation(SET_UNION, ppszLeft, nLeft, ppszRight, nRight,
+      bFoldCase, pppszResult, pnResultCount, "UnionStrings");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// UniqueStrings function
+
+int UniqueStrings(char* const* ppszStrings, int nCount, BOOL bFoldCase,
+    char*** pppszResult, int* pnResultCount) {
+  CORE_PROBE(CORE_FN_UNIQUE_STRINGS);
+  CORE_PROBE_BYTES(GetArrayBytes(nCount, 0));
+
+  return RunSetOperation(SET_UNION, ppszStrings, nCount, NULL, 0, bFoldCase,
+      pppszResult, pnResultCount, "UniqueStrings");
+}
@@ -0,0 +1,674 @@
+// string_sort.c - Implementation of sorting of string arrays
+
+#include "stdafx.h"
+#include "common_core.h"
+#include "string_sort.h"
+#include "core_fold.h"
+#include "core_work_pool.h"
+#include "core_stats_internal.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only definitions
+
+/* Groups this small are finished by insertion sort */
+#ifndef STRING_SORT_QUICKSORT_CUTOFF
+#define STRING_SORT_QUICKSORT_CUTOFF  16
+#endif //STRING_SORT_QUICKSORT_CUTOFF
+
+#ifndef STRING_SORT_RADIX_CUTOFF
+#define STRING_SORT_RADIX_CUTOFF      32
+#endif //STRING_SORT_RADIX_CUTOFF
+
+/* A string, and eight of its characters, folded if need be, packed most
+ * significant first so that comparing keys compares the characters.  A key
+ * whose last character is zero is the end of its string. */
+typedef struct _SORT_ITEM {
+  uint64_t ullKey;
+  char* psz;
+} SORT_ITEM;
+
+#define KEY_ENDS_STRING(ullKey)   (((ullKey) & 0xff) == 0)
+
+/* Fewest strings per thread that SortUniqueStrings starts a thread for */
+#ifndef STRING_SORT_PARALLEL_MINIMUM
+#define STRING_SORT_PARALLEL_MINIMUM  16384
+#endif //STRING_SORT_PARALLEL_MINIMUM
+
+/* Sorted runs per thread; more runs balance better, but make the merge
+ * heaps deeper */
+#define STRING_SORT_RUNS_PER_THREAD   4
+
+#define STRING_SORT_MAX_RUNS \
+  (WORK_POOL_MAX_THREADS * STRING_SORT_RUNS_PER_THREAD)
+
+/* Samples taken from each run to choose the splitters of the merge */
+#define STRING_SORT_SAMPLES_PER_RUN   16
+
+/* State shared by the tasks of SortUniqueStrings.  The items are cut into
+ * nRuns runs, which are sorted separately, then merged into the scratch
+ * items in nRuns ranges of values, bounded by the splitters: range r holds
+ * the strings from pSplitters[r - 1] (inclusive) to pSplitters[r]
+ * (exclusive).  Each merge moves the duplicates in its range, which are
+ * all the duplicates there are, since equal strings fall in the same range,
+ * to the back of the range's output.  They are freed only once every merge
+ * is done, since the merges compare strings of each other's ranges when
+ * they look for where their ranges start. */
+typedef struct _UNIQUE_SORT {
+  SORT_ITEM* pItems;
+  SORT_ITEM* pScratch;
+  size_t nItems;
+  size_t nRuns;
+  const SORT_ITEM* pSplitters;        /* nRuns - 1 of them */
+  size_t* pnRangeStarts;              /* where each range's output starts */
+  size_t* pnRangeSizes;               /* how many strings each range has */
+  size_t* pnRangeCounts;              /* how many of them were kept */
+  const CASE_FOLD* pFold;
+} UNIQUE_SORT;
+
+///////////////////////////////////////////////////////////////////////////////
+// Internal-use-only functions
+
+///////////////////////////////////////////////////////////////////////////////
+// LoadKeys function - Caches characters nOffset to nOffset + 7 of each
+// string, which are known to be at least nOffset characters long.
+//
+
+static void LoadKeys(SORT_ITEM* pItems, size_t nItems, size_t nOffset,
+    const CASE_FOLD* pFold) {
+  for (size_t i = 0; i < nItems; i++) {
+    const unsigned char* p = (const unsigned char*) pItems[i].psz + nOffset;
+    uint64_t ullKey = 0;
+    for (int j = 0; j < 8 && p[j] != '\0'; j++) {
+      ullKey |= (uint64_t) (pFold == NULL ? p[j] : pFold->table[p[j]])
+          << (56 - 8 * j);
+    }
+    pItems[i].ullKey = ullKey;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// CompareItems function - Compares two strings that agree up to the
+// characters cached, which start at nOffset.
+//
+
+static inline int CompareItems(const SORT_ITEM* pLeft,
+    const SORT_ITEM* pRight, size_t nOffset, const CASE_FOLD* pFold) {
+  if (pLeft->ullKey != pRight->ullKey) {
+    return pLeft->ullKey < pRight->ullKey ? -1 : 1;
+  }
+  if (KEY_ENDS_STRING(pLeft->ullKey)) {
+    return 0;
+  }
+
+  const unsigned char* pchLeft = (const unsigned char*) pLeft->psz
+      + nOffset + 8;
+  const unsigned char* pchRight = (const unsigned char*) pRight->psz
+      + nOffset + 8;
+  if (pFold == NULL) {
+    return strcmp((const char*) pchLeft, (const char*) pchRight);
+  }
+
+  while (*pchLeft != '\0'
+      && pFold->table[*pchLeft] == pFold->table[*pchRight]) {
+    pchLeft++;
+    pchRight++;
+  }
+  return (int) pFold->table[*pchLeft] - (int) pFold->table[*pchRight];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// InsertionSort function - Sorts a small group of strings that agree up to
+// the characters cached, keeping equal ones in order.
+//
+
+static void InsertionSort(SORT_ITEM* pItems, size_t nItems, size_t nOffset,
+    const CASE_FOLD* pFold) {
+  for (size_t i = 1; i < nItems; i++) {
+    const SORT_ITEM ITEM = pItems[i];
+    size_t j = i;
+    while (j > 0 && CompareItems(&pItems[j - 1], &ITEM, nOffset, pFold) > 0) {
+      pItems[j] = pItems[j - 1];
+      j--;
+    }
+    pItems[j] = ITEM;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MedianOf function - Gets the median of three keys.
+//
+
+static inline uint64_t MedianOf(uint64_t a, uint64_t b, uint64_t c) {
+  if (a > b) {
+    const uint64_t T = a;
+    a = b;
+    b = T;
+  }
+  return c <= a ? a : c >= b ? b : c;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MultikeySort function - Multikey quicksort: partitions strings that agree
+// up to nOffset three ways on their cached characters, and sorts the middle
+// part on the next eight characters.  Recurses into the two smaller parts
+// and loops on the largest, so that the stack stays O(log n) deep.
+//
+
+static void MultikeySort(SORT_ITEM* pItems, size_t nItems, size_t nOffset,
+    const CASE_FOLD* pFold);
+
+static void SortEqualPart(SORT_ITEM* pItems, size_t nItems, size_t nOffset,
+    uint64_t ullKey, const CASE_FOLD* pFold) {
+  if (nItems > 1 && !KEY_ENDS_STRING(ullKey)) {
+    LoadKeys(pItems, nItems, nOffset + 8, pFold);
+    MultikeySort(pItems, nItems, nOffset + 8, pFold);
+  }
+}
+
+static void MultikeySort(SORT_ITEM* pItems, size_t nItems, size_t nOffset,
+    const CASE_FOLD* pFold) {
+  while (nItems > STRING_SORT_QUICKSORT_CUTOFF) {
+    const uint64_t PIVOT = MedianOf(pItems[0].ullKey,
+        pItems[nItems / 2].ullKey, pItems[nItems - 1].ullKey);
+
+    /* [0, nLess) < PIVOT, [nLess, nGreater) == PIVOT, the rest > PIVOT */
+    size_t nLess = 0;
+    size_t nGreater = nItems;
+    for (size_t i = 0; i < nGreater; ) {
+      const SORT_ITEM ITEM = pItems[i];
+      if (ITEM.ullKey < PIVOT) {
+        pItems[i++] = pItems[nLess];
+        pItems[nLess++] = ITEM;
+      } else if (ITEM.ullKey > PIVOT) {
+        pItems[i] = pItems[--nGreater];
+        pItems[nGreater] = ITEM;
+      } else {
+        i++;
+      }
+    }
+
+    SORT_ITEM* pEqual = pItems + nLess;
+    const size_t EQUAL = nGreater - nLess;
+    SORT_ITEM* pGreater = pItems + nGreater;
+    const size_t GREATER = nItems - nGreater;
+
+    if (nLess >= EQUAL && nLess >= GREATER) {
+      SortEqualPart(pEqual, EQUAL, nOffset, PIVOT, pFold);
+      MultikeySort(pGreater, GREATER, nOffset, pFold);
+      nItems = nLess;
+    } else if (GREATER >= EQUAL) {
+      MultikeySort(pItems, nLess, nOffset, pFold);
+      SortEqualPart(pEqual, EQUAL, nOffset, PIVOT, pFold);
+      pItems = pGreater;
+      nItems = GREATER;
+    } else {
+      MultikeySort(pItems, nLess, nOffset, pFold);
+      MultikeySort(pGreater, GREATER, nOffset, pFold);
+      if (KEY_ENDS_STRING(PIVOT)) {
+        return;
+      }
+      pItems = pEqual;
+      nItems = EQUAL;
+      nOffset += 8;
+      LoadKeys(pItems, nItems, nOffset, pFold);
+    }
+  }
+
+  InsertionSort(pItems, nItems, nOffset, pFold);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// RadixSort function - Stable MSD radix sort of strings that agree up to
+// nDepth characters, on character nDepth, which is cached.  pScratch has
+// room for nItems items.  Recurses into all the buckets but the largest,
+// and loops on that one.
+//
+
+static void RadixSort(SORT_ITEM* pItems, SORT_ITEM* pScratch, size_t nItems,
+    size_t nDepth, const CASE_FOLD* pFold) {
+  while (nItems > STRING_SORT_RADIX_CUTOFF) {
+    const int SHIFT = 56 - 8 * (int) (nDepth % 8);
+    size_t nCounts[UCHAR_MAX + 1] = { 0 };
+    for (size_t i = 0; i < nItems; i++) {
+      nCounts[(pItems[i].ullKey >> SHIFT) & 0xff]++;
+    }
+
+    /* Strings that end here are equal, and already in order */
+    if (nCounts[0] == nItems) {
+      return;
+    }
+
+    size_t nStarts[UCHAR_MAX + 1];
+    size_t nNext = 0;
+    size_t nLargest = 1;
+    for (int c = 0; c <= UCHAR_MAX; c++) {
+      nStarts[c] = nNext;
+      nNext += nCounts[c];
+      if (c > 0 && nCounts[c] > nCounts[nLargest]) {
+        nLargest = c;
+      }
+    }
+    const size_t LARGEST_START = nStarts[nLargest];
+
+    if (nCounts[nLargest] < nItems) {
+      for (size_t i = 0; i < nItems; i++) {
+        pScratch[nStarts[(pItems[i].ullKey >> SHIFT) & 0xff]++] = pItems[i];
+      }
+      memcpy(pItems, pScratch, nItems * sizeof(SORT_ITEM));
+
+      for (int c = 1; c <= UCHAR_MAX; c++) {
+        const size_t START = nStarts[c] - nCounts[c];
+        if (c != (int) nLargest && nCounts[c] > 1) {
+          if ((nDepth + 1) % 8 == 0) {
+            LoadKeys(pItems + START, nCounts[c], nDepth + 1, pFold);
+          }
+          RadixSort(pItems + START, pScratch + START, nCounts[c], nDepth + 1,
+              pFold);
+        }
+      }
+    }
+
+    pItems += LARGEST_START;
+    pScratch += LARGEST_START;
+    nItems = nCounts[nLargest];
+    nDepth++;
+    if (nDepth % 8 == 0) {
+      LoadKeys(pItems, nItems, nDepth, pFold);
+    }
+  }
+
+  InsertionSort(pItems, nItems, nDepth / 8 * 8, pFold);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// GetRunStart function - Gets the index of the first item of run r, or the
+// item count, for r equal to the run count.
+//
+
+static inline size_t GetRunStart(const UNIQUE_SORT* pSort, size_t r) {
+  return pSort->nItems * r / pSort->nRuns;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SortRun function - Task that sorts one run, stably, and leaves the first
+// eight characters of each string cached for the merge.
+//
+
+static void SortRun(void* pvSort, size_t r) {
+  const UNIQUE_SORT* pSort = (const UNIQUE_SORT*) pvSort;
+  const size_t START = GetRunStart(pSort, r);
+  const size_t COUNT = GetRunStart(pSort, r + 1) - START;
+
+  LoadKeys(pSort->pItems + START, COUNT, 0, pSort->pFold);
+  RadixSort(pSort->pItems + START, pSort->pScratch + START, COUNT, 0,
+      pSort->pFold);
+  LoadKeys(pSort->pItems + START, COUNT, 0, pSort->pFold);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FindRangeStart function - Finds where range nRange starts in sorted run r:
+// the first string of the run not less than the range's lower splitter.
+//
+
+static size_t FindRangeStart(const UNIQUE_SORT* pSort, size_t r,
+    size_t nRange) {
+  size_t nLow = GetRunStart(pSort, r);
+  size_t nHigh = GetRunStart(pSort, r + 1);
+  if (nRange == 0 || nRange == pSort->nRuns) {
+    return nRange == 0 ? nLow : nHigh;
+  }
+
+  const SORT_ITEM* pSplitter = &pSort->pSplitters[nRange - 1];
+  while (nLow < nHigh) {
+    const size_t MIDDLE = nLow + (nHigh - nLow) / 2;
+    if (CompareItems(&pSort->pItems[MIDDLE], pSplitter, 0, pSort->pFold) < 0) {
+      nLow = MIDDLE + 1;
+    } else {
+      nHigh = MIDDLE;
+    }
+  }
+  return nLow;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// IsMergedBefore function - Tells whether the next string of run a goes
+// before that of run b: the smaller string, or, of equal ones, that of the
+// earlier run, which came earlier in the array.
+//
+
+static inline BOOL IsMergedBefore(const UNIQUE_SORT* pSort,
+    const size_t* pnNext, size_t a, size_t b) {
+  const int ORDER = CompareItems(&pSort->pItems[pnNext[a]],
+      &pSort->pItems[pnNext[b]], 0, pSort->pFold);
+  return ORDER < 0 || (ORDER == 0 && a < b);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SiftDown function - Restores the order of a heap of run numbers, ordered
+// by IsMergedBefore, whose element i may be out of place.
+//
+
+static void SiftDown(const UNIQUE_SORT* pSort, const size_t* pnNext,
+    size_t* pnHeap, size_t nHeap, size_t i) {
+  for (;;) {
+    size_t nFirst = i;
+    const size_t LEFT = 2 * i + 1;
+    const size_t RIGHT = LEFT + 1;
+    if (LEFT < nHeap
+        && IsMergedBefore(pSort, pnNext, pnHeap[LEFT], pnHeap[nFirst])) {
+      nFirst = LEFT;
+    }
+    if (RIGHT < nHeap
+        && IsMergedBefore(pSort, pnNext, pnHeap[RIGHT], pnHeap[nFirst])) {
+      nFirst = RIGHT;
+    }
+    if (nFirst == i) {
+      return;
+    }
+
+    const size_t T = pnHeap[i];
+    pnHeap[i] = pnHeap[nFirst];
+    pnHeap[nFirst] = T;
+    i = nFirst;
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// MergeRange function - Task that merges one range of values out of every
+// run into the scratch items, keeping the first of each set of equal strings
+// and putting the others at the back of the range's output.
+//
+
+static void MergeRange(void* pvSort, size_t nRange) {
+  UNIQUE_SORT* pSort = (UNIQUE_SORT*) pvSort;
+  size_t nNext[STRING_SORT_MAX_RUNS];
+  size_t nEnd[STRING_SORT_MAX_RUNS];
+  size_t nHeap[STRING_SORT_MAX_RUNS];
+  size_t nHeapCount = 0;
+  size_t nOutput = 0;
+  size_t nSize = 0;
+
+  for (size_t r = 0; r < pSort->nRuns; r++) {
+    nNext[r] = FindRangeStart(pSort, r, nRange);
+    nEnd[r] = FindRangeStart(pSort, r, nRange + 1);
+    nOutput += nNext[r] - GetRunStart(pSort, r);
+    nSize += nEnd[r] - nNext[r];
+    if (nNext[r] < nEnd[r]) {
+      nHeap[nHeapCount++] = r;
+    }
+  }
+
+  /* Ranges start where the strings less than them end */
+  pSort->pnRangeStarts[nRange] = nOutput;
+  pSort->pnRangeSizes[nRange] = nSize;
+  size_t nDuplicate = nOutput + nSize;
+
+  for (size_t i = nHeapCount / 2; i-- > 0; ) {
+    SiftDown(pSort, nNext, nHeap, nHeapCount, i);
+  }
+
+  SORT_ITEM* pKept = NULL;
+  while (nHeapCount > 0) {
+    const size_t RUN = nHeap[0];
+    SORT_ITEM* pItem = &pSort->pItems[nNext[RUN]++];
+
+    if (pKept != NULL && CompareItems(pKept, pItem, 0, pSort->pFold) == 0) {
+      pSort->pScratch[--nDuplicate] = *pItem;
+    } else {
+      pKept = &pSort->pScratch[nOutput++];
+      *pKept = *pItem;
+    }
+
+    if (nNext[RUN] == nEnd[RUN]) {
+      nHeap[0] = nHeap[--nHeapCount];
+    }
+    SiftDown(pSort, nNext, nHeap, nHeapCount, 0);
+  }
+
+  pSort->pnRangeCounts[nRange] = nOutput - pSort->pnRangeStarts[nRange];
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// FreeDuplicates function - Task that frees the duplicates one merge found,
+// as FreeStringArray would.
+//
+
+static void FreeDuplicates(void* pvSort, size_t nRange) {
+  UNIQUE_SORT* pSort = (UNIQUE_SORT*) pvSort;
+  SORT_ITEM* pRange = pSort->pScratch + pSort->pnRangeStarts[nRange];
+
+  for (size_t i = pSort->pnRangeCounts[nRange];
+      i < pSort->pnRangeSizes[nRange]; i++) {
+    FreeBuffer((void**) &pRange[i].psz);
+  }
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// ChooseSplitters function - Chooses the nRuns - 1 strings that bound the
+// ranges of values merged, from a sample of every run, so that the ranges
+// are about the same size.  Returns FALSE if memory ran out.
+//
+
+static BOOL ChooseSplitters(UNIQUE_SORT* pSort, SORT_ITEM* pSplitters) {
+  const size_t SAMPLES = pSort->nRuns * STRING_SORT_SAMPLES_PER_RUN;
+  SORT_ITEM* pSamples = (SORT_ITEM*) malloc(SAMPLES * sizeof(SORT_ITEM));
+  if (pSamples == NULL) {
+    return FALSE;
+  }
+
+  for (size_t r = 0; r < pSort->nRuns; r++) {
+    const size_t START = GetRunStart(pSort, r);
+    const size_t COUNT = GetRunStart(pSort, r + 1) - START;
+    for (size_t i = 0; i < STRING_SORT_SAMPLES_PER_RUN; i++) {
+      pSamples[r * STRING_SORT_SAMPLES_PER_RUN + i] = pSort->pItems[START
+          + COUNT * (2 * i + 1) / (2 * STRING_SORT_SAMPLES_PER_RUN)];
+    }
+  }
+
+  MultikeySort(pSamples, SAMPLES, 0, pSort->pFold);
+  for (size_t r = 1; r < pSort->nRuns; r++) {
+    pSplitters[r - 1] = pSamples[r * STRING_SORT_SAMPLES_PER_RUN];
+  }
+  LoadKeys(pSplitters, pSort->nRuns - 1, 0, pSort->pFold);
+
+  free(pSamples);
+  return TRUE;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SortUnique function - Sorts an array of strings on nThreads threads and
+// drops the duplicates.  Returns OK, or ERROR if memory ran out, in which
+// case the array is left as it was.
+//
+
+static int SortUnique(char** ppszStrings, size_t nCount, BOOL bFoldCase,
+    int nThreads, int* pnUniqueCount) {
+  UNIQUE_SORT sort;
+  memset(&sort, 0, sizeof(sort));
+  sort.nItems = nCount;
+  sort.nRuns = 1;
+  if (nThreads > 1) {
+    sort.nRuns = (size_t) nThreads * STRING_SORT_RUNS_PER_THREAD;
+  }
+
+  sort.pItems = (SORT_ITEM*) malloc(2 * nCount * sizeof(SORT_ITEM));
+  SORT_ITEM* pSplitters = (SORT_ITEM*) malloc(sort.nRuns
+      * sizeof(SORT_ITEM));
+  sort.pnRangeStarts = (size_t*) malloc(3 * sort.nRuns * sizeof(size_t));
+  if (sort.pItems == NULL || pSplitters == NULL
+      || sort.pnRangeStarts == NULL) {
+    free(sort.pItems);
+    free(pSplitters);
+    free(sort.pnRangeStarts);
+    return ERROR;
+  }
+
+  sort.pScratch = sort.pItems + nCount;
+  sort.pSplitters = pSplitters;
+  sort.pnRangeSizes = sort.pnRangeStarts + sort.nRuns;
+  sort.pnRangeCounts = sort.pnRangeSizes + sort.nRuns;
+
+  CASE_FOLD fold;
+  if (bFoldCase) {
+    BuildCaseFold(&fold);
+    sort.pFold = &fold;
+  }
+
+  for (size_t i = 0; i < nCount; i++) {
+    sort.pItems[i].psz = ppszStrings[i];
+  }
+
+  RunWorkPool(nThreads, sort.nRuns, SortRun, &sort);
+
+  if (sort.nRuns > 1 && !ChooseSplitters(&sort, pSplitters)) {
+    free(sort.pItems);
+    free(pSplitters);
+    free(sort.pnRangeStarts);
+    return ERROR;
+  }
+
+  /* Nothing can fail from here on, so the duplicates can be freed */
+  RunWorkPool(nThreads, sort.nRuns, MergeRange, &sort);
+  RunWorkPool(nThreads, sort.nRuns, FreeDuplicates, &sort);
+
+  size_t nKept = 0;
+  for (size_t r = 0; r < sort.nRuns; r++) {
+    for (size_t i = 0; i < sort.pnRangeCounts[r]; i++) {
+      ppszStrings[nKept++] = sort.pScratch[sort.pnRangeStarts[r] + i].psz;
+    }
+  }
+  for (size_t i = nKept; i < nCount; i++) {
+    ppszStrings[i] = NULL;
+  }
+
+  *pnUniqueCount = (int) nKept;
+
+  free(sort.pItems);
+  free(pSplitters);
+  free(sort.pnRangeStarts);
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Sort function - Sorts an array of strings, stably or not.  Returns OK,
+// or ERROR with the last-error record set.
+//
+
+static int Sort(char** ppszStrings, int nCount, BOOL bFoldCase,
+    BOOL bStable, const char* pszFunction) {
+  if (nCount < 0 || (ppszStrings == NULL && nCount > 0)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pszFunction);
+    return ERROR;
+  }
+
+  if (nCount == 0) {
+    return OK;
+  }
+
+  SORT_ITEM* pItems = (SORT_ITEM*) malloc((size_t) nCount
+      * (bStable ? 2 : 1) * sizeof(SORT_ITEM));
+  if (pItems == NULL) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, pszFunction);
+    return ERROR;
+  }
+
+  for (int i = 0; i < nCount; i++) {
+    if (ppszStrings[i] == NULL) {
+      free(pItems);
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT, pszFunction);
+      return ERROR;
+    }
+    pItems[i].psz = ppszStrings[i];
+  }
+
+  CASE_FOLD fold;
+  const CASE_FOLD* pFold = NULL;
+  if (bFoldCase) {
+    BuildCaseFold(&fold);
+    pFold = &fold;
+  }
+
+  LoadKeys(pItems, nCount, 0, pFold);
+  if (bStable) {
+    RadixSort(pItems, pItems + nCount, nCount, 0, pFold);
+  } else {
+    MultikeySort(pItems, nCount, 0, pFold);
+  }
+
+  for (int i = 0; i < nCount; i++) {
+    ppszStrings[i] = pItems[i].psz;
+  }
+
+  free(pItems);
+  return OK;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Publicly-exposed functions
+
+///////////////////////////////////////////////////////////////////////////////
+// SortStrings function
+
+int SortStrings(char** ppszStrings, int nCount, BOOL bFoldCase) {
+  CORE_PROBE(CORE_FN_SORT_STRINGS);
+  CORE_PROBE_BYTES(nCount < 0 ? 0 : (size_t) nCount * sizeof(char*));
+
+  return Sort(ppszStrings, nCount, bFoldCase, FALSE, "SortStrings");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SortStringsStable function
+
+int SortStringsStable(char** ppszStrings, int nCount, BOOL bFoldCase) {
+  CORE_PROBE(CORE_FN_SORT_STRINGS_STABLE);
+  CORE_PROBE_BYTES(nCount < 0 ? 0 : (size_t) nCount * sizeof(char*));
+
+  return Sort(ppszStrings, nCount, bFoldCase, TRUE, "SortStringsStable");
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// SortUniqueStrings function
+
+int SortUniqueStrings(char** ppszStrings, int nCount, BOOL bFoldCase,
+    int nThreads, int* pnUniqueCount) {
+  CORE_PROBE(CORE_FN_SORT_UNIQUE_STRINGS);
+  CORE_PROBE_BYTES(nCount < 0 ? 0 : (size_t) nCount * sizeof(char*));
+
+  if (pnUniqueCount == NULL) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "SortUniqueStrings: pnUniqueCount");
+    return ERROR;
+  }
+
+  if (nCount < 0 || (ppszStrings == NULL && nCount > 0)) {
+    SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+        "SortUniqueStrings: ppszStrings");
+    return ERROR;
+  }
+
+  for (int i = 0; i < nCount; i++) {
+    if (ppszStrings[i] == NULL) {
+      SetLastCoreError(CORE_ERROR_INVALID_ARGUMENT,
+          "SortUniqueStrings: ppszStrings");
+      return ERROR;
+    }
+  }
+
+  *pnUniqueCount = 0;
+  if (nCount == 0) {
+    return OK;
+  }
+
+  /* Threads that would get fewer strings than this cost more than they
+   * save */
+  int nLimit = nCount / STRING_SORT_PARALLEL_MINIMUM;
+  nThreads = GetWorkPoolThreadCount(nThreads, nLimit < 1 ? 1 : nLimit);
+
+  if (SortUnique(ppszStrings, (size_t) nCount, bFoldCase, nThreads,
+      pnUniqueCount) != OK) {
+    SetLastCoreError(CORE_ERROR_OUT_OF_MEMORY, "SortUniqueStrings");
+    return ERROR;
+  }
+
+  return OK;
+}